@@ -0,0 +1,120 @@
+"""
+This script measures the scaling of the parallel fluid force evaluation of MulticopterSimulatorItem.
+
+A fleet of quadcopters is simulated in two worlds based on the sample worlds:
+the air world of the Multicopter sample (QuadcopterJoystick.cnoid) with the floor model,
+and the underwater world of the Submersible sample (SubmersibleSample.cnoid) with the Labo1 model
+and the density and viscosity of water. The submersible model itself is not used because it does
+not have the link attributes of MulticopterPlugin.
+
+Each world is simulated with the different numbers of the threads of MulticopterSimulatorItem,
+and the final positions of the quadcopters are checked to be identical to those of the serial evaluation.
+
+Usage: choreonoid -p FluidForceBenchmark.py
+"""
+
+from cnoid.Util import *
+from cnoid.Base import *
+from cnoid.BodyPlugin import *
+from cnoid.MulticopterPlugin import *
+import time
+
+fleetSize = 8
+timeLength = 5.0
+threadCounts = [1, 2, 4, 8]
+
+worlds = [
+    # name, environment model, fluid density [kg/m^3], viscosity [Pa*s]
+    ("Multicopter (air)", "misc/floor.body", 1.293, 1.7e-5),
+    ("Submersible (water)", "Labo1/Labo1.body", 1000.0, 1.0e-3),
+]
+
+def createWorld(name, environmentModel, density, viscosity):
+    worldItem = WorldItem()
+    worldItem.setName(name)
+    RootItem.instance.addChildItem(worldItem)
+
+    environmentItem = BodyItem()
+    environmentItem.load(shareDirectory + "/model/" + environmentModel)
+    worldItem.addChildItem(environmentItem)
+
+    quadcopters = []
+    for i in range(fleetSize):
+        bodyItem = BodyItem()
+        bodyItem.load(shareDirectory + "/model/multicopter/quadcopter.body")
+        bodyItem.setName("quadcopter{}".format(i + 1))
+        bodyItem.body.rootLink.setTranslation([(i % 4) * 0.8, (i // 4) * 0.8, 1.0])
+        bodyItem.body.calcForwardKinematics()
+        bodyItem.notifyKinematicStateChange()
+        worldItem.addChildItem(bodyItem)
+        quadcopters.append(bodyItem)
+
+    worldItem.storeCurrentBodyPositionsAsInitialPositions()
+
+    simulatorItem = AISTSimulatorItem()
+    simulatorItem.setRealtimeSyncMode(0) # NonRealtimeSync
+    simulatorItem.setRecordingMode(SimulatorItem.RecordingMode.NoRecording)
+    simulatorItem.setTimeRangeMode(SimulatorItem.TimeRangeMode.SpecifiedTime)
+    simulatorItem.setTimeLength(timeLength)
+    worldItem.addChildItem(simulatorItem)
+
+    multicopterSimulatorItem = MulticopterSimulatorItem()
+    multicopterSimulatorItem.setFluidDensity(density)
+    multicopterSimulatorItem.setViscosity(viscosity)
+    simulatorItem.addChildItem(multicopterSimulatorItem)
+
+    return (worldItem, simulatorItem, multicopterSimulatorItem, quadcopters)
+
+trials = []
+for world in worlds:
+    for numThreads in threadCounts:
+        trials.append((world, numThreads))
+
+results = {}
+currentTrial = None
+startTime = 0.0
+
+def startNextTrial():
+    global currentTrial, startTime
+    if not trials:
+        finish()
+        return
+    currentTrial = trials.pop(0)
+    (name, model, density, viscosity), numThreads = currentTrial
+    worldItem, simulatorItem, multicopterSimulatorItem, quadcopters = createdWorlds[name]
+    worldItem.restoreInitialBodyPositions()
+    multicopterSimulatorItem.setNumThreads(numThreads)
+    RootItem.instance.selectItem(simulatorItem)
+    startTime = time.perf_counter()
+    simulatorItem.startSimulation()
+
+def onSimulationFinished(isForced):
+    elapsed = time.perf_counter() - startTime
+    (name, model, density, viscosity), numThreads = currentTrial
+    quadcopters = createdWorlds[name][3]
+    positions = [bodyItem.body.rootLink.T.tolist() for bodyItem in quadcopters]
+    if numThreads == 1:
+        results[name] = (elapsed, positions)
+        print("{}: {} quadcopters, {:.1f} s".format(name, fleetSize, timeLength))
+        serialTime = elapsed
+        isIdentical = True
+    else:
+        serialTime, serialPositions = results[name]
+        isIdentical = (positions == serialPositions)
+    print("{:3d} threads: {:.3f} s, speedup {:.2f}{}".format(
+        numThreads, elapsed, serialTime / elapsed, "" if isIdentical else " (the positions differ)"))
+    startNextTrial()
+
+def finish():
+    for connection in connections.values():
+        connection.disconnect()
+    print("All the benchmark trials have been finished.")
+
+createdWorlds = {}
+connections = {}
+for name, model, density, viscosity in worlds:
+    created = createWorld(name, model, density, viscosity)
+    createdWorlds[name] = created
+    connections[name] = created[1].sigSimulationFinished.connect(onSimulationFinished)
+
+startNextTrial()
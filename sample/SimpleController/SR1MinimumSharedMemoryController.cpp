@@ -0,0 +1,92 @@
+/**
+   This program is an example of the controller process connected with SharedMemoryBridgeController.
+   It controls SR1 in the same way as SR1MinimumController. Start the simulation of
+   SR1MinimumSharedMemory.cnoid and run this program.
+
+   Usage: SR1MinimumSharedMemoryController [shared memory name]
+*/
+
+#include <cnoid/SharedMemoryControllerChannel>
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/ExecutablePath>
+#include <vector>
+#include <thread>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+const double pgain[] = {
+    8000.0, 8000.0, 8000.0, 8000.0, 8000.0, 8000.0,
+    3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 
+    8000.0, 8000.0, 8000.0, 8000.0, 8000.0, 8000.0,
+    3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 
+    8000.0, 8000.0, 8000.0 };
+    
+const double dgain[] = {
+    100.0, 100.0, 100.0, 100.0, 100.0, 100.0,
+    100.0, 100.0, 100.0, 100.0, 100.0, 100.0, 100.0,
+    100.0, 100.0, 100.0, 100.0, 100.0, 100.0,
+    100.0, 100.0, 100.0, 100.0, 100.0, 100.0, 100.0,
+    100.0, 100.0, 100.0 };
+
+int main(int argc, char* argv[])
+{
+    string name = (argc >= 2) ? argv[1] : "/cnoid-SR1";
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(shareDir() + "/model/SR1/SR1.body");
+    if(!body){
+        cerr << "The SR1 model cannot be loaded." << endl;
+        return 1;
+    }
+
+    SharedMemoryControllerChannel channel;
+    bool isWaitingMessageShown = false;
+    while(!channel.open(name)){
+        if(!isWaitingMessageShown){
+            cout << "Waiting for the simulation to start ..." << endl;
+            isWaitingMessageShown = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    if(channel.numJoints() != body->numJoints()){
+        cerr << "The body in the simulation is not SR1." << endl;
+        return 1;
+    }
+    cout << "Connected to \"" << name << "\"." << endl;
+
+    const double dt = channel.timeStep();
+    vector<double> qref;
+    vector<double> qold;
+
+    while(!channel.isTerminated()){
+        if(!channel.waitForState(1.0)){
+            continue;
+        }
+        channel.readState(body);
+
+        if(qref.empty()){
+            for(auto& joint : body->joints()){
+                qref.push_back(joint->q());
+            }
+            qold = qref;
+        }
+        for(int i=0; i < body->numJoints(); ++i){
+            Link* joint = body->joint(i);
+            double q = joint->q();
+            double dq = (q - qold[i]) / dt;
+            double u = (qref[i] - q) * pgain[i] + (0.0 - dq) * dgain[i];
+            qold[i] = q;
+            joint->u() = u;
+        }
+
+        channel.writeCommand(body);
+        channel.publishCommand();
+    }
+
+    cout << "The simulation has been finished." << endl;
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/**
+   This program compares the collision geometries of AISTCollisionDetector in the simulation of
+   a model on the floor. The model is simulated with the triangle meshes, the convex hulls and the
+   convex decomposition specified by the "collision_geometry" key of the body information, and the
+   computation time, the number of the contact points and the final position of the root link are shown.
+
+   Usage: ConvexCollisionBenchmark [number of steps] [model file ...]
+*/
+
+#include <cnoid/DyWorld>
+#include <cnoid/DyBody>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MaterialTable>
+#include <cnoid/SceneGraph>
+#include <cnoid/BodyLoader>
+#include <cnoid/CloneMap>
+#include <cnoid/ExecutablePath>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Result
+{
+    double time;
+    double meanNumContacts;
+    Vector3 finalPosition;
+};
+
+DyBodyPtr cloneBody(Body* orgBody)
+{
+    CloneMap cloneMap;
+    DyBodyPtr body = new DyBody;
+    cloneMap.setClone(orgBody, body);
+    body->copyFrom(orgBody, &cloneMap);
+    body->initializeState();
+    body->calcForwardKinematics();
+    return body;
+}
+
+BoundingBox calcBoundingBox(Body* body)
+{
+    BoundingBox bbox;
+    for(auto& link : body->links()){
+        BoundingBox linkBBox = link->collisionShape()->boundingBox();
+        if(!linkBBox.empty()){
+            linkBBox.transform(link->T());
+            bbox.expandBy(linkBBox);
+        }
+    }
+    return bbox;
+}
+
+Result simulate(
+    MaterialTable* materialTable, Body* floor, Body* model, const string& collisionGeometry, int numSteps)
+{
+    DyWorld<ConstraintForceSolver> world;
+    world.setTimeStep(0.001);
+    world.setGravityAcceleration(Vector3(0.0, 0.0, -9.80665));
+
+    auto detector = new AISTCollisionDetector;
+    // The primitive shapes are also detected as the meshes to compare the general narrowphases
+    detector->setPrimitiveCollisionEnabled(false);
+    world.constraintForceSolver.setCollisionDetector(detector);
+    world.constraintForceSolver.setMaterialTable(materialTable);
+
+    auto floorBody = cloneBody(floor);
+    model->info()->write("collision_geometry", collisionGeometry);
+    auto body = cloneBody(model);
+
+    // The model is put on the floor
+    body->rootLink()->p().z() += calcBoundingBox(floorBody).max().z() - calcBoundingBox(body).min().z() + 0.001;
+    body->calcForwardKinematics();
+
+    for(auto& link : body->links()){
+        if(link->jointType() == Link::PseudoContinuousTrackJoint){
+            link->dq_target() = 0.5;
+        } else if(!link->isRoot()){
+            // The joints are kept at the initial positions by the high-gain mode
+            link->setActuationMode(Link::JointDisplacement);
+            link->q_target() = link->q();
+        }
+    }
+
+    for(auto& body : { floorBody, body }){
+        int bodyIndex = world.addBody(body);
+        world.constraintForceSolver.setBodyCollisionDetectionMode(bodyIndex, true, false);
+    }
+    world.initialize();
+
+    Result result;
+    std::chrono::steady_clock::duration time(0);
+    size_t numContacts = 0;
+    for(int i=0; i < numSteps; ++i){
+        world.constraintForceSolver.clearExternalForces();
+        auto start = std::chrono::steady_clock::now();
+        world.calcNextState();
+        time += std::chrono::steady_clock::now() - start;
+        auto collisions = world.constraintForceSolver.getCollisions();
+        for(auto& linkPair : *collisions){
+            numContacts += linkPair->collisions.size();
+        }
+    }
+    result.time = std::chrono::duration<double>(time).count();
+    result.meanNumContacts = static_cast<double>(numContacts) / numSteps;
+    result.finalPosition = body->rootLink()->p();
+
+    return result;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numSteps = (argc >= 2) ? std::stoi(argv[1]) : 2000;
+    vector<string> filenames;
+    for(int i=2; i < argc; ++i){
+        filenames.push_back(argv[i]);
+    }
+    if(filenames.empty()){
+        filenames.push_back(shareDir() + "/model/misc/crawler.body");
+        filenames.push_back(shareDir() + "/model/SR1/SR1.body");
+    }
+
+    BodyLoader loader;
+    BodyPtr floor = loader.load(shareDir() + "/model/misc/floor.body");
+    if(!floor){
+        cerr << "The floor model cannot be loaded." << endl;
+        return 1;
+    }
+
+    MaterialTablePtr materialTable = new MaterialTable;
+    materialTable->load(shareDir() + "/default/materials.yaml", cerr);
+
+    const vector<string> collisionGeometries = { "mesh", "convex_hull", "convex_decomposition" };
+
+    for(auto& filename : filenames){
+        BodyPtr model = loader.load(filename);
+        if(!model){
+            cerr << "The model file \"" << filename << "\" cannot be loaded." << endl;
+            return 1;
+        }
+        cout << model->modelName() << " with " << model->numLinks() << " links, " << numSteps << " steps" << endl;
+        for(auto& collisionGeometry : collisionGeometries){
+            auto result = simulate(materialTable, floor, model, collisionGeometry, numSteps);
+            cout << "  " << setw(22) << left << collisionGeometry << right << fixed
+                 << setprecision(3) << result.time << " s, "
+                 << setprecision(1) << result.meanNumContacts << " contacts per step, root position ("
+                 << setprecision(3) << result.finalPosition.x() << ", " << result.finalPosition.y() << ", "
+                 << result.finalPosition.z() << ")" << endl;
+        }
+    }
+
+    return 0;
+}
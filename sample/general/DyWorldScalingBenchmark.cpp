@@ -0,0 +1,121 @@
+/**
+   This program measures the scaling of the parallel integration of DyWorld.
+   The copies of a model are simulated with the different numbers of the integration threads,
+   and the final states are checked to be bitwise identical to those of the serial integration.
+
+   Usage: DyWorldScalingBenchmark [number of bodies] [number of steps] [model file]
+*/
+
+#include <cnoid/DyWorld>
+#include <cnoid/DyBody>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/BodyLoader>
+#include <cnoid/CloneMap>
+#include <cnoid/ExecutablePath>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+double simulate(Body* orgBody, int numBodies, int numSteps, int numThreads, vector<double>& out_states)
+{
+    DyWorld<ConstraintForceSolver> world;
+    world.setTimeStep(0.001);
+    world.setGravityAcceleration(Vector3(0.0, 0.0, -9.80665));
+    world.setParallelIntegration(numThreads);
+
+    for(int i=0; i < numBodies; ++i){
+        CloneMap cloneMap;
+        DyBodyPtr body = new DyBody;
+        cloneMap.setClone(orgBody, body);
+        body->copyFrom(orgBody, &cloneMap);
+        body->initializeState();
+        body->rootLink()->p().x() += 2.0 * i;
+        // The initial postures are varied so that the bodies do not move in the same way
+        for(auto& joint : body->joints()){
+            joint->q() = 0.01 * ((i + joint->jointId()) % 7);
+            joint->setActuationMode(Link::JointEffort);
+        }
+        body->calcForwardKinematics();
+        int bodyIndex = world.addBody(body);
+        world.constraintForceSolver.setBodyCollisionDetectionMode(bodyIndex, false, false);
+    }
+    world.initialize();
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i < numSteps; ++i){
+        world.constraintForceSolver.clearExternalForces();
+        world.calcNextState();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    out_states.clear();
+    for(int i=0; i < world.numBodies(); ++i){
+        for(auto& link : world.body(i)->links()){
+            out_states.insert(out_states.end(), link->p().data(), link->p().data() + 3);
+            out_states.insert(out_states.end(), link->v().data(), link->v().data() + 3);
+            out_states.insert(out_states.end(), link->w().data(), link->w().data() + 3);
+            out_states.push_back(link->q());
+            out_states.push_back(link->dq());
+        }
+    }
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numBodies = (argc >= 2) ? std::stoi(argv[1]) : 32;
+    int numSteps = (argc >= 3) ? std::stoi(argv[2]) : 1000;
+    string filename = (argc >= 4) ? argv[3] : shareDir() + "/model/SR1/SR1.body";
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(filename);
+    if(!body){
+        cerr << "The model file \"" << filename << "\" cannot be loaded." << endl;
+        return 1;
+    }
+
+    vector<int> threadCounts = { 1, 2, 4, 8 };
+    int numHardwareThreads = std::thread::hardware_concurrency();
+    if(numHardwareThreads > 8){
+        threadCounts.push_back(numHardwareThreads);
+    }
+
+    cout << numBodies << " bodies of " << body->modelName() << " with " << body->numLinks()
+         << " links, " << numSteps << " steps" << endl;
+
+    vector<double> serialStates;
+    vector<double> states;
+    double serialTime = 0.0;
+    bool isDeterministic = true;
+
+    for(auto& numThreads : threadCounts){
+        double time = simulate(body, numBodies, numSteps, numThreads, numThreads == 1 ? serialStates : states);
+        bool isIdentical = true;
+        if(numThreads == 1){
+            serialTime = time;
+        } else {
+            isIdentical =
+                (states.size() == serialStates.size()) &&
+                (std::memcmp(states.data(), serialStates.data(), states.size() * sizeof(double)) == 0);
+            if(!isIdentical){
+                isDeterministic = false;
+            }
+        }
+        cout << setw(3) << numThreads << " threads: " << fixed << setprecision(3) << time << " s, speedup "
+             << setprecision(2) << (serialTime / time) << (isIdentical ? "" : " (the states differ)") << endl;
+    }
+
+    return isDeterministic ? 0 : 1;
+}
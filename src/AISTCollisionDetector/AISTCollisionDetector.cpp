@@ -5,6 +5,7 @@
 
 #include "AISTCollisionDetector.h"
 #include "ColdetModelPair.h"
+#include "ColdetModelCache.h"
 #include <cnoid/IdPair>
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshExtractor>
@@ -12,6 +13,7 @@
 #include <algorithm>
 #include <random>
 #include <set>
+#include <unordered_map>
 
 using namespace std;
 using namespace cnoid;
@@ -42,10 +44,16 @@ class ColdetModelEx : public ColdetModel
 public:
     ReferencedPtr object;
     bool isStatic;
+    bool isSleeping;
     stdx::optional<Isometry3> localPosition;
     ColdetModelExPtr sibling;
     
-    ColdetModelEx() : isStatic(false) { }
+    ColdetModelEx() : isStatic(false), isSleeping(false) { }
+
+    //! The internal model is shared with the original model
+    ColdetModelEx(const ColdetModel& org) : ColdetModel(org), isStatic(false), isSleeping(false) { }
+
+    bool isStaticOrSleeping() const { return isStatic || isSleeping; }
 };
 
 class ColdetModelPairEx;
@@ -84,6 +92,26 @@ public:
     }
 
     ColdetModelPairExPtr sibling;
+
+    /**
+       The pairs of the sleeping geometries are kept so that the pairs do not have to be rebuilt
+       every time a geometry falls asleep or wakes up. Such a pair is skipped while both the
+       geometries are static or sleeping.
+    */
+    bool isStaticPair() {
+        return model(0)->isStaticOrSleeping() && model(1)->isStaticOrSleeping();
+    }
+
+    bool checkCollisionWithSiblings(){
+        ColdetModelPairEx* modelPair = this;
+        do {
+            if(modelPair->checkCollision()){
+                return true;
+            }
+            modelPair = modelPair->sibling;
+        } while(modelPair);
+        return false;
+    }
 };
 
 
@@ -132,16 +160,19 @@ class AISTCollisionDetector::Impl
 public:
     vector<ColdetModelExPtr> models;
     vector<ColdetModelPairExPtr> modelPairs;
+    unordered_map<IdPair<GeometryHandle>, ColdetModelPairEx*> modelPairMap;
     int maxNumThreads;
     set<IdPair<GeometryHandle>> ignoredPairs;
     MeshExtractor* meshExtractor;
+    bool isPrimitiveCollisionEnabled;
     bool isReady;
     CollisionPair collisionPair;
         
     Impl();
     ~Impl();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
-    void addMesh(ColdetModelEx* model);
+    void addMesh(ColdetModel* model);
+    bool setPrimitive(ColdetModel* model, SgMesh* mesh);
     void makeReady();
     void detectCollisions(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback);
     void detectCollisions(const std::function<void(const CollisionPair&)>& callback);
@@ -171,6 +202,7 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetector::Impl::Impl()
 {
     isReady = false;
+    isPrimitiveCollisionEnabled = true;
     maxNumThreads = 0;
     numThreads = 0;
     meshExtractor = new MeshExtractor;
@@ -217,6 +249,7 @@ void AISTCollisionDetector::clearGeometries()
 {
     impl->models.clear();
     impl->modelPairs.clear();
+    impl->modelPairMap.clear();
     impl->ignoredPairs.clear();
     impl->isReady = false;
 }
@@ -237,11 +270,38 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::addGeometry(SgNode* geomet
 stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode* geometry)
 {
     if(geometry){
-        ColdetModelExPtr model = new ColdetModelEx;
-        if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
-            model->setName(geometry->name());
-            model->build();
-            if(model->isValid()){
+        ColdetModelPtr meshModel = new ColdetModel;
+        int numMeshes = 0;
+        SgMesh* primitiveMesh = nullptr;
+        Isometry3 primitivePosition;
+        bool extracted = meshExtractor->extract(
+            geometry,
+            [&](){
+                addMesh(meshModel);
+                if(++numMeshes == 1 && !meshExtractor->isCurrentScaled()){
+                    primitiveMesh = meshExtractor->currentMesh();
+                    primitivePosition = meshExtractor->currentTransformWithoutScaling();
+                }
+            });
+        if(extracted){
+            // The primitive information is only used for the geometry consisting of a single primitive mesh
+            bool hasPrimitive = false;
+            if(isPrimitiveCollisionEnabled && numMeshes == 1 && primitiveMesh){
+                hasPrimitive = setPrimitive(meshModel, primitiveMesh);
+            }
+            /*
+              The model built from the same mesh is shared with the other detectors
+              instead of building the AABB tree again.
+            */
+            ColdetModelPtr builtModel = ColdetModelCache::instance()->findOrBuild(meshModel);
+            if(builtModel->isValid()){
+                ColdetModelExPtr model = new ColdetModelEx(*builtModel);
+                model->setName(geometry->name());
+                if(hasPrimitive){
+                    Eigen::Matrix<double, 3, 3, Eigen::RowMajor> R = primitivePosition.linear();
+                    Vector3 p = primitivePosition.translation();
+                    model->setPrimitivePosition(R.data(), p.data());
+                }
                 models.push_back(model);
                 isReady = false;
                 return getHandle(model);
@@ -252,7 +312,7 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode*
 }
 
 
-void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
+void AISTCollisionDetector::Impl::addMesh(ColdetModel* model)
 {
     SgMesh* mesh = meshExtractor->currentMesh();
     const Affine3& T = meshExtractor->currentTransform();
@@ -277,6 +337,123 @@ void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
 }
 
 
+bool AISTCollisionDetector::Impl::setPrimitive(ColdetModel* model, SgMesh* mesh)
+{
+    switch(mesh->primitiveType()){
+
+    case SgMesh::BoxType: {
+        const Vector3& size = mesh->primitive<SgMesh::Box>().size;
+        if(size.minCoeff() <= 0.0){
+            return false;
+        }
+        model->setPrimitiveType(ColdetModel::SP_BOX);
+        model->setNumPrimitiveParams(3);
+        for(int i=0; i < 3; ++i){
+            model->setPrimitiveParam(i, size[i]);
+        }
+        return true;
+    }
+    case SgMesh::SphereType: {
+        const auto& sphere = mesh->primitive<SgMesh::Sphere>();
+        if(sphere.radius <= 0.0){
+            return false;
+        }
+        model->setPrimitiveType(ColdetModel::SP_SPHERE);
+        model->setNumPrimitiveParams(1);
+        model->setPrimitiveParam(0, sphere.radius);
+        return true;
+    }
+    case SgMesh::CylinderType: {
+        const auto& cylinder = mesh->primitive<SgMesh::Cylinder>();
+        if(cylinder.radius <= 0.0 || cylinder.height <= 0.0 ||
+           !cylinder.top || !cylinder.bottom || !cylinder.side){
+            return false;
+        }
+        model->setPrimitiveType(ColdetModel::SP_CYLINDER);
+        model->setNumPrimitiveParams(2);
+        model->setPrimitiveParam(0, cylinder.radius);
+        model->setPrimitiveParam(1, cylinder.height);
+        return true;
+    }
+    case SgMesh::CapsuleType: {
+        const auto& capsule = mesh->primitive<SgMesh::Capsule>();
+        if(capsule.radius <= 0.0 || capsule.height < 0.0){
+            return false;
+        }
+        model->setPrimitiveType(ColdetModel::SP_CAPSULE);
+        model->setNumPrimitiveParams(2);
+        model->setPrimitiveParam(0, capsule.radius);
+        model->setPrimitiveParam(1, capsule.height);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+
+void AISTCollisionDetector::setPrimitiveCollisionEnabled(bool on)
+{
+    impl->isPrimitiveCollisionEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isPrimitiveCollisionEnabled() const
+{
+    return impl->isPrimitiveCollisionEnabled;
+}
+
+
+bool AISTCollisionDetector::setGeometryConvexHulls(GeometryHandle geometry, int maxNumHulls)
+{
+    bool result = true;
+    auto model = getColdetModel(geometry);
+    do {
+        if(!model->useConvexHulls(maxNumHulls) && maxNumHulls > 0){
+            result = false;
+        }
+        model = model->sibling;
+    } while(model);
+    return result;
+}
+
+
+void AISTCollisionDetector::setModelCacheEnabled(bool on)
+{
+    ColdetModelCache::instance()->setEnabled(on);
+}
+
+
+bool AISTCollisionDetector::isModelCacheEnabled()
+{
+    return ColdetModelCache::instance()->isEnabled();
+}
+
+
+void AISTCollisionDetector::setModelCacheCapacity(int numTriangles)
+{
+    ColdetModelCache::instance()->setCapacity(numTriangles);
+}
+
+
+void AISTCollisionDetector::setModelCacheDirectory(const std::string& directory)
+{
+    ColdetModelCache::instance()->setDirectory(directory);
+}
+
+
+std::string AISTCollisionDetector::modelCacheDirectory()
+{
+    return ColdetModelCache::instance()->directory();
+}
+
+
+void AISTCollisionDetector::clearModelCache()
+{
+    ColdetModelCache::instance()->clear();
+}
+
+
 void AISTCollisionDetector::setCustomObject(GeometryHandle geometry, Referenced* object)
 {
     getColdetModel(geometry)->object = object;
@@ -290,6 +467,12 @@ void AISTCollisionDetector::setGeometryStatic(GeometryHandle geometry, bool isSt
 }
 
 
+void AISTCollisionDetector::setGeometrySleeping(GeometryHandle geometry, bool isSleeping)
+{
+    getColdetModel(geometry)->isSleeping = isSleeping;
+}
+
+
 void AISTCollisionDetector::ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore)
 {
     IdPair<GeometryHandle> idPair(geometry1, geometry2);
@@ -318,6 +501,7 @@ bool AISTCollisionDetector::makeReady()
 void AISTCollisionDetector::Impl::makeReady()
 {
     modelPairs.clear();
+    modelPairMap.clear();
     const int n = models.size();
     for(int i=0; i < n; ++i){
         ColdetModelEx* model1 = models[i];
@@ -326,7 +510,9 @@ void AISTCollisionDetector::Impl::makeReady()
             if(!model1->isStatic || !model2->isStatic){
                 IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
                 if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
-                    modelPairs.push_back(new ColdetModelPairEx(model1, model2));
+                    auto modelPair = new ColdetModelPairEx(model1, model2);
+                    modelPairs.push_back(modelPair);
+                    modelPairMap[handlePair] = modelPair;
                 }
             }
         }
@@ -403,6 +589,9 @@ void AISTCollisionDetector::Impl::detectCollisions
     auto& collisions = collisionPair.collisions();
     
     for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+        if(modelPair->isStaticPair()){
+            continue;
+        }
         collisions.clear();
         do {
             if(getHandle(modelPair->model(0)) == geometry || getHandle(modelPair->model(1)) == geometry){
@@ -442,6 +631,9 @@ void AISTCollisionDetector::Impl::detectCollisions(const std::function<void(cons
     auto& collisions = collisionPair.collisions();
     
     for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+        if(modelPair->isStaticPair()){
+            continue;
+        }
         collisions.clear();
         do {
             if(!modelPair->detectCollisions().empty()){
@@ -457,6 +649,52 @@ void AISTCollisionDetector::Impl::detectCollisions(const std::function<void(cons
 }
 
 
+bool AISTCollisionDetector::checkCollision()
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    for(auto& modelPair : impl->modelPairs){
+        if(!modelPair->isStaticPair() && modelPair->checkCollisionWithSiblings()){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool AISTCollisionDetector::checkCollision(GeometryHandle geometry)
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    for(auto& modelPair : impl->modelPairs){
+        if(getHandle(modelPair->model(0)) == geometry || getHandle(modelPair->model(1)) == geometry){
+            if(!modelPair->isStaticPair() && modelPair->checkCollisionWithSiblings()){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/**
+   \note The check is always false for the pair of static geometries and the ignored pair.
+*/
+bool AISTCollisionDetector::checkCollision(GeometryHandle geometry1, GeometryHandle geometry2)
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    auto p = impl->modelPairMap.find(IdPair<GeometryHandle>(geometry1, geometry2));
+    if(p != impl->modelPairMap.end() && !p->second->isStaticPair()){
+        return p->second->checkCollisionWithSiblings();
+    }
+    return false;
+}
+
+
 void AISTCollisionDetector::Impl::detectCollisionsInParallel(const std::function<void(const CollisionPair&)>& callback)
 {
     if(ENABLE_SHUFFLE){
@@ -499,6 +737,9 @@ void AISTCollisionDetector::Impl::extractCollisionsOfAssignedPairs
         } else {
             modelPair = modelPairs[i];
         }
+        if(modelPair->isStaticPair()){
+            continue;
+        }
 
         collisionPairs.push_back(CollisionPair());
         CollisionPair& collisionPair = collisionPairs.back();
@@ -7,6 +7,7 @@
 #define CNOID_AIST_COLLISION_DETECTOR_AIST_COLLISION_DETECTOR_H
 
 #include <cnoid/CollisionDetector>
+#include <string>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -23,6 +24,7 @@ public:
     virtual stdx::optional<GeometryHandle> addGeometry(SgNode* geometry) override;
     virtual void setCustomObject(GeometryHandle geometry, Referenced* object) override;
     virtual void setGeometryStatic(GeometryHandle geometry, bool isStatic = true) override;
+    virtual void setGeometrySleeping(GeometryHandle geometry, bool isSleeping = true) override;
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) override;
     virtual bool makeReady() override;
     virtual void updatePosition(GeometryHandle geometry, const Isometry3& position) override;
@@ -30,6 +32,9 @@ public:
     virtual void detectCollisions(std::function<void(const CollisionPair& collisionPair)> callback) override;
     virtual void detectCollisions(
         GeometryHandle geometry, std::function<void(const CollisionPair& collisionPair)> callback) override;
+    virtual bool checkCollision() override;
+    virtual bool checkCollision(GeometryHandle geometry) override;
+    virtual bool checkCollision(GeometryHandle geometry1, GeometryHandle geometry2) override;
 
     // CollisionDetectorDistanceAPI
     virtual double detectDistance(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
@@ -37,6 +42,43 @@ public:
     // experimental
     void setNumThreads(int n);
 
+    /**
+       The contacts of the geometries given as a single box, sphere, cylinder or capsule mesh are generated
+       analytically from their primitive shapes instead of their triangles. The pairs of primitives without
+       the analytic method and the box against a general mesh are detected with the triangles.
+       This must be set before adding the geometries. The default value is true.
+    */
+    void setPrimitiveCollisionEnabled(bool on);
+    bool isPrimitiveCollisionEnabled() const;
+
+    /**
+       The collisions of the geometry are detected with its convex hull by the GJK and EPA algorithms
+       instead of its triangles, and the contacts are kept as persistent contact manifolds.
+       The mesh is approximately decomposed into the convex parts of maxNumHulls at most when it is
+       greater than one, and zero restores the detection with the triangles.
+       The hulls are made when this function is called first for the mesh.
+       \return false if the hulls cannot be made
+    */
+    bool setGeometryConvexHulls(GeometryHandle geometry, int maxNumHulls = 1);
+
+    /**
+       The collision models built from the same meshes are shared by all the detector instances
+       in the process, so the AABB trees of the identical bodies and of the bodies that are loaded
+       again are not rebuilt. The cache is enabled by default.
+    */
+    static void setModelCacheEnabled(bool on);
+    static bool isModelCacheEnabled();
+    //! The models are released from the least recently used one when their total number of triangles exceeds this
+    static void setModelCacheCapacity(int numTriangles);
+    /**
+       The built models are also stored in the directory and restored from it in the later processes.
+       An empty string disables the storage. The initial directory is given by the environment variable
+       CNOID_AIST_COLLISION_MODEL_CACHE_DIR.
+    */
+    static void setModelCacheDirectory(const std::string& directory);
+    static std::string modelCacheDirectory();
+    static void clearModelCache();
+
 private:
     class Impl;
     Impl* impl;
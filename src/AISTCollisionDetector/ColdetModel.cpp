@@ -54,7 +54,8 @@ ColdetModel::ColdetModel()
 
 
 ColdetModel::ColdetModel(const ColdetModel& org)
-    : name_(org.name_),
+    : convexHulls(org.convexHulls),
+      name_(org.name_),
       isValid_(org.isValid_)
 {
     internalModel = org.internalModel;
@@ -273,12 +274,7 @@ bool ColdetModelInternalModel::build()
         OPCC.mKeepOriginal = false;
         
         model.Build(OPCC);
-        if(model.GetTree()){
-            AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
-            for(int i=0; i<AABBTreeMaxDepth; i++)
-                for(int j=0; j<i; j++)
-                    numBBMap.at(i) += numLeafMap.at(j);
-        }
+        updateTreeDepth();
         result = true;
     }
 
@@ -286,6 +282,37 @@ bool ColdetModelInternalModel::build()
 }
 
 
+bool ColdetModelInternalModel::restore(int numNodes, const Opcode::CollisionAABB* boxes, const udword* nodeData)
+{
+    if(triangles.empty() || neighbors.size() != triangles.size()){
+        return false;
+    }
+    iMesh.SetPointers(&triangles[0], &vertices[0]);
+    iMesh.SetNbTriangles(triangles.size());
+    iMesh.SetNbVertices(vertices.size());
+
+    if(!model.Restore(&iMesh, numNodes, boxes, nodeData)){
+        return false;
+    }
+    updateTreeDepth();
+    return true;
+}
+
+
+void ColdetModelInternalModel::updateTreeDepth()
+{
+    AABBTreeMaxDepth = 0;
+    numBBMap.clear();
+    numLeafMap.clear();
+    if(model.GetTree()){
+        AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
+        for(int i=0; i<AABBTreeMaxDepth; i++)
+            for(int j=0; j<i; j++)
+                numBBMap.at(i) += numLeafMap.at(j);
+    }
+}
+
+
 void ColdetModel::setPosition(const Isometry3& T)
 {
     transform->Set((float)T(0,0), (float)T(1,0), (float)T(2,0), 0.0f,
@@ -360,6 +387,49 @@ void ColdetModel::setPrimitivePosition(const double* R, const double* p)
 }
 
 
+bool ColdetModel::useConvexHulls(int maxNumHulls)
+{
+    if(maxNumHulls <= 0 || !isValid_){
+        convexHulls.clear();
+        return false;
+    }
+    convexHulls = internalModel->getConvexHulls(maxNumHulls);
+    return !convexHulls.empty();
+}
+
+
+const std::vector<ConvexHullPtr>& ColdetModelInternalModel::getConvexHulls(int maxNumHulls)
+{
+    // The ratio of the concavity depth allowed in a convex part to the size of the mesh
+    static const double ConcavityTolerance = 0.02;
+
+    lock_guard<std::mutex> lock(convexHullMutex);
+
+    auto inserted = convexHullSets.emplace(maxNumHulls, std::vector<ConvexHullPtr>());
+    auto& hulls = inserted.first->second;
+    if(inserted.second){
+        std::vector<Vector3> points;
+        points.reserve(vertices.size());
+        for(auto& v : vertices){
+            points.emplace_back(v.x, v.y, v.z);
+        }
+        if(maxNumHulls == 1){
+            if(auto hull = ConvexHull::create(points)){
+                hulls.push_back(hull);
+            }
+        } else {
+            std::vector<int> indices;
+            indices.reserve(triangles.size() * 3);
+            for(auto& triangle : triangles){
+                indices.insert(indices.end(), triangle.mVRef, triangle.mVRef + 3);
+            }
+            hulls = ConvexHull::decompose(points, indices, maxNumHulls, ConcavityTolerance);
+        }
+    }
+    return hulls;
+}
+
+
 double ColdetModel::computeDistanceWithRay(const double *point, 
                                            const double *dir)
 {
@@ -18,11 +18,18 @@ class Matrix4x4;
 namespace cnoid {
 
 class ColdetModelInternalModel;
+class ConvexHull;
 
 class CNOID_EXPORT ColdetModel : public Referenced
 {
 public:
-    enum PrimitiveType { SP_MESH, SP_BOX, SP_CYLINDER, SP_CONE, SP_SPHERE, SP_PLANE };
+    /**
+       The parameters of the primitives are as follows, and the axis of a cylinder or a capsule is the y-axis.
+       - SP_BOX: the sizes along the x, y and z axes
+       - SP_SPHERE: the radius
+       - SP_CYLINDER, SP_CAPSULE: the radius and the height. The height of a capsule does not contain its caps.
+    */
+    enum PrimitiveType { SP_MESH, SP_BOX, SP_CYLINDER, SP_CONE, SP_SPHERE, SP_PLANE, SP_CAPSULE };
 
     /**
      * @brief constructor
@@ -186,6 +193,19 @@ public:
      * @param p position relative to link (length = 3)
      */
     void setPrimitivePosition(const double* R, const double* p);
+
+    /**
+     * @brief use the convex hulls of the mesh instead of the triangles in the collision detection
+     * @param maxNumHulls the mesh is approximately decomposed into the convex parts of this number at most
+     * when it is greater than one. Zero restores the detection with the triangles.
+     * @return true if the hulls are made
+     *
+     * The hulls are made at the first request for the mesh and shared by the models of the same mesh.
+     * This must be called after build().
+     */
+    bool useConvexHulls(int maxNumHulls = 1);
+
+    int getNumConvexHulls() const { return convexHulls.size(); }
         
     /**
      * @brief compute distance between a point and this mesh along ray
@@ -216,10 +236,12 @@ private:
     ColdetModelInternalModel* internalModel;
     IceMaths::Matrix4x4* transform;
     IceMaths::Matrix4x4* pTransform; ///< transform of primitive
+    std::vector<ref_ptr<ConvexHull>> convexHulls;
     std::string name_;
     bool isValid_;
 
     friend class ColdetModelPair;
+    friend class ColdetModelCache;
 };
 
 typedef ref_ptr<ColdetModel> ColdetModelPtr;
@@ -0,0 +1,410 @@
+#include "ColdetModelCache.h"
+#include "ColdetModelInternalModel.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = stdx::filesystem;
+
+namespace {
+
+const char FileSignature[8] = { 'C', 'N', 'O', 'I', 'D', 'C', 'D', 'M' };
+const uint32_t FileFormatVersion = 1;
+
+struct FileHeader
+{
+    char signature[8];
+    uint32_t version;
+    // The sizes of the elements are checked because the data is stored in the native layout
+    uint32_t vertexSize;
+    uint32_t triangleSize;
+    uint32_t boxSize;
+    uint64_t hash;
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t numNodes;
+    uint32_t primitiveType;
+    uint32_t numPrimitiveParams;
+};
+
+class HashAccumulator
+{
+    uint64_t hash;
+public:
+    HashAccumulator() : hash(14695981039346656037ULL) { }
+    void add(uint32_t word){
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    void add(const void* data, size_t size){
+        const char* p = static_cast<const char*>(data);
+        for(size_t i=0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)){
+            uint32_t word;
+            std::memcpy(&word, p + i, sizeof(word));
+            add(word);
+        }
+    }
+    uint64_t value() const { return hash; }
+};
+
+template<class T>
+bool readArray(std::istream& is, std::vector<T>& out_array, size_t size)
+{
+    out_array.resize(size);
+    if(size > 0){
+        is.read(reinterpret_cast<char*>(&out_array[0]), size * sizeof(T));
+    }
+    return !is.fail();
+}
+
+template<class T>
+void writeArray(std::ostream& os, const std::vector<T>& array)
+{
+    if(!array.empty()){
+        os.write(reinterpret_cast<const char*>(&array[0]), array.size() * sizeof(T));
+    }
+}
+
+}
+
+
+ColdetModelCache* ColdetModelCache::instance()
+{
+    static ColdetModelCache cache;
+    return &cache;
+}
+
+
+ColdetModelCache::ColdetModelCache()
+{
+    isEnabled_ = true;
+    capacity_ = 1000000;
+    numTriangles = 0;
+
+    if(char* CNOID_AIST_COLLISION_MODEL_CACHE_DIR = getenv("CNOID_AIST_COLLISION_MODEL_CACHE_DIR")){
+        directory_ = CNOID_AIST_COLLISION_MODEL_CACHE_DIR;
+    }
+}
+
+
+void ColdetModelCache::setEnabled(bool on)
+{
+    lock_guard<std::mutex> lock(mutex);
+    isEnabled_ = on;
+    if(!on){
+        entries.clear();
+        entryMap.clear();
+        numTriangles = 0;
+    }
+}
+
+
+bool ColdetModelCache::isEnabled() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return isEnabled_;
+}
+
+
+void ColdetModelCache::setCapacity(int maxNumTriangles)
+{
+    lock_guard<std::mutex> lock(mutex);
+    capacity_ = maxNumTriangles;
+    removeOverflowedEntries();
+}
+
+
+int ColdetModelCache::capacity() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return capacity_;
+}
+
+
+void ColdetModelCache::setDirectory(const std::string& directory)
+{
+    lock_guard<std::mutex> lock(mutex);
+    directory_ = directory;
+}
+
+
+std::string ColdetModelCache::directory() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return directory_;
+}
+
+
+void ColdetModelCache::clear()
+{
+    lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    entryMap.clear();
+    numTriangles = 0;
+}
+
+
+uint64_t ColdetModelCache::computeHash(ColdetModel* model)
+{
+    auto internalModel = model->internalModel;
+    HashAccumulator hash;
+    hash.add(internalModel->vertices.size());
+    hash.add(internalModel->triangles.size());
+    if(!internalModel->vertices.empty()){
+        hash.add(&internalModel->vertices[0], internalModel->vertices.size() * sizeof(IceMaths::Point));
+    }
+    if(!internalModel->triangles.empty()){
+        hash.add(&internalModel->triangles[0], internalModel->triangles.size() * sizeof(IceMaths::IndexedTriangle));
+    }
+    hash.add(internalModel->pType);
+    if(!internalModel->pParams.empty()){
+        hash.add(&internalModel->pParams[0], internalModel->pParams.size() * sizeof(float));
+    }
+    return hash.value();
+}
+
+
+bool ColdetModelCache::isSameMesh(ColdetModel* model1, ColdetModel* model2)
+{
+    auto m1 = model1->internalModel;
+    auto m2 = model2->internalModel;
+    if(m1 == m2){
+        return true;
+    }
+    if(m1->vertices.size() != m2->vertices.size() ||
+       m1->triangles.size() != m2->triangles.size() ||
+       m1->pType != m2->pType ||
+       m1->pParams != m2->pParams){
+        return false;
+    }
+    if(!m1->vertices.empty() &&
+       std::memcmp(&m1->vertices[0], &m2->vertices[0], m1->vertices.size() * sizeof(IceMaths::Point)) != 0){
+        return false;
+    }
+    if(!m1->triangles.empty() &&
+       std::memcmp(&m1->triangles[0], &m2->triangles[0],
+                   m1->triangles.size() * sizeof(IceMaths::IndexedTriangle)) != 0){
+        return false;
+    }
+    return true;
+}
+
+
+ColdetModelPtr ColdetModelCache::findOrBuild(ColdetModel* model)
+{
+    string directory;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(!isEnabled_){
+            model->build();
+            return model;
+        }
+        directory = directory_;
+    }
+
+    uint64_t hash = computeHash(model);
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto range = entryMap.equal_range(hash);
+        for(auto p = range.first; p != range.second; ++p){
+            auto entry = p->second;
+            if(isSameMesh(entry->model, model)){
+                entries.splice(entries.begin(), entries, entry);
+                return entry->model;
+            }
+        }
+    }
+
+    ColdetModelPtr builtModel;
+    bool isLoaded = false;
+    string filename;
+    if(!directory.empty()){
+        filename = getFilePath(directory, hash);
+        builtModel = load(filename, model);
+        isLoaded = (builtModel != nullptr);
+    }
+    if(!builtModel){
+        model->build();
+        if(!model->isValid()){
+            return model;
+        }
+        builtModel = model;
+    }
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        // The same model may have been added by another thread while the model was being built
+        auto range = entryMap.equal_range(hash);
+        for(auto p = range.first; p != range.second; ++p){
+            auto entry = p->second;
+            if(isSameMesh(entry->model, builtModel)){
+                entries.splice(entries.begin(), entries, entry);
+                return entry->model;
+            }
+        }
+        if(isEnabled_){
+            addEntry(hash, builtModel);
+        }
+    }
+
+    if(!filename.empty() && !isLoaded){
+        save(filename, builtModel);
+    }
+
+    return builtModel;
+}
+
+
+void ColdetModelCache::addEntry(uint64_t hash, ColdetModel* model)
+{
+    entries.push_front(Entry{ hash, model });
+    entryMap.emplace(hash, entries.begin());
+    numTriangles += model->getNumTriangles();
+    removeOverflowedEntries();
+}
+
+
+void ColdetModelCache::removeOverflowedEntries()
+{
+    // The most recently used entry is kept even if it exceeds the capacity by itself
+    while(numTriangles > capacity_ && entries.size() > 1){
+        auto last = std::prev(entries.end());
+        auto range = entryMap.equal_range(last->hash);
+        for(auto p = range.first; p != range.second; ++p){
+            if(p->second == last){
+                entryMap.erase(p);
+                break;
+            }
+        }
+        numTriangles -= last->model->getNumTriangles();
+        entries.erase(last);
+    }
+}
+
+
+std::string ColdetModelCache::getFilePath(const std::string& directory, uint64_t hash)
+{
+    return (filesystem::path(directory) / fmt::format("{0:016x}.cdm", hash)).string();
+}
+
+
+ColdetModelPtr ColdetModelCache::load(const std::string& filename, ColdetModel* orgModel)
+{
+    ifstream is(filename, ios::in | ios::binary);
+    if(!is){
+        return nullptr;
+    }
+
+    FileHeader header;
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(is.fail() ||
+       std::memcmp(header.signature, FileSignature, sizeof(FileSignature)) != 0 ||
+       header.version != FileFormatVersion ||
+       header.vertexSize != sizeof(IceMaths::Point) ||
+       header.triangleSize != sizeof(IceMaths::IndexedTriangle) ||
+       header.boxSize != sizeof(Opcode::CollisionAABB)){
+        return nullptr;
+    }
+
+    ColdetModelPtr model = new ColdetModel;
+    auto internalModel = model->internalModel;
+    internalModel->pType = static_cast<ColdetModel::PrimitiveType>(header.primitiveType);
+    vector<Opcode::CollisionAABB> boxes;
+    vector<udword> nodeData;
+
+    if(!readArray(is, internalModel->vertices, header.numVertices) ||
+       !readArray(is, internalModel->triangles, header.numTriangles) ||
+       !readArray(is, internalModel->neighbors, header.numTriangles) ||
+       !readArray(is, internalModel->pParams, header.numPrimitiveParams) ||
+       !readArray(is, boxes, header.numNodes) ||
+       !readArray(is, nodeData, header.numNodes)){
+        return nullptr;
+    }
+
+    // The file may have been made for another mesh with the same hash value
+    if(!isSameMesh(model, orgModel)){
+        return nullptr;
+    }
+    for(auto& triangle : internalModel->triangles){
+        for(int i=0; i < 3; ++i){
+            if(triangle.mVRef[i] >= internalModel->vertices.size()){
+                return nullptr;
+            }
+        }
+    }
+
+    if(!internalModel->restore(header.numNodes, boxes.data(), nodeData.data())){
+        return nullptr;
+    }
+    model->isValid_ = true;
+
+    return model;
+}
+
+
+bool ColdetModelCache::save(const std::string& filename, ColdetModel* model)
+{
+    auto internalModel = model->internalModel;
+    auto tree = dynamic_cast<const Opcode::AABBCollisionTree*>(internalModel->model.GetTree());
+    if(!tree || internalModel->neighbors.size() != internalModel->triangles.size()){
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(header.signature, FileSignature, sizeof(FileSignature));
+    header.version = FileFormatVersion;
+    header.vertexSize = sizeof(IceMaths::Point);
+    header.triangleSize = sizeof(IceMaths::IndexedTriangle);
+    header.boxSize = sizeof(Opcode::CollisionAABB);
+    header.hash = computeHash(model);
+    header.numVertices = internalModel->vertices.size();
+    header.numTriangles = internalModel->triangles.size();
+    header.numNodes = tree->GetNbNodes();
+    header.primitiveType = internalModel->pType;
+    header.numPrimitiveParams = internalModel->pParams.size();
+
+    vector<Opcode::CollisionAABB> boxes(header.numNodes);
+    vector<udword> nodeData(header.numNodes);
+    tree->ExportNodes(boxes.data(), nodeData.data());
+
+    stdx::error_code ec;
+    filesystem::path filePath(filename);
+    filesystem::create_directories(filePath.parent_path(), ec);
+
+    /*
+      The data is written into a temporary file first and the file is renamed so that
+      another process does not read the incomplete file.
+    */
+    std::random_device random;
+    string tmpFilename = fmt::format("{0}.{1:08x}.tmp", filename, random());
+    {
+        ofstream os(tmpFilename, ios::out | ios::binary | ios::trunc);
+        if(!os){
+            return false;
+        }
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeArray(os, internalModel->vertices);
+        writeArray(os, internalModel->triangles);
+        writeArray(os, internalModel->neighbors);
+        writeArray(os, internalModel->pParams);
+        writeArray(os, boxes);
+        writeArray(os, nodeData);
+        if(os.fail()){
+            os.close();
+            filesystem::remove(tmpFilename, ec);
+            return false;
+        }
+    }
+    filesystem::rename(tmpFilename, filePath, ec);
+    if(ec){
+        filesystem::remove(tmpFilename, ec);
+        return false;
+    }
+    return true;
+}
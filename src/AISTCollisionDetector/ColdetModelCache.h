@@ -0,0 +1,77 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_COLDET_MODEL_CACHE_H
+#define CNOID_AIST_COLLISION_DETECTOR_COLDET_MODEL_CACHE_H
+
+#include "ColdetModel.h"
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+namespace cnoid {
+
+/**
+   This class keeps the built collision models in the process so that the models of the same meshes
+   are shared by the detector instances instead of being rebuilt for each instance.
+   A model is identified by the content of its vertices and triangles, which have been transformed
+   into the geometry coordinate, and its primitive parameters.
+   The built models can also be stored in a directory and restored from it in another process.
+*/
+class ColdetModelCache
+{
+public:
+    static ColdetModelCache* instance();
+
+    void setEnabled(bool on);
+    bool isEnabled() const;
+
+    //! The models are released from the least recently used one when the total number of triangles exceeds this
+    void setCapacity(int maxNumTriangles);
+    int capacity() const;
+
+    //! An empty string disables the storage
+    void setDirectory(const std::string& directory);
+    std::string directory() const;
+
+    void clear();
+
+    /**
+       \param model The model whose vertices and triangles are set but which is not built yet.
+       \return The built model that has the same mesh as the given model. The internal model of the returned
+       model is shared with the cache and the other detectors, so it must be copied by the copy constructor
+       of ColdetModel before it is used. The given model is built and returned if the cache is disabled.
+    */
+    ColdetModelPtr findOrBuild(ColdetModel* model);
+
+private:
+    struct Entry {
+        uint64_t hash;
+        ColdetModelPtr model;
+    };
+    typedef std::list<Entry> EntryList;
+
+    mutable std::mutex mutex;
+    bool isEnabled_;
+    int capacity_;
+    int numTriangles;
+    std::string directory_;
+    // The most recently used entry is at the front
+    EntryList entries;
+    std::unordered_multimap<uint64_t, EntryList::iterator> entryMap;
+
+    ColdetModelCache();
+    ColdetModelCache(const ColdetModelCache&) = delete;
+    ColdetModelCache& operator=(const ColdetModelCache&) = delete;
+
+    static uint64_t computeHash(ColdetModel* model);
+    static bool isSameMesh(ColdetModel* model1, ColdetModel* model2);
+    void addEntry(uint64_t hash, ColdetModel* model);
+    void removeOverflowedEntries();
+    static std::string getFilePath(const std::string& directory, uint64_t hash);
+    ColdetModelPtr load(const std::string& filename, ColdetModel* orgModel);
+    bool save(const std::string& filename, ColdetModel* model);
+};
+
+}
+
+#endif
@@ -6,8 +6,12 @@
 #define CNOID_AIST_COLLISION_DETECTOR_COLDET_MODEL_INTERNAL_MODEL_H
 
 #include "ColdetModel.h"
+#include "ConvexHull.h"
 #include "Opcode/Opcode.h"
 #include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
 
 namespace cnoid {
 
@@ -47,6 +51,12 @@ public:
 
     bool build();
 
+    /**
+       Restore the tree from the nodes exported by Opcode::AABBCollisionTree::ExportNodes.
+       The vertices, triangles and neighbors must be set before calling this function.
+    */
+    bool restore(int numNodes, const Opcode::CollisionAABB* boxes, const udword* nodeData);
+
     // need two instances ?
     Opcode::Model model;
     Opcode::MeshInterface iMesh;
@@ -56,6 +66,11 @@ public:
     ColdetModel::PrimitiveType pType;
     std::vector<float> pParams;
 
+    //! The convex hulls of the mesh for each maximum number of the hulls
+    std::map<int, std::vector<ConvexHullPtr>> convexHullSets;
+    std::mutex convexHullMutex;
+    const std::vector<ConvexHullPtr>& getConvexHulls(int maxNumHulls);
+
     int getAABBTreeDepth() {
         return AABBTreeMaxDepth;
     };
@@ -71,15 +86,18 @@ public:
     };
 
 private:
-    int refCounter;
+    // The model may be shared by the detectors used in different threads
+    std::atomic<int> refCounter;
     int AABBTreeMaxDepth;
     std::vector<int> numBBMap;
     std::vector<int> numLeafMap;
 
     void extractNeghiborTriangles();
+    void updateTreeDepth();
     int computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max );
 
     friend class ColdetModel;
+    friend class ColdetModelCache;
 };
 }
 
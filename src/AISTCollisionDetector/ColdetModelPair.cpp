@@ -8,6 +8,8 @@
 #include "StdCollisionPairInserter.h"
 #include "Opcode/Opcode.h"
 #include "SSVTreeCollider.h"
+#include "PrimitiveCollider.h"
+#include "ConvexCollider.h"
 #include <iostream>
 
 using namespace std;
@@ -31,18 +33,97 @@ struct figStruct {
     float area;
     float cx, cy;
 };
+
+bool getPrimitiveShapeType(int primitiveType, PrimitiveShape::Type& out_type)
+{
+    switch(primitiveType){
+    case ColdetModel::SP_BOX:
+        out_type = PrimitiveShape::Box;
+        return true;
+    case ColdetModel::SP_SPHERE:
+        out_type = PrimitiveShape::Sphere;
+        return true;
+    case ColdetModel::SP_CYLINDER:
+        out_type = PrimitiveShape::Cylinder;
+        return true;
+    case ColdetModel::SP_CAPSULE:
+        out_type = PrimitiveShape::Capsule;
+        return true;
+    default:
+        return false;
+    }
+}
+
+Isometry3 toIsometry3(const IceMaths::Matrix4x4& M)
+{
+    Isometry3 T;
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            T.linear()(j, i) = M[i][j];
+        }
+        T.translation()[i] = M[3][i];
+    }
+    return T;
+}
+
+/**
+   \param T The position of the primitive, which is the product of the primitive transform
+   and the model transform of ColdetModel
+*/
+PrimitiveShape getPrimitiveShape(ColdetModel* model, PrimitiveShape::Type type, const IceMaths::Matrix4x4& T)
+{
+    PrimitiveShape shape;
+    shape.type = type;
+    shape.T = toIsometry3(T);
+    float p[3] = { 0.0f, 0.0f, 0.0f };
+    for(int i=0; i < 3; ++i){
+        model->getPrimitiveParam(i, p[i]);
+    }
+    if(type == PrimitiveShape::Box){
+        shape.halfSize << p[0] / 2.0, p[1] / 2.0, p[2] / 2.0;
+        shape.radius = 0.0;
+        shape.halfHeight = 0.0;
+    } else {
+        shape.halfSize.setZero();
+        shape.radius = p[0];
+        shape.halfHeight = (type == PrimitiveShape::Sphere) ? 0.0 : p[1] / 2.0;
+    }
+    return shape;
+}
+
+void addCollisionData(std::vector<collision_data>& cdata, const PrimitiveContact& contact, bool isReversed)
+{
+    cdata.emplace_back();
+    collision_data& col = cdata.back();
+    col.id1 = 0;
+    col.id2 = 0;
+    col.num_of_i_points = 1;
+    col.i_points[0] = contact.point;
+    col.i_point_new[0] = 1;
+    col.i_point_new[1] = 0;
+    col.i_point_new[2] = 0;
+    col.i_point_new[3] = 0;
+    col.n_vector = isReversed ? Vector3(-contact.normal) : contact.normal;
+    col.depth = contact.depth;
+    col.n.setZero();
+    col.m.setZero();
+    col.c_type = 0;
+}
+
 }
 
 
 ColdetModelPair::ColdetModelPair()
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    convexManifolds = nullptr;
 }
 
 
 ColdetModelPair::ColdetModelPair(ColdetModel* model0, ColdetModel* model1, double tolerance)
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    convexManifolds = nullptr;
     set(model0, model1);
     tolerance_ = tolerance;
 }
@@ -51,6 +132,7 @@ ColdetModelPair::ColdetModelPair(ColdetModel* model0, ColdetModel* model1, doubl
 ColdetModelPair::ColdetModelPair(const ColdetModelPair& org)
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    convexManifolds = nullptr;
     set(org.models[0], org.models[1]);
     tolerance_ = org.tolerance_;
 }
@@ -59,6 +141,7 @@ ColdetModelPair::ColdetModelPair(const ColdetModelPair& org)
 ColdetModelPair::~ColdetModelPair()
 {
     delete collisionPairInserter;
+    delete convexManifolds;
 }
 
 
@@ -71,6 +154,9 @@ void ColdetModelPair::set(ColdetModel* model0, ColdetModel* model1)
     if(model0 && model1){
         collisionPairInserter->set(model1->internalModel, model0->internalModel);
     }
+    if(convexManifolds){
+        convexManifolds->clear();
+    }
 }
 
 
@@ -82,6 +168,9 @@ std::vector<collision_data>& ColdetModelPair::detectCollisionsSub(bool detectAll
     int pt1 = models[1]->getPrimitiveType();
     bool detected;
     bool detectPlaneSphereCollisions(bool detectAllContacts);
+    PrimitiveShape::Type type0, type1;
+    bool isPrimitive0 = getPrimitiveShapeType(pt0, type0);
+    bool isPrimitive1 = getPrimitiveShapeType(pt1, type1);
     
     if (( pt0 == ColdetModel::SP_PLANE && pt1 == ColdetModel::SP_CYLINDER)
         || (pt1 == ColdetModel::SP_PLANE && pt0 == ColdetModel::SP_CYLINDER)){
@@ -90,10 +179,22 @@ std::vector<collision_data>& ColdetModelPair::detectCollisionsSub(bool detectAll
     else if (pt0 == ColdetModel::SP_PLANE || pt1 == ColdetModel::SP_PLANE){
         detected = detectPlaneMeshCollisions(detectAllContacts);
     }
+    else if (!models[0]->convexHulls.empty() || !models[1]->convexHulls.empty()) {
+        detected = detectConvexCollisions(detectAllContacts);
+    }
+    // The primitive collider is used prior to the old sphere functions if it supports the pair
+    else if (isPrimitive0 && isPrimitive1 && PrimitiveCollider::isSupportedPair(type0, type1)) {
+        detected = detectPrimitiveCollisions(detectAllContacts);
+    }
+    else if (isPrimitive0 && PrimitiveCollider::isSupportedWithMesh(type0)) {
+        detected = detectPrimitiveMeshCollisions(0, detectAllContacts);
+    }
+    else if (isPrimitive1 && PrimitiveCollider::isSupportedWithMesh(type1)) {
+        detected = detectPrimitiveMeshCollisions(1, detectAllContacts);
+    }
     else if (pt0 == ColdetModel::SP_SPHERE && pt1 == ColdetModel::SP_SPHERE) {
         detected = detectSphereSphereCollisions(detectAllContacts);
     }
-	
     else if (pt0 == ColdetModel::SP_SPHERE || pt1 == ColdetModel::SP_SPHERE) {
         detected = detectSphereMeshCollisions(detectAllContacts);
     }
@@ -204,6 +305,177 @@ bool ColdetModelPair::detectMeshMeshCollisions(bool detectAllContacts)
     return result;
 }
 
+bool ColdetModelPair::detectPrimitiveCollisions(bool detectAllContacts)
+{
+    if(!models[0]->isValid() || !models[1]->isValid()){
+        return false;
+    }
+    PrimitiveShape::Type types[2];
+    PrimitiveShape shapes[2];
+    for(int i=0; i < 2; ++i){
+        ColdetModel* model = models[i];
+        getPrimitiveShapeType(model->getPrimitiveType(), types[i]);
+        shapes[i] = getPrimitiveShape(model, types[i], (*(model->pTransform)) * (*(model->transform)));
+    }
+
+    std::vector<PrimitiveContact> contacts;
+    PrimitiveCollider::collide(shapes[0], shapes[1], contacts);
+
+    std::vector<collision_data>& cdata = collisionPairInserter->collisions();
+    cdata.clear();
+    for(auto& contact : contacts){
+        addCollisionData(cdata, contact, false);
+    }
+    return !cdata.empty();
+}
+
+
+/**
+   The triangles of the mesh around the primitive are collected with the sphere that contains the primitive,
+   and the contacts with the triangles are generated analytically.
+*/
+bool ColdetModelPair::detectPrimitiveMeshCollisions(int primitiveIndex, bool detectAllContacts)
+{
+    ColdetModel* primitive = models[primitiveIndex];
+    ColdetModel* mesh = models[1 - primitiveIndex];
+    if(!primitive->isValid() || !mesh->isValid()){
+        return false;
+    }
+
+    PrimitiveShape::Type type;
+    getPrimitiveShapeType(primitive->getPrimitiveType(), type);
+    PrimitiveShape shape = getPrimitiveShape(primitive, type, (*(primitive->pTransform)) * (*(primitive->transform)));
+
+    const Vector3& center = shape.T.translation();
+    IceMaths::Sphere sphere(IceMaths::Point(center.x(), center.y(), center.z()), PrimitiveCollider::boundingRadius(shape));
+    Opcode::SphereCache cache;
+    Opcode::SphereCollider collider;
+    if(!collider.Collide(cache, sphere, mesh->internalModel->model, nullptr, mesh->transform)){
+        std::cerr << "SphereCollider::Collide() failed" << std::endl;
+        return false;
+    }
+    const int numTouchedTriangles = collider.GetNbTouchedPrimitives();
+    if(!collider.GetContactStatus() || numTouchedTriangles == 0){
+        return false;
+    }
+
+    const Isometry3 T = toIsometry3(*(mesh->transform));
+    const udword* touchedTriangles = collider.GetTouchedPrimitives();
+    std::vector<Vector3> vertices;
+    vertices.reserve(numTouchedTriangles * 3);
+    for(int i=0; i < numTouchedTriangles; ++i){
+        int indices[3];
+        mesh->getTriangle(touchedTriangles[i], indices[0], indices[1], indices[2]);
+        for(int j=0; j < 3; ++j){
+            float x, y, z;
+            mesh->getVertex(indices[j], x, y, z);
+            vertices.push_back(T * Vector3(x, y, z));
+        }
+    }
+
+    std::vector<PrimitiveContact> contacts;
+    PrimitiveCollider::collideWithTriangles(shape, vertices, contacts);
+
+    std::vector<collision_data>& cdata = collisionPairInserter->collisions();
+    cdata.clear();
+    for(auto& contact : contacts){
+        addCollisionData(cdata, contact, primitiveIndex == 1);
+    }
+    return !cdata.empty();
+}
+
+
+/**
+   The contacts of the convex hulls are generated with the GJK and EPA algorithms. The other model
+   is given by its convex hulls, its primitive shape or the triangles around each hull.
+*/
+bool ColdetModelPair::detectConvexCollisions(bool detectAllContacts)
+{
+    if(!models[0]->isValid() || !models[1]->isValid()){
+        return false;
+    }
+    const int convexIndex = models[0]->convexHulls.empty() ? 1 : 0;
+    ColdetModel* convex = models[convexIndex];
+    ColdetModel* other = models[1 - convexIndex];
+    const Isometry3 T1 = toIsometry3(*(convex->transform));
+    const Isometry3 T2 = toIsometry3(*(other->transform));
+
+    const int numHulls = convex->convexHulls.size();
+    const int numOtherHulls = other->convexHulls.size();
+    PrimitiveShape::Type primitiveType;
+    bool isOtherPrimitive = false;
+    if(numOtherHulls == 0){
+        isOtherPrimitive = getPrimitiveShapeType(other->getPrimitiveType(), primitiveType);
+    }
+    const size_t numManifolds = numHulls * std::max(numOtherHulls, 1);
+    if(!convexManifolds){
+        convexManifolds = new std::vector<ConvexContactManifold>;
+    }
+    if(convexManifolds->size() != numManifolds){
+        convexManifolds->clear();
+        convexManifolds->resize(numManifolds);
+    }
+
+    std::vector<PrimitiveContact> contacts;
+    ConvexShape shape1, shape2;
+    std::vector<Vector3> vertices;
+
+    for(int i=0; i < numHulls; ++i){
+        shape1.setHull(convex->convexHulls[i], T1);
+
+        if(numOtherHulls > 0){
+            for(int j=0; j < numOtherHulls; ++j){
+                shape2.setHull(other->convexHulls[j], T2);
+                ConvexCollider::collide(shape1, shape2, contacts, &(*convexManifolds)[i * numOtherHulls + j]);
+            }
+
+        } else if(isOtherPrimitive){
+            shape2.setPrimitive(getPrimitiveShape(other, primitiveType, (*(other->pTransform)) * (*(other->transform))));
+            ConvexCollider::collide(shape1, shape2, contacts, &(*convexManifolds)[i]);
+
+        } else {
+            // The triangles around the hull are collected with the sphere that contains the hull
+            const Vector3 center = shape1.center();
+            IceMaths::Sphere sphere(IceMaths::Point(center.x(), center.y(), center.z()), shape1.boundingRadius());
+            Opcode::SphereCache cache;
+            Opcode::SphereCollider collider;
+            if(!collider.Collide(cache, sphere, other->internalModel->model, nullptr, other->transform)){
+                std::cerr << "SphereCollider::Collide() failed" << std::endl;
+                continue;
+            }
+            const size_t begin = contacts.size();
+            const int numTouchedTriangles = collider.GetContactStatus() ? collider.GetNbTouchedPrimitives() : 0;
+            const udword* touchedTriangles = collider.GetTouchedPrimitives();
+            for(int k=0; k < numTouchedTriangles; ++k){
+                int indices[3];
+                other->getTriangle(touchedTriangles[k], indices[0], indices[1], indices[2]);
+                Vector3 v[3];
+                for(int l=0; l < 3; ++l){
+                    float x, y, z;
+                    other->getVertex(indices[l], x, y, z);
+                    v[l] = T2 * Vector3(x, y, z);
+                }
+                shape2.setTriangle(v[0], v[1], v[2]);
+                ConvexCollider::collide(shape1, shape2, contacts);
+            }
+            PrimitiveCollider::mergeContacts(contacts, begin, 0.02 * shape1.boundingRadius());
+            (*convexManifolds)[i].update(T1, T2, contacts, begin);
+        }
+
+        if(!detectAllContacts && !contacts.empty()){
+            break;
+        }
+    }
+
+    std::vector<collision_data>& cdata = collisionPairInserter->collisions();
+    cdata.clear();
+    for(auto& contact : contacts){
+        addCollisionData(cdata, contact, convexIndex == 1);
+    }
+    return !cdata.empty();
+}
+
+
 bool ColdetModelPair::detectSphereSphereCollisions(bool detectAllContacts) {
 	
     bool result = false;
@@ -232,12 +504,15 @@ bool ColdetModelPair::detectSphereSphereCollisions(bool detectAllContacts) {
 
             result = true;
 
-            float x = (pow(D.Magnitude(), 2) + pow(radiusA, 2) - pow(radiusB, 2)) / (2 * D.Magnitude());
-            float R = sqrt(pow(radiusA, 2) - pow(x, 2));
-			
-            IceMaths::Point n = D / D.Magnitude();
-			
-            IceMaths::Point q = centerA + n * x;
+            IceMaths::Point n(0.0f, 0.0f, 1.0f);
+            IceMaths::Point q = centerA;
+
+            // The normal cannot be determined for the coincident centers
+            if (D.Magnitude() > 1.0e-6f) {
+                float x = (pow(D.Magnitude(), 2) + pow(radiusA, 2) - pow(radiusB, 2)) / (2 * D.Magnitude());
+                n = D / D.Magnitude();
+                q = centerA + n * x;
+            }
 
             std::vector<collision_data>& cdata = collisionPairInserter->collisions();
             cdata.clear();			
@@ -352,9 +627,7 @@ bool ColdetModelPair::detectSphereMeshCollisions(bool detectAllContacts) {
                         IceMaths::TransformPlane(face_s, face[i], sTransInv);
                         face_s.Normalize();
 						
-                        if (abs(face_s.d) > radius)
-                            cout << "No intersection";
-                        else {
+                        if (abs(face_s.d) <= radius) {
 
                             R = sqrt(pow(radius, 2) - pow(face_s.d, 2));
                             depth[i] = radius - abs(face_s.d);
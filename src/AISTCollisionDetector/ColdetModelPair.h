@@ -12,6 +12,8 @@
 
 namespace cnoid {
 
+class ConvexContactManifold;
+
 class CNOID_EXPORT ColdetModelPair : public Referenced
 {
 public:
@@ -82,10 +84,15 @@ private:
     bool detectSphereMeshCollisions(bool detectAllContacts);
     bool detectPlaneCylinderCollisions(bool detectAllContacts);
     bool detectPlaneMeshCollisions(bool detectAllContacts);
+    bool detectPrimitiveCollisions(bool detectAllContacts);
+    bool detectPrimitiveMeshCollisions(int primitiveIndex, bool detectAllContacts);
+    bool detectConvexCollisions(bool detectAllContacts);
 
     ColdetModelPtr models[2];
     double tolerance_;
     Opcode::CollisionPairInserter* collisionPairInserter;
+    // The contact manifolds of the convex hull pairs, which are created at the first detection of the hulls
+    std::vector<ConvexContactManifold>* convexManifolds;
     int boxTestsCount;
     int triTestsCount;
 };
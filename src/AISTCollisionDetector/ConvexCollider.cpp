@@ -0,0 +1,881 @@
+#include "ConvexCollider.h"
+#include <cnoid/MathUtil>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int MaxNumGjkIterations = 64;
+const int MaxNumEpaIterations = 128;
+const double GjkRelativeTolerance = 1.0e-10;
+const double EpaTolerance = 1.0e-6;
+const double Epsilon = 1.0e-12;
+const int NumDiscVertices = 16;
+
+/*
+  The features of the shapes are clipped to generate the contacts of a face when the normal given by EPA
+  is closer to the normal of a face than this, and the single contact of EPA is used otherwise.
+*/
+const double FaceContactThreshold = 0.999;
+
+// A capsule or the side of a cylinder is regarded as lying along a face if the cosine is smaller than this
+const double ParallelAxisThreshold = 0.02;
+
+// The normals of the contacts are regarded as the same if their inner product exceeds this
+const double SameNormalThreshold = 0.999;
+
+/*
+  The stored contacts of a manifold are removed when they are separated or slid more than this,
+  and they are replaced with the new contacts that are closer than this.
+*/
+const double ContactBreakingThreshold = 0.002;
+
+struct SupportPoint
+{
+    Vector3 w;
+    Vector3 p1;
+    Vector3 p2;
+};
+
+
+inline SupportPoint computeSupport(const ConvexShape& shape1, const ConvexShape& shape2, const Vector3& direction)
+{
+    SupportPoint s;
+    s.p1 = shape1.support(direction);
+    s.p2 = shape2.support(-direction);
+    s.w = s.p1 - s.p2;
+    return s;
+}
+
+
+/**
+   Compute the closest point of the triangle to the origin
+   \param out_lambdas The barycentric coordinates of the closest point
+*/
+Vector3 findClosestPointOnTriangle(const Vector3& a, const Vector3& b, const Vector3& c, double out_lambdas[3])
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const double d1 = -ab.dot(a);
+    const double d2 = -ac.dot(a);
+    if(d1 <= 0.0 && d2 <= 0.0){
+        out_lambdas[0] = 1.0; out_lambdas[1] = 0.0; out_lambdas[2] = 0.0;
+        return a;
+    }
+    const double d3 = -ab.dot(b);
+    const double d4 = -ac.dot(b);
+    if(d3 >= 0.0 && d4 <= d3){
+        out_lambdas[0] = 0.0; out_lambdas[1] = 1.0; out_lambdas[2] = 0.0;
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+        const double v = d1 / (d1 - d3);
+        out_lambdas[0] = 1.0 - v; out_lambdas[1] = v; out_lambdas[2] = 0.0;
+        return a + v * ab;
+    }
+    const double d5 = -ab.dot(c);
+    const double d6 = -ac.dot(c);
+    if(d6 >= 0.0 && d5 <= d6){
+        out_lambdas[0] = 0.0; out_lambdas[1] = 0.0; out_lambdas[2] = 1.0;
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+        const double w = d2 / (d2 - d6);
+        out_lambdas[0] = 1.0 - w; out_lambdas[1] = 0.0; out_lambdas[2] = w;
+        return a + w * ac;
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+        const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        out_lambdas[0] = 0.0; out_lambdas[1] = 1.0 - w; out_lambdas[2] = w;
+        return b + w * (c - b);
+    }
+    const double sum = va + vb + vc;
+    if(sum < Epsilon){
+        // The triangle is degenerate
+        const double t = std::max(0.0, std::min(1.0, d1 / std::max(ab.squaredNorm(), Epsilon)));
+        out_lambdas[0] = 1.0 - t; out_lambdas[1] = t; out_lambdas[2] = 0.0;
+        return a + t * ab;
+    }
+    const double v = vb / sum;
+    const double w = vc / sum;
+    out_lambdas[0] = 1.0 - v - w; out_lambdas[1] = v; out_lambdas[2] = w;
+    return a + ab * v + ac * w;
+}
+
+
+/**
+   The simplex of GJK, which is reduced to the smallest one that contains the closest point to the origin
+*/
+class Simplex
+{
+public:
+    SupportPoint points[4];
+    double lambdas[4];
+    int size;
+
+    Simplex() : size(0) { }
+
+    void add(const SupportPoint& s){
+        points[size++] = s;
+    }
+
+    bool contains(const Vector3& w) const {
+        for(int i=0; i < size; ++i){
+            if((points[i].w - w).squaredNorm() < Epsilon * Epsilon){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! \return true if the origin is inside the tetrahedron
+    bool update(Vector3& out_closest);
+
+private:
+    void reduce(const int* indices, const double* newLambdas, int n){
+        SupportPoint reduced[4];
+        int newSize = 0;
+        for(int i=0; i < n; ++i){
+            if(newLambdas[i] > 0.0){
+                reduced[newSize] = points[indices[i]];
+                lambdas[newSize] = newLambdas[i];
+                ++newSize;
+            }
+        }
+        for(int i=0; i < newSize; ++i){
+            points[i] = reduced[i];
+        }
+        size = newSize;
+    }
+};
+
+
+bool Simplex::update(Vector3& out_closest)
+{
+    if(size == 1){
+        lambdas[0] = 1.0;
+        out_closest = points[0].w;
+        return false;
+    }
+
+    if(size == 2){
+        const Vector3& a = points[0].w;
+        const Vector3 ab = points[1].w - a;
+        const double t = std::max(0.0, std::min(1.0, -a.dot(ab) / std::max(ab.squaredNorm(), Epsilon)));
+        const int indices[2] = { 0, 1 };
+        const double newLambdas[2] = { 1.0 - t, t };
+        reduce(indices, newLambdas, 2);
+        out_closest = a + t * ab;
+        return false;
+    }
+
+    if(size == 3){
+        double newLambdas[3];
+        out_closest = findClosestPointOnTriangle(points[0].w, points[1].w, points[2].w, newLambdas);
+        const int indices[3] = { 0, 1, 2 };
+        reduce(indices, newLambdas, 3);
+        return false;
+    }
+
+    static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+    bool isInside = true;
+    double minDistance2 = std::numeric_limits<double>::max();
+    int closestFace = -1;
+    double closestLambdas[3];
+    for(int i=0; i < 4; ++i){
+        const Vector3& a = points[faces[i][0]].w;
+        const Vector3& b = points[faces[i][1]].w;
+        const Vector3& c = points[faces[i][2]].w;
+        const Vector3& d = points[faces[i][3]].w;
+        const Vector3 n = (b - a).cross(c - a);
+        const double sOrigin = -n.dot(a);
+        const double sOpposite = n.dot(d - a);
+        // The face of a flat tetrahedron is always checked
+        if(sOrigin * sOpposite < 0.0 || fabs(sOpposite) < Epsilon){
+            isInside = false;
+            double faceLambdas[3];
+            Vector3 p = findClosestPointOnTriangle(a, b, c, faceLambdas);
+            double d2 = p.squaredNorm();
+            if(d2 < minDistance2){
+                minDistance2 = d2;
+                closestFace = i;
+                out_closest = p;
+                std::copy(faceLambdas, faceLambdas + 3, closestLambdas);
+            }
+        }
+    }
+    if(isInside){
+        out_closest.setZero();
+        return true;
+    }
+    reduce(faces[closestFace], closestLambdas, 3);
+    return false;
+}
+
+
+/**
+   \return true if the shapes intersect
+*/
+bool runGjk(const ConvexShape& shape1, const ConvexShape& shape2, Vector3& io_direction, Simplex& simplex)
+{
+    Vector3 v = io_direction;
+    if(v.squaredNorm() < Epsilon){
+        v = Vector3::UnitX();
+    }
+    simplex.size = 0;
+    simplex.add(computeSupport(shape1, shape2, -v));
+    simplex.update(v);
+
+    for(int i=0; i < MaxNumGjkIterations; ++i){
+        const double v2 = v.squaredNorm();
+        if(v2 < Epsilon * Epsilon){
+            io_direction = v;
+            return true;
+        }
+        SupportPoint s = computeSupport(shape1, shape2, -v);
+        // The direction is a separating axis
+        if(v.dot(s.w) > 0.0){
+            io_direction = v;
+            return false;
+        }
+        // The support point does not get closer to the origin
+        if(v2 - v.dot(s.w) <= GjkRelativeTolerance * v2 || simplex.contains(s.w)){
+            io_direction = v;
+            return v.dot(s.w) <= 0.0;
+        }
+        simplex.add(s);
+        if(simplex.update(v)){
+            return true;
+        }
+    }
+    io_direction = v;
+    return v.squaredNorm() < Epsilon;
+}
+
+
+class EpaPolytope
+{
+public:
+    struct Face
+    {
+        int v[3];
+        Vector3 normal;
+        double distance;
+        bool isAlive;
+    };
+    vector<SupportPoint> vertices;
+    vector<Face> faces;
+
+    bool addFace(int a, int b, int c){
+        Face face;
+        face.v[0] = a;
+        face.v[1] = b;
+        face.v[2] = c;
+        Vector3 n = (vertices[b].w - vertices[a].w).cross(vertices[c].w - vertices[a].w);
+        double norm = n.norm();
+        if(norm < Epsilon){
+            return false;
+        }
+        face.normal = n / norm;
+        face.distance = face.normal.dot(vertices[a].w);
+        face.isAlive = true;
+        faces.push_back(face);
+        return true;
+    }
+};
+
+
+//! The simplex of GJK is expanded to a tetrahedron when the shapes are just touching
+bool expandToTetrahedron(const ConvexShape& shape1, const ConvexShape& shape2, Simplex& simplex)
+{
+    static const Vector3 axes[6] = {
+        Vector3::UnitX(), -Vector3::UnitX(), Vector3::UnitY(), -Vector3::UnitY(), Vector3::UnitZ(), -Vector3::UnitZ() };
+
+    if(simplex.size == 1){
+        for(auto& axis : axes){
+            SupportPoint s = computeSupport(shape1, shape2, axis);
+            if((s.w - simplex.points[0].w).squaredNorm() > Epsilon){
+                simplex.add(s);
+                break;
+            }
+        }
+    }
+    if(simplex.size == 2){
+        const Vector3 d = (simplex.points[1].w - simplex.points[0].w).normalized();
+        const Vector3 u = d.unitOrthogonal();
+        for(int i=0; i < 6; ++i){
+            const Vector3 direction = AngleAxis(i * PI / 3.0, d) * u;
+            SupportPoint s = computeSupport(shape1, shape2, direction);
+            const Vector3 r = s.w - simplex.points[0].w;
+            if((r - d * d.dot(r)).squaredNorm() > Epsilon){
+                simplex.add(s);
+                break;
+            }
+        }
+    }
+    if(simplex.size == 3){
+        const Vector3 n = (simplex.points[1].w - simplex.points[0].w).cross(simplex.points[2].w - simplex.points[0].w);
+        for(int sign = 1; sign >= -1; sign -= 2){
+            SupportPoint s = computeSupport(shape1, shape2, sign * n);
+            if(fabs(n.normalized().dot(s.w - simplex.points[0].w)) > sqrt(Epsilon)){
+                simplex.add(s);
+                break;
+            }
+        }
+    }
+    return simplex.size == 4;
+}
+
+
+/**
+   \return false if the penetration cannot be computed because the polytope is degenerate
+*/
+bool runEpa(const ConvexShape& shape1, const ConvexShape& shape2, Simplex& simplex,
+            Vector3& out_normal, double& out_depth, Vector3& out_point1, Vector3& out_point2)
+{
+    if(simplex.size < 4 && !expandToTetrahedron(shape1, shape2, simplex)){
+        return false;
+    }
+
+    EpaPolytope polytope;
+    for(int i=0; i < 4; ++i){
+        polytope.vertices.push_back(simplex.points[i]);
+    }
+    static const int tetrahedronFaces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+    for(auto& f : tetrahedronFaces){
+        int a = f[0], b = f[1], c = f[2];
+        const auto& v = polytope.vertices;
+        if((v[b].w - v[a].w).cross(v[c].w - v[a].w).dot(v[f[3]].w - v[a].w) > 0.0){
+            std::swap(b, c);
+        }
+        if(!polytope.addFace(a, b, c)){
+            return false;
+        }
+    }
+
+    vector<pair<int, int>> horizon;
+    int closest = -1;
+    for(int iteration = 0; iteration < MaxNumEpaIterations; ++iteration){
+        closest = -1;
+        double minDistance = std::numeric_limits<double>::max();
+        for(size_t i=0; i < polytope.faces.size(); ++i){
+            auto& face = polytope.faces[i];
+            if(face.isAlive && face.distance < minDistance){
+                minDistance = face.distance;
+                closest = i;
+            }
+        }
+        if(closest < 0){
+            return false;
+        }
+        const Vector3 normal = polytope.faces[closest].normal;
+        SupportPoint s = computeSupport(shape1, shape2, normal);
+        if(s.w.dot(normal) - minDistance < EpaTolerance){
+            break;
+        }
+
+        const int newVertex = polytope.vertices.size();
+        polytope.vertices.push_back(s);
+        horizon.clear();
+        for(auto& face : polytope.faces){
+            if(face.isAlive && face.normal.dot(s.w - polytope.vertices[face.v[0]].w) > 0.0){
+                face.isAlive = false;
+                for(int k=0; k < 3; ++k){
+                    pair<int, int> edge(face.v[k], face.v[(k + 1) % 3]);
+                    auto p = std::find(horizon.begin(), horizon.end(), make_pair(edge.second, edge.first));
+                    if(p != horizon.end()){
+                        horizon.erase(p);
+                    } else {
+                        horizon.push_back(edge);
+                    }
+                }
+            }
+        }
+        for(auto& edge : horizon){
+            polytope.addFace(edge.first, edge.second, newVertex);
+        }
+    }
+
+    const auto& face = polytope.faces[closest];
+    const SupportPoint& a = polytope.vertices[face.v[0]];
+    const SupportPoint& b = polytope.vertices[face.v[1]];
+    const SupportPoint& c = polytope.vertices[face.v[2]];
+    out_normal = face.normal;
+    out_depth = std::max(face.distance, 0.0);
+
+    // The barycentric coordinates of the projection of the origin on the face
+    const Vector3 p = face.normal * face.distance;
+    const Vector3 v0 = b.w - a.w;
+    const Vector3 v1 = c.w - a.w;
+    const Vector3 v2 = p - a.w;
+    const double d00 = v0.dot(v0);
+    const double d01 = v0.dot(v1);
+    const double d11 = v1.dot(v1);
+    const double d20 = v2.dot(v0);
+    const double d21 = v2.dot(v1);
+    const double denom = d00 * d11 - d01 * d01;
+    double v = 0.0, w = 0.0;
+    if(fabs(denom) > Epsilon * Epsilon){
+        v = (d11 * d20 - d01 * d21) / denom;
+        w = (d00 * d21 - d01 * d20) / denom;
+    }
+    const double u = 1.0 - v - w;
+    out_point1 = u * a.p1 + v * b.p1 + w * c.p1;
+    out_point2 = u * a.p2 + v * b.p2 + w * c.p2;
+    return true;
+}
+
+}
+
+
+ConvexShape::ConvexShape()
+{
+    type = Hull;
+    hull = nullptr;
+    T.setIdentity();
+    halfSize.setZero();
+    radius = 0.0;
+    halfHeight = 0.0;
+    lastSupportVertex = 0;
+}
+
+
+void ConvexShape::setHull(const ConvexHull* hull, const Isometry3& T)
+{
+    type = Hull;
+    this->hull = hull;
+    this->T = T;
+    lastSupportVertex = 0;
+}
+
+
+void ConvexShape::setPrimitive(const PrimitiveShape& primitive)
+{
+    switch(primitive.type){
+    case PrimitiveShape::Box:      type = Box;      break;
+    case PrimitiveShape::Sphere:   type = Sphere;   break;
+    case PrimitiveShape::Capsule:  type = Capsule;  break;
+    case PrimitiveShape::Cylinder: type = Cylinder; break;
+    }
+    T = primitive.T;
+    halfSize = primitive.halfSize;
+    radius = primitive.radius;
+    halfHeight = primitive.halfHeight;
+}
+
+
+void ConvexShape::setTriangle(const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    type = Triangle;
+    triangle[0] = a;
+    triangle[1] = b;
+    triangle[2] = c;
+}
+
+
+Vector3 ConvexShape::support(const Vector3& direction) const
+{
+    switch(type){
+
+    case Hull: {
+        const Vector3 localDirection = T.linear().transpose() * direction;
+        lastSupportVertex = hull->findSupportVertex(localDirection, lastSupportVertex);
+        return T * hull->vertices()[lastSupportVertex];
+    }
+    case Box: {
+        Vector3 p = T.translation();
+        for(int i=0; i < 3; ++i){
+            const Vector3 axis = T.linear().col(i);
+            p += (direction.dot(axis) >= 0.0 ? halfSize[i] : -halfSize[i]) * axis;
+        }
+        return p;
+    }
+    case Sphere:
+    case Capsule:
+    case Cylinder: {
+        const Vector3 axis = T.linear().col(1);
+        const double a = direction.dot(axis);
+        Vector3 p = T.translation() + (a >= 0.0 ? halfHeight : -halfHeight) * axis;
+        if(type == Cylinder){
+            const Vector3 radial = direction - a * axis;
+            const double norm = radial.norm();
+            if(norm > Epsilon){
+                p += (radius / norm) * radial;
+            }
+        } else {
+            const double norm = direction.norm();
+            if(norm > Epsilon){
+                p += (radius / norm) * direction;
+            }
+        }
+        return p;
+    }
+    case Triangle: {
+        int index = 0;
+        double maxProjection = direction.dot(triangle[0]);
+        for(int i=1; i < 3; ++i){
+            double projection = direction.dot(triangle[i]);
+            if(projection > maxProjection){
+                maxProjection = projection;
+                index = i;
+            }
+        }
+        return triangle[index];
+    }
+    }
+    return T.translation();
+}
+
+
+double ConvexShape::getFace(const Vector3& direction, std::vector<Vector3>& out_vertices, Vector3& out_normal) const
+{
+    out_vertices.clear();
+
+    switch(type){
+
+    case Hull: {
+        const Vector3 localDirection = T.linear().transpose() * direction;
+        const auto& face = hull->faces()[hull->findFaceAlong(localDirection)];
+        const auto& vertices = hull->vertices();
+        for(auto& index : face.vertexIndices){
+            out_vertices.push_back(T * vertices[index]);
+        }
+        out_normal = T.linear() * face.normal;
+        return out_normal.dot(direction);
+    }
+    case Box: {
+        const Matrix3 R = T.linear();
+        int axis = 0;
+        double maxProjection = -1.0;
+        for(int i=0; i < 3; ++i){
+            double projection = fabs(direction.dot(R.col(i)));
+            if(projection > maxProjection){
+                maxProjection = projection;
+                axis = i;
+            }
+        }
+        const double sign = (direction.dot(R.col(axis)) >= 0.0) ? 1.0 : -1.0;
+        const int i1 = (axis + 1) % 3;
+        const int i2 = (axis + 2) % 3;
+        const Vector3 center = T.translation() + sign * halfSize[axis] * R.col(axis);
+        const Vector3 u = halfSize[i1] * R.col(i1);
+        const Vector3 v = halfSize[i2] * R.col(i2);
+        out_vertices = { center + u + v, center - u + v, center - u - v, center + u - v };
+        out_normal = sign * R.col(axis);
+        return maxProjection;
+    }
+    case Cylinder: {
+        const Vector3 axis = T.linear().col(1);
+        const double a = direction.dot(axis);
+        out_normal = (a >= 0.0) ? axis : Vector3(-axis);
+        const Vector3 center = T.translation() + halfHeight * out_normal;
+        const Vector3 u = axis.unitOrthogonal();
+        const Vector3 v = axis.cross(u);
+        for(int i=0; i < NumDiscVertices; ++i){
+            const double angle = 2.0 * PI * i / NumDiscVertices;
+            out_vertices.push_back(center + radius * (cos(angle) * u + sin(angle) * v));
+        }
+        return fabs(a);
+    }
+    case Triangle: {
+        Vector3 normal = (triangle[1] - triangle[0]).cross(triangle[2] - triangle[0]);
+        const double norm = normal.norm();
+        if(norm < Epsilon){
+            return -1.0;
+        }
+        out_normal = normal / norm;
+        if(out_normal.dot(direction) < 0.0){
+            out_normal = -out_normal;
+        }
+        out_vertices.assign(triangle, triangle + 3);
+        return out_normal.dot(direction);
+    }
+    default:
+        return -1.0;
+    }
+}
+
+
+void ConvexShape::getSupportFeature(const Vector3& direction, std::vector<Vector3>& out_vertices) const
+{
+    Vector3 normal;
+    switch(type){
+
+    case Hull:
+    case Box:
+    case Triangle:
+        getFace(direction, out_vertices, normal);
+        return;
+
+    case Capsule:
+    case Cylinder: {
+        const Vector3 axis = T.linear().col(1);
+        const double a = direction.dot(axis);
+        if(type == Cylinder && fabs(a) > FaceContactThreshold){
+            getFace(direction, out_vertices, normal);
+            return;
+        }
+        if(fabs(a) < ParallelAxisThreshold){
+            const Vector3 radial = direction - a * axis;
+            const Vector3 offset = T.translation() + radius * radial.normalized();
+            out_vertices = { offset + halfHeight * axis, offset - halfHeight * axis };
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    out_vertices.clear();
+    out_vertices.push_back(support(direction));
+}
+
+
+Vector3 ConvexShape::center() const
+{
+    switch(type){
+    case Hull:
+        return T * hull->center();
+    case Triangle:
+        return (triangle[0] + triangle[1] + triangle[2]) / 3.0;
+    default:
+        return T.translation();
+    }
+}
+
+
+double ConvexShape::boundingRadius() const
+{
+    switch(type){
+    case Hull:
+        return hull->radius();
+    case Box:
+        return halfSize.norm();
+    case Sphere:
+        return radius;
+    case Capsule:
+        return radius + halfHeight;
+    case Cylinder:
+        return sqrt(radius * radius + halfHeight * halfHeight);
+    case Triangle: {
+        const Vector3 c = center();
+        return std::max({ (triangle[0] - c).norm(), (triangle[1] - c).norm(), (triangle[2] - c).norm() });
+    }
+    }
+    return 0.0;
+}
+
+
+ConvexContactManifold::ConvexContactManifold()
+{
+    lastDirection_.setZero();
+}
+
+
+void ConvexContactManifold::clear()
+{
+    points.clear();
+}
+
+
+void ConvexContactManifold::update
+(const Isometry3& T1, const Isometry3& T2, std::vector<PrimitiveContact>& io_contacts, size_t begin)
+{
+    const size_t numNewContacts = io_contacts.size() - begin;
+    if(numNewContacts == 0){
+        points.clear();
+        return;
+    }
+
+    const Isometry3 T1inv = T1.inverse();
+    const Isometry3 T2inv = T2.inverse();
+    const Matrix3 R1 = T1.linear();
+
+    vector<Point> newPoints;
+    for(size_t i = begin; i < io_contacts.size(); ++i){
+        const auto& contact = io_contacts[i];
+        const Vector3 offset = contact.normal * (contact.depth / 2.0);
+        newPoints.push_back({ T1inv * Vector3(contact.point + offset), T2inv * Vector3(contact.point - offset),
+                              R1.transpose() * contact.normal });
+    }
+
+    // The new contacts of a face contact are complete
+    if(numNewContacts >= 3){
+        points.swap(newPoints);
+        return;
+    }
+
+    vector<PrimitiveContact> candidates(io_contacts.begin() + begin, io_contacts.end());
+    vector<Point> candidatePoints = newPoints;
+    for(auto& point : points){
+        const Vector3 p1 = T1 * point.local1;
+        const Vector3 p2 = T2 * point.local2;
+        const Vector3 storedNormal = R1 * point.localNormal;
+        const PrimitiveContact* sameNormalContact = nullptr;
+        for(size_t i=0; i < numNewContacts; ++i){
+            if(candidates[i].normal.dot(storedNormal) > SameNormalThreshold){
+                sameNormalContact = &candidates[i];
+                break;
+            }
+        }
+        if(!sameNormalContact){
+            continue;
+        }
+        const Vector3& normal = sameNormalContact->normal;
+        const Vector3 r = p1 - p2;
+        const double depth = r.dot(normal);
+        if(depth < -ContactBreakingThreshold || (r - depth * normal).norm() > ContactBreakingThreshold){
+            continue;
+        }
+        const Vector3 midpoint = (p1 + p2) / 2.0;
+        bool isReplaced = false;
+        for(size_t i=0; i < numNewContacts; ++i){
+            if((candidates[i].point - midpoint).norm() < ContactBreakingThreshold){
+                isReplaced = true;
+                break;
+            }
+        }
+        if(!isReplaced){
+            PrimitiveContact contact;
+            contact.point = midpoint;
+            contact.normal = normal;
+            contact.depth = depth;
+            candidates.push_back(contact);
+            candidatePoints.push_back(point);
+        }
+    }
+
+    int indices[4];
+    int numSelected = PrimitiveCollider::selectSpanningContacts(candidates.data(), candidates.size(), indices);
+    points.clear();
+    io_contacts.resize(begin);
+    for(int i=0; i < numSelected; ++i){
+        const auto& contact = candidates[indices[i]];
+        points.push_back(candidatePoints[indices[i]]);
+        // The stored contacts that are slightly separated are kept but not used
+        if(contact.depth >= 0.0){
+            io_contacts.push_back(contact);
+        }
+    }
+}
+
+
+bool ConvexCollider::computePenetration
+(const ConvexShape& shape1, const ConvexShape& shape2, Vector3& io_direction,
+ Vector3& out_normal, double& out_depth, Vector3& out_point1, Vector3& out_point2)
+{
+    Simplex simplex;
+    if(!runGjk(shape1, shape2, io_direction, simplex)){
+        return false;
+    }
+    if(!runEpa(shape1, shape2, simplex, out_normal, out_depth, out_point1, out_point2)){
+        return false;
+    }
+    // The direction for the next detection, which is the closest point of the Minkowski difference
+    io_direction = -out_normal;
+    return true;
+}
+
+
+bool ConvexCollider::collide
+(const ConvexShape& shape1, const ConvexShape& shape2, std::vector<PrimitiveContact>& out_contacts,
+ ConvexContactManifold* manifold)
+{
+    if((shape1.center() - shape2.center()).norm() > shape1.boundingRadius() + shape2.boundingRadius()){
+        if(manifold){
+            manifold->clear();
+        }
+        return false;
+    }
+
+    Vector3 direction;
+    if(manifold && !manifold->lastDirection().isZero()){
+        direction = manifold->lastDirection();
+    } else {
+        direction = shape1.center() - shape2.center();
+    }
+    Vector3 normal, point1, point2;
+    double depth;
+    bool isPenetrating = computePenetration(shape1, shape2, direction, normal, depth, point1, point2);
+    if(manifold){
+        manifold->setLastDirection(direction);
+    }
+    // Only the front side of a triangle generates the contact
+    Vector3 faceNormal;
+    vector<Vector3> face;
+    if(isPenetrating){
+        if(shape2.type == ConvexShape::Triangle){
+            isPenetrating = shape2.getFace(-normal, face, faceNormal) > 0.0 &&
+                faceNormal.dot((shape2.triangle[1] - shape2.triangle[0]).cross(shape2.triangle[2] - shape2.triangle[0])) > 0.0;
+        } else if(shape1.type == ConvexShape::Triangle){
+            isPenetrating = shape1.getFace(normal, face, faceNormal) > 0.0 &&
+                faceNormal.dot((shape1.triangle[1] - shape1.triangle[0]).cross(shape1.triangle[2] - shape1.triangle[0])) > 0.0;
+        }
+    }
+    if(!isPenetrating){
+        if(manifold){
+            manifold->clear();
+        }
+        return false;
+    }
+
+    const size_t begin = out_contacts.size();
+    vector<Vector3> face1, face2, incident;
+    Vector3 normal1, normal2;
+
+    /*
+      The contacts with a triangle of a mesh are always resolved along the normal of the triangle.
+      The normal given by the EPA algorithm may point to the side of the triangle when a shape crosses
+      the internal edge between the adjacent triangles, and such a contact makes the shape bump on a flat
+      mesh. The contacts of the shape outside the triangle are given by the other triangles.
+    */
+    if(shape2.type == ConvexShape::Triangle){
+        normal = -faceNormal;
+        shape1.getSupportFeature(normal, incident);
+        PrimitiveCollider::addClippedContacts(face, faceNormal, incident, normal, out_contacts);
+    } else if(shape1.type == ConvexShape::Triangle){
+        normal = faceNormal;
+        shape2.getSupportFeature(-normal, incident);
+        PrimitiveCollider::addClippedContacts(face, faceNormal, incident, normal, out_contacts);
+    } else {
+        const double alignment1 = shape1.getFace(normal, face1, normal1);
+        const double alignment2 = shape2.getFace(-normal, face2, normal2);
+        if(std::max(alignment1, alignment2) >= FaceContactThreshold){
+            if(alignment1 >= alignment2){
+                shape2.getSupportFeature(-normal, incident);
+                PrimitiveCollider::addClippedContacts(face1, normal1, incident, normal, out_contacts);
+            } else {
+                shape1.getSupportFeature(normal, incident);
+                PrimitiveCollider::addClippedContacts(face2, normal2, incident, normal, out_contacts);
+            }
+        }
+        if(out_contacts.size() == begin){
+            out_contacts.emplace_back();
+            auto& contact = out_contacts.back();
+            contact.point = (point1 + point2) / 2.0;
+            contact.normal = normal;
+            contact.depth = depth;
+        }
+    }
+    if(out_contacts.size() == begin){
+        if(manifold){
+            manifold->clear();
+        }
+        return false;
+    }
+    PrimitiveCollider::reduceContacts(out_contacts, begin);
+
+    if(manifold){
+        manifold->update(shape1.T, shape2.T, out_contacts, begin);
+    }
+
+    return out_contacts.size() > begin;
+}
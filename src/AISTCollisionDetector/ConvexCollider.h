@@ -0,0 +1,117 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_CONVEX_COLLIDER_H
+#define CNOID_AIST_COLLISION_DETECTOR_CONVEX_COLLIDER_H
+
+#include "ConvexHull.h"
+#include "PrimitiveCollider.h"
+#include <vector>
+
+namespace cnoid {
+
+/**
+   A convex shape in the world coordinate that is given to ConvexCollider by its support mapping.
+*/
+class ConvexShape
+{
+public:
+    enum Type { Hull, Box, Sphere, Capsule, Cylinder, Triangle };
+
+    Type type;
+    const ConvexHull* hull;
+    //! The position of the shape other than a triangle
+    Isometry3 T;
+    //! The parameters of the primitive shapes. The axis of a cylinder or a capsule is the y-axis.
+    Vector3 halfSize;
+    double radius;
+    double halfHeight;
+    //! The vertices of a triangle in the world coordinate
+    Vector3 triangle[3];
+    //! The support vertex of the hull found in the last search, which is used as the start of the next search
+    mutable int lastSupportVertex;
+
+    ConvexShape();
+    void setHull(const ConvexHull* hull, const Isometry3& T);
+    void setPrimitive(const PrimitiveShape& primitive);
+    void setTriangle(const Vector3& a, const Vector3& b, const Vector3& c);
+
+    //! The point of the shape that is the farthest along the direction
+    Vector3 support(const Vector3& direction) const;
+
+    /**
+       Get the face of the shape whose outward normal is the closest to the direction.
+       \return The inner product of the normal and the direction, or -1 if the shape does not have faces
+    */
+    double getFace(const Vector3& direction, std::vector<Vector3>& out_vertices, Vector3& out_normal) const;
+
+    /**
+       Get the face, the edge or the vertex of the shape that is the farthest along the direction
+    */
+    void getSupportFeature(const Vector3& direction, std::vector<Vector3>& out_vertices) const;
+
+    Vector3 center() const;
+    double boundingRadius() const;
+};
+
+
+/**
+   This class keeps the contacts of a shape pair in the local coordinates of the shapes, and the contacts
+   that are still valid after the shapes move are added to the single contact found by the EPA algorithm.
+   The contacts of an edge or a curved surface are accumulated over the steps in this way while the contacts
+   of a face contact are replaced with the new ones.
+*/
+class ConvexContactManifold
+{
+public:
+    ConvexContactManifold();
+
+    //! The separating direction found in the last detection, which is used as the initial direction of GJK
+    const Vector3& lastDirection() const { return lastDirection_; }
+    void setLastDirection(const Vector3& direction) { lastDirection_ = direction; }
+
+    void clear();
+
+    /**
+       The contacts from the begin index are updated with the stored contacts.
+       \param T1, T2 The positions of the first and second shapes, which must be the positions
+       of the same coordinates over the steps.
+    */
+    void update(const Isometry3& T1, const Isometry3& T2, std::vector<PrimitiveContact>& io_contacts, size_t begin);
+
+private:
+    struct Point
+    {
+        Vector3 local1;
+        Vector3 local2;
+        Vector3 localNormal;
+    };
+    std::vector<Point> points;
+    Vector3 lastDirection_;
+};
+
+
+class ConvexCollider
+{
+public:
+    /**
+       The penetration is computed with the GJK and EPA algorithms.
+       \param io_direction The initial search direction of GJK, which is updated with the found direction
+       \param out_normal The normal from the first shape to the second shape
+       \param out_point1, out_point2 The deepest points of the shapes
+       \return false if the shapes do not intersect
+    */
+    static bool computePenetration(
+        const ConvexShape& shape1, const ConvexShape& shape2, Vector3& io_direction,
+        Vector3& out_normal, double& out_depth, Vector3& out_point1, Vector3& out_point2);
+
+    /**
+       The contacts are generated by clipping the features of the shapes around the normal given by
+       the EPA algorithm. The contact of a triangle is only generated for the front side of the triangle.
+       \note The normals of the contacts point from the first shape to the second shape.
+    */
+    static bool collide(
+        const ConvexShape& shape1, const ConvexShape& shape2, std::vector<PrimitiveContact>& out_contacts,
+        ConvexContactManifold* manifold = nullptr);
+};
+
+}
+
+#endif
@@ -0,0 +1,784 @@
+#include "ConvexHull.h"
+#include <map>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The support vertex of a hull with more vertices than this is searched by hill climbing
+const int MaxNumVerticesForExhaustiveSearch = 32;
+
+// The adjacent triangles of a hull are merged into a polygon face if the inner product of their normals exceeds this
+const double CoplanarNormalThreshold = 1.0 - 1.0e-6;
+
+// The number of the points used to evaluate the concavity of a part is limited to this
+const int MaxNumConcavitySamples = 2000;
+
+struct HullTriangle
+{
+    int v[3];
+    // The neighbor across the edge from v[i] to v[(i + 1) % 3]
+    int neighbors[3];
+    Vector3 normal;
+    double offset;
+    vector<int> outsidePoints;
+    bool isAlive;
+    bool isVisible;
+
+    double distance(const Vector3& p) const { return normal.dot(p) - offset; }
+};
+
+
+class QuickHullBuilder
+{
+public:
+    const vector<Vector3>& points;
+    vector<HullTriangle> triangles;
+    double epsilon;
+    int initialVertices[3];
+    Vector3 planeNormal;
+
+    QuickHullBuilder(const vector<Vector3>& points) : points(points) { }
+
+    //! \return The dimension of the point set
+    int build();
+    void extract(vector<Vector3>& out_vertices, vector<ConvexHull::Face>& out_faces, vector<vector<int>>& out_neighbors);
+
+private:
+    int addTriangle(int v0, int v1, int v2);
+    bool addPoint(int triangleIndex, vector<int>& newTriangles);
+    void assignPoint(int pointIndex, const vector<int>& candidates);
+};
+
+
+int QuickHullBuilder::addTriangle(int v0, int v1, int v2)
+{
+    triangles.emplace_back();
+    auto& triangle = triangles.back();
+    triangle.v[0] = v0;
+    triangle.v[1] = v1;
+    triangle.v[2] = v2;
+    triangle.neighbors[0] = triangle.neighbors[1] = triangle.neighbors[2] = -1;
+    Vector3 normal = (points[v1] - points[v0]).cross(points[v2] - points[v0]);
+    double norm = normal.norm();
+    triangle.normal = (norm > 0.0) ? Vector3(normal / norm) : Vector3::UnitZ();
+    triangle.offset = triangle.normal.dot(points[v0]);
+    triangle.isAlive = true;
+    triangle.isVisible = false;
+    return triangles.size() - 1;
+}
+
+
+void QuickHullBuilder::assignPoint(int pointIndex, const vector<int>& candidates)
+{
+    const Vector3& p = points[pointIndex];
+    for(auto& index : candidates){
+        auto& triangle = triangles[index];
+        if(triangle.distance(p) > epsilon){
+            triangle.outsidePoints.push_back(pointIndex);
+            break;
+        }
+    }
+}
+
+
+int QuickHullBuilder::build()
+{
+    const int n = points.size();
+    if(n == 0){
+        return -1;
+    }
+
+    int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+    for(int i=1; i < n; ++i){
+        for(int j=0; j < 3; ++j){
+            if(points[i][j] < points[extremes[j * 2]][j]){
+                extremes[j * 2] = i;
+            }
+            if(points[i][j] > points[extremes[j * 2 + 1]][j]){
+                extremes[j * 2 + 1] = i;
+            }
+        }
+    }
+    Vector3 extent;
+    for(int j=0; j < 3; ++j){
+        extent[j] = points[extremes[j * 2 + 1]][j] - points[extremes[j * 2]][j];
+    }
+    epsilon = std::max(extent.norm() * 1.0e-8, 1.0e-12);
+
+    int i0 = 0, i1 = 0;
+    double maxDistance2 = -1.0;
+    for(int i=0; i < 6; ++i){
+        for(int j = i + 1; j < 6; ++j){
+            double d2 = (points[extremes[i]] - points[extremes[j]]).squaredNorm();
+            if(d2 > maxDistance2){
+                maxDistance2 = d2;
+                i0 = extremes[i];
+                i1 = extremes[j];
+            }
+        }
+    }
+    if(sqrt(maxDistance2) <= epsilon){
+        return 0;
+    }
+
+    const Vector3 lineDirection = (points[i1] - points[i0]).normalized();
+    int i2 = -1;
+    double maxDistance = epsilon;
+    for(int i=0; i < n; ++i){
+        Vector3 v = points[i] - points[i0];
+        double d = (v - lineDirection * lineDirection.dot(v)).norm();
+        if(d > maxDistance){
+            maxDistance = d;
+            i2 = i;
+        }
+    }
+    if(i2 < 0){
+        return 1;
+    }
+
+    initialVertices[0] = i0;
+    initialVertices[1] = i1;
+    initialVertices[2] = i2;
+    planeNormal = (points[i1] - points[i0]).cross(points[i2] - points[i0]).normalized();
+    int i3 = -1;
+    maxDistance = epsilon;
+    for(int i=0; i < n; ++i){
+        double d = fabs(planeNormal.dot(points[i] - points[i0]));
+        if(d > maxDistance){
+            maxDistance = d;
+            i3 = i;
+        }
+    }
+    if(i3 < 0){
+        return 2;
+    }
+
+    // The initial tetrahedron
+    const int vertices[4] = { i0, i1, i2, i3 };
+    const int faceVertices[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+    for(auto& f : faceVertices){
+        int a = vertices[f[0]];
+        int b = vertices[f[1]];
+        int c = vertices[f[2]];
+        Vector3 normal = (points[b] - points[a]).cross(points[c] - points[a]);
+        if(normal.dot(points[vertices[f[3]]] - points[a]) > 0.0){
+            std::swap(b, c);
+        }
+        addTriangle(a, b, c);
+    }
+    for(int i=0; i < 4; ++i){
+        auto& t1 = triangles[i];
+        for(int k=0; k < 3; ++k){
+            int a = t1.v[k];
+            int b = t1.v[(k + 1) % 3];
+            for(int j=0; j < 4; ++j){
+                auto& t2 = triangles[j];
+                for(int l=0; l < 3; ++l){
+                    if(t2.v[l] == b && t2.v[(l + 1) % 3] == a){
+                        t1.neighbors[k] = j;
+                    }
+                }
+            }
+        }
+    }
+
+    vector<int> candidates = { 0, 1, 2, 3 };
+    for(int i=0; i < n; ++i){
+        if(i != i0 && i != i1 && i != i2 && i != i3){
+            assignPoint(i, candidates);
+        }
+    }
+
+    vector<int> stack = candidates;
+    vector<int> newTriangles;
+    while(!stack.empty()){
+        int index = stack.back();
+        stack.pop_back();
+        while(triangles[index].isAlive && !triangles[index].outsidePoints.empty()){
+            newTriangles.clear();
+            if(addPoint(index, newTriangles)){
+                stack.insert(stack.end(), newTriangles.begin(), newTriangles.end());
+                break;
+            }
+        }
+    }
+
+    return 3;
+}
+
+
+/**
+   The farthest outside point of the triangle is added to the hull.
+   \return false if the point is discarded without changing the hull
+*/
+bool QuickHullBuilder::addPoint(int triangleIndex, vector<int>& newTriangles)
+{
+    auto& outsidePoints = triangles[triangleIndex].outsidePoints;
+    int eyeIndex = 0;
+    double maxDistance = -1.0;
+    for(size_t i=0; i < outsidePoints.size(); ++i){
+        double d = triangles[triangleIndex].distance(points[outsidePoints[i]]);
+        if(d > maxDistance){
+            maxDistance = d;
+            eyeIndex = i;
+        }
+    }
+    const int eye = outsidePoints[eyeIndex];
+    const Vector3& eyePoint = points[eye];
+
+    vector<int> visibles = { triangleIndex };
+    triangles[triangleIndex].isVisible = true;
+    for(size_t i=0; i < visibles.size(); ++i){
+        for(auto& neighbor : triangles[visibles[i]].neighbors){
+            auto& triangle = triangles[neighbor];
+            if(!triangle.isVisible && triangle.distance(eyePoint) > epsilon){
+                triangle.isVisible = true;
+                visibles.push_back(neighbor);
+            }
+        }
+    }
+
+    struct HorizonEdge { int a, b, outside; };
+    vector<HorizonEdge> horizon;
+    map<int, int> startVertexCounts;
+    bool isValidHorizon = true;
+    for(auto& index : visibles){
+        auto& triangle = triangles[index];
+        for(int k=0; k < 3; ++k){
+            int neighbor = triangle.neighbors[k];
+            if(!triangles[neighbor].isVisible){
+                int a = triangle.v[k];
+                horizon.push_back({ a, triangle.v[(k + 1) % 3], neighbor });
+                if(++startVertexCounts[a] > 1){
+                    isValidHorizon = false;
+                }
+            }
+        }
+    }
+
+    // The point is discarded if the visible region is not a disc because of the numerical errors
+    if(!isValidHorizon){
+        for(auto& index : visibles){
+            triangles[index].isVisible = false;
+        }
+        outsidePoints.erase(outsidePoints.begin() + eyeIndex);
+        return false;
+    }
+
+    map<int, int> triangleStartingAt;
+    map<int, int> triangleEndingAt;
+    for(auto& edge : horizon){
+        int index = addTriangle(edge.a, edge.b, eye);
+        auto& triangle = triangles[index];
+        triangle.neighbors[0] = edge.outside;
+        auto& outside = triangles[edge.outside];
+        for(int k=0; k < 3; ++k){
+            if(outside.v[k] == edge.b && outside.v[(k + 1) % 3] == edge.a){
+                outside.neighbors[k] = index;
+            }
+        }
+        triangleStartingAt[edge.a] = index;
+        triangleEndingAt[edge.b] = index;
+        newTriangles.push_back(index);
+    }
+    for(auto& index : newTriangles){
+        auto& triangle = triangles[index];
+        triangle.neighbors[1] = triangleStartingAt[triangle.v[1]];
+        triangle.neighbors[2] = triangleEndingAt[triangle.v[0]];
+    }
+
+    for(auto& index : visibles){
+        auto& triangle = triangles[index];
+        for(auto& p : triangle.outsidePoints){
+            if(p != eye){
+                assignPoint(p, newTriangles);
+            }
+        }
+        triangle.outsidePoints.clear();
+        triangle.isAlive = false;
+        triangle.isVisible = false;
+    }
+
+    return true;
+}
+
+
+void QuickHullBuilder::extract
+(vector<Vector3>& out_vertices, vector<ConvexHull::Face>& out_faces, vector<vector<int>>& out_neighbors)
+{
+    vector<int> vertexIndexMap(points.size(), -1);
+    auto getVertexIndex = [&](int pointIndex){
+        int& index = vertexIndexMap[pointIndex];
+        if(index < 0){
+            index = out_vertices.size();
+            out_vertices.push_back(points[pointIndex]);
+            out_neighbors.emplace_back();
+        }
+        return index;
+    };
+
+    for(auto& triangle : triangles){
+        if(triangle.isAlive){
+            for(int k=0; k < 3; ++k){
+                int a = getVertexIndex(triangle.v[k]);
+                int b = getVertexIndex(triangle.v[(k + 1) % 3]);
+                out_neighbors[a].push_back(b);
+            }
+        }
+    }
+
+    // The coplanar triangles around a seed triangle are merged into a polygon
+    vector<int> groups(triangles.size(), -1);
+    vector<int> members;
+    for(size_t seed = 0; seed < triangles.size(); ++seed){
+        if(!triangles[seed].isAlive || groups[seed] >= 0){
+            continue;
+        }
+        const Vector3& seedNormal = triangles[seed].normal;
+        members.clear();
+        members.push_back(seed);
+        groups[seed] = seed;
+        for(size_t i=0; i < members.size(); ++i){
+            for(auto& neighbor : triangles[members[i]].neighbors){
+                if(groups[neighbor] < 0 && triangles[neighbor].normal.dot(seedNormal) > CoplanarNormalThreshold){
+                    groups[neighbor] = seed;
+                    members.push_back(neighbor);
+                }
+            }
+        }
+
+        Vector3 normal = Vector3::Zero();
+        vector<int> indices;
+        for(auto& member : members){
+            auto& triangle = triangles[member];
+            normal += (points[triangle.v[1]] - points[triangle.v[0]]).cross(points[triangle.v[2]] - points[triangle.v[0]]);
+            for(auto& v : triangle.v){
+                indices.push_back(vertexIndexMap[v]);
+            }
+        }
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        double norm = normal.norm();
+        normal = (norm > 0.0) ? Vector3(normal / norm) : seedNormal;
+
+        Vector3 centroid = Vector3::Zero();
+        for(auto& index : indices){
+            centroid += out_vertices[index];
+        }
+        centroid /= indices.size();
+        const Vector3 u = normal.unitOrthogonal();
+        const Vector3 w = normal.cross(u);
+        vector<pair<double, int>> angles;
+        for(auto& index : indices){
+            Vector3 r = out_vertices[index] - centroid;
+            angles.emplace_back(atan2(w.dot(r), u.dot(r)), index);
+        }
+        std::sort(angles.begin(), angles.end());
+
+        out_faces.emplace_back();
+        auto& face = out_faces.back();
+        face.normal = normal;
+        face.offset = -std::numeric_limits<double>::max();
+        for(auto& angle : angles){
+            face.vertexIndices.push_back(angle.second);
+            face.offset = std::max(face.offset, normal.dot(out_vertices[angle.second]));
+        }
+    }
+}
+
+
+class DisjointSet
+{
+    vector<int> parents;
+public:
+    DisjointSet(int n) : parents(n) {
+        std::iota(parents.begin(), parents.end(), 0);
+    }
+    int find(int i){
+        while(parents[i] != i){
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    }
+    void unite(int i, int j){
+        parents[find(i)] = find(j);
+    }
+};
+
+
+struct Part
+{
+    vector<int> triangles;
+    ConvexHullPtr hull;
+    double concavity;
+    Vector3 deepestPoint;
+    bool isSplittable;
+};
+
+
+void evaluatePart(Part& part, const vector<Vector3>& vertices, const vector<int>& triangles)
+{
+    vector<Vector3> points;
+    vector<Vector3> samples;
+    vector<int> indices;
+    for(auto& t : part.triangles){
+        Vector3 centroid = Vector3::Zero();
+        for(int i=0; i < 3; ++i){
+            int index = triangles[t * 3 + i];
+            indices.push_back(index);
+            centroid += vertices[index];
+        }
+        samples.push_back(centroid / 3.0);
+    }
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    for(auto& index : indices){
+        points.push_back(vertices[index]);
+    }
+    samples.insert(samples.end(), points.begin(), points.end());
+
+    part.hull = ConvexHull::create(points);
+    part.concavity = 0.0;
+    part.isSplittable = (part.hull != nullptr) && part.triangles.size() >= 2;
+    if(part.hull){
+        const size_t step = std::max(samples.size() / MaxNumConcavitySamples, size_t(1));
+        for(size_t i=0; i < samples.size(); i += step){
+            double depth = part.hull->computeDepth(samples[i]);
+            if(depth > part.concavity){
+                part.concavity = depth;
+                part.deepestPoint = samples[i];
+            }
+        }
+    }
+}
+
+
+double computeVolume(const ConvexHull* hull)
+{
+    auto& hullVertices = hull->vertices();
+    const Vector3& origin = hullVertices.front();
+    double volume = 0.0;
+    for(auto& face : hull->faces()){
+        auto& indices = face.vertexIndices;
+        const Vector3& v0 = hullVertices[indices[0]];
+        double area = 0.0;
+        for(size_t i=2; i < indices.size(); ++i){
+            area += (hullVertices[indices[i-1]] - v0).cross(hullVertices[indices[i]] - v0).dot(face.normal);
+        }
+        volume += area * (face.offset - face.normal.dot(origin));
+    }
+    return volume / 6.0;
+}
+
+
+/**
+   The part is split with the axis-aligned plane through the deepest point. The plane is chosen so that
+   the total volume of the hulls becomes the smallest. Note that the concavity depth is not a good measure
+   for this choice because slicing a part thinly always decreases the depth even if it does not separate
+   the concave region such as the hole of a torus. The longer extent is preferred for the same volume.
+*/
+bool splitPart(const Part& part, const vector<Vector3>& vertices, const vector<int>& triangles, Part& out_part1, Part& out_part2)
+{
+    auto& hullVertices = part.hull->vertices();
+    Vector3 lower = hullVertices.front();
+    Vector3 upper = hullVertices.front();
+    for(auto& v : hullVertices){
+        lower = lower.cwiseMin(v);
+        upper = upper.cwiseMax(v);
+    }
+    const Vector3 extents = upper - lower;
+    const double volumeTolerance = 1.0e-3 * computeVolume(part.hull);
+
+    double minVolume = std::numeric_limits<double>::max();
+    int selectedAxis = -1;
+    for(int axis = 0; axis < 3; ++axis){
+        Part parts[2];
+        for(auto& t : part.triangles){
+            double centroid =
+                (vertices[triangles[t * 3]][axis] + vertices[triangles[t * 3 + 1]][axis] +
+                 vertices[triangles[t * 3 + 2]][axis]) / 3.0;
+            parts[(centroid < part.deepestPoint[axis]) ? 0 : 1].triangles.push_back(t);
+        }
+        if(parts[0].triangles.empty() || parts[1].triangles.empty()){
+            continue;
+        }
+        evaluatePart(parts[0], vertices, triangles);
+        evaluatePart(parts[1], vertices, triangles);
+        if(!parts[0].hull || !parts[1].hull){
+            continue;
+        }
+        double volume = computeVolume(parts[0].hull) + computeVolume(parts[1].hull);
+        bool isBetter;
+        if(selectedAxis < 0 || volume < minVolume - volumeTolerance){
+            isBetter = true;
+        } else if(volume < minVolume + volumeTolerance){
+            isBetter = extents[axis] > extents[selectedAxis];
+        } else {
+            isBetter = false;
+        }
+        if(isBetter){
+            minVolume = volume;
+            selectedAxis = axis;
+            out_part1 = std::move(parts[0]);
+            out_part2 = std::move(parts[1]);
+        }
+    }
+    return selectedAxis >= 0;
+}
+
+}
+
+
+ConvexHull::ConvexHull()
+{
+    radius_ = 0.0;
+    center_.setZero();
+}
+
+
+ConvexHullPtr ConvexHull::create(const std::vector<Vector3>& points)
+{
+    QuickHullBuilder builder(points);
+    int dimension = builder.build();
+    if(dimension < 2){
+        return nullptr;
+    }
+    ConvexHullPtr hull = new ConvexHull;
+    if(dimension == 2){
+        hull->setPolygon(points, builder.planeNormal);
+    } else {
+        builder.extract(hull->vertices_, hull->faces_, hull->neighbors);
+    }
+    if(hull->vertices_.size() < 3){
+        return nullptr;
+    }
+    hull->updateBoundingSphere();
+    return hull;
+}
+
+
+//! The convex polygon of the points on the plane is made by the monotone chain algorithm
+void ConvexHull::setPolygon(const std::vector<Vector3>& points, const Vector3& normal)
+{
+    const Vector3 u = normal.unitOrthogonal();
+    const Vector3 w = normal.cross(u);
+    vector<pair<Vector2, int>> projected;
+    for(size_t i=0; i < points.size(); ++i){
+        projected.emplace_back(Vector2(u.dot(points[i]), w.dot(points[i])), i);
+    }
+    std::sort(projected.begin(), projected.end(),
+              [](const pair<Vector2, int>& p1, const pair<Vector2, int>& p2){
+                  return (p1.first.x() < p2.first.x()) ||
+                      (p1.first.x() == p2.first.x() && p1.first.y() < p2.first.y());
+              });
+    auto cross = [](const Vector2& o, const Vector2& a, const Vector2& b){
+        return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+    };
+    const int n = projected.size();
+    vector<int> chain(2 * n);
+    int k = 0;
+    for(int i=0; i < n; ++i){
+        while(k >= 2 && cross(projected[chain[k - 2]].first, projected[chain[k - 1]].first, projected[i].first) <= 0.0){
+            --k;
+        }
+        chain[k++] = i;
+    }
+    for(int i = n - 2, lower = k + 1; i >= 0; --i){
+        while(k >= lower && cross(projected[chain[k - 2]].first, projected[chain[k - 1]].first, projected[i].first) <= 0.0){
+            --k;
+        }
+        chain[k++] = i;
+    }
+    const int numVertices = std::max(k - 1, 0);
+
+    vertices_.clear();
+    neighbors.clear();
+    faces_.resize(2);
+    faces_[0].normal = normal;
+    faces_[1].normal = -normal;
+    for(auto& face : faces_){
+        face.vertexIndices.clear();
+        face.offset = -std::numeric_limits<double>::max();
+    }
+    for(int i=0; i < numVertices; ++i){
+        vertices_.push_back(points[projected[chain[i]].second]);
+        neighbors.push_back({ (i + numVertices - 1) % numVertices, (i + 1) % numVertices });
+        faces_[0].vertexIndices.push_back(i);
+        faces_[1].vertexIndices.push_back(numVertices - 1 - i);
+    }
+    for(auto& face : faces_){
+        for(auto& v : vertices_){
+            face.offset = std::max(face.offset, face.normal.dot(v));
+        }
+    }
+}
+
+
+void ConvexHull::updateBoundingSphere()
+{
+    Vector3 lower = vertices_.front();
+    Vector3 upper = vertices_.front();
+    for(auto& v : vertices_){
+        lower = lower.cwiseMin(v);
+        upper = upper.cwiseMax(v);
+    }
+    center_ = (lower + upper) / 2.0;
+    radius_ = 0.0;
+    for(auto& v : vertices_){
+        radius_ = std::max(radius_, (v - center_).norm());
+    }
+}
+
+
+int ConvexHull::findSupportVertex(const Vector3& direction, int initialVertex) const
+{
+    const int n = vertices_.size();
+    if(n <= MaxNumVerticesForExhaustiveSearch){
+        int index = 0;
+        double maxProjection = direction.dot(vertices_[0]);
+        for(int i=1; i < n; ++i){
+            double projection = direction.dot(vertices_[i]);
+            if(projection > maxProjection){
+                maxProjection = projection;
+                index = i;
+            }
+        }
+        return index;
+    }
+
+    // The local maximum is the global maximum on a convex hull
+    int index = (initialVertex >= 0 && initialVertex < n) ? initialVertex : 0;
+    double maxProjection = direction.dot(vertices_[index]);
+    while(true){
+        int next = index;
+        for(auto& neighbor : neighbors[index]){
+            double projection = direction.dot(vertices_[neighbor]);
+            if(projection > maxProjection){
+                maxProjection = projection;
+                next = neighbor;
+            }
+        }
+        if(next == index){
+            break;
+        }
+        index = next;
+    }
+    return index;
+}
+
+
+int ConvexHull::findFaceAlong(const Vector3& direction) const
+{
+    int index = 0;
+    double maxProjection = -std::numeric_limits<double>::max();
+    for(size_t i=0; i < faces_.size(); ++i){
+        double projection = direction.dot(faces_[i].normal);
+        if(projection > maxProjection){
+            maxProjection = projection;
+            index = i;
+        }
+    }
+    return index;
+}
+
+
+double ConvexHull::computeDepth(const Vector3& point) const
+{
+    double depth = std::numeric_limits<double>::max();
+    for(auto& face : faces_){
+        depth = std::min(depth, face.offset - face.normal.dot(point));
+    }
+    return depth;
+}
+
+
+std::vector<ConvexHullPtr> ConvexHull::decompose
+(const std::vector<Vector3>& vertices, const std::vector<int>& triangles, int maxNumHulls, double concavityTolerance)
+{
+    const int numTriangles = triangles.size() / 3;
+    vector<ConvexHullPtr> hulls;
+    if(numTriangles == 0){
+        return hulls;
+    }
+
+    // The vertices at the same position are identified to find the connected components
+    map<array<double, 3>, int> positionToVertexMap;
+    vector<int> weldedVertices(vertices.size());
+    for(size_t i=0; i < vertices.size(); ++i){
+        const Vector3& v = vertices[i];
+        weldedVertices[i] = positionToVertexMap.emplace(array<double, 3>{{ v.x(), v.y(), v.z() }}, i).first->second;
+    }
+    DisjointSet components(vertices.size());
+    for(int i=0; i < numTriangles; ++i){
+        int v0 = weldedVertices[triangles[i * 3]];
+        components.unite(weldedVertices[triangles[i * 3 + 1]], v0);
+        components.unite(weldedVertices[triangles[i * 3 + 2]], v0);
+    }
+    map<int, vector<int>> componentTriangles;
+    for(int i=0; i < numTriangles; ++i){
+        componentTriangles[components.find(weldedVertices[triangles[i * 3]])].push_back(i);
+    }
+
+    vector<Part> parts;
+    for(auto& kv : componentTriangles){
+        parts.emplace_back();
+        parts.back().triangles = std::move(kv.second);
+    }
+    std::sort(parts.begin(), parts.end(),
+              [](const Part& p1, const Part& p2){ return p1.triangles.size() > p2.triangles.size(); });
+    maxNumHulls = std::max(maxNumHulls, 1);
+    if((int)parts.size() > maxNumHulls){
+        auto& last = parts[maxNumHulls - 1];
+        for(size_t i = maxNumHulls; i < parts.size(); ++i){
+            last.triangles.insert(last.triangles.end(), parts[i].triangles.begin(), parts[i].triangles.end());
+        }
+        parts.resize(maxNumHulls);
+    }
+    for(auto& part : parts){
+        evaluatePart(part, vertices, triangles);
+    }
+
+    Vector3 lower = vertices.front();
+    Vector3 upper = vertices.front();
+    for(auto& v : vertices){
+        lower = lower.cwiseMin(v);
+        upper = upper.cwiseMax(v);
+    }
+    const double tolerance = concavityTolerance * (upper - lower).norm();
+
+    while((int)parts.size() < maxNumHulls){
+        int target = -1;
+        double maxConcavity = tolerance;
+        for(size_t i=0; i < parts.size(); ++i){
+            if(parts[i].isSplittable && parts[i].concavity > maxConcavity){
+                maxConcavity = parts[i].concavity;
+                target = i;
+            }
+        }
+        if(target < 0){
+            break;
+        }
+        Part part1, part2;
+        if(splitPart(parts[target], vertices, triangles, part1, part2)){
+            parts[target] = std::move(part1);
+            parts.push_back(std::move(part2));
+        } else {
+            parts[target].isSplittable = false;
+        }
+    }
+
+    for(auto& part : parts){
+        if(part.hull){
+            hulls.push_back(part.hull);
+        }
+    }
+    return hulls;
+}
@@ -0,0 +1,83 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_CONVEX_HULL_H
+#define CNOID_AIST_COLLISION_DETECTOR_CONVEX_HULL_H
+
+#include <cnoid/Referenced>
+#include <cnoid/EigenTypes>
+#include <vector>
+
+namespace cnoid {
+
+class ConvexHull;
+typedef ref_ptr<ConvexHull> ConvexHullPtr;
+
+/**
+   The convex hull of a point set, which is used by the GJK and EPA algorithms in ConvexCollider.
+   The hull of the points on a plane is given as the polygon that has the faces of both sides.
+*/
+class ConvexHull : public Referenced
+{
+public:
+    struct Face
+    {
+        //! The outward normal
+        Vector3 normal;
+        //! normal.dot(p) equals this for the points on the face
+        double offset;
+        //! The vertices of the convex polygon in the counterclockwise order seen from the outside
+        std::vector<int> vertexIndices;
+    };
+
+    /**
+       The hull is built with the quickhull algorithm.
+       \return nullptr if the points do not span any area
+    */
+    static ConvexHullPtr create(const std::vector<Vector3>& points);
+
+    /**
+       The mesh is approximately decomposed into the convex parts by splitting the parts with the deepest
+       concavity until the concavity of every part becomes smaller than the tolerance or the number of
+       the parts reaches the maximum number. The separated components of the mesh are always separated.
+       \param triangles The vertex indices of the triangles. Three elements are used for each triangle.
+       \param concavityTolerance The ratio of the allowed concavity depth to the size of the mesh
+    */
+    static std::vector<ConvexHullPtr> decompose(
+        const std::vector<Vector3>& vertices, const std::vector<int>& triangles,
+        int maxNumHulls, double concavityTolerance);
+
+    const std::vector<Vector3>& vertices() const { return vertices_; }
+    const std::vector<Face>& faces() const { return faces_; }
+
+    //! The center and the radius of the sphere that contains the hull
+    const Vector3& center() const { return center_; }
+    double radius() const { return radius_; }
+
+    /**
+       \param initialVertex The search begins with this vertex. The vertex found in the last search
+       with the similar direction makes the search faster.
+    */
+    int findSupportVertex(const Vector3& direction, int initialVertex = 0) const;
+
+    //! The face whose outward normal is the closest to the direction
+    int findFaceAlong(const Vector3& direction) const;
+
+    /**
+       The depth of the deepest point inside the hull, which is zero or negative for the points outside.
+    */
+    double computeDepth(const Vector3& point) const;
+
+private:
+    std::vector<Vector3> vertices_;
+    std::vector<Face> faces_;
+    // The adjacent vertices of each vertex used by the hill climbing search of the support vertex
+    std::vector<std::vector<int>> neighbors;
+    Vector3 center_;
+    double radius_;
+
+    ConvexHull();
+    void setPolygon(const std::vector<Vector3>& points, const Vector3& normal);
+    void updateBoundingSphere();
+};
+
+}
+
+#endif
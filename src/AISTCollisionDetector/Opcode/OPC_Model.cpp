@@ -213,6 +213,20 @@ bool Model::Build(const OPCODECREATE& create)
 }
 #pragma clang diagnostic pop
 
+// Added for Choreonoid
+bool Model::Restore(const MeshInterface* imesh, udword nb_nodes, const CollisionAABB* boxes, const udword* data)
+{
+	if(!imesh || !imesh->IsValid())	return false;
+
+	Release();
+
+	SetMeshInterface(imesh);
+
+	if(!CreateTree(false, false))	return false;
+
+	return static_cast<AABBCollisionTree*>(mTree)->ImportNodes(nb_nodes, boxes, data, imesh->GetNbTriangles());
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
@@ -36,6 +36,10 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+		// Added for Choreonoid
+		// Restores a model built before from the mesh and the nodes exported by AABBCollisionTree::ExportNodes.
+							bool				Restore(const MeshInterface* imesh, udword nb_nodes, const CollisionAABB* boxes, const udword* data);
+
 #ifdef __MESHMERIZER_H__
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
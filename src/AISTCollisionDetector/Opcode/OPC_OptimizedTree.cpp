@@ -266,6 +266,63 @@ bool AABBCollisionTree::Build(AABBTree* tree)
 	return true;
 }
 
+// Added for Choreonoid
+// The data of a leaf node is the primitive index marked as leaf, and the data of the other node
+// is the index of the positive child shifted by one bit.
+void AABBCollisionTree::ExportNodes(CollisionAABB* boxes, udword* data) const
+{
+	for(udword i=0;i<mNbNodes;i++)
+	{
+		boxes[i] = mNodes[i].mAABB;
+		if(mNodes[i].IsLeaf())	data[i] = udword(mNodes[i].mData);
+		else					data[i] = udword(mNodes[i].GetPos() - mNodes)<<1;
+	}
+}
+
+bool AABBCollisionTree::ImportNodes(udword nb_nodes, const CollisionAABB* boxes, const udword* data, udword nb_primitives)
+{
+	// Only complete trees whose children follow their parents are accepted
+	if(!nb_nodes || nb_nodes!=nb_primitives*2-1)	return false;
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		if(data[i]&1)
+		{
+			if((data[i]>>1)>=nb_primitives)	return false;
+		}
+		else
+		{
+			udword PosID = data[i]>>1;
+			if(PosID<=i || PosID+1>=nb_nodes)	return false;
+		}
+	}
+
+	if(mNbNodes!=nb_nodes)
+	{
+		mNbNodes = nb_nodes;
+		DELETEARRAY(mNodes);
+		mNodes = new AABBCollisionNode[mNbNodes];
+		CHECKALLOC(mNodes);
+	}
+
+	mNodes[0].mB = &mNodes[0];
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		mNodes[i].mAABB = boxes[i];
+		if(data[i]&1)
+		{
+			mNodes[i].mData = data[i];
+		}
+		else
+		{
+			AABBCollisionNode* Pos = &mNodes[data[i]>>1];
+			mNodes[i].mData = (EXWORD)Pos;
+			Pos[0].mB = &mNodes[i];
+			Pos[1].mB = &mNodes[i];
+		}
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Refits the collision tree after vertices have been modified.
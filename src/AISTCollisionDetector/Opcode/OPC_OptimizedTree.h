@@ -188,6 +188,13 @@
 	class OPCODE_API AABBCollisionTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBCollisionTree, AABBCollisionNode)
+
+		// Added for Choreonoid
+		// The nodes are exported and imported with the child node indices instead of the pointers
+		// so that a built tree can be stored and restored without rebuilding it.
+		public:
+		void						ExportNodes(CollisionAABB* boxes, udword* data)	const;
+		bool						ImportNodes(udword nb_nodes, const CollisionAABB* boxes, const udword* data, udword nb_primitives);
 	};
 
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
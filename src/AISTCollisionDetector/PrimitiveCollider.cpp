@@ -0,0 +1,1215 @@
+#include "PrimitiveCollider.h"
+#include <cnoid/MathUtil>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double Epsilon = 1.0e-9;
+const int MaxNumPolygonVertices = 40;
+const int NumDiscVertices = 16;
+const size_t MaxNumManifoldContacts = 4;
+
+/*
+  A face axis is preferred to the other axes unless the other axis is clearly shallower
+  because the contacts of a face are more stable than the single contact of an edge.
+*/
+const double EdgeAxisRelativeTolerance = 0.95;
+const double EdgeAxisAbsoluteTolerance = 1.0e-5;
+
+// The side plane of a reference face edge shorter than this is skipped
+const double MinSideNormalSquaredNorm = 1.0e-12;
+
+// The normals of the contacts on the same face are regarded as the same if their inner product exceeds this
+const double SameNormalThreshold = 0.999;
+
+/*
+  A polygon with a fixed capacity to avoid the heap allocation in the primitive pair functions.
+  The interface is the subset of std::vector used by clipPolygon and addClippedContacts so that
+  the functions can also be applied to the vector polygons of ConvexCollider.
+*/
+class Polygon
+{
+public:
+    Vector3 vertices[MaxNumPolygonVertices];
+    int numVertices;
+
+    Polygon() : numVertices(0) { }
+    int size() const { return numVertices; }
+    bool empty() const { return numVertices == 0; }
+    const Vector3& operator[](int index) const { return vertices[index]; }
+    void clear() { numVertices = 0; }
+    void push_back(const Vector3& v){
+        if(numVertices < MaxNumPolygonVertices){
+            vertices[numVertices++] = v;
+        }
+    }
+};
+
+
+inline double signOf(double x)
+{
+    return (x >= 0.0) ? 1.0 : -1.0;
+}
+
+
+inline double projectBox(const Vector3& axis, const Matrix3& R, const Vector3& halfSize)
+{
+    return halfSize.x() * fabs(axis.dot(R.col(0))) +
+        halfSize.y() * fabs(axis.dot(R.col(1))) +
+        halfSize.z() * fabs(axis.dot(R.col(2)));
+}
+
+
+inline double projectCylinder(const Vector3& axis, const Vector3& cylinderAxis, double radius, double halfHeight)
+{
+    const double c = axis.dot(cylinderAxis);
+    return halfHeight * fabs(c) + radius * sqrt(std::max(0.0, 1.0 - c * c));
+}
+
+
+void addContact(vector<PrimitiveContact>& contacts, const Vector3& point, const Vector3& normal, double depth)
+{
+    contacts.emplace_back();
+    auto& contact = contacts.back();
+    contact.point = point;
+    contact.normal = normal;
+    contact.depth = depth;
+}
+
+
+void getBoxFace(const PrimitiveShape& box, int axis, double sign, Polygon& out_face)
+{
+    const Matrix3 R = box.T.linear();
+    const Vector3& h = box.halfSize;
+    const int i1 = (axis + 1) % 3;
+    const int i2 = (axis + 2) % 3;
+    const Vector3 center = box.T.translation() + sign * h[axis] * R.col(axis);
+    const Vector3 u = h[i1] * R.col(i1);
+    const Vector3 v = h[i2] * R.col(i2);
+    out_face.clear();
+    out_face.push_back(center + u + v);
+    out_face.push_back(center - u + v);
+    out_face.push_back(center - u - v);
+    out_face.push_back(center + u - v);
+}
+
+
+//! Get the face of the box whose outward normal is the closest to the direction
+void getBoxFaceAlong(const PrimitiveShape& box, const Vector3& direction, Polygon& out_face)
+{
+    const Matrix3 R = box.T.linear();
+    int axis = 0;
+    double maxProjection = -1.0;
+    for(int i=0; i < 3; ++i){
+        double projection = fabs(direction.dot(R.col(i)));
+        if(projection > maxProjection){
+            maxProjection = projection;
+            axis = i;
+        }
+    }
+    getBoxFace(box, axis, signOf(direction.dot(R.col(axis))), out_face);
+}
+
+
+void getDisc(const Vector3& center, const Vector3& axis, double radius, Polygon& out_disc)
+{
+    const Vector3 u = axis.unitOrthogonal();
+    const Vector3 v = axis.cross(u);
+    out_disc.clear();
+    for(int i=0; i < NumDiscVertices; ++i){
+        const double angle = 2.0 * PI * i / NumDiscVertices;
+        out_disc.push_back(center + radius * (cos(angle) * u + sin(angle) * v));
+    }
+}
+
+
+//! Keep the part of the polygon where normal.dot(p) <= offset
+template<class PolygonType>
+void clipPolygon(const PolygonType& polygon, const Vector3& normal, double offset, PolygonType& out_polygon)
+{
+    out_polygon.clear();
+    const int n = polygon.size();
+    if(n == 0){
+        return;
+    }
+    if(n == 1){
+        if(normal.dot(polygon[0]) <= offset){
+            out_polygon.push_back(polygon[0]);
+        }
+        return;
+    }
+    // A segment is not closed
+    const int numEdges = (n == 2) ? 1 : n;
+    for(int i=0; i < numEdges; ++i){
+        const Vector3& a = polygon[i];
+        const Vector3& b = polygon[(i + 1) % n];
+        const double da = normal.dot(a) - offset;
+        const double db = normal.dot(b) - offset;
+        if(da <= 0.0){
+            out_polygon.push_back(a);
+        }
+        if((da <= 0.0) != (db <= 0.0)){
+            out_polygon.push_back(a + (b - a) * (da / (da - db)));
+        }
+    }
+    if(n == 2 && normal.dot(polygon[1]) <= offset){
+        out_polygon.push_back(polygon[1]);
+    }
+}
+
+
+/**
+   Select the contacts that span the contact region. The deepest contact is always selected.
+   \return The number of the selected contacts
+*/
+int selectSpanningContacts(const PrimitiveContact* c, int n, int* out_selected)
+{
+    if(n <= (int)MaxNumManifoldContacts){
+        for(int i=0; i < n; ++i){
+            out_selected[i] = i;
+        }
+        return n;
+    }
+
+    int i0 = 0;
+    for(int i=1; i < n; ++i){
+        if(c[i].depth > c[i0].depth){
+            i0 = i;
+        }
+    }
+    out_selected[0] = i0;
+
+    int i1 = i0;
+    double maxDistance2 = -1.0;
+    for(int i=0; i < n; ++i){
+        double d2 = (c[i].point - c[i0].point).squaredNorm();
+        if(i != i0 && d2 > maxDistance2){
+            maxDistance2 = d2;
+            i1 = i;
+        }
+    }
+    out_selected[1] = i1;
+
+    int i2 = i0;
+    double maxArea = -1.0;
+    const Vector3 e = c[i1].point - c[i0].point;
+    for(int i=0; i < n; ++i){
+        double area = (c[i].point - c[i0].point).cross(e).squaredNorm();
+        if(i != i0 && i != i1 && area > maxArea){
+            maxArea = area;
+            i2 = i;
+        }
+    }
+    out_selected[2] = i2;
+
+    int i3 = i0;
+    double maxMinDistance2 = -1.0;
+    for(int i=0; i < n; ++i){
+        if(i == i0 || i == i1 || i == i2){
+            continue;
+        }
+        double d2 = std::min({ (c[i].point - c[i0].point).squaredNorm(),
+                               (c[i].point - c[i1].point).squaredNorm(),
+                               (c[i].point - c[i2].point).squaredNorm() });
+        if(d2 > maxMinDistance2){
+            maxMinDistance2 = d2;
+            i3 = i;
+        }
+    }
+    out_selected[3] = i3;
+
+    return MaxNumManifoldContacts;
+}
+
+
+/**
+   Reduce the contacts from the begin index to the ones that span the contact region.
+*/
+void reduceContacts(vector<PrimitiveContact>& contacts, size_t begin)
+{
+    const int n = contacts.size() - begin;
+    if(n <= (int)MaxNumManifoldContacts){
+        return;
+    }
+    int selected[MaxNumManifoldContacts];
+    selectSpanningContacts(&contacts[begin], n, selected);
+
+    PrimitiveContact reduced[MaxNumManifoldContacts];
+    for(size_t i=0; i < MaxNumManifoldContacts; ++i){
+        reduced[i] = contacts[begin + selected[i]];
+    }
+    contacts.resize(begin);
+    contacts.insert(contacts.end(), reduced, reduced + MaxNumManifoldContacts);
+}
+
+
+/**
+   Add the contacts of the incident feature clipped by the side planes of the reference face.
+   Only the points below the reference face are added.
+   \param refNormal The outward normal of the reference face
+*/
+template<class PolygonType>
+void addClippedContacts
+(const PolygonType& refFace, const Vector3& refNormal, const PolygonType& incident, const Vector3& contactNormal,
+ vector<PrimitiveContact>& out_contacts)
+{
+    PolygonType buf1 = incident;
+    PolygonType buf2;
+    PolygonType* polygon = &buf1;
+    PolygonType* clipped = &buf2;
+
+    const int n = refFace.size();
+    Vector3 centroid = Vector3::Zero();
+    for(int i=0; i < n; ++i){
+        centroid += refFace[i];
+    }
+    centroid /= n;
+
+    for(int i=0; i < n; ++i){
+        const Vector3& a = refFace[i];
+        const Vector3& b = refFace[(i + 1) % n];
+        Vector3 sideNormal = (b - a).cross(refNormal);
+        // The degenerate edge of a merged hull face does not give a side plane
+        if(sideNormal.squaredNorm() < MinSideNormalSquaredNorm){
+            continue;
+        }
+        if(sideNormal.dot(centroid - a) > 0.0){
+            sideNormal = -sideNormal;
+        }
+        clipPolygon(*polygon, sideNormal, sideNormal.dot(a), *clipped);
+        std::swap(polygon, clipped);
+        if(polygon->empty()){
+            return;
+        }
+    }
+
+    const size_t begin = out_contacts.size();
+    const Vector3& facePoint = refFace[0];
+    for(int i=0; i < polygon->size(); ++i){
+        const Vector3& p = (*polygon)[i];
+        const double depth = -refNormal.dot(p - facePoint);
+        if(depth >= 0.0){
+            addContact(out_contacts, p + refNormal * (depth / 2.0), contactNormal, depth);
+        }
+    }
+    reduceContacts(out_contacts, begin);
+}
+
+
+//! Closest points of the segments p0-p1 and q0-q1 given as the parameters of the segments
+void findClosestPointsOfSegments
+(const Vector3& p0, const Vector3& p1, const Vector3& q0, const Vector3& q1, double& out_s, double& out_t)
+{
+    const Vector3 d1 = p1 - p0;
+    const Vector3 d2 = q1 - q0;
+    const Vector3 r = p0 - q0;
+    const double a = d1.squaredNorm();
+    const double e = d2.squaredNorm();
+    const double f = d2.dot(r);
+
+    if(a <= Epsilon && e <= Epsilon){
+        out_s = out_t = 0.0;
+        return;
+    }
+    if(a <= Epsilon){
+        out_s = 0.0;
+        out_t = std::min(std::max(f / e, 0.0), 1.0);
+        return;
+    }
+    const double c = d1.dot(r);
+    if(e <= Epsilon){
+        out_t = 0.0;
+        out_s = std::min(std::max(-c / a, 0.0), 1.0);
+        return;
+    }
+    const double b = d1.dot(d2);
+    const double denom = a * e - b * b;
+    if(denom > Epsilon){
+        out_s = std::min(std::max((b * f - c * e) / denom, 0.0), 1.0);
+    } else {
+        // Parallel segments. The middle of the overlapping part is used.
+        double t0 = std::min(std::max(-c / a, 0.0), 1.0);
+        double t1 = std::min(std::max((b - c) / a, 0.0), 1.0);
+        out_s = (t0 + t1) / 2.0;
+    }
+    out_t = (b * out_s + f) / e;
+    if(out_t < 0.0){
+        out_t = 0.0;
+        out_s = std::min(std::max(-c / a, 0.0), 1.0);
+    } else if(out_t > 1.0){
+        out_t = 1.0;
+        out_s = std::min(std::max((b - c) / a, 0.0), 1.0);
+    }
+}
+
+
+Vector3 findClosestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const Vector3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if(d1 <= 0.0 && d2 <= 0.0){
+        return a;
+    }
+    const Vector3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if(d3 >= 0.0 && d4 <= d3){
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+        return a + (d1 / (d1 - d3)) * ab;
+    }
+    const Vector3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if(d6 >= 0.0 && d5 <= d6){
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+        return a + (d2 / (d2 - d6)) * ac;
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+        return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+
+//! \return The distance between the segment and the triangle
+double findClosestPointsOfSegmentAndTriangle
+(const Vector3& p0, const Vector3& p1, const Vector3& a, const Vector3& b, const Vector3& c,
+ Vector3& out_segmentPoint, Vector3& out_trianglePoint)
+{
+    const Vector3 n = (b - a).cross(c - a);
+    const double d0 = n.dot(p0 - a);
+    const double d1 = n.dot(p1 - a);
+    if(((d0 <= 0.0 && d1 >= 0.0) || (d0 >= 0.0 && d1 <= 0.0)) && d0 != d1){
+        const Vector3 x = p0 + (p1 - p0) * (d0 / (d0 - d1));
+        if((b - a).cross(x - a).dot(n) >= 0.0 &&
+           (c - b).cross(x - b).dot(n) >= 0.0 &&
+           (a - c).cross(x - c).dot(n) >= 0.0){
+            out_segmentPoint = x;
+            out_trianglePoint = x;
+            return 0.0;
+        }
+    }
+
+    double minDistance2 = std::numeric_limits<double>::max();
+    for(auto& p : { p0, p1 }){
+        Vector3 q = findClosestPointOnTriangle(p, a, b, c);
+        double d2 = (q - p).squaredNorm();
+        if(d2 < minDistance2){
+            minDistance2 = d2;
+            out_segmentPoint = p;
+            out_trianglePoint = q;
+        }
+    }
+    const Vector3* vertices[] = { &a, &b, &c };
+    for(int i=0; i < 3; ++i){
+        const Vector3& e0 = *vertices[i];
+        const Vector3& e1 = *vertices[(i + 1) % 3];
+        double s, t;
+        findClosestPointsOfSegments(p0, p1, e0, e1, s, t);
+        Vector3 x = p0 + s * (p1 - p0);
+        Vector3 y = e0 + t * (e1 - e0);
+        double d2 = (y - x).squaredNorm();
+        if(d2 < minDistance2){
+            minDistance2 = d2;
+            out_segmentPoint = x;
+            out_trianglePoint = y;
+        }
+    }
+    return sqrt(minDistance2);
+}
+
+
+/**
+   The squared distance between the box and the points of the segment is a convex function
+   of the segment parameter, so its minimum is found by the golden section search.
+   \return The squared distance between the segment and the box
+*/
+double findClosestPointsOfSegmentAndBox
+(const Vector3& p0, const Vector3& p1, const PrimitiveShape& box, double& out_t, Vector3& out_boxPoint)
+{
+    const Matrix3 R = box.T.linear();
+    const Vector3 s0 = R.transpose() * (p0 - box.T.translation());
+    const Vector3 s1 = R.transpose() * (p1 - box.T.translation());
+    const Vector3& h = box.halfSize;
+
+    auto distance2 = [&](double t){
+        Vector3 q = s0 + t * (s1 - s0);
+        return (q - q.cwiseMax(-h).cwiseMin(h)).squaredNorm();
+    };
+
+    const double g = 0.6180339887498949;
+    double lower = 0.0;
+    double upper = 1.0;
+    double x1 = upper - g * (upper - lower);
+    double x2 = lower + g * (upper - lower);
+    double f1 = distance2(x1);
+    double f2 = distance2(x2);
+    for(int i=0; i < 40; ++i){
+        if(f1 < f2){
+            upper = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = upper - g * (upper - lower);
+            f1 = distance2(x1);
+        } else {
+            lower = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = lower + g * (upper - lower);
+            f2 = distance2(x2);
+        }
+    }
+    double t = (lower + upper) / 2.0;
+    double minDistance2 = distance2(t);
+    for(double e : { 0.0, 1.0 }){
+        double d2 = distance2(e);
+        if(d2 < minDistance2){
+            minDistance2 = d2;
+            t = e;
+        }
+    }
+    out_t = t;
+    Vector3 q = s0 + t * (s1 - s0);
+    out_boxPoint = box.T * Vector3(q.cwiseMax(-h).cwiseMin(h));
+    return minDistance2;
+}
+
+
+bool findSphereBoxContact(const Vector3& center, double radius, const PrimitiveShape& box, PrimitiveContact& out_contact)
+{
+    const Matrix3 R = box.T.linear();
+    const Vector3& h = box.halfSize;
+    const Vector3 q = R.transpose() * (center - box.T.translation());
+    const Vector3 clamped = q.cwiseMax(-h).cwiseMin(h);
+    const Vector3 diff = q - clamped;
+    const double distance2 = diff.squaredNorm();
+
+    if(distance2 > radius * radius){
+        return false;
+    }
+    if(distance2 > Epsilon * Epsilon){
+        const double distance = sqrt(distance2);
+        out_contact.normal = -(R * diff) / distance;
+        out_contact.depth = radius - distance;
+    } else {
+        // The center is inside the box
+        int axis = 0;
+        double minGap = std::numeric_limits<double>::max();
+        for(int i=0; i < 3; ++i){
+            double gap = h[i] - fabs(q[i]);
+            if(gap < minGap){
+                minGap = gap;
+                axis = i;
+            }
+        }
+        out_contact.normal = -signOf(q[axis]) * R.col(axis);
+        out_contact.depth = radius + minGap;
+    }
+    out_contact.point = center + out_contact.normal * (radius - out_contact.depth / 2.0);
+    return true;
+}
+
+
+void getSegment(const PrimitiveShape& shape, Vector3& out_p0, Vector3& out_p1)
+{
+    const Vector3 axis = shape.T.linear().col(1);
+    const Vector3& c = shape.T.translation();
+    if(shape.type == PrimitiveShape::Capsule){
+        out_p0 = c - shape.halfHeight * axis;
+        out_p1 = c + shape.halfHeight * axis;
+    } else {
+        out_p0 = c;
+        out_p1 = c;
+    }
+}
+
+
+void collideBoxBox(const PrimitiveShape& box1, const PrimitiveShape& box2, vector<PrimitiveContact>& out_contacts)
+{
+    const Matrix3 R1 = box1.T.linear();
+    const Matrix3 R2 = box2.T.linear();
+    const Vector3 d = box2.T.translation() - box1.T.translation();
+
+    // 0: face of box1, 1: face of box2, 2: edge-edge
+    int axisType = -1;
+    int axisIndex1 = 0;
+    int axisIndex2 = 0;
+    double minOverlap = std::numeric_limits<double>::max();
+    Vector3 normal;
+
+    auto testAxis = [&](Vector3 axis, int type, int index1, int index2){
+        const double len = axis.norm();
+        if(len < 1.0e-6){
+            return true; // The edges are parallel
+        }
+        axis /= len;
+        const double distance = axis.dot(d);
+        const double overlap =
+            projectBox(axis, R1, box1.halfSize) + projectBox(axis, R2, box2.halfSize) - fabs(distance);
+        if(overlap < 0.0){
+            return false;
+        }
+        bool isBetter;
+        if(type < 2){
+            isBetter = (overlap < minOverlap);
+        } else {
+            isBetter = (overlap < EdgeAxisRelativeTolerance * minOverlap - EdgeAxisAbsoluteTolerance);
+        }
+        if(isBetter){
+            minOverlap = overlap;
+            normal = (distance < 0.0) ? -axis : axis;
+            axisType = type;
+            axisIndex1 = index1;
+            axisIndex2 = index2;
+        }
+        return true;
+    };
+
+    for(int i=0; i < 3; ++i){
+        if(!testAxis(R1.col(i), 0, i, 0)){
+            return;
+        }
+    }
+    for(int i=0; i < 3; ++i){
+        if(!testAxis(R2.col(i), 1, 0, i)){
+            return;
+        }
+    }
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            if(!testAxis(R1.col(i).cross(R2.col(j)), 2, i, j)){
+                return;
+            }
+        }
+    }
+
+    if(axisType == 0){
+        Polygon refFace, incidentFace;
+        getBoxFace(box1, axisIndex1, signOf(normal.dot(R1.col(axisIndex1))), refFace);
+        getBoxFaceAlong(box2, -normal, incidentFace);
+        addClippedContacts(refFace, normal, incidentFace, normal, out_contacts);
+
+    } else if(axisType == 1){
+        Polygon refFace, incidentFace;
+        getBoxFace(box2, axisIndex2, -signOf(normal.dot(R2.col(axisIndex2))), refFace);
+        getBoxFaceAlong(box1, normal, incidentFace);
+        addClippedContacts(refFace, -normal, incidentFace, normal, out_contacts);
+
+    } else {
+        // The closest points of the support edges
+        Vector3 p1 = box1.T.translation();
+        Vector3 p2 = box2.T.translation();
+        for(int k=0; k < 3; ++k){
+            if(k != axisIndex1){
+                p1 += signOf(normal.dot(R1.col(k))) * box1.halfSize[k] * R1.col(k);
+            }
+            if(k != axisIndex2){
+                p2 -= signOf(normal.dot(R2.col(k))) * box2.halfSize[k] * R2.col(k);
+            }
+        }
+        const Vector3 e1 = box1.halfSize[axisIndex1] * R1.col(axisIndex1);
+        const Vector3 e2 = box2.halfSize[axisIndex2] * R2.col(axisIndex2);
+        double s, t;
+        findClosestPointsOfSegments(p1 - e1, p1 + e1, p2 - e2, p2 + e2, s, t);
+        const Vector3 x1 = p1 - e1 + 2.0 * s * e1;
+        const Vector3 x2 = p2 - e2 + 2.0 * t * e2;
+        addContact(out_contacts, (x1 + x2) / 2.0, normal, minOverlap);
+    }
+}
+
+
+//! The normals of the contacts point from the capsule to the box
+void collideCapsuleBox
+(const Vector3& p0, const Vector3& p1, double radius, const PrimitiveShape& box, vector<PrimitiveContact>& out_contacts)
+{
+    double t;
+    Vector3 boxPoint;
+    const double distance2 = findClosestPointsOfSegmentAndBox(p0, p1, box, t, boxPoint);
+    if(distance2 > radius * radius){
+        return;
+    }
+
+    if(distance2 > Epsilon * Epsilon){
+        PrimitiveContact mainContact;
+        if(!findSphereBoxContact(p0 + t * (p1 - p0), radius, box, mainContact)){
+            return;
+        }
+        /*
+          The end spheres are also tested so that a capsule lying on a face has the contacts
+          at its both ends instead of the single contact at an arbitrary point.
+        */
+        int numEndContacts = 0;
+        const Vector3* ends[] = { &p0, &p1 };
+        const double endParams[] = { 0.0, 1.0 };
+        for(int i=0; i < 2; ++i){
+            PrimitiveContact contact;
+            if(fabs(t - endParams[i]) > 1.0e-6 &&
+               findSphereBoxContact(*ends[i], radius, box, contact) &&
+               contact.normal.dot(mainContact.normal) > SameNormalThreshold){
+                out_contacts.push_back(contact);
+                ++numEndContacts;
+            }
+        }
+        if(numEndContacts < 2){
+            out_contacts.push_back(mainContact);
+        }
+        return;
+    }
+
+    // The segment penetrates the box. The capsule is pushed out along the box axis with the smallest overlap.
+    const Matrix3 R = box.T.linear();
+    const Vector3& h = box.halfSize;
+    const Vector3 s0 = R.transpose() * (p0 - box.T.translation());
+    const Vector3 s1 = R.transpose() * (p1 - box.T.translation());
+    int axis = 0;
+    double sign = 1.0;
+    double minOverlap = std::numeric_limits<double>::max();
+    for(int i=0; i < 3; ++i){
+        for(double s : { 1.0, -1.0 }){
+            double overlap = h[i] - (std::min(s * s0[i], s * s1[i]) - radius);
+            if(overlap < minOverlap){
+                minOverlap = overlap;
+                axis = i;
+                sign = s;
+            }
+        }
+    }
+    const Vector3 direction = sign * Vector3::Unit(axis);
+    const Vector3 normal = -(R * direction);
+    for(auto& s : { s0, s1 }){
+        double depth = h[axis] - (sign * s[axis] - radius);
+        if(depth > 0.0){
+            Vector3 q = s - direction * (radius - depth / 2.0);
+            q = q.cwiseMax(-h).cwiseMin(h);
+            addContact(out_contacts, box.T * q, normal, depth);
+        }
+    }
+}
+
+
+void collideSegments
+(const Vector3& p0, const Vector3& p1, double radius1, const Vector3& q0, const Vector3& q1, double radius2,
+ vector<PrimitiveContact>& out_contacts)
+{
+    double s, t;
+    findClosestPointsOfSegments(p0, p1, q0, q1, s, t);
+    const Vector3 x = p0 + s * (p1 - p0);
+    const Vector3 y = q0 + t * (q1 - q0);
+    const Vector3 diff = y - x;
+    const double distance = diff.norm();
+    if(distance > radius1 + radius2){
+        return;
+    }
+    Vector3 normal;
+    if(distance > Epsilon){
+        normal = diff / distance;
+    } else if((p1 - p0).squaredNorm() > Epsilon){
+        normal = (p1 - p0).normalized().unitOrthogonal();
+    } else {
+        normal = Vector3::UnitZ();
+    }
+    const double depth = radius1 + radius2 - distance;
+    addContact(out_contacts, x + normal * (radius1 - depth / 2.0), normal, depth);
+}
+
+
+/**
+   A convex polytope collided with a cylinder. A box or a triangle of a mesh is given as the polytope.
+*/
+class ConvexPolytope
+{
+public:
+    Vector3 vertices[8];
+    int numVertices;
+    Vector3 faceNormals[3];
+    int numFaceNormals;
+    Vector3 edges[3];
+    int numEdges;
+    //! Only the front side of the triangle is considered
+    bool isTriangle;
+    const PrimitiveShape* box;
+
+    void setBox(const PrimitiveShape& box){
+        this->box = &box;
+        isTriangle = false;
+        const Matrix3 R = box.T.linear();
+        numVertices = 0;
+        for(double x : { -1.0, 1.0 }){
+            for(double y : { -1.0, 1.0 }){
+                for(double z : { -1.0, 1.0 }){
+                    vertices[numVertices++] = box.T * Vector3(x * box.halfSize.x(), y * box.halfSize.y(), z * box.halfSize.z());
+                }
+            }
+        }
+        numFaceNormals = 3;
+        numEdges = 3;
+        for(int i=0; i < 3; ++i){
+            faceNormals[i] = R.col(i);
+            edges[i] = R.col(i);
+        }
+    }
+
+    bool setTriangle(const Vector3& a, const Vector3& b, const Vector3& c){
+        box = nullptr;
+        isTriangle = true;
+        Vector3 n = (b - a).cross(c - a);
+        double len = n.norm();
+        if(len < Epsilon){
+            return false;
+        }
+        vertices[0] = a;
+        vertices[1] = b;
+        vertices[2] = c;
+        numVertices = 3;
+        faceNormals[0] = n / len;
+        numFaceNormals = 1;
+        edges[0] = b - a;
+        edges[1] = c - b;
+        edges[2] = a - c;
+        numEdges = 3;
+        return true;
+    }
+
+    void project(const Vector3& axis, double& out_min, double& out_max) const {
+        out_min = out_max = axis.dot(vertices[0]);
+        for(int i=1; i < numVertices; ++i){
+            double p = axis.dot(vertices[i]);
+            if(p < out_min){
+                out_min = p;
+            } else if(p > out_max){
+                out_max = p;
+            }
+        }
+    }
+
+    void getFaceAlong(const Vector3& direction, Polygon& out_face) const {
+        if(isTriangle){
+            out_face.clear();
+            for(int i=0; i < 3; ++i){
+                out_face.push_back(vertices[i]);
+            }
+        } else {
+            getBoxFaceAlong(*box, direction, out_face);
+        }
+    }
+};
+
+
+//! The normals of the contacts point from the cylinder to the polytope
+void collideCylinderPolytope
+(const PrimitiveShape& cylinder, const ConvexPolytope& polytope, vector<PrimitiveContact>& out_contacts)
+{
+    const Vector3 a = cylinder.T.linear().col(1);
+    const Vector3& c = cylinder.T.translation();
+    const double r = cylinder.radius;
+    const double hh = cylinder.halfHeight;
+
+    // 0: face of the polytope, 1: cap of the cylinder, 2: others
+    int axisType = -1;
+    double minOverlap = std::numeric_limits<double>::max();
+    Vector3 normal;
+
+    auto testAxis = [&](Vector3 axis, int type, bool isOneSided){
+        const double len = axis.norm();
+        if(len < 1.0e-6){
+            return true;
+        }
+        axis /= len;
+        const double center = axis.dot(c);
+        const double extent = projectCylinder(axis, a, r, hh);
+        double pmin, pmax;
+        polytope.project(axis, pmin, pmax);
+        const double overlapForward = center + extent - pmin;
+        const double overlapBackward = pmax - (center - extent);
+        if(overlapForward < 0.0 || overlapBackward < 0.0){
+            return false;
+        }
+        double overlap;
+        Vector3 n;
+        if(isOneSided){
+            if(overlapForward > 2.0 * extent){
+                // The cylinder is behind the triangle
+                return false;
+            }
+            overlap = overlapForward;
+            n = axis;
+        } else if(overlapForward < overlapBackward){
+            overlap = overlapForward;
+            n = axis;
+        } else {
+            overlap = overlapBackward;
+            n = -axis;
+        }
+        bool isBetter;
+        if(type < 2){
+            isBetter = (overlap < minOverlap);
+        } else {
+            isBetter = (overlap < EdgeAxisRelativeTolerance * minOverlap - EdgeAxisAbsoluteTolerance);
+        }
+        if(isBetter){
+            minOverlap = overlap;
+            normal = n;
+            axisType = type;
+        }
+        return true;
+    };
+
+    if(polytope.isTriangle){
+        if(!testAxis(-polytope.faceNormals[0], 0, true)){
+            return;
+        }
+    } else {
+        for(int i=0; i < polytope.numFaceNormals; ++i){
+            if(!testAxis(polytope.faceNormals[i], 0, false)){
+                return;
+            }
+        }
+    }
+    if(!testAxis(a, 1, false)){
+        return;
+    }
+    for(int i=0; i < polytope.numEdges; ++i){
+        if(!testAxis(a.cross(polytope.edges[i]), 2, false)){
+            return;
+        }
+    }
+    // The direction between the closest points of the cylinder axis and the polytope
+    const Vector3 a0 = c - hh * a;
+    const Vector3 a1 = c + hh * a;
+    Vector3 segmentPoint, polytopePoint;
+    if(polytope.isTriangle){
+        findClosestPointsOfSegmentAndTriangle(
+            a0, a1, polytope.vertices[0], polytope.vertices[1], polytope.vertices[2], segmentPoint, polytopePoint);
+    } else {
+        double t;
+        findClosestPointsOfSegmentAndBox(a0, a1, *polytope.box, t, polytopePoint);
+        segmentPoint = a0 + t * (a1 - a0);
+    }
+    const Vector3 closestDirection = polytopePoint - segmentPoint;
+    if(closestDirection.squaredNorm() > Epsilon && !testAxis(closestDirection, 2, false)){
+        return;
+    }
+
+    const double cosine = normal.dot(a);
+    const Vector3 cap = c + signOf(cosine) * hh * a;
+    Vector3 w = normal - cosine * a;
+    const double wlen = w.norm();
+    w = (wlen > Epsilon) ? Vector3(w / wlen) : Vector3::Zero();
+    // The deepest point of the cylinder in the normal direction
+    const Vector3 support = cap + r * w;
+
+    const size_t numContacts = out_contacts.size();
+
+    if(axisType == 0){
+        Polygon refFace, incident;
+        polytope.getFaceAlong(-normal, refFace);
+        if(fabs(cosine) > 0.9){
+            getDisc(cap, a, r, incident);
+        } else if(fabs(cosine) < 0.1){
+            incident.push_back(c - hh * a + r * w);
+            incident.push_back(c + hh * a + r * w);
+        } else {
+            incident.push_back(support);
+        }
+        addClippedContacts(refFace, -normal, incident, normal, out_contacts);
+
+    } else if(axisType == 1){
+        Polygon refFace, incident;
+        getDisc(cap, a, r, refFace);
+        polytope.getFaceAlong(-normal, incident);
+        addClippedContacts(refFace, normal, incident, normal, out_contacts);
+    }
+
+    // A face of a triangle not touched by the clipped feature is left to the neighboring triangles
+    if(axisType == 2 || (out_contacts.size() == numContacts && !polytope.isTriangle)){
+        addContact(out_contacts, support - normal * (minOverlap / 2.0), normal, minOverlap);
+    }
+}
+
+
+//! The normals of the contacts point from the capsule to the triangle
+void collideCapsuleTriangle
+(const Vector3& p0, const Vector3& p1, double radius, const Vector3& a, const Vector3& b, const Vector3& c,
+ vector<PrimitiveContact>& out_contacts)
+{
+    Vector3 faceNormal = (b - a).cross(c - a);
+    const double len = faceNormal.norm();
+    if(len < Epsilon){
+        return;
+    }
+    faceNormal /= len;
+
+    Vector3 segmentPoint, trianglePoint;
+    const double distance = findClosestPointsOfSegmentAndTriangle(p0, p1, a, b, c, segmentPoint, trianglePoint);
+    if(distance > radius){
+        return;
+    }
+
+    if(distance <= Epsilon){
+        // The segment intersects the triangle
+        double behind = 0.0;
+        for(auto& p : { p0, p1 }){
+            behind = std::max(behind, -faceNormal.dot(p - a));
+        }
+        addContact(out_contacts, trianglePoint, -faceNormal, radius + behind);
+        return;
+    }
+
+    // The triangles whose back faces are closest to the capsule are ignored
+    if(faceNormal.dot(segmentPoint - a) < 0.0){
+        return;
+    }
+
+    const Vector3 normal = (trianglePoint - segmentPoint) / distance;
+    const double depth = radius - distance;
+    PrimitiveContact mainContact;
+    mainContact.normal = normal;
+    mainContact.depth = depth;
+    mainContact.point = segmentPoint + normal * (radius - depth / 2.0);
+
+    if((p1 - p0).squaredNorm() <= Epsilon){
+        out_contacts.push_back(mainContact);
+        return;
+    }
+
+    int numEndContacts = 0;
+    for(auto& p : { p0, p1 }){
+        if((p - segmentPoint).squaredNorm() <= Epsilon){
+            continue;
+        }
+        const Vector3 q = findClosestPointOnTriangle(p, a, b, c);
+        const Vector3 diff = q - p;
+        const double d = diff.norm();
+        if(d > Epsilon && d <= radius){
+            const Vector3 n = diff / d;
+            if(n.dot(normal) > SameNormalThreshold){
+                addContact(out_contacts, p + n * ((radius + d) / 2.0), n, radius - d);
+                ++numEndContacts;
+            }
+        }
+    }
+    if(numEndContacts < 2){
+        out_contacts.push_back(mainContact);
+    }
+}
+
+
+/**
+   The contacts with the same normal that are close to each other are merged,
+   and the contacts of each normal are reduced to the ones spanning the contact region.
+*/
+void mergeContacts(vector<PrimitiveContact>& contacts, size_t begin, double distanceTolerance)
+{
+    vector<PrimitiveContact> merged;
+    vector<vector<PrimitiveContact>> groups;
+    const double tolerance2 = distanceTolerance * distanceTolerance;
+
+    for(size_t i = begin; i < contacts.size(); ++i){
+        const PrimitiveContact& contact = contacts[i];
+        vector<PrimitiveContact>* group = nullptr;
+        for(auto& g : groups){
+            if(g.front().normal.dot(contact.normal) > SameNormalThreshold){
+                group = &g;
+                break;
+            }
+        }
+        if(!group){
+            groups.emplace_back();
+            groups.back().push_back(contact);
+            continue;
+        }
+        bool isMerged = false;
+        for(auto& existing : *group){
+            if((existing.point - contact.point).squaredNorm() < tolerance2){
+                if(contact.depth > existing.depth){
+                    existing = contact;
+                }
+                isMerged = true;
+                break;
+            }
+        }
+        if(!isMerged){
+            group->push_back(contact);
+        }
+    }
+
+    contacts.resize(begin);
+    for(auto& group : groups){
+        size_t groupBegin = contacts.size();
+        contacts.insert(contacts.end(), group.begin(), group.end());
+        reduceContacts(contacts, groupBegin);
+    }
+}
+
+}
+
+
+int PrimitiveCollider::selectSpanningContacts(const PrimitiveContact* contacts, int numContacts, int* out_indices)
+{
+    return ::selectSpanningContacts(contacts, numContacts, out_indices);
+}
+
+
+void PrimitiveCollider::clipPolygon
+(const std::vector<Vector3>& polygon, const Vector3& normal, double offset, std::vector<Vector3>& out_polygon)
+{
+    ::clipPolygon(polygon, normal, offset, out_polygon);
+}
+
+
+void PrimitiveCollider::addClippedContacts
+(const std::vector<Vector3>& refFace, const Vector3& refNormal, const std::vector<Vector3>& incident,
+ const Vector3& contactNormal, std::vector<PrimitiveContact>& out_contacts)
+{
+    ::addClippedContacts(refFace, refNormal, incident, contactNormal, out_contacts);
+}
+
+
+void PrimitiveCollider::reduceContacts(std::vector<PrimitiveContact>& contacts, size_t begin)
+{
+    ::reduceContacts(contacts, begin);
+}
+
+
+void PrimitiveCollider::mergeContacts(std::vector<PrimitiveContact>& contacts, size_t begin, double distanceTolerance)
+{
+    ::mergeContacts(contacts, begin, distanceTolerance);
+}
+
+
+bool PrimitiveCollider::isSupportedPair(PrimitiveShape::Type type1, PrimitiveShape::Type type2)
+{
+    if(type1 == PrimitiveShape::Box || type2 == PrimitiveShape::Box){
+        return true;
+    }
+    auto isSegmentType = [](PrimitiveShape::Type type){
+        return type == PrimitiveShape::Sphere || type == PrimitiveShape::Capsule;
+    };
+    return isSegmentType(type1) && isSegmentType(type2);
+}
+
+
+bool PrimitiveCollider::isSupportedWithMesh(PrimitiveShape::Type type)
+{
+    return type != PrimitiveShape::Box;
+}
+
+
+double PrimitiveCollider::boundingRadius(const PrimitiveShape& shape)
+{
+    switch(shape.type){
+    case PrimitiveShape::Box:
+        return shape.halfSize.norm();
+    case PrimitiveShape::Sphere:
+        return shape.radius;
+    case PrimitiveShape::Cylinder:
+        return sqrt(shape.radius * shape.radius + shape.halfHeight * shape.halfHeight);
+    case PrimitiveShape::Capsule:
+        return shape.radius + shape.halfHeight;
+    }
+    return 0.0;
+}
+
+
+bool PrimitiveCollider::collide
+(const PrimitiveShape& shape1, const PrimitiveShape& shape2, std::vector<PrimitiveContact>& out_contacts)
+{
+    if(!isSupportedPair(shape1.type, shape2.type)){
+        return false;
+    }
+
+    // The shapes are swapped so that the box is the second shape
+    if(shape1.type == PrimitiveShape::Box && shape2.type != PrimitiveShape::Box){
+        const size_t begin = out_contacts.size();
+        collide(shape2, shape1, out_contacts);
+        for(size_t i = begin; i < out_contacts.size(); ++i){
+            out_contacts[i].normal = -out_contacts[i].normal;
+        }
+        return true;
+    }
+
+    if(shape2.type == PrimitiveShape::Box){
+        switch(shape1.type){
+        case PrimitiveShape::Box:
+            collideBoxBox(shape1, shape2, out_contacts);
+            break;
+        case PrimitiveShape::Sphere:
+        {
+            PrimitiveContact contact;
+            if(findSphereBoxContact(shape1.T.translation(), shape1.radius, shape2, contact)){
+                out_contacts.push_back(contact);
+            }
+            break;
+        }
+        case PrimitiveShape::Capsule:
+        {
+            Vector3 p0, p1;
+            getSegment(shape1, p0, p1);
+            collideCapsuleBox(p0, p1, shape1.radius, shape2, out_contacts);
+            break;
+        }
+        case PrimitiveShape::Cylinder:
+        {
+            ConvexPolytope polytope;
+            polytope.setBox(shape2);
+            collideCylinderPolytope(shape1, polytope, out_contacts);
+            break;
+        }
+        }
+        return true;
+    }
+
+    Vector3 p0, p1, q0, q1;
+    getSegment(shape1, p0, p1);
+    getSegment(shape2, q0, q1);
+    collideSegments(p0, p1, shape1.radius, q0, q1, shape2.radius, out_contacts);
+    return true;
+}
+
+
+bool PrimitiveCollider::collideWithTriangles
+(const PrimitiveShape& shape, const std::vector<Vector3>& vertices, std::vector<PrimitiveContact>& out_contacts)
+{
+    if(!isSupportedWithMesh(shape.type)){
+        return false;
+    }
+
+    const size_t begin = out_contacts.size();
+    const int numTriangles = vertices.size() / 3;
+
+    if(shape.type == PrimitiveShape::Cylinder){
+        ConvexPolytope polytope;
+        for(int i=0; i < numTriangles; ++i){
+            if(polytope.setTriangle(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2])){
+                collideCylinderPolytope(shape, polytope, out_contacts);
+            }
+        }
+    } else {
+        Vector3 p0, p1;
+        getSegment(shape, p0, p1);
+        for(int i=0; i < numTriangles; ++i){
+            collideCapsuleTriangle(
+                p0, p1, shape.radius, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2], out_contacts);
+        }
+    }
+
+    mergeContacts(out_contacts, begin, 0.1 * shape.radius);
+
+    return true;
+}
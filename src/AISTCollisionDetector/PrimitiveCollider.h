@@ -0,0 +1,93 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLIDER_H
+#define CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLIDER_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+
+namespace cnoid {
+
+class PrimitiveShape
+{
+public:
+    enum Type { Box, Sphere, Cylinder, Capsule };
+
+    Type type;
+    //! The center position of the shape. The axis of a cylinder or a capsule is the y-axis.
+    Isometry3 T;
+    //! The half extents of a box
+    Vector3 halfSize;
+    double radius;
+    //! The half height of a cylinder or of the cylindrical part of a capsule
+    double halfHeight;
+};
+
+class PrimitiveContact
+{
+public:
+    Vector3 point;
+    //! The normal points from the first shape to the second shape
+    Vector3 normal;
+    double depth;
+};
+
+/**
+   This class generates the contacts between primitive shapes and between a primitive shape and
+   the triangles of a mesh analytically instead of intersecting their triangles. The contacts of
+   a face contact are limited to four points on the boundary of the contact region, so the contact
+   sets are smaller and more stable than those of the triangle intersections.
+*/
+class PrimitiveCollider
+{
+public:
+    static bool isSupportedPair(PrimitiveShape::Type type1, PrimitiveShape::Type type2);
+    static bool isSupportedWithMesh(PrimitiveShape::Type type);
+
+    /**
+       \return false if the pair is not supported
+    */
+    static bool collide(
+        const PrimitiveShape& shape1, const PrimitiveShape& shape2, std::vector<PrimitiveContact>& out_contacts);
+
+    /**
+       \param vertices The vertices of the triangles in the world coordinate. Three elements are used for each triangle.
+       \note The normals of the contacts point from the shape to the mesh.
+    */
+    static bool collideWithTriangles(
+        const PrimitiveShape& shape, const std::vector<Vector3>& vertices, std::vector<PrimitiveContact>& out_contacts);
+
+    //! The radius of the sphere that contains the shape
+    static double boundingRadius(const PrimitiveShape& shape);
+
+    /**
+       Select at most four contacts that span the contact region. The deepest contact is always selected.
+       \param out_indices The array of four elements that receives the indices of the selected contacts
+       \return The number of the selected contacts
+    */
+    static int selectSpanningContacts(const PrimitiveContact* contacts, int numContacts, int* out_indices);
+
+    //! Reduce the contacts from the begin index to the ones selected by selectSpanningContacts
+    static void reduceContacts(std::vector<PrimitiveContact>& contacts, size_t begin);
+
+    /**
+       The contacts from the begin index with the same normal that are close to each other are merged,
+       and the contacts of each normal are reduced by reduceContacts.
+    */
+    static void mergeContacts(std::vector<PrimitiveContact>& contacts, size_t begin, double distanceTolerance);
+
+    //! Keep the part of the polygon where normal.dot(p) <= offset. A polygon of two vertices is a segment.
+    static void clipPolygon(
+        const std::vector<Vector3>& polygon, const Vector3& normal, double offset, std::vector<Vector3>& out_polygon);
+
+    /**
+       Add the contacts of the incident feature clipped by the side planes of the reference face.
+       Only the points below the reference face are added, and they are reduced by reduceContacts.
+       \param refNormal The outward normal of the reference face
+    */
+    static void addClippedContacts(
+        const std::vector<Vector3>& refFace, const Vector3& refNormal, const std::vector<Vector3>& incident,
+        const Vector3& contactNormal, std::vector<PrimitiveContact>& out_contacts);
+};
+
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include <cnoid/TimeBar>
 #include <cnoid/MessageView>
 #include <cnoid/BodyMotionGenerationBar>
+#include <cnoid/PoseSeqInterpolator>
 #include <cnoid/CheckBox>
 #include <cnoid/Separator>
 #include <fmt/format.h>
@@ -230,7 +231,19 @@ namespace {
             timer.start();
             
             motionItem->motion()->setFrameRate(timeBar->frameRate());
-            bool result = balancer->apply(provider, *motionItem->motion(), bar->isSe3Enabled());
+
+            // Each thread evaluating the frames in parallel requires its own provider
+            std::vector<PoseProvider*> providers;
+            providers.push_back(provider);
+            std::vector<PoseSeqInterpolatorPtr> interpolatorClones;
+            if(auto interpolator = dynamic_cast<PoseSeqInterpolator*>(provider)){
+                for(int i=1; i < bar->numThreads(); ++i){
+                    interpolatorClones.push_back(interpolator->clone());
+                    providers.push_back(interpolatorClones.back().get());
+                }
+            }
+            
+            bool result = balancer->apply(providers, *motionItem->motion(), bar->isSe3Enabled());
             
             if(result){
                 if(putMessages){
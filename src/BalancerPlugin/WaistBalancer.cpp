@@ -9,6 +9,7 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
 #include <cnoid/GaussianFilter>
+#include <cnoid/ThreadPool>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -18,6 +19,15 @@ using namespace cnoid;
 namespace {
 
     const bool DoVerticalAccCompensation = true;
+
+    /*
+      The kinematics evaluation of a frame range begins this number of frames before the range
+      so that the velocities and momenta at the first frame are the same as the serial evaluation.
+    */
+    const int NumWarmUpFrames = 2;
+
+    // Frame ranges are not divided into smaller ones than this
+    const int MinNumFramesPerRange = 50;
     
 #if defined(_MSC_VER) && _MSC_VER < 1800
     inline long lround(double x) {
@@ -38,7 +48,8 @@ WaistBalancer::WaistBalancer()
     : os_(&nullout())
 {
     g = 9.8;
-    waistLink = 0;
+    mainState.provider = nullptr;
+    mainState.waistLink = nullptr;
     numIterations_ = 2;
     boundaryConditionType = KEEP_POSITIONS;
     initialWaistTrajectoryMode = ORG_TRAJECTORY;
@@ -57,7 +68,7 @@ WaistBalancer::WaistBalancer()
 void WaistBalancer::setBody(const BodyPtr& body)
 {
     body_ = body;
-    waistLink = 0;
+    mainState.waistLink = nullptr;
 }
 
 
@@ -69,7 +80,7 @@ const BodyPtr& WaistBalancer::body() const
 
 void WaistBalancer::setWaistLink(Link* waistLink)
 {
-    this->waistLink = waistLink;
+    mainState.waistLink = waistLink;
 }
 
 
@@ -202,18 +213,40 @@ void WaistBalancer::enableWaistHeightRelaxation(bool on)
 }
 
 
-bool WaistBalancer::apply(PoseProvider* provider_, BodyMotion& motion, bool putAllLinkPositions)
+bool WaistBalancer::apply(PoseProvider* provider, BodyMotion& motion, bool putAllLinkPositions)
 {
-    if(!body_){
+    return apply(std::vector<PoseProvider*>{ provider }, motion, putAllLinkPositions);
+}
+
+
+bool WaistBalancer::apply(const std::vector<PoseProvider*>& providers, BodyMotion& motion, bool putAllLinkPositions)
+{
+    if(!body_ || providers.empty()){
         return false;
     }
 
-    if(!waistLink){
-        waistLink = body_->rootLink();
+    if(!mainState.waistLink){
+        mainState.waistLink = body_->rootLink();
+    }
+    waistLinkIndex = mainState.waistLink->index();
+
+    mainState.body = body_;
+    mainState.provider = providers.front();
+    mainState.os = os_;
+
+    // The body clones of the workers are created by evaluateFrames when they are actually used
+    const int numWorkers = providers.size() - 1;
+    workerStates.resize(numWorkers);
+    for(int i=0; i < numWorkers; ++i){
+        auto& state = workerStates[i];
+        if(!state){
+            state.reset(new KinematicsState);
+        }
+        state->body.reset();
+        state->provider = providers[i+1];
+        state->waistLink = nullptr;
+        state->os = &state->messageBuf;
     }
-    waistLinkIndex = waistLink->index();
-    
-    provider = provider_;
 
     frameRate = motion.frameRate();
     timeStep = 1.0 / frameRate;
@@ -236,6 +269,12 @@ bool WaistBalancer::apply(PoseProvider* provider_, BodyMotion& motion, bool putA
 
     bool result = apply2(motion, putAllLinkPositions);
 
+    mainState.provider = nullptr;
+    for(auto& state : workerStates){
+        state->body.reset();
+        state->provider = nullptr;
+    }
+
     // restore the original body state
     for(int i=0; i < numJoints; ++i){
         body_->joint(i)->q() = q0[i];
@@ -250,6 +289,8 @@ bool WaistBalancer::apply(PoseProvider* provider_, BodyMotion& motion, bool putA
 
 bool WaistBalancer::apply2(BodyMotion& motion, bool putAllLinkPositions)
 {
+    PoseProvider* provider = mainState.provider;
+
     targetBeginningTime = std::max(provider->beginningTime(), timeRangeLower);
     targetEndingTime = std::min(provider->endingTime(), timeRangeUpper);
     
@@ -269,7 +310,7 @@ bool WaistBalancer::apply2(BodyMotion& motion, bool putAllLinkPositions)
         initWaistHeightRelaxation();
     }
     
-    initBodyKinematics(endingFrame, Vector3::Zero());
+    initBodyKinematics(mainState, endingFrame, Vector3::Zero());
 
     if(provider->baseLinkIndex() < 0){
         return false;
@@ -278,6 +319,8 @@ bool WaistBalancer::apply2(BodyMotion& motion, bool putAllLinkPositions)
         return false;
     }
 
+    const Vector3& cm = mainState.cm;
+    const Vector3& desiredZmp = mainState.desiredZmp;
     Vector3 cmProjection(cm[0], cm[1], desiredZmp[2]);
     doProcessFinalBoundary = ((cmProjection - desiredZmp).norm() < 2.0e-3);
 
@@ -346,6 +389,7 @@ bool WaistBalancer::calcBoundaryCmAdjustmentTrajectorySub(int begin, int directi
     bool adjusted = true;
     int i;
     Vector3 translation;
+    PoseProvider* provider = mainState.provider;
 
     provider->seek(timeOfFrame(begin));
     Vector3 zmp0 = *provider->ZMP();
@@ -400,6 +444,8 @@ bool WaistBalancer::calcBoundaryCmAdjustmentTrajectorySub(int begin, int directi
 bool WaistBalancer::calcWaistTranslationWithCmAboveZmp
 (int frame, const Vector3& zmp, Vector3& out_translation)
 {
+    KinematicsState& s = mainState;
+    PoseProvider* provider = s.provider;
     out_translation.setZero();
 
     double time = timeOfFrame(frame);
@@ -409,24 +455,25 @@ bool WaistBalancer::calcWaistTranslationWithCmAboveZmp
     if(baseLinkIndex < 0){
         return false;
     }
-    baseLink = body_->link(baseLinkIndex);
-    fkTraverse.find(baseLink);
+    s.baseLink = body_->link(baseLinkIndex);
+    s.fkTraverse.find(s.baseLink);
 
     bool converged = false;
     const int n = body_->numJoints();
 
     for(int i=0; i < 50; ++i){
 
-        provider->getBaseLinkPosition(baseLink->T());
+        provider->getBaseLinkPosition(s.baseLink->T());
         
-        provider->getJointPositions(jointPositions);
+        provider->getJointPositions(s.jointPositions);
         for(int j=0; j < n; ++j){
             Link* joint = body_->joint(j);
-            const auto& q = jointPositions[j];
+            const auto& q = s.jointPositions[j];
             joint->q() = q ? *q : 0.0;
         }
-        fkTraverse.calcForwardKinematics(true);
-        cm = body_->calcCenterOfMass();
+        s.fkTraverse.calcForwardKinematics(true);
+        const Vector3 cm = body_->calcCenterOfMass();
+        s.cm = cm;
 
         Vector3 diff(zmp[0] - cm[0], zmp[1] - cm[1], 0.0);
 
@@ -442,92 +489,109 @@ bool WaistBalancer::calcWaistTranslationWithCmAboveZmp
 }
 
 
-void WaistBalancer::initBodyKinematics(int frame, const Vector3& cmTranslation)
+void WaistBalancer::initBodyKinematics(KinematicsState& s, int frame, const Vector3& cmTranslation, bool doRecord)
 {
+    PoseProvider* provider = s.provider;
+    Body* body = s.body;
+    
     provider->seek(timeOfFrame(frame), waistLinkIndex, cmTranslation);
 
     int baseLinkIndex = provider->baseLinkIndex();
     if(baseLinkIndex >= 0){
-        baseLink = body_->link(baseLinkIndex);
-        provider->getBaseLinkPosition(baseLink->T());
+        s.baseLink = body->link(baseLinkIndex);
+        provider->getBaseLinkPosition(s.baseLink->T());
     } else {
-        baseLink = body_->rootLink();
-        baseLink->p().setZero();
-        baseLink->R().setIdentity();
+        s.baseLink = body->rootLink();
+        s.baseLink->p().setZero();
+        s.baseLink->R().setIdentity();
     }
-    baseLink->v().setZero();
-    baseLink->w().setZero();
+    s.baseLink->v().setZero();
+    s.baseLink->w().setZero();
     
-    fkTraverse.find(baseLink);
+    s.fkTraverse.find(s.baseLink);
 
-    const int n = body_->numJoints();
-    provider->getJointPositions(jointPositions);
+    const int n = body->numJoints();
+    provider->getJointPositions(s.jointPositions);
     for(int i=0; i < n; ++i){
-        Link* joint = body_->joint(i);
-        const auto& q = jointPositions[i];
+        Link* joint = body->joint(i);
+        const auto& q = s.jointPositions[i];
         joint->q() = q ? *q : 0.0;
         joint->dq() = 0.0;
     }
 
-    updateCmAndZmp(frame);
+    updateCmAndZmp(s, frame, doRecord);
 }
 
 
-void WaistBalancer::updateCmAndZmp(int frame)
+/**
+   @param doRecord false when the frame is only evaluated to reproduce the state at the next frames.
+   The initial waist trajectory and the messages are not output in that case.
+*/
+void WaistBalancer::updateCmAndZmp(KinematicsState& s, int frame, bool doRecord)
 {
-    fkTraverse.calcForwardKinematics(true);
+    s.fkTraverse.calcForwardKinematics(true);
 
-    cm = body_->calcCenterOfMass();
+    s.cm = s.body->calcCenterOfMass();
 
     if(isCalculatingInitialWaistTrajectory){
-        Vector3& p = totalCmTranslations[frame];
-        p.x() = -waistLink->p().x();
-        p.y() = -waistLink->p().y();
-        p.z() = 0.0;
-        desiredZmp = *provider->ZMP();
-        zmpDiff = desiredZmp;
+        if(doRecord){
+            Vector3& p = initialCmTranslations[frame];
+            p.x() = -s.waistLink->p().x();
+            p.y() = -s.waistLink->p().y();
+            p.z() = 0.0;
+        }
+        s.desiredZmp = *s.provider->ZMP();
+        s.zmpDiff = s.desiredZmp;
 
     } else {
         Vector3 P, L;
-        body_->calcTotalMomentum(P, L);
+        s.body->calcTotalMomentum(P, L);
 
-        dP = (P - P0) / dt;
-        dL = (L - L0) / dt;
+        s.dP = (P - s.P0) / dt;
+        s.dL = (L - s.L0) / dt;
 
-        P0 = P;
-        L0 = L;
+        s.P0 = P;
+        s.L0 = L;
 
         const double inertial_g_thresh = 1.0;
-        double ddz = dP.z() / m;
-        inertial_g = g + ddz;
+        double ddz = s.dP.z() / m;
+        s.inertial_g = g + ddz;
         
-        if(inertial_g < inertial_g_thresh){
-            os() << fmt::format(
-                _("Warning: The body is floating at {0} (Vertical CM acceleration is {1})."),
-                (frame * timeStep), (ddz))
-                 << endl;
+        if(s.inertial_g < inertial_g_thresh){
+            if(doRecord){
+                *s.os << fmt::format(
+                    _("Warning: The body is floating at {0} (Vertical CM acceleration is {1})."),
+                    (frame * timeStep), (ddz))
+                      << endl;
+            }
 
             if(DoVerticalAccCompensation){
-                dP.z() = m * (inertial_g_thresh - g);
-                inertial_g = inertial_g_thresh;
+                s.dP.z() = m * (inertial_g_thresh - g);
+                s.inertial_g = inertial_g_thresh;
             }
         }
 
-        zmp.x() = (dP.x() * desiredZmp.z() - dL.y() + mg * cm.x()) / (dP.z() + mg);
-        zmp.y() = (dP.y() * desiredZmp.z() + dL.x() + mg * cm.y()) / (dP.z() + mg);
-        zmp.z() = desiredZmp.z();
-        zmpDiff = desiredZmp - zmp;
+        const Vector3& dP = s.dP;
+        const Vector3& dL = s.dL;
+        const Vector3& cm = s.cm;
+        Vector3& zmp = s.zmp;
+        zmp.x() = (dP.x() * s.desiredZmp.z() - dL.y() + mg * cm.x()) / (dP.z() + mg);
+        zmp.y() = (dP.y() * s.desiredZmp.z() + dL.x() + mg * cm.y()) / (dP.z() + mg);
+        zmp.z() = s.desiredZmp.z();
+        s.zmpDiff = s.desiredZmp - zmp;
 
-        desiredZmp = *provider->ZMP();
+        s.desiredZmp = *s.provider->ZMP();
     }
 }
 
 
-bool WaistBalancer::updateBodyKinematics1(int frame)
+bool WaistBalancer::updateBodyKinematics1(KinematicsState& s, int frame, bool doRecord)
 {
     bool result = true;
-    
-    const int n = body_->numJoints();
+
+    PoseProvider* provider = s.provider;
+    Body* body = s.body;
+    const int n = body->numJoints();
     const int nextFrame = frame + 1;
 
     if(nextFrame <= endingFrame){
@@ -536,11 +600,12 @@ bool WaistBalancer::updateBodyKinematics1(int frame)
         result = provider->seek(timeOfFrame(nextFrame), waistLinkIndex, totalCmTranslations[nextFrame]);
 
         if(!isCalculatingInitialWaistTrajectory){
-        
+
+            Link*& baseLink = s.baseLink;
             const int baseLinkIndex = provider->baseLinkIndex();
             if(baseLinkIndex != baseLink->index() && baseLinkIndex >= 0){
-                baseLink = body_->link(baseLinkIndex);
-                fkTraverse.find(baseLink);
+                baseLink = body->link(baseLinkIndex);
+                s.fkTraverse.find(baseLink);
             }
         
             Isometry3 T_next;
@@ -550,10 +615,10 @@ bool WaistBalancer::updateBodyKinematics1(int frame)
             baseLink->v() = (T_next.translation() - baseLink->p()) / dt;
             baseLink->w() = omegaFromRot(baseLink->R().transpose() * T_next.linear()) / dt;
 
-            provider->getJointPositions(jointPositions);
+            provider->getJointPositions(s.jointPositions);
             for(int i=0; i < n; ++i){
-                Link* joint = body_->joint(i);
-                const auto& q = jointPositions[i];
+                Link* joint = body->joint(i);
+                const auto& q = s.jointPositions[i];
                 if(q){
                     joint->dq() = (*q - joint->q()) / dt;
                 } else {
@@ -563,66 +628,125 @@ bool WaistBalancer::updateBodyKinematics1(int frame)
         }
     }
 
-    updateCmAndZmp(frame);
+    updateCmAndZmp(s, frame, doRecord);
 
     return result;
 }
 
 
-void WaistBalancer::updateBodyKinematics2()
+void WaistBalancer::updateBodyKinematics2(KinematicsState& s)
 {
-    const int n = body_->numJoints();
-    provider->getJointPositions(jointPositions);
+    Body* body = s.body;
+    const int n = body->numJoints();
+    s.provider->getJointPositions(s.jointPositions);
     for(int i=0; i < n; ++i){
-        Link* joint = body_->joint(i);
-        const auto& q = jointPositions[i];
+        Link* joint = body->joint(i);
+        const auto& q = s.jointPositions[i];
         if(q){
             joint->q() = *q;
         }
     }
-    provider->getBaseLinkPosition(baseLink->T());
+    s.provider->getBaseLinkPosition(s.baseLink->T());
 }
 
 
-bool WaistBalancer::calcCmTranslations()
+/**
+   Divide the frames into ranges and evaluate each of them with a kinematics state in parallel.
+   The messages output in the worker threads are put in the order of the frames.
+   @return true if the evaluations of all the ranges succeed
+*/
+bool WaistBalancer::evaluateFrames
+(int firstFrame, int lastFrame, const std::function<void(KinematicsState& s, int firstFrame, int lastFrame)>& evaluate)
 {
-    initBodyKinematics(frameToStartBalancer, totalCmTranslations[frameToStartBalancer]);
+    const int numFrames = lastFrame - firstFrame + 1;
+    const int numRanges =
+        std::max(1, std::min(static_cast<int>(workerStates.size()) + 1, numFrames / MinNumFramesPerRange));
 
-    //const double gdt2 = g * dt2;
+    mainState.result = true;
     
-    for(int i = 0; i < numFilteredFrames; ++i){
-
-        updateBodyKinematics1(i + frameToStartBalancer);
+    if(numRanges == 1){
+        evaluate(mainState, firstFrame, lastFrame);
+        return mainState.result;
+    }
 
-        if(doStoreOriginalWaistFeetPositionsForWaistHeightRelaxation){
-            // store waist and feet positions
-            WaistFeetPos& p = waistFeetPosSeq[i];
-            p.T_waist = waistLink->T();
-            for(int j=0; j < 2; ++j){
-                Link* footLink = waistFeetIK.baseLink(j);
-                p.T_foot[j] = footLink->T();
-            }
+    const int size = numFrames / numRanges;
+    const int remainder = numFrames % numRanges;
+    vector<int> firstFrames(numRanges + 1);
+    int frame = firstFrame;
+    for(int i=0; i < numRanges; ++i){
+        firstFrames[i] = frame;
+        frame += (i < remainder) ? (size + 1) : size;
+    }
+    firstFrames[numRanges] = lastFrame + 1;
+
+    ThreadPool threadPool(numRanges - 1);
+    for(int i=1; i < numRanges; ++i){
+        KinematicsState* state = workerStates[i-1].get();
+        if(!state->body){
+            state->body = body_->clone();
+            state->waistLink = state->body->link(waistLinkIndex);
         }
+        state->result = true;
+        state->messageBuf.str("");
+        threadPool.start(
+            [&, state, i](){ evaluate(*state, firstFrames[i], firstFrames[i+1] - 1); });
+    }
+    evaluate(mainState, firstFrames[0], firstFrames[1] - 1);
+    threadPool.wait();
+
+    bool result = mainState.result;
+    for(int i=1; i < numRanges; ++i){
+        KinematicsState* state = workerStates[i-1].get();
+        os() << state->messageBuf.str();
+        result &= state->result;
+    }
+    os().flush();
+    
+    return result;
+}
 
-        updateBodyKinematics2();
-
-        Coeff& c = coeffSeq[i];
-        /*
-        c.a = -cm.z();
-        c.b = 2.0 * cm.z() + gdt2;
-        c.d = gdt2 * zmpDiff;
-        */
 
-        if(DoVerticalAccCompensation){
-            const double gdt2 = inertial_g * dt2;
-            c.a = -cm.z() / gdt2;
-            c.b = 2.0 * cm.z() / gdt2 + 1.0;
+/**
+   Initialize the kinematics state to evaluate the frames from firstFrame.
+   When the range does not begin at initialFrame, the state is initialized at the frame a
+   little before the range and the frames up to the range are evaluated without recording
+   anything so that the state is the same as the one evaluated from initialFrame.
+*/
+void WaistBalancer::initBodyKinematicsForFrameRange
+(KinematicsState& s, int initialFrame, int firstFrame, const Vector3& initialCmTranslation)
+{
+    if(firstFrame == initialFrame){
+        initBodyKinematics(s, initialFrame, initialCmTranslation);
+    } else {
+        const int warmUpFrame = std::max(initialFrame, firstFrame - NumWarmUpFrames);
+        if(warmUpFrame == initialFrame){
+            initBodyKinematics(s, warmUpFrame, initialCmTranslation, false);
         } else {
-            const double gdt2 = g * dt2;        
-            c.a = -cm.z() / gdt2;
-            c.b = 2.0 * cm.z() / gdt2 + 1.0;
+            initBodyKinematics(s, warmUpFrame, totalCmTranslations[warmUpFrame], false);
         }
-        c.d = zmpDiff;
+        for(int frame = warmUpFrame; frame < firstFrame; ++frame){
+            updateBodyKinematics1(s, frame, false);
+            updateBodyKinematics2(s);
+        }
+    }
+}
+
+
+bool WaistBalancer::calcCmTranslations()
+{
+    if(isCalculatingInitialWaistTrajectory){
+        initialCmTranslations.resize(totalCmTranslations.size());
+    }
+
+    evaluateFrames(
+        frameToStartBalancer, endingFrame,
+        [this](KinematicsState& s, int firstFrame, int lastFrame){
+            calcCoeffs(s, firstFrame, lastFrame); });
+
+    if(isCalculatingInitialWaistTrajectory){
+        std::copy(initialCmTranslations.begin() + frameToStartBalancer,
+                  initialCmTranslations.begin() + endingFrame + 1,
+                  totalCmTranslations.begin() + frameToStartBalancer);
     }
     
     double bet;
@@ -685,6 +809,52 @@ bool WaistBalancer::calcCmTranslations()
 }
 
 
+void WaistBalancer::calcCoeffs(KinematicsState& s, int firstFrame, int lastFrame)
+{
+    initBodyKinematicsForFrameRange(
+        s, frameToStartBalancer, firstFrame, totalCmTranslations[frameToStartBalancer]);
+
+    //const double gdt2 = g * dt2;
+    
+    for(int frame = firstFrame; frame <= lastFrame; ++frame){
+
+        const int i = frame - frameToStartBalancer;
+
+        updateBodyKinematics1(s, frame);
+
+        if(doStoreOriginalWaistFeetPositionsForWaistHeightRelaxation){
+            // store waist and feet positions
+            WaistFeetPos& p = waistFeetPosSeq[i];
+            p.T_waist = s.waistLink->T();
+            for(int j=0; j < 2; ++j){
+                Link* footLink = s.body->link(waistFeetIK.baseLink(j)->index());
+                p.T_foot[j] = footLink->T();
+            }
+        }
+
+        updateBodyKinematics2(s);
+
+        Coeff& c = coeffSeq[i];
+        /*
+        c.a = -cm.z();
+        c.b = 2.0 * cm.z() + gdt2;
+        c.d = gdt2 * zmpDiff;
+        */
+
+        if(DoVerticalAccCompensation){
+            const double gdt2 = s.inertial_g * dt2;
+            c.a = -s.cm.z() / gdt2;
+            c.b = 2.0 * s.cm.z() / gdt2 + 1.0;
+        } else {
+            const double gdt2 = g * dt2;        
+            c.a = -s.cm.z() / gdt2;
+            c.b = 2.0 * s.cm.z() / gdt2 + 1.0;
+        }
+        c.d = s.zmpDiff;
+    }
+}
+
+
 void WaistBalancer::initWaistHeightRelaxation()
 {
     LeggedBodyHelperPtr legged = getLeggedBodyHelper(body_);
@@ -707,7 +877,7 @@ void WaistBalancer::initWaistHeightRelaxation()
             waistDeltaZseq.resize(numFilteredFrames);
 
             if(waistFeetIK.body() != body_){
-                waistFeetIK.reset(body_, waistLink);
+                waistFeetIK.reset(body_, mainState.waistLink);
                 for(int i=0; i < 2; ++i){
                     waistFeetIK.addBaseLink(legged->footLink(i));
                 }
@@ -840,38 +1010,49 @@ bool WaistBalancer::applyCmTranslations(BodyMotion& motion, bool putAllLinkPosit
         }
     }
     
-    bool completed = true;
-
     const int numJoints = body_->numJoints();
     const int numLinksToPut = (putAllLinkPositions ? body_->numLinks() : 1);
     
     motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
 
-    MultiValueSeq& qseq = *motion.jointPosSeq();
-    MultiSE3Seq& pseq = *motion.linkPosSeq();
     auto zmpseq = getOrCreateZMPSeq(motion);
     zmpseq->setRootRelative(false);
 
-    initBodyKinematics(beginningFrame, totalCmTranslations[beginningFrame]);
+    return evaluateFrames(
+        beginningFrame, endingFrame,
+        [&](KinematicsState& s, int firstFrame, int lastFrame){
+            putFrames(s, motion, *zmpseq, numLinksToPut, firstFrame, lastFrame); });
+}
 
-    for(int frame = beginningFrame; frame <= endingFrame; ++frame){
 
-        completed &= updateBodyKinematics1(frame); 
+void WaistBalancer::putFrames
+(KinematicsState& s, BodyMotion& motion, ZMPSeq& zmpseq, int numLinksToPut, int firstFrame, int lastFrame)
+{
+    Body* body = s.body;
+    const int numJoints = body->numJoints();
+    MultiValueSeq& qseq = *motion.jointPosSeq();
+    MultiSE3Seq& pseq = *motion.linkPosSeq();
+
+    initBodyKinematicsForFrameRange(s, beginningFrame, firstFrame, totalCmTranslations[beginningFrame]);
+
+    for(int frame = firstFrame; frame <= lastFrame; ++frame){
+
+        if(!updateBodyKinematics1(s, frame)){
+            s.result = false;
+        }
 
         MultiValueSeq::Frame qs = qseq.frame(frame);
         for(int i=0; i < numJoints; ++i){
-            qs[i] = body_->joint(i)->q();
+            qs[i] = body->joint(i)->q();
         }
 
-        zmpseq->at(frame) = zmp;
+        zmpseq[frame] = s.zmp;
         
         for(int i=0; i < numLinksToPut; ++i){
-            Link* link = body_->link(i);
+            Link* link = body->link(i);
             pseq.at(frame, i).set(link->T());
         }
 
-        updateBodyKinematics2();
+        updateBodyKinematics2(s);
     }
-
-    return completed;
 }
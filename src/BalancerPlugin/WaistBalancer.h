@@ -12,10 +12,14 @@
 #include <cnoid/CompositeIK>
 #include <cnoid/stdx/optional>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <sstream>
 
 namespace cnoid {
 
     class PoseProvider;
+    class ZMPSeq;
 
     class WaistBalancer
     {
@@ -68,8 +72,46 @@ namespace cnoid {
             
         bool apply(PoseProvider* provider, BodyMotion& motion, bool putAllLinkPositions = false);
 
+        /**
+           The frame-by-frame kinematics evaluation of each iteration is divided into the frame
+           ranges of the same number as the providers when more than one provider is given.
+           Each range is evaluated in a separate thread with its own provider and a clone of the
+           body, so the providers must not share any state with each other. The frames are not
+           divided and the body is not cloned when there are too few frames. The result is identical
+           to that of a single provider only when the pose provided by a seek does not depend on the
+           preceding seeks.
+        */
+        bool apply(const std::vector<PoseProvider*>& providers, BodyMotion& motion, bool putAllLinkPositions = false);
+
       private:
 
+        /*
+          The state of the frame-by-frame kinematics evaluation.
+          An instance is created for each thread evaluating a frame range.
+        */
+        struct KinematicsState {
+            BodyPtr body;
+            PoseProvider* provider;
+            Link* baseLink;
+            Link* waistLink;
+            LinkTraverse fkTraverse;
+            std::vector<stdx::optional<double>> jointPositions;
+            double inertial_g;
+            Vector3 cm; // center of mass
+            Vector3 P0; // prev momentum
+            Vector3 L0; // prev angular momentum
+            Vector3 dP;
+            Vector3 dL;
+            Vector3 zmp; // calculated ZMP
+            Vector3 desiredZmp;
+            Vector3 zmpDiff;
+            std::ostream* os;
+            std::ostringstream messageBuf;
+            bool result;
+        };
+        KinematicsState mainState;
+        std::vector<std::unique_ptr<KinematicsState>> workerStates;
+
         std::vector<double> q0;
         Vector3 p0;
         Matrix3 R0;
@@ -85,12 +127,7 @@ namespace cnoid {
         double dynamicsTimeRatio;
 
         BodyPtr body_;
-        Link* baseLink;
-        LinkTraverse fkTraverse;
-        PoseProvider* provider;
         bool isCalculatingInitialWaistTrajectory;
-
-        std::vector<stdx::optional<double>> jointPositions;
             
         int numIterations_;
         int beginningFrame;
@@ -104,15 +141,6 @@ namespace cnoid {
         double g;
         double mg;
         double m;
-        double inertial_g;
-        Vector3 cm; // center of mass
-        Vector3 P0; // prev momentum
-        Vector3 L0; // prev angular momentum
-        Vector3 dP;
-        Vector3 dL;
-        Vector3 zmp; // calculated ZMP
-        Vector3 desiredZmp;
-        Vector3 zmpDiff;
 
         struct Coeff {
             double a;
@@ -122,8 +150,8 @@ namespace cnoid {
         std::vector<Coeff> coeffSeq;
 
         std::vector<Vector3> totalCmTranslations;
+        std::vector<Vector3> initialCmTranslations;
 
-        Link* waistLink;
         int waistLinkIndex;
             
         int boundaryConditionType;
@@ -164,16 +192,24 @@ namespace cnoid {
         bool calcBoundaryCmAdjustmentTrajectorySub(int begin, int direction);
         bool calcWaistTranslationWithCmAboveZmp(
             int frame, const Vector3& zmp, Vector3& out_translation);
-        void initBodyKinematics(int frame, const Vector3& cmTranslation);
-        void updateCmAndZmp(int frame);
-        bool updateBodyKinematics1(int frame);
-        void updateBodyKinematics2();
+        void initBodyKinematics(KinematicsState& s, int frame, const Vector3& cmTranslation, bool doRecord = true);
+        void updateCmAndZmp(KinematicsState& s, int frame, bool doRecord = true);
+        bool updateBodyKinematics1(KinematicsState& s, int frame, bool doRecord = true);
+        void updateBodyKinematics2(KinematicsState& s);
+        bool evaluateFrames(
+            int firstFrame, int lastFrame,
+            const std::function<void(KinematicsState& s, int firstFrame, int lastFrame)>& evaluate);
+        void initBodyKinematicsForFrameRange(
+            KinematicsState& s, int initialFrame, int firstFrame, const Vector3& initialCmTranslation);
         bool calcCmTranslations();
+        void calcCoeffs(KinematicsState& s, int firstFrame, int lastFrame);
         void initWaistHeightRelaxation();
         void relaxWaistHeightTrajectory();
         void applyCubicBoundarySmoother(int begin, int direction);
         void applyQuinticBoundarySmoother(int begin, int direction);
         bool applyCmTranslations(BodyMotion& motion, bool putAllLinkPositions);
+        void putFrames(
+            KinematicsState& s, BodyMotion& motion, ZMPSeq& zmpseq, int numLinksToPut, int firstFrame, int lastFrame);
 
         inline double timeOfFrame(int frame) {
             return std::max(targetBeginningTime, std::min(targetEndingTime, (frame / frameRate)));
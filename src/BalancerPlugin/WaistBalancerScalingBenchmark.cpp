@@ -0,0 +1,245 @@
+/**
+   This program measures the scaling of the parallel frame evaluation of WaistBalancer.
+   A swaying motion of a biped model is filtered with the different numbers of the pose providers,
+   and the filtered motions are checked to be bitwise identical to that of the serial evaluation.
+
+   Usage: WaistBalancerScalingBenchmark [number of frames] [number of iterations] [model file]
+*/
+
+#include "WaistBalancer.h"
+#include <cnoid/PoseProvider>
+#include <cnoid/BodyLoader>
+#include <cnoid/LeggedBodyHelper>
+#include <cnoid/JointPath>
+#include <cnoid/ZMPSeq>
+#include <cnoid/ValueTree>
+#include <cnoid/EigenUtil>
+#include <cnoid/ExecutablePath>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double FrameRate = 200.0;
+
+/*
+  The waist sways sideways and the arms swing while the feet stay at the initial positions.
+  The desired ZMP is fixed at the center of the soles so that the balancer has to shift the waist.
+  The leg joint angles are solved from the standard pose in every seek so that the provided poses
+  do not depend on the order of the seeks, which is required for the identical results.
+*/
+class SwayingPoseProvider : public PoseProvider
+{
+public:
+    SwayingPoseProvider(Body* orgBody, int numFrames)
+        : numFrames(numFrames)
+    {
+        body_ = orgBody->clone();
+        auto pose = body_->info()->findListing("standardPose");
+        q0.resize(body_->numJoints(), 0.0);
+        if(pose->isValid()){
+            for(int i=0; i < pose->size() && i < body_->numJoints(); ++i){
+                q0[i] = radian(pose->at(i)->toDouble());
+            }
+        }
+        setStandardPose();
+        body_->calcForwardKinematics();
+
+        Link* rootLink = body_->rootLink();
+        T_root0 = rootLink->T();
+        auto legged = getLeggedBodyHelper(body_);
+        for(int i=0; i < legged->numFeet(); ++i){
+            Link* footLink = legged->footLink(i);
+            legPaths.push_back(JointPath::getCustomPath(body_, rootLink, footLink));
+            footPositions.push_back(footLink->T());
+        }
+        zmp = legged->homeCopOfSoles();
+
+        rightShoulder = body_->link("RARM_SHOULDER_P");
+        leftShoulder = body_->link("LARM_SHOULDER_P");
+    }
+
+    void setStandardPose()
+    {
+        for(int i=0; i < body_->numJoints(); ++i){
+            body_->joint(i)->q() = q0[i];
+        }
+    }
+
+    virtual Body* body() const override { return body_; }
+    virtual double beginningTime() const override { return 0.0; }
+    virtual double endingTime() const override { return (numFrames - 1) / FrameRate; }
+
+    virtual bool seek(double time) override
+    {
+        return seek(time, 0, Vector3::Zero());
+    }
+
+    virtual bool seek(double time, int waistLinkIndex, const Vector3& waistTranslation) override
+    {
+        if(waistLinkIndex != 0){
+            return false;
+        }
+        const int frame = std::min(static_cast<int>(std::lround(time * FrameRate)), numFrames - 1);
+        const double t = frame / FrameRate;
+
+        setStandardPose();
+        T_root = T_root0;
+        T_root.translation().y() += 0.04 * sin(2.0 * PI * 0.5 * t);
+        T_root.translation() += waistTranslation;
+        body_->rootLink()->setPosition(T_root);
+        if(rightShoulder && leftShoulder){
+            const double q = 0.5 * sin(2.0 * PI * 0.8 * t);
+            rightShoulder->q() = q;
+            leftShoulder->q() = -q;
+        }
+        bool solved = true;
+        for(size_t i=0; i < legPaths.size(); ++i){
+            if(!legPaths[i]->setBaseLinkGoal(T_root).calcInverseKinematics(footPositions[i])){
+                solved = false;
+            }
+        }
+        return solved;
+    }
+
+    virtual int baseLinkIndex() const override { return 0; }
+
+    virtual bool getBaseLinkPosition(Isometry3& out_T) const override
+    {
+        out_T = T_root;
+        return true;
+    }
+
+    virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const override
+    {
+        const int n = body_->numJoints();
+        out_q.resize(n);
+        for(int i=0; i < n; ++i){
+            out_q[i] = body_->joint(i)->q();
+        }
+    }
+
+    virtual stdx::optional<Vector3> ZMP() const override { return zmp; }
+
+private:
+    BodyPtr body_;
+    int numFrames;
+    vector<double> q0;
+    Isometry3 T_root0;
+    Isometry3 T_root;
+    vector<shared_ptr<JointPath>> legPaths;
+    vector<Isometry3> footPositions;
+    Vector3 zmp;
+    Link* rightShoulder;
+    Link* leftShoulder;
+};
+
+
+double filter(Body* body, int numFrames, int numIterations, int numThreads, vector<double>& out_states)
+{
+    vector<unique_ptr<SwayingPoseProvider>> providerInstances;
+    vector<PoseProvider*> providers;
+    for(int i=0; i < numThreads; ++i){
+        providerInstances.emplace_back(new SwayingPoseProvider(body, numFrames));
+        providers.push_back(providerInstances.back().get());
+    }
+
+    WaistBalancer balancer;
+    balancer.setBody(body);
+    balancer.setNumIterations(numIterations);
+    balancer.setFullTimeRange();
+
+    BodyMotion motion;
+    motion.setFrameRate(FrameRate);
+
+    auto start = std::chrono::steady_clock::now();
+    bool result = balancer.apply(providers, motion);
+    auto end = std::chrono::steady_clock::now();
+
+    out_states.clear();
+    if(result){
+        auto qseq = motion.jointPosSeq();
+        auto pseq = motion.linkPosSeq();
+        auto zmpSeq = getZMPSeq(motion);
+        for(int frame=0; frame < motion.numFrames(); ++frame){
+            auto qs = qseq->frame(frame);
+            out_states.insert(out_states.end(), qs.begin(), qs.end());
+            auto& p = pseq->at(frame, 0);
+            out_states.insert(out_states.end(), p.translation().data(), p.translation().data() + 3);
+            out_states.insert(out_states.end(), p.rotation().coeffs().data(), p.rotation().coeffs().data() + 4);
+            if(zmpSeq){
+                auto& zmp = (*zmpSeq)[frame];
+                out_states.insert(out_states.end(), zmp.data(), zmp.data() + 3);
+            }
+        }
+    }
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numFrames = (argc >= 2) ? std::stoi(argv[1]) : 4000;
+    int numIterations = (argc >= 3) ? std::stoi(argv[2]) : 2;
+    string filename = (argc >= 4) ? argv[3] : shareDir() + "/model/SR1/SR1.body";
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(filename);
+    if(!body){
+        cerr << "The model file \"" << filename << "\" cannot be loaded." << endl;
+        return 1;
+    }
+    auto legged = getLeggedBodyHelper(body);
+    if(!legged->isValid() || legged->numFeet() != 2){
+        cerr << "The model \"" << body->modelName() << "\" is not a biped model." << endl;
+        return 1;
+    }
+
+    vector<int> threadCounts = { 1, 2, 4, 8 };
+    int numHardwareThreads = std::thread::hardware_concurrency();
+    if(numHardwareThreads > 8){
+        threadCounts.push_back(numHardwareThreads);
+    }
+
+    cout << numFrames << " frames of " << body->modelName() << ", " << numIterations << " iterations" << endl;
+
+    vector<double> serialStates;
+    vector<double> states;
+    double serialTime = 0.0;
+    bool isDeterministic = true;
+
+    for(auto& numThreads : threadCounts){
+        double time = filter(body, numFrames, numIterations, numThreads, numThreads == 1 ? serialStates : states);
+        if(numThreads == 1 && serialStates.empty()){
+            cerr << "The balancer failed to filter the motion." << endl;
+            return 1;
+        }
+        bool isIdentical = true;
+        if(numThreads == 1){
+            serialTime = time;
+        } else {
+            isIdentical =
+                (states.size() == serialStates.size()) &&
+                (std::memcmp(states.data(), serialStates.data(), states.size() * sizeof(double)) == 0);
+            if(!isIdentical){
+                isDeterministic = false;
+            }
+        }
+        cout << setw(3) << numThreads << " threads: " << fixed << setprecision(3) << time << " s, speedup "
+             << setprecision(2) << (serialTime / time) << (isIdentical ? "" : " (the motions differ)") << endl;
+    }
+
+    return isDeterministic ? 0 : 1;
+}
@@ -79,7 +79,11 @@ void AbstractSeqItem::doPutProperties(PutPropertyFunction& putProperty)
 
 bool AbstractSeqItem::store(Archive& archive)
 {
-    if(overwriteOrSaveWithDialog()){
+    bool isStoredAsBinaryData = false;
+    if(archive.isBinaryDataStorageEnabled() && filePath().empty()){
+        isStoredAsBinaryData = storeSeqAsBinaryData(archive);
+    }
+    if(!isStoredAsBinaryData && overwriteOrSaveWithDialog()){
         archive.writeFileInformation(this);
     }
     archive.write("offsetTime", abstractSeq()->getOffsetTime());
@@ -93,10 +97,25 @@ bool AbstractSeqItem::restore(const Archive& archive)
     if(archive.read("offsetTime", offsetTime)){
         abstractSeq()->setOffsetTime(offsetTime);
     }
+    if(archive.hasBinaryData("seq_data")){
+        return restoreSeqFromBinaryData(archive);
+    }
     return archive.loadFileTo(this);
 }
 
 
+bool AbstractSeqItem::storeSeqAsBinaryData(Archive& /* archive */)
+{
+    return false;
+}
+
+
+bool AbstractSeqItem::restoreSeqFromBinaryData(const Archive& /* archive */)
+{
+    return false;
+}
+
+
 void AbstractMultiSeqItem::initializeClass(ExtensionManager* ext)
 {
     ext->itemManager().registerAbstractClass<AbstractMultiSeqItem, AbstractSeqItem>();
@@ -27,6 +27,13 @@ protected:
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
     virtual bool restore(const Archive& archive) override;
+
+    /**
+       These functions are implemented by the items whose sequences can be stored in the
+       binary side-car file of the project file when the sequences are not saved as files.
+    */
+    virtual bool storeSeqAsBinaryData(Archive& archive);
+    virtual bool restoreSeqFromBinaryData(const Archive& archive);
 };
 
 typedef ref_ptr<AbstractSeqItem> AbstractSeqItemPtr;
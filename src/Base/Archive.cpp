@@ -8,13 +8,19 @@
 #include <cnoid/FilePathVariableProcessor>
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <fstream>
 #include <map>
 #include <deque>
+#include <memory>
+#include <climits>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 namespace filesystem = cnoid::stdx::filesystem;
+using fmt::format;
 
 namespace {
 
@@ -32,6 +38,55 @@ struct FunctionInfo {
 
 deque<function<void()>> finalProcesses;
 
+const char BinaryDataFileSignature[] = "CNOIDBIN";
+const int BinaryDataFileVersion = 1;
+const int BinaryDataFileHeaderSize = 16;
+
+class BinaryDataFile
+{
+public:
+    string filename;
+    ifstream stream;
+    bool isOpened;
+    bool isValid;
+    std::streamoff fileSize;
+
+    BinaryDataFile(const string& filename)
+        : filename(filename)
+    {
+        isOpened = false;
+        isValid = false;
+        fileSize = 0;
+    }
+
+    // The file is opened when the first block is read and shared by the following reads
+    bool read(int offset, int size, vector<char>& out_data)
+    {
+        if(!isOpened){
+            isOpened = true;
+            stream.open(fromUTF8(filename).c_str(), ios::in | ios::binary);
+            char signature[8];
+            if(stream.read(signature, 8) && memcmp(signature, BinaryDataFileSignature, 8) == 0){
+                stream.seekg(0, ios::end);
+                fileSize = stream.tellg();
+                isValid = true;
+            } else {
+                MessageView::instance()->putln(
+                    format(_("\"{0}\" is not a valid binary data file."), filename), MessageView::Warning);
+            }
+        }
+        if(!isValid || offset < BinaryDataFileHeaderSize || size < 0 ||
+           static_cast<std::streamoff>(offset) + size > fileSize){
+            return false;
+        }
+        out_data.resize(size);
+        stream.clear();
+        stream.seekg(offset);
+        stream.read(out_data.data(), size);
+        return !stream.fail();
+    }
+};
+
 }
 
 namespace cnoid {
@@ -54,16 +109,75 @@ public:
     vector<FunctionInfo> nextPostProcesses;
     bool isDoingPostProcesses;
 
+    string projectFile;
+    bool isBinaryDataStorageEnabled;
+    string binaryDataFile;
+    ofstream binaryDataOutput;
+    // -1 if the file cannot be opened
+    int binaryDataOutputSize;
+    map<string, shared_ptr<BinaryDataFile>> binaryDataFileMap;
+
     ArchiveSharedData(){
         currentParentItem = nullptr;
         pointerToProcessesOnSubTreeRestored = nullptr;
         isDoingPostProcesses = false;
+        isBinaryDataStorageEnabled = false;
+        binaryDataOutputSize = 0;
+    }
+
+    ~ArchiveSharedData(){
+        finishBinaryDataOutput();
     }
+
+    bool openBinaryDataOutput();
+    void finishBinaryDataOutput();
 };
 
 }
 
 
+bool ArchiveSharedData::openBinaryDataOutput()
+{
+    if(binaryDataOutputSize < 0){
+        return false;
+    }
+    // The data is written to a temporary file not to break the existing file which may be being read
+    binaryDataFile = projectFile + ".bin";
+    binaryDataOutput.open(fromUTF8(binaryDataFile + ".tmp").c_str(), ios::out | ios::binary | ios::trunc);
+    if(!binaryDataOutput){
+        MessageView::instance()->putln(
+            format(_("Binary data file \"{0}\" cannot be opened."), binaryDataFile), MessageView::Error);
+        binaryDataOutputSize = -1;
+        return false;
+    }
+    char header[BinaryDataFileHeaderSize];
+    memset(header, 0, BinaryDataFileHeaderSize);
+    memcpy(header, BinaryDataFileSignature, 8);
+    int32_t version = BinaryDataFileVersion;
+    memcpy(header + 8, &version, sizeof(version));
+    binaryDataOutput.write(header, BinaryDataFileHeaderSize);
+    binaryDataOutputSize = BinaryDataFileHeaderSize;
+    return true;
+}
+
+
+void ArchiveSharedData::finishBinaryDataOutput()
+{
+    if(binaryDataOutput.is_open()){
+        binaryDataOutput.close();
+        auto tmpPath = filesystem::path(fromUTF8(binaryDataFile + ".tmp"));
+        auto path = filesystem::path(fromUTF8(binaryDataFile));
+        stdx::error_code ec;
+        filesystem::rename(tmpPath, path, ec);
+        if(ec){
+            MessageView::instance()->putln(
+                format(_("Binary data file \"{0}\" cannot be written: {1}"), binaryDataFile, ec.message()),
+                MessageView::Error);
+        }
+    }
+}
+
+
 Archive* Archive::invalidArchive()
 {
     static ArchivePtr invalidArchive_ = new Archive;
@@ -94,6 +208,7 @@ Archive::~Archive()
 void Archive::initSharedInfo(const std::string& projectFile, bool isSubProject)
 {
     shared = new ArchiveSharedData;
+    shared->projectFile = projectFile;
 
     if(!isSubProject){
         shared->pathVariableProcessor = FilePathVariableProcessor::systemInstance();
@@ -351,6 +466,86 @@ bool Archive::writeFileInformation(Item* item)
 }
 
 
+void Archive::setBinaryDataStorageEnabled(bool on)
+{
+    if(shared){
+        shared->isBinaryDataStorageEnabled = on;
+    }
+}
+
+
+bool Archive::isBinaryDataStorageEnabled() const
+{
+    return shared && shared->isBinaryDataStorageEnabled;
+}
+
+
+bool Archive::writeBinaryData(const std::string& key, const void* data, size_t size)
+{
+    if(!isBinaryDataStorageEnabled()){
+        return false;
+    }
+    auto& output = shared->binaryDataOutput;
+    if(!output.is_open()){
+        if(!shared->openBinaryDataOutput()){
+            return false;
+        }
+    }
+
+    // Each data is aligned to 8 bytes
+    int offset = shared->binaryDataOutputSize;
+    int padding = (8 - offset % 8) % 8;
+    if(size > static_cast<size_t>(INT_MAX - offset - padding)){
+        return false;
+    }
+    if(padding > 0){
+        static const char zeros[8] = { 0 };
+        output.write(zeros, padding);
+        offset += padding;
+    }
+    output.write(static_cast<const char*>(data), size);
+    if(!output){
+        return false;
+    }
+    shared->binaryDataOutputSize = offset + size;
+
+    auto node = createFlowStyleMapping(key);
+    node->write("binary_file", getRelocatablePath(shared->binaryDataFile), DOUBLE_QUOTED);
+    node->write("offset", offset);
+    node->write("size", static_cast<int>(size));
+    
+    return true;
+}
+
+
+bool Archive::hasBinaryData(const std::string& key) const
+{
+    auto node = findMapping(key);
+    return node->isValid() && node->find("binary_file")->isValid();
+}
+
+
+bool Archive::readBinaryData(const std::string& key, std::vector<char>& out_data) const
+{
+    auto node = findMapping(key);
+    if(node->isValid()){
+        string file;
+        int offset, size;
+        if(node->read("binary_file", file) && node->read("offset", offset) && node->read("size", size)){
+            file = resolveRelocatablePath(file);
+            if(!file.empty()){
+                auto& binaryDataFile = shared->binaryDataFileMap[file];
+                if(!binaryDataFile){
+                    binaryDataFile = make_shared<BinaryDataFile>(file);
+                }
+                return binaryDataFile->read(offset, size, out_data);
+            }
+        }
+    }
+    return false;
+}
+
+
 void Archive::clearIds()
 {
     if(shared){
@@ -7,6 +7,7 @@
 
 #include <cnoid/ValueTree>
 #include <string>
+#include <vector>
 #include <functional>
 #include "exportdecl.h"
 
@@ -76,6 +77,21 @@ public:
     bool writeRelocatablePath(const std::string& key, const std::string& path);
     bool writeFileInformation(Item* item);
 
+    /**
+       Large data can be stored in the binary side-car file of the project file, which is named
+       "<project file>.bin", when the binary data storage mode of the project manager is enabled.
+       The archive only has the reference to the data with the key.
+       The data is read eagerly by readBinaryData when the item is restored. Only the side-car
+       file itself is opened when the first block is read, and each read only loads the requested
+       block.
+       \return false if the binary data storage is not enabled or the data cannot be written.
+       In that case, the data should be written to the archive in the usual way.
+    */
+    bool isBinaryDataStorageEnabled() const;
+    bool writeBinaryData(const std::string& key, const void* data, size_t size);
+    bool hasBinaryData(const std::string& key) const;
+    bool readBinaryData(const std::string& key, std::vector<char>& out_data) const;
+
     //! \deprecated
     [[deprecated("Use loadFileTo(Item* item, const std::string& filepath)")]]
     bool loadFileTo(const std::string& filepath, Item* item) const {
@@ -99,6 +115,7 @@ private:
     static Archive* invalidArchive();
     void registerItemId(const Item* item, int id);
     void registerViewId(const View* view, int id);
+    void setBinaryDataStorageEnabled(bool on);
 
     // called from ItemTreeArchiver
     void setPointerToProcessesOnSubTreeRestored(std::vector<std::function<void()>>* pfunc);
@@ -10,6 +10,7 @@
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
+#include <cnoid/MeshRayIntersector>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
 #include <GL/glu.h>
@@ -18,6 +19,7 @@
 #include <deque>
 #include <mutex>
 #include <regex>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 #include "gettext.h"
@@ -79,6 +81,52 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+/**
+   Bounding volume hierarchy of the points or the line segments of a plot for the ray cast picking.
+   The primitives whose bounding boxes expanded by a margin are crossed by a ray are enumerated
+   as the candidates to be checked precisely.
+*/
+class PlotPrimitiveTree
+{
+public:
+    PlotPrimitiveTree(SgPlot* plot, bool isLineSet);
+    bool empty() const { return nodes.empty(); }
+    const Vector3f& min() const { return nodes.front().min; }
+    const Vector3f& max() const { return nodes.front().max; }
+
+    /**
+       The ray is given in the local coordinate of the plot. The direction does not have to be
+       normalized, and the primitives which may be within the margin from the ray in the range of
+       0 <= t <= tmax are passed to the function.
+    */
+    template<class Function>
+    void forEachCandidate(
+        const Vector3& origin, const Vector3& direction, double tmax, double margin, Function function) const;
+
+private:
+    static const int MaxNumLeafPrimitives = 8;
+
+    struct Node
+    {
+        Vector3f min;
+        Vector3f max;
+        // The index of the first primitive for a leaf node and the index of the second child for an inner node.
+        // The first child of an inner node is always the next node.
+        int index;
+        // Zero for an inner node
+        int numPrimitives;
+    };
+    vector<Node> nodes;
+    // The indices of the points or the lines
+    vector<int> primitives;
+    vector<Vector3f> primitiveMins;
+    vector<Vector3f> primitiveMaxs;
+
+    int buildNode(int begin, int end);
+    bool intersectBox(
+        const Node& node, const Vector3& origin, const Vector3& invDirection, double tmax, double margin) const;
+};
+
 class VertexResource : public GLResource
 {
 public:
@@ -93,6 +141,8 @@ public:
     Matrix4 localTransform;
     SgLineSetPtr boundingBoxLines;
     SgLineSetPtr normalVisualization;
+    unique_ptr<MeshRayIntersector> rayIntersector;
+    unique_ptr<PlotPrimitiveTree> plotPrimitiveTree;
     ScopedConnection connection;
 
     VertexResource(const VertexResource&) = delete;
@@ -106,7 +156,13 @@ public:
 
         connection.reset(
             obj->sigUpdated().connect(
-                [&](const SgUpdate&){ numVertices = 0; }));
+                [&](const SgUpdate& update){
+                    numVertices = 0;
+                    if(update.hasAction(SgUpdate::GeometryModified)){
+                        rayIntersector.reset();
+                        plotPrimitiveTree.reset();
+                    }
+                }));
     }
 
     void clearHandles(){
@@ -160,6 +216,157 @@ public:
 
 typedef ref_ptr<VertexResource> VertexResourcePtr;
 
+
+PlotPrimitiveTree::PlotPrimitiveTree(SgPlot* plot, bool isLineSet)
+{
+    const SgVertexArray& vertices = *plot->vertices();
+    const int numVertices = vertices.size();
+    if(!isLineSet){
+        primitives.reserve(numVertices);
+        for(int i=0; i < numVertices; ++i){
+            primitives.push_back(i);
+            primitiveMins.push_back(vertices[i]);
+            primitiveMaxs.push_back(vertices[i]);
+        }
+    } else {
+        auto lineSet = static_cast<SgLineSet*>(plot);
+        const int numLines = lineSet->numLines();
+        primitives.reserve(numLines);
+        for(int i=0; i < numLines; ++i){
+            auto line = lineSet->line(i);
+            if(line[0] < numVertices && line[1] < numVertices){
+                primitives.push_back(i);
+                primitiveMins.push_back(vertices[line[0]].cwiseMin(vertices[line[1]]));
+                primitiveMaxs.push_back(vertices[line[0]].cwiseMax(vertices[line[1]]));
+            }
+        }
+    }
+
+    // The primitive index in the following process is the index in the primitive arrays
+    vector<int> orgIndices;
+    orgIndices.swap(primitives);
+    const int n = orgIndices.size();
+    primitives.resize(n);
+    for(int i=0; i < n; ++i){
+        primitives[i] = i;
+    }
+    if(n > 0){
+        nodes.reserve(2 * n / MaxNumLeafPrimitives + 1);
+        buildNode(0, n);
+    }
+    for(auto& index : primitives){
+        index = orgIndices[index];
+    }
+
+    primitiveMins.clear();
+    primitiveMins.shrink_to_fit();
+    primitiveMaxs.clear();
+    primitiveMaxs.shrink_to_fit();
+}
+
+
+int PlotPrimitiveTree::buildNode(int begin, int end)
+{
+    const int nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    Vector3f min = Vector3f::Constant(std::numeric_limits<float>::max());
+    Vector3f max = Vector3f::Constant(std::numeric_limits<float>::lowest());
+    Vector3f cmin = min;
+    Vector3f cmax = max;
+    for(int i = begin; i < end; ++i){
+        const int j = primitives[i];
+        min = min.cwiseMin(primitiveMins[j]);
+        max = max.cwiseMax(primitiveMaxs[j]);
+        const Vector3f c = (primitiveMins[j] + primitiveMaxs[j]) / 2.0f;
+        cmin = cmin.cwiseMin(c);
+        cmax = cmax.cwiseMax(c);
+    }
+    nodes[nodeIndex].min = min;
+    nodes[nodeIndex].max = max;
+
+    const int n = end - begin;
+    int axis;
+    const float extent = (cmax - cmin).maxCoeff(&axis);
+
+    if(n <= MaxNumLeafPrimitives || extent <= 0.0f){
+        nodes[nodeIndex].index = begin;
+        nodes[nodeIndex].numPrimitives = n;
+    } else {
+        const int middle = begin + n / 2;
+        std::nth_element(
+            primitives.begin() + begin, primitives.begin() + middle, primitives.begin() + end,
+            [&](int a, int b){
+                return (primitiveMins[a][axis] + primitiveMaxs[a][axis]) < (primitiveMins[b][axis] + primitiveMaxs[b][axis]); });
+        buildNode(begin, middle);
+        const int secondChild = buildNode(middle, end);
+        nodes[nodeIndex].index = secondChild;
+        nodes[nodeIndex].numPrimitives = 0;
+    }
+
+    return nodeIndex;
+}
+
+
+bool PlotPrimitiveTree::intersectBox
+(const Node& node, const Vector3& origin, const Vector3& invDirection, double tmax, double margin) const
+{
+    double t0 = 0.0;
+    double t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        double tnear = (node.min[i] - margin - origin[i]) * invDirection[i];
+        double tfar = (node.max[i] + margin - origin[i]) * invDirection[i];
+        if(tnear > tfar){
+            std::swap(tnear, tfar);
+        }
+        // The comparisons are written so that NaN values do not shrink the range
+        if(tnear > t0){
+            t0 = tnear;
+        }
+        if(tfar < t1){
+            t1 = tfar;
+        }
+        if(t0 > t1){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template<class Function>
+void PlotPrimitiveTree::forEachCandidate
+(const Vector3& origin, const Vector3& direction, double tmax, double margin, Function function) const
+{
+    if(nodes.empty()){
+        return;
+    }
+    const Vector3 invDirection = direction.cwiseInverse();
+    const bool isMarginFinite = std::isfinite(margin);
+
+    // The depth of the tree built with the median split never exceeds this size
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        const int nodeIndex = stack[--stackSize];
+        const Node& node = nodes[nodeIndex];
+        if(isMarginFinite && !intersectBox(node, origin, invDirection, tmax, margin)){
+            continue;
+        }
+        if(node.numPrimitives > 0){
+            const int end = node.index + node.numPrimitives;
+            for(int i = node.index; i < end; ++i){
+                function(primitives[i]);
+            }
+        } else {
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = nodeIndex + 1;
+        }
+    }
+}
+
 class TextureResource : public GLResource
 {
 public:
@@ -306,6 +513,9 @@ public:
     bool isRenderingVisibleImage;
     bool isRenderingPickingImage;
     bool isPickingImageOutputEnabled;
+    bool isRayCastPickingEnabled;
+    bool isRayCastingForPicking;
+    bool isRayCastPickingUnavailable;
     bool isShadowCastingAvailable;
     bool isWorldLightShadowEnabled;
     bool isRenderingShadowMap;
@@ -403,6 +613,12 @@ public:
     Vector3 pickedPoint;
     int overlayPickIndex0;
 
+    // The ray is "pickingRayOrigin + t * pickingRayDirection" where 0 <= t <= 1
+    Vector3 pickingRayOrigin;
+    Vector3 pickingRayDirection;
+    double rayCastHitParameter;
+    int rayCastPickIndex;
+
     ostream* os_;
     ostream& os() { return *os_; }
 
@@ -431,6 +647,12 @@ public:
     void doRender();
     void setupFullLightingRendering();
     bool doPick(int x, int y);
+    bool pickByRayCasting(int x, int y, bool& out_picked);
+    void updateRayCastHit(double t, int pickIndex);
+    void castRayToMesh(SgMesh* mesh, const Affine3& modelTransform, int pickIndex);
+    void castRayToPlot(
+        SgPlot* plot, GLenum primitiveMode, VertexResource* resource, const Affine3& modelTransform, int pickIndex);
+    double getPickingToleranceInPixels(SgPlot* plot, GLenum primitiveMode);
     bool renderShadowMap(int lightIndex);
     bool renderShadowMap(SgLight* light, const Isometry3& T);
     void renderCamera(SgCamera* camera, const Isometry3& cameraPosition);
@@ -646,6 +868,17 @@ void GLSLSceneRenderer::Impl::initialize()
     isRenderingVisibleImage = false;
     isRenderingPickingImage = false;
     isPickingImageOutputEnabled = false;
+    isRayCastingForPicking = false;
+    isRayCastPickingUnavailable = false;
+    rayCastHitParameter = 1.0;
+    rayCastPickIndex = -1;
+
+    isRayCastPickingEnabled = true;
+    if(char* CNOID_ENABLE_RAY_CAST_PICKING = getenv("CNOID_ENABLE_RAY_CAST_PICKING")){
+        if(strcmp(CNOID_ENABLE_RAY_CAST_PICKING, "0") == 0){
+            isRayCastPickingEnabled = false;
+        }
+    }
     isShadowCastingAvailable = true;
     isWorldLightShadowEnabled = false;
     isRenderingShadowMap = false;
@@ -1313,6 +1546,13 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
     if(isGLCleared){
         initializeGLForRendering();
     }
+
+    if(isRayCastPickingEnabled && !isPickingImageOutputEnabled){
+        bool picked;
+        if(pickByRayCasting(x, y, picked)){
+            return picked;
+        }
+    }
     
     int vx, vy, width, height;
     self->getViewport(vx, vy, width, height);
@@ -1428,6 +1668,278 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
 }
 
 
+/**
+   Resolve the picking by casting the ray through the pixel to the scene on the CPU.
+   The scene graph is traversed with the same functions as the rendering of the picking image
+   so that the node path of the picked object is the same, but the intersections with the ray
+   are calculated instead of drawing the shapes. The triangle BVH of each mesh is cached in the
+   vertex resource of the mesh and is discarded when the geometry of the mesh is modified.
+   \return false if the picking cannot be resolved by the ray casting. The picking image must be
+   rendered in that case.
+*/
+bool GLSLSceneRenderer::Impl::pickByRayCasting(int x, int y, bool& out_picked)
+{
+    auto camera = self->currentCamera();
+    if(!camera){
+        return false;
+    }
+
+    isRenderingPickingImage = true;
+    isRenderingVisibleImage = false;
+    isRayCastingForPicking = true;
+    isRayCastPickingUnavailable = false;
+    beginRendering();
+
+    pushProgram(solidColorProgram);
+    currentNodePath.clear();
+    pickingNodePathList.clear();
+    overlayPickIndex0 = std::numeric_limits<int>::max();
+
+    renderCamera(camera, self->currentCameraPosition());
+
+    // The ray through the pixel center from the near clip plane to the far clip plane
+    Vector3 p0, p1;
+    bool isRayValid =
+        self->unproject(x + 0.5, y + 0.5, 0.0, p0) && self->unproject(x + 0.5, y + 0.5, 1.0, p1);
+
+    if(isRayValid){
+        pickingRayOrigin = p0;
+        pickingRayDirection = p1 - p0;
+        rayCastHitParameter = 1.0;
+        rayCastPickIndex = -1;
+
+        transparentRenderingQueue.clear();
+        overlayRenderingQueue.clear();
+        renderChildNodes(self->sceneRoot());
+
+        if(!transparentRenderingQueue.empty()){
+            renderTransparentObjects();
+        }
+        if(!overlayRenderingQueue.empty()){
+            // The overlay objects are picked in preference to the other objects
+            double t0 = rayCastHitParameter;
+            int pickIndex0 = rayCastPickIndex;
+            rayCastHitParameter = 1.0;
+            rayCastPickIndex = -1;
+            overlayPickIndex0 = pickingNodePathList.size();
+            for(auto& func : overlayRenderingQueue){
+                func();
+            }
+            overlayRenderingQueue.clear();
+            if(!transparentRenderingQueue.empty()){
+                renderTransparentObjects();
+            }
+            if(rayCastPickIndex < 0){
+                rayCastHitParameter = t0;
+                rayCastPickIndex = pickIndex0;
+            }
+        }
+    }
+
+    popProgram();
+    isRayCastingForPicking = false;
+    isRenderingPickingImage = false;
+    endRendering();
+
+    if(!isRayValid || isRayCastPickingUnavailable){
+        return false;
+    }
+
+    pickedNodePath.clear();
+    if(rayCastPickIndex >= 0 && rayCastPickIndex < static_cast<int>(pickingNodePathList.size())){
+        pickedPoint = pickingRayOrigin + rayCastHitParameter * pickingRayDirection;
+        pickedNodePath = *pickingNodePathList[rayCastPickIndex];
+    }
+    out_picked = !pickedNodePath.empty();
+
+    return true;
+}
+
+
+void GLSLSceneRenderer::Impl::updateRayCastHit(double t, int pickIndex)
+{
+    if(t < rayCastHitParameter || rayCastPickIndex < 0){
+        rayCastHitParameter = t;
+        rayCastPickIndex = pickIndex;
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::castRayToMesh(SgMesh* mesh, const Affine3& modelTransform, int pickIndex)
+{
+    if(isBoundingBoxRenderingMode){
+        // The bounding box lines are picked in this mode
+        isRayCastPickingUnavailable = true;
+        return;
+    }
+    
+    VertexResource* resource = getOrCreateVertexResource(mesh);
+    if(!resource->rayIntersector){
+        resource->rayIntersector.reset(new MeshRayIntersector(mesh));
+    }
+
+    bool doCullBackFaces;
+    switch(backFaceCullingMode){
+    case ENABLE_BACK_FACE_CULLING:
+        doCullBackFaces = mesh->isSolid();
+        break;
+    case DISABLE_BACK_FACE_CULLING:
+        doCullBackFaces = false;
+        break;
+    case FORCE_BACK_FACE_CULLING:
+    default:
+        doCullBackFaces = true;
+        break;
+    }
+    if(doCullBackFaces && modelTransform.linear().determinant() < 0.0){
+        // The front and back faces are swapped by the mirroring transform
+        doCullBackFaces = false;
+    }
+
+    // The ray parameter is not changed by the transformation because the direction is not normalized
+    const Affine3 T_inv = modelTransform.inverse();
+    const Vector3 origin = T_inv * pickingRayOrigin;
+    const Vector3 direction = T_inv.linear() * pickingRayDirection;
+    double t = rayCastHitParameter;
+    if(resource->rayIntersector->intersect(origin, direction, t, doCullBackFaces)){
+        updateRayCastHit(t, pickIndex);
+    }
+}
+
+
+double GLSLSceneRenderer::Impl::getPickingToleranceInPixels(SgPlot* plot, GLenum primitiveMode)
+{
+    double size;
+    if(primitiveMode == GL_LINES){
+        size = std::max(static_cast<SgLineSet*>(plot)->lineWidth(), MinLineWidthForPicking);
+    } else {
+        size = static_cast<SgPointSet*>(plot)->pointSize();
+        if(size <= 0.0){
+            size = defaultPointSize;
+        }
+    }
+    return std::max(size / 2.0, 0.5);
+}
+
+
+/**
+   The point or the line is picked when the distance from the ray is within the half
+   of its size in pixels, which is the same condition as the picking image.
+   The candidates of the points and the lines are found with the bounding volume hierarchy
+   whose boxes are expanded by the tolerance converted into the local coordinate.
+*/
+void GLSLSceneRenderer::Impl::castRayToPlot
+(SgPlot* plot, GLenum primitiveMode, VertexResource* resource, const Affine3& modelTransform, int pickIndex)
+{
+    if(!plot->hasVertices()){
+        return;
+    }
+    const Vector3& o = pickingRayOrigin;
+    const Vector3& d = pickingRayDirection;
+    const double dd = d.squaredNorm();
+    if(dd == 0.0){
+        return;
+    }
+
+    const bool isLineSet = (primitiveMode != GL_POINTS);
+    if(!resource->plotPrimitiveTree){
+        resource->plotPrimitiveTree.reset(new PlotPrimitiveTree(plot, isLineSet));
+    }
+    auto& tree = *resource->plotPrimitiveTree;
+    if(tree.empty()){
+        return;
+    }
+    
+    const double tolerance = getPickingToleranceInPixels(plot, primitiveMode);
+
+    /*
+      The pixel size ratio is inversely proportional to the depth, so its minimum in the bounding
+      box is given at one of the corners. The margin is not limited when a corner is behind the camera.
+    */
+    double margin = std::numeric_limits<double>::infinity();
+    double minRatio = std::numeric_limits<double>::max();
+    const Vector3 bmin = tree.min().cast<double>();
+    const Vector3 bmax = tree.max().cast<double>();
+    for(int i=0; i < 8; ++i){
+        const Vector3 corner((i & 1) ? bmax.x() : bmin.x(), (i & 2) ? bmax.y() : bmin.y(), (i & 4) ? bmax.z() : bmin.z());
+        double r = self->projectedPixelSizeRatio(modelTransform * corner);
+        if(!(r > 0.0)){
+            minRatio = 0.0;
+            break;
+        }
+        minRatio = std::min(minRatio, r);
+    }
+    if(minRatio > 0.0){
+        // A local distance is scaled at least by the smallest singular value in the world coordinate
+        const double minScale = modelTransform.linear().jacobiSvd().singularValues().minCoeff();
+        if(minScale > 0.0){
+            margin = tolerance / minRatio / minScale;
+        }
+    }
+
+    auto checkPoint = [&](const Vector3& p, double t){
+        if(t >= 0.0 && t <= rayCastHitParameter){
+            double r = self->projectedPixelSizeRatio(p);
+            if(r > 0.0 && (p - (o + t * d)).norm() * r <= tolerance){
+                updateRayCastHit(t, pickIndex);
+            }
+        }
+    };
+
+    // The ray parameter is not changed by the transformation because the direction is not normalized
+    const Affine3 T_inv = modelTransform.inverse();
+    const Vector3 localOrigin = T_inv * o;
+    const Vector3 localDirection = T_inv.linear() * d;
+    const SgVertexArray& vertices = *plot->vertices();
+
+    if(!isLineSet){
+        tree.forEachCandidate(
+            localOrigin, localDirection, rayCastHitParameter, margin,
+            [&](int index){
+                const Vector3 p = modelTransform * vertices[index].cast<double>();
+                checkPoint(p, (p - o).dot(d) / dd);
+            });
+    } else {
+        auto lineSet = static_cast<SgLineSet*>(plot);
+        tree.forEachCandidate(
+            localOrigin, localDirection, rayCastHitParameter, margin,
+            [&](int index){
+                auto line = lineSet->line(index);
+                const Vector3 a = modelTransform * vertices[line[0]].cast<double>();
+                const Vector3 u = modelTransform * vertices[line[1]].cast<double>() - a;
+                // The closest point on the segment to the ray
+                const Vector3 w = a - o;
+                const double b = d.dot(u);
+                const double uu = u.dot(u);
+                const double denom = dd * uu - b * b;
+                double s = 0.0;
+                if(denom > 1.0e-12 * dd * uu){
+                    s = (b * d.dot(w) - dd * u.dot(w)) / denom;
+                    if(s < 0.0){
+                        s = 0.0;
+                    } else if(s > 1.0){
+                        s = 1.0;
+                    }
+                }
+                const Vector3 p = a + s * u;
+                checkPoint(p, (p - o).dot(d) / dd);
+            });
+    }
+}
+
+
+bool GLSLSceneRenderer::isRayCastPickingEnabled() const
+{
+    return impl->isRayCastPickingEnabled;
+}
+
+
+void GLSLSceneRenderer::setRayCastPickingEnabled(bool on)
+{
+    impl->isRayCastPickingEnabled = on;
+}
+
+
 void GLSLSceneRenderer::setPickingImageOutputEnabled(bool on)
 {
     impl->isPickingImageOutputEnabled = on;
@@ -2154,6 +2666,11 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
 {
     auto mesh = shape->mesh();
+
+    if(isRayCastingForPicking){
+        castRayToMesh(mesh, modelTransform, pickIndex);
+        return;
+    }
     
     if(isRenderingPickingImage){
         setPickColor(pickIndex);
@@ -2834,7 +3351,8 @@ void GLSLSceneRenderer::Impl::renderPlot
  const std::function<SgVertexArrayPtr()>& getVertices, std::function<bool()> setupShaderProgram)
 {
     VertexResource* resource = getOrCreateVertexResource(plot);
-    if(!resource->isValid()){
+    // The vertex buffer is not necessary for the picking by ray casting
+    if(!isRayCastingForPicking && !resource->isValid()){
         glBindVertexArray(resource->vao);
         SgVertexArrayPtr vertices = getVertices();
         const size_t n = vertices->size();
@@ -2919,6 +3437,11 @@ void GLSLSceneRenderer::Impl::renderPlotMain
 (SgPlot* plot, GLenum primitiveMode, VertexResource* resource, const Affine3& modelTransform, int pickIndex,
  const std::function<bool()>& setupShaderProgram)
 {
+    if(isRayCastingForPicking){
+        castRayToPlot(plot, primitiveMode, resource, modelTransform, pickIndex);
+        return;
+    }
+
     bool pushed = setupShaderProgram();
     
     if(isRenderingPickingImage){
@@ -91,6 +91,8 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
 
     void setLowMemoryConsumptionMode(bool on);
 
+    virtual bool isRayCastPickingEnabled() const override;
+    virtual void setRayCastPickingEnabled(bool on) override;
     virtual void setPickingImageOutputEnabled(bool on) override;
     virtual bool getPickingImage(Image& out_image) override;
 
@@ -310,6 +310,18 @@ bool GLSceneRenderer::unproject(double x, double y, double z, Vector3& out_proje
 }
 
 
+bool GLSceneRenderer::isRayCastPickingEnabled() const
+{
+    return false;
+}
+
+
+void GLSceneRenderer::setRayCastPickingEnabled(bool)
+{
+
+}
+
+
 void GLSceneRenderer::setPickingImageOutputEnabled(bool)
 {
 
@@ -119,6 +119,14 @@ public:
 
     virtual void setBoundingBoxRenderingForLightweightRenderingGroupEnabled(bool on);
 
+    /**
+       The picking is resolved by casting the ray to the scene on the CPU if the ray casting
+       picking is enabled and it is supported by the renderer. Otherwise the picking image is
+       rendered to resolve the picking.
+    */
+    virtual bool isRayCastPickingEnabled() const;
+    virtual void setRayCastPickingEnabled(bool on);
+
     virtual void setPickingImageOutputEnabled(bool on);
     virtual bool getPickingImage(Image& out_image);
 
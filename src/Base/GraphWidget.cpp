@@ -47,6 +47,165 @@ struct EditHistory
 typedef std::shared_ptr<EditHistory> EditHistoryPtr;
 typedef deque<EditHistoryPtr> EditHistoryList;
 
+/**
+   The pyramid of the minimum and maximum values of a sequence.
+   The level k consists of the blocks of 2^(k + BaseShift) frames, and the extreme values of any
+   frame range can be obtained by visiting O(log n) blocks instead of all the frames in the range.
+   The blocks overlapping the invalidated frames are recalculated by the update function.
+*/
+class MinMaxPyramid
+{
+public:
+    struct Block {
+        double min;
+        double max;
+        int minFrame;
+        int maxFrame;
+    };
+
+    static constexpr int BaseShift = 3;
+
+    MinMaxPyramid() {
+        invalidateAll();
+    }
+
+    void invalidate(int frameBegin, int frameEnd) {
+        dirtyBegin = std::min(dirtyBegin, std::max(frameBegin, 0));
+        dirtyEnd = std::max(dirtyEnd, frameEnd);
+    }
+
+    void invalidateAll() {
+        dirtyBegin = 0;
+        dirtyEnd = std::numeric_limits<int>::max();
+    }
+
+    template<class ValueFunction>
+    void update(int numFrames, ValueFunction value);
+
+    template<class ValueFunction>
+    void getMinMax(int frameBegin, int frameEnd, ValueFunction value, Block& out_block) const;
+
+private:
+    vector<vector<Block>> levels;
+    int dirtyBegin;
+    int dirtyEnd;
+};
+
+
+template<class ValueFunction>
+void MinMaxPyramid::update(int numFrames, ValueFunction value)
+{
+    const int begin = dirtyBegin;
+    const int end = std::min(dirtyEnd, numFrames);
+    
+    int level = 0;
+    int numBlocks = numFrames >> BaseShift;
+    while(numBlocks > 0){
+        if(level == static_cast<int>(levels.size())){
+            levels.emplace_back();
+        }
+        auto& blocks = levels[level];
+        const int orgNumBlocks = blocks.size();
+        blocks.resize(numBlocks);
+
+        const int shift = BaseShift + level;
+        int first = begin >> shift;
+        int last = (begin < end) ? (((end - 1) >> shift) + 1) : first;
+        if(orgNumBlocks < numBlocks){
+            first = std::min(first, orgNumBlocks);
+            last = numBlocks;
+        }
+        last = std::min(last, numBlocks);
+
+        for(int i = first; i < last; ++i){
+            Block& block = blocks[i];
+            if(level == 0){
+                int frame = i << BaseShift;
+                const int next = frame + (1 << BaseShift);
+                block.min = block.max = value(frame);
+                block.minFrame = block.maxFrame = frame;
+                while(++frame < next){
+                    const double v = value(frame);
+                    if(v < block.min){
+                        block.min = v;
+                        block.minFrame = frame;
+                    } else if(v > block.max){
+                        block.max = v;
+                        block.maxFrame = frame;
+                    }
+                }
+            } else {
+                const Block& b0 = levels[level - 1][i * 2];
+                const Block& b1 = levels[level - 1][i * 2 + 1];
+                block = b0;
+                if(b1.min < block.min){
+                    block.min = b1.min;
+                    block.minFrame = b1.minFrame;
+                }
+                if(b1.max > block.max){
+                    block.max = b1.max;
+                    block.maxFrame = b1.maxFrame;
+                }
+            }
+        }
+        numBlocks >>= 1;
+        ++level;
+    }
+    levels.resize(level);
+
+    dirtyBegin = std::numeric_limits<int>::max();
+    dirtyEnd = 0;
+}
+
+
+template<class ValueFunction>
+void MinMaxPyramid::getMinMax(int frameBegin, int frameEnd, ValueFunction value, Block& out_block) const
+{
+    out_block.min = std::numeric_limits<double>::max();
+    out_block.max = -std::numeric_limits<double>::max();
+    out_block.minFrame = out_block.maxFrame = frameBegin;
+
+    const int numLevels = levels.size();
+    int frame = frameBegin;
+    while(frame < frameEnd){
+        // Find the largest block which begins at the frame and is contained in the range
+        int level = -1;
+        for(int i = numLevels - 1; i >= 0; --i){
+            const int shift = BaseShift + i;
+            const int size = 1 << shift;
+            if((frame & (size - 1)) == 0 && frame + size <= frameEnd &&
+               (frame >> shift) < static_cast<int>(levels[i].size())){
+                level = i;
+                break;
+            }
+        }
+        if(level < 0){
+            const double v = value(frame);
+            if(v < out_block.min){
+                out_block.min = v;
+                out_block.minFrame = frame;
+            }
+            if(v > out_block.max){
+                out_block.max = v;
+                out_block.maxFrame = frame;
+            }
+            ++frame;
+        } else {
+            const int shift = BaseShift + level;
+            const Block& block = levels[level][frame >> shift];
+            if(block.min < out_block.min){
+                out_block.min = block.min;
+                out_block.minFrame = block.minFrame;
+            }
+            if(block.max > out_block.max){
+                out_block.max = block.max;
+                out_block.maxFrame = block.maxFrame;
+            }
+            frame += (1 << shift);
+        }
+    }
+}
+
 }
 
 namespace cnoid {
@@ -66,8 +225,15 @@ public:
     */
     vector<double> values;
     int numFrames; // the actual number of frames (values.size() - 2)
+
+    // The buffer to receive the data to detect the modified frames
+    vector<double> requestBuffer;
+
+    MinMaxPyramid valuePyramid;
+    MinMaxPyramid velocityPyramid;
         
-    int prevNumValues;
+    // True when the number of frames, the frame rate or the offset is changed after the last update
+    bool isDomainChanged;
     double offset;
     double stepRatio;
     double lowerValueLimit;
@@ -87,6 +253,12 @@ public:
 
     GraphDataHandler::DataRequestCallback dataRequestCallback;
     GraphDataHandler::DataModifiedCallback dataModifiedCallback;
+
+    void invalidatePyramids(int frameBegin, int frameEnd) {
+        valuePyramid.invalidate(frameBegin, frameEnd);
+        // The velocity of a frame depends on the values of the adjacent frames
+        velocityPyramid.invalidate(frameBegin - 1, frameEnd + 1);
+    }
 };
 
 class GraphWidgetImpl
@@ -229,6 +401,10 @@ public:
     void selectEditTargetByClicking(double screenX, double screenY);
     bool onScreenPaintEvent(QPaintEvent* event);
     void drawTrajectory(QPainter& painter, const QRect& rect, GraphDataHandlerImpl* data);
+    template<class ValueFunction>
+    void drawMinMaxPolyline(
+        const MinMaxPyramid& pyramid, ValueFunction value, int frame, int frame_begin, int frame_end,
+        double screenOffsetX, double xratio);
     void drawLimits(QPainter& painter, GraphDataHandlerImpl* data);
     void updateControlPoints(GraphDataHandlerImpl* data);
     void drawGrid(QPainter& painter);
@@ -261,6 +437,8 @@ GraphDataHandlerImpl::GraphDataHandlerImpl()
     lowerVelocityLimit = -std::numeric_limits<double>::max();
     upperVelocityLimit =  std::numeric_limits<double>::max();
 
+    numFrames = 0;
+    isDomainChanged = true;
     isControlPointUpdateNeeded = true;
 
     currentHistory = 0;
@@ -289,6 +467,17 @@ void GraphDataHandler::setLabel(const std::string& label)
 
 void GraphDataHandler::setFrameProperties(int numFrames, double frameRate, double offset)
 {
+    if(numFrames != impl->numFrames){
+        // The last frame is also invalidated because its velocity depends on the padding element
+        impl->invalidatePyramids(
+            std::min(numFrames, impl->numFrames) - 1, std::max(numFrames, impl->numFrames));
+    }
+    if(1.0 / frameRate != impl->stepRatio){
+        impl->velocityPyramid.invalidateAll();
+    }
+    if(numFrames != impl->numFrames || 1.0 / frameRate != impl->stepRatio || offset != impl->offset){
+        impl->isDomainChanged = true;
+    }
     impl->values.resize(numFrames + 2);
     impl->numFrames = numFrames;
     impl->stepRatio = 1.0 / frameRate;
@@ -527,14 +716,38 @@ void GraphWidgetImpl::updateData(GraphDataHandlerPtr handler)
     
     GraphDataHandlerImpl* data = handler->impl;
 
-    if(data->prevNumValues != data->numFrames){
+    if(data->isDomainChanged){
         isReconfigurationNeeded = true;
         isDomainUpdateNeeded = true;
+        data->isDomainChanged = false;
     }
     
     if(data->dataRequestCallback){
-        vector<double>& values = data->values;
-        data->dataRequestCallback(0, data->numFrames, &(values[1]));
+        /*
+          All the frames have to be requested because the item update does not tell which frames
+          are modified, and a regenerated sequence may change the earlier frames while it grows.
+          Only the modified frames are copied to the values so that the min/max pyramids are updated
+          incrementally, and the cost of a repaint does not depend on the number of frames.
+        */
+        const int n = data->numFrames;
+        auto& buf = data->requestBuffer;
+        buf.resize(n);
+        if(n > 0){
+            data->dataRequestCallback(0, n, &buf[0]);
+        }
+        double* values = &data->values[1];
+        int begin = 0;
+        while(begin < n && values[begin] == buf[begin]){
+            ++begin;
+        }
+        if(begin < n){
+            int end = n;
+            while(values[end - 1] == buf[end - 1]){
+                --end;
+            }
+            std::copy(buf.begin() + begin, buf.begin() + end, values + begin);
+            data->invalidatePyramids(begin, end);
+        }
     }
     screen->update();
 }
@@ -1402,6 +1615,7 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
     if(editMode == GraphWidget::LINE_MODE){
         EditHistoryPtr& history = editTarget->editHistories.back();
         std::copy(history->orgValues.begin(), history->orgValues.end(), &values[history->frame]);
+        editTarget->invalidatePyramids(history->frame, history->frame + history->orgValues.size());
     }
 
     if(frameBegin < frameEnd){
@@ -1442,6 +1656,8 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
             }
         }
 
+        editTarget->invalidatePyramids(frameBegin, frameEnd);
+
         editedFrameBegin = std::min(editedFrameBegin, frameBegin);
         editedFrameEnd = std::max(editedFrameEnd, frameEnd);
 
@@ -1502,6 +1718,7 @@ void GraphWidgetImpl::undoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->orgValues.begin(), history->orgValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidatePyramids(history->frame, history->frame + history->orgValues.size());
             editTarget->dataModifiedCallback(history->frame, history->orgValues.size(), &history->orgValues[0]);
             screen->update();
         }
@@ -1518,6 +1735,7 @@ void GraphWidgetImpl::redoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->newValues.begin(), history->newValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidatePyramids(history->frame, history->frame + history->newValues.size());
             editTarget->dataModifiedCallback(history->frame, history->newValues.size(), &history->newValues[0]);
             currentHistory++;
             screen->update();
@@ -1699,37 +1917,10 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = calcVelocity(frame++, values, stepRatio2);
-                    double max = min;
-                    while(frame < next){
-                        const double v = calcVelocity(frame, values, stepRatio2);
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                        frame++;
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                auto velocity = [&](int f){ return calcVelocity(f, values, stepRatio2); };
+                data->velocityPyramid.update(numFrames, velocity);
+                drawMinMaxPolyline(
+                    data->velocityPyramid, velocity, frame, frame_begin, frame_end, screenOffsetX, xratio);
             }
 
             painter.drawPolyline(polyline);
@@ -1755,35 +1946,10 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = values[frame++];
-                    double max = min;
-                    while(frame < next){
-                        const double v = values[frame++];
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                auto value = [values](int f){ return values[f]; };
+                data->valuePyramid.update(numFrames, value);
+                drawMinMaxPolyline(
+                    data->valuePyramid, value, frame, frame_begin, frame_end, screenOffsetX, xratio);
             }
 
             painter.drawPolyline(polyline);
@@ -1811,6 +1977,39 @@ void GraphWidgetImpl::drawTrajectory
 }
 
 
+/**
+   Set the polyline which connects the minimum and maximum values of the frames in each pixel.
+   The min/max values are obtained from the pyramid so that the cost does not depend on the
+   number of the frames in a pixel.
+*/
+template<class ValueFunction>
+void GraphWidgetImpl::drawMinMaxPolyline
+(const MinMaxPyramid& pyramid, ValueFunction value, int frame, int frame_begin, int frame_end,
+ double screenOffsetX, double xratio)
+{
+    const int m = (int)(0.5 / xratio);
+    const int n = ceil(double(frame_end - frame) / m);
+    polyline.resize(n * 2);
+    MinMaxPyramid::Block block;
+    for(int i=0; i < n; ++i){
+        const int next = std::min(frame + m, frame_end);
+        pyramid.getMinMax(frame, next, value, block);
+        frame = next;
+        const double px_min = screenOffsetX + (block.minFrame - frame_begin) * xratio;
+        const double px_max = screenOffsetX + (block.maxFrame - frame_begin) * xratio;
+        const double upper = screenCenterY - (block.max + centerY) * scaleY;
+        const double lower = screenCenterY - (block.min + centerY) * scaleY;
+        if(px_min <= px_max){
+            polyline[i*2] = QPointF(px_min, lower);
+            polyline[i*2+1] = QPointF(px_max, upper);
+        } else {
+            polyline[i*2] = QPointF(px_max, upper);
+            polyline[i*2+1] = QPointF(px_min, lower);
+        }
+    }
+}
+
+
 void GraphWidgetImpl::updateControlPoints(GraphDataHandlerImpl* data)
 {
     if(data->isControlPointUpdateNeeded){
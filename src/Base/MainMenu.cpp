@@ -102,6 +102,7 @@ void MainMenu::setMenuItems()
     
     mm.setPath(N_("Project File Options"));
     setActionAsProjectLayoutToggle(mm.addCheckItem(_("Layout")));
+    setActionAsProjectBinaryDataStorageToggle(mm.addCheckItem(_("Binary Data File")));
     setActionAsShowPathVariableEditor(mm.addItem(_("Edit Path Variables")));
 
     mm.goBackToUpperMenu().addSeparator();
@@ -333,6 +334,14 @@ void MainMenu::setActionAsProjectLayoutToggle(Action* action)
 }
 
 
+void MainMenu::setActionAsProjectBinaryDataStorageToggle(Action* action)
+{
+    static_cast<Menu*>(action->parentWidget())->sigAboutToShow().connect(
+        [action](){ action->setChecked(ProjectManager::instance()->isBinaryDataStorageMode()); });
+    action->sigToggled().connect([](bool on){ ProjectManager::instance()->setBinaryDataStorageMode(on); });
+}
+
+
 void MainMenu::setActionAsShowPathVariableEditor(Action* action)
 {
     action->sigTriggered().connect([](){ PathVariableEditor::instance()->show(); });
@@ -65,6 +65,7 @@ protected:
     void setActionAsSaveProject(Action* action);
     void setActionAsSaveProjectAs(Action* action);
     void setActionAsProjectLayoutToggle(Action* action);
+    void setActionAsProjectBinaryDataStorageToggle(Action* action);
     void setActionAsShowPathVariableEditor(Action* action);
     void setActionAsExitApplication(Action* action);
     void setActionAsUndo(Action* action);
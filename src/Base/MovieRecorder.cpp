@@ -17,11 +17,13 @@
 #include <QPainter>
 #include <QProgressDialog>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <fmt/format.h>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <algorithm>
 #include <cstdlib>
 
 // For the mouse cursor capture
@@ -83,6 +85,14 @@ public:
     bool isImageSizeSpecified;
     int imageWidth;
     int imageHeight;
+    bool isOffscreenRenderingEnabled;
+    bool isRenderingOffscreen;
+    int offscreenImageWidth;
+    int offscreenImageHeight;
+    int numEncodingThreads;
+    string encodingPreset;
+    int maxNumQueuedFrames;
+    int numDroppedFrames;
 
     Signal<void(bool on)> sigRecordingStateChanged;
     Signal<void()> sigRecordingConfigurationChanged;
@@ -134,6 +144,7 @@ public:
     void onTargetViewRemoved(View* view);
     void setCurrentEncoder(int index, bool doNotify);
     void setCurrentEncoderByFormatName(const std::string& formatName, bool doNotify);
+    void resetUnsupportedEncodingPreset();
     
     bool startRecording();
     bool initializeRecording();
@@ -213,6 +224,11 @@ MovieRecorder::Impl::Impl(MovieRecorder* self)
     isImageSizeSpecified = false;
     imageWidth = 640;
     imageHeight = 480;
+    isOffscreenRenderingEnabled = false;
+    isRenderingOffscreen = false;
+    numEncodingThreads = 0;
+    maxNumQueuedFrames = 60;
+    numDroppedFrames = 0;
 
     targetView = nullptr;
 
@@ -456,6 +472,7 @@ void MovieRecorder::Impl::setCurrentEncoder(int index, bool doNotify)
     if(index < encoders.size()){
         currentEncoder = encoders[index];
         currentEncoderIndex = index;
+        resetUnsupportedEncodingPreset();
         if(doNotify){
             sigRecordingConfigurationChanged();
         }
@@ -474,6 +491,22 @@ void MovieRecorder::Impl::setCurrentEncoderByFormatName(const std::string& forma
 }
 
 
+/**
+   The presets depend on the encoder, and an encoder such as libopenh264 does not accept the presets
+   of another encoder. The preset is reset to the default one when the current encoder is switched to
+   an encoder that does not support it. Note that the preset restored from the configuration must not
+   be reset here before the encoders are added.
+*/
+void MovieRecorder::Impl::resetUnsupportedEncodingPreset()
+{
+    if(currentEncoder && !encodingPreset.empty()){
+        if(!currentEncoder->isEncodingPresetSupported(encodingPreset)){
+            encodingPreset.clear();
+        }
+    }
+}
+
+
 std::string MovieRecorder::outputDirectory() const
 {
     return impl->directory;
@@ -589,6 +622,60 @@ void MovieRecorder::setImageSize(int width, int height)
 }
 
 
+int MovieRecorder::numEncodingThreads() const
+{
+    return impl->numEncodingThreads;
+}
+
+
+void MovieRecorder::setNumEncodingThreads(int n)
+{
+    impl->numEncodingThreads = std::max(n, 0);
+}
+
+
+std::string MovieRecorder::encodingPreset() const
+{
+    return impl->encodingPreset;
+}
+
+
+void MovieRecorder::setEncodingPreset(const std::string& preset)
+{
+    impl->encodingPreset = preset;
+}
+
+
+int MovieRecorder::maxNumQueuedFrames() const
+{
+    return impl->maxNumQueuedFrames;
+}
+
+
+void MovieRecorder::setMaxNumQueuedFrames(int n)
+{
+    impl->maxNumQueuedFrames = std::max(n, 0);
+}
+
+
+int MovieRecorder::numDroppedFrames() const
+{
+    return impl->numDroppedFrames;
+}
+
+
+bool MovieRecorder::isOffscreenRenderingEnabled() const
+{
+    return impl->isOffscreenRenderingEnabled;
+}
+
+
+void MovieRecorder::setOffscreenRenderingEnabled(bool on)
+{
+    impl->isOffscreenRenderingEnabled = on;
+}
+
+
 bool MovieRecorder::isMouseCursorCaptureAvailable()
 {
     return hasMouseCursorCaptureFeature;
@@ -684,6 +771,12 @@ bool MovieRecorder::Impl::initializeRecording()
     filesystem::path basePath(dirPath / fromUTF8(fileBaseName));
     fileBasePath = toUTF8(basePath.string());
 
+    isRenderingOffscreen = (recordingMode == OfflineMode) && isOffscreenRenderingEnabled;
+    if(isRenderingOffscreen && !dynamic_cast<SceneView*>(targetView)){
+        showWarningDialog(_("Offscreen rendering is only available for a scene view."));
+        return false;
+    }
+
     int width, height;
     QSize viewSize = targetView->size();
     if(isImageSizeSpecified){
@@ -699,6 +792,7 @@ bool MovieRecorder::Impl::initializeRecording()
     }
 
     frame = 0;
+    numDroppedFrames = 0;
     requestStopRecording = false;
     timeStep = 1.0 / frameRate;
     startingTime = isStartingTimeSpecified ? specifiedStartingTime : 0.0;
@@ -707,7 +801,10 @@ bool MovieRecorder::Impl::initializeRecording()
     bool initialized = currentEncoder->initializeEncoding(width, height, frameRate);
 
     if(initialized){
-        if(isImageSizeSpecified){
+        if(isRenderingOffscreen){
+            offscreenImageWidth = width;
+            offscreenImageHeight = height;
+        } else if(isImageSizeSpecified){
             int x = (viewSize.width() - width) / 2;
             int y = (viewSize.height() - height) / 2;
             targetView->setGeometry(x, y, width, height);
@@ -738,11 +835,21 @@ bool MovieRecorder::Impl::startOfflineModeRecording()
     startBlinking();
     startEncoding();
 
+    QElapsedTimer eventTimer;
+    eventTimer.start();
+
     while(time <= finishingTime && doContinue){
 
         doContinue = timeBar->setTime(time);
 
-        QCoreApplication::processEvents();
+        /*
+          The offscreen rendering does not need the view to be repainted for each frame,
+          so the events are only processed at intervals to keep the GUI responsive.
+        */
+        if(!isRenderingOffscreen || eventTimer.elapsed() >= 100){
+            QCoreApplication::processEvents();
+            eventTimer.restart();
+        }
 
         if(requestStopRecording){
             break;
@@ -863,10 +970,31 @@ void MovieRecorder::Impl::onDirectModeTimerTimeout()
 
 void MovieRecorder::Impl::captureViewImage(bool waitForPrevOutput)
 {
+    if(!waitForPrevOutput && maxNumQueuedFrames > 0){
+        /*
+          The frame is dropped without capturing it when the encoder cannot keep up with
+          the capture so that the memory usage does not grow without bound.
+        */
+        std::lock_guard<std::mutex> lock(imageQueueMutex);
+        if(static_cast<int>(capturedImages.size()) >= maxNumQueuedFrames){
+            ++numDroppedFrames;
+            return;
+        }
+    }
+    
     CapturedImagePtr captured = new CapturedImage;
     captured->frame = frame;
     
-    if(SceneView* sceneView = dynamic_cast<SceneView*>(targetView)){
+    if(isRenderingOffscreen){
+        auto sceneView = static_cast<SceneView*>(targetView);
+        captured->image = sceneView->sceneWidget()->renderOffscreenImage(offscreenImageWidth, offscreenImageHeight);
+        if(stdx::get<QImage>(captured->image).isNull()){
+            mv->putln(_("The scene cannot be rendered offscreen because the view has not been shown yet."),
+                      MessageView::Error);
+            requestStopRecording = true;
+            return;
+        }
+    } else if(SceneView* sceneView = dynamic_cast<SceneView*>(targetView)){
         captured->image = sceneView->sceneWidget()->getImage();
         if(isMouseCursorCaptureEnabled){
             QPainter painter(&stdx::get<QImage>(captured->image));
@@ -886,7 +1014,15 @@ void MovieRecorder::Impl::captureViewImage(bool waitForPrevOutput)
     {
         std::unique_lock<std::mutex> lock(imageQueueMutex);
         if(waitForPrevOutput){
-            while(!capturedImages.empty()){
+            /*
+              In the offscreen rendering, the rendering of the next frame is overlapped with
+              the encoding of the queued frames as long as the queue has room.
+            */
+            size_t maxSize = 0;
+            if(isRenderingOffscreen && maxNumQueuedFrames > 1){
+                maxSize = maxNumQueuedFrames - 1;
+            }
+            while(capturedImages.size() > maxSize){
                 imageQueueCondition.wait(lock);
             }
         }
@@ -1059,8 +1195,17 @@ void MovieRecorder::Impl::stopRecording(bool isFinished)
         } else {
             mv->putln(fmt::format(_("Recording of {} has been stopped."), viewName));
         }
+        if(numDroppedFrames > 0){
+            mv->putln(
+                fmt::format(_("{0} of {1} frames were dropped because the encoding could not keep up with the capture."),
+                            numDroppedFrames, frame),
+                MessageView::Warning);
+        }
 
-        targetView->updateGeometry();
+        if(!isRenderingOffscreen){
+            targetView->updateGeometry();
+        }
+        isRenderingOffscreen = false;
 
         sigRecordingStateChanged(false);
     }
@@ -1181,6 +1326,10 @@ void MovieRecorder::Impl::store(Mapping* archive)
     if(hasMouseCursorCaptureFeature){
         archive->write("mouseCursor", isMouseCursorCaptureEnabled);
     }
+    archive->write("encodingThreads", numEncodingThreads);
+    archive->write("encodingPreset", encodingPreset, DOUBLE_QUOTED);
+    archive->write("maxQueuedFrames", maxNumQueuedFrames);
+    archive->write("offscreen", isOffscreenRenderingEnabled);
 }
 
 
@@ -1216,6 +1365,10 @@ void MovieRecorder::Impl::restore(const Mapping* archive)
     if(hasMouseCursorCaptureFeature){
         archive->read("mouseCursor", isMouseCursorCaptureEnabled);
     }
+    archive->read("encodingThreads", numEncodingThreads);
+    archive->read("encodingPreset", encodingPreset);
+    archive->read("maxQueuedFrames", maxNumQueuedFrames);
+    archive->read("offscreen", isOffscreenRenderingEnabled);
 
     updateViewMarker();
     sigRecordingConfigurationChanged();
@@ -1270,6 +1423,35 @@ bool MovieRecorderEncoder::initializeEncoding
 }
 
 
+std::vector<std::string> MovieRecorderEncoder::encodingPresets() const
+{
+    return std::vector<std::string>();
+}
+
+
+int MovieRecorderEncoder::numEncodingThreads() const
+{
+    return recorderImpl->numEncodingThreads;
+}
+
+
+bool MovieRecorderEncoder::isEncodingPresetSupported(const std::string& preset) const
+{
+    auto presets = encodingPresets();
+    return std::find(presets.begin(), presets.end(), preset) != presets.end();
+}
+
+
+std::string MovieRecorderEncoder::encodingPreset() const
+{
+    auto& preset = recorderImpl->encodingPreset;
+    if(!preset.empty() && isEncodingPresetSupported(preset)){
+        return preset;
+    }
+    return std::string();
+}
+
+
 MovieRecorderEncoder::CapturedImagePtr MovieRecorderEncoder::getNextFrameImage()
 {
     return recorderImpl->getNextFrameImage();
@@ -57,6 +57,40 @@ public:
     int imageHeight() const;
     void setImageSize(int width, int height);
 
+    /**
+       The number of the threads used for encoding. The value 0 means that the number is
+       determined automatically.
+    */
+    int numEncodingThreads() const;
+    void setNumEncodingThreads(int n);
+
+    /**
+       The speed preset of the encoder. An empty string means the default preset of the encoder.
+       The preset is reset to the empty string when the current encoder is switched to an encoder
+       that does not support it, and the default preset is used for recording in the same case.
+    */
+    std::string encodingPreset() const;
+    void setEncodingPreset(const std::string& preset);
+
+    /**
+       The maximum number of the captured frames waiting for encoding in the online and direct modes.
+       New frames are dropped while the queue is full. The value 0 means that the queue is not bounded.
+    */
+    int maxNumQueuedFrames() const;
+    void setMaxNumQueuedFrames(int n);
+
+    //! The number of the frames dropped in the current or last recording
+    int numDroppedFrames() const;
+
+    /**
+       When this is enabled, the offline mode renders the scene of the target scene view into an
+       offscreen frame buffer instead of grabbing the widget. The frames are then rendered at the
+       specified image size as fast as the encoder can consume them, regardless of the size and
+       visibility of the view.
+    */
+    bool isOffscreenRenderingEnabled() const;
+    void setOffscreenRenderingEnabled(bool on);
+
     static bool isMouseCursorCaptureAvailable();
     bool isMouseCursorCaptureEnabled() const;
     void setMouseCursorCaptureEnabled(bool on);
@@ -90,9 +124,17 @@ public:
     virtual bool initializeEncoding(int width, int height, int frameRate);
     virtual bool doEncoding(std::string fileBasename) = 0;
 
+    //! The speed presets that can be specified by MovieRecorder::setEncodingPreset
+    virtual std::vector<std::string> encodingPresets() const;
+    bool isEncodingPresetSupported(const std::string& preset) const;
+
 protected:
     MovieRecorderEncoder();
 
+    int numEncodingThreads() const;
+    //! The preset of the recorder, or an empty string when this encoder does not support it
+    std::string encodingPreset() const;
+
     class CapturedImage : public Referenced
     {
     public:
@@ -2,6 +2,9 @@
 #include "MovieRecorder.h"
 #include "MovieRecorderDialog.h"
 #include "ExtensionManager.h"
+#include "OptionManager.h"
+#include "LazyCaller.h"
+#include "App.h"
 #include "gettext.h"
 
 using namespace std;
@@ -14,10 +17,33 @@ MovieRecorderBar* MovieRecorderBar::instance_ = nullptr;
 }
 
 
+static void onSigOptionsParsed(boost::program_options::variables_map& v)
+{
+    if(v.count("record-movie")){
+        callLater(
+            [](){
+                auto recorder = MovieRecorder::instance();
+                auto mode = recorder->recordingMode();
+                bool isOffscreen = recorder->isOffscreenRenderingEnabled();
+                recorder->setRecordingMode(MovieRecorder::OfflineMode);
+                recorder->setOffscreenRenderingEnabled(true);
+                recorder->startRecording();
+                recorder->setRecordingMode(mode);
+                recorder->setOffscreenRenderingEnabled(isOffscreen);
+                App::exit();
+            });
+    }
+}
+
+
 void MovieRecorderBar::initializeClass(ExtensionManager* ext)
 {
     instance_ = new MovieRecorderBar;
     ext->addToolBar(instance_);
+
+    ext->optionManager()
+        .addOption("record-movie", "record a movie of the target view in the offline mode with the offscreen rendering and exit")
+        .sigOptionsParsed(1).connect(onSigOptionsParsed);
 }
 
 
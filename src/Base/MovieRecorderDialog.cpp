@@ -99,6 +99,7 @@ MovieRecorderDialog::MovieRecorderDialog()
                 auto block = recorderConfConnection.scopedBlock();
                 int encoderIndex = encoderCombo->currentData().toInt();
                 recorder_->setCurrentEncoder(encoderIndex);
+                updatePresetCombo();
             }));
     hbox->addWidget(encoderCombo);
     hbox->addStretch();
@@ -241,6 +242,61 @@ MovieRecorderDialog::MovieRecorderDialog()
                 recorder_->setImageSize(imageWidthSpin->value(), height);
             }));
     hbox->addWidget(imageHeightSpin);
+    hbox->addSpacing(4);
+
+    offscreenCheck = new CheckBox(_("Offscreen rendering"), this);
+    offscreenCheck->setToolTip(
+        _("Render the frames of the offline mode offscreen at the image size without waiting for the display."));
+    widgetConnections.add(
+        offscreenCheck->sigToggled().connect(
+            [this](bool on){
+                auto block = recorderConfConnection.scopedBlock();
+                recorder_->setOffscreenRenderingEnabled(on);
+            }));
+    hbox->addWidget(offscreenCheck);
+    hbox->addStretch();
+    vbox->addLayout(hbox);
+
+    hbox = new QHBoxLayout;
+    hbox->addWidget(new QLabel(_("Encoding threads")));
+    encodingThreadsSpin = new SpinBox(this);
+    encodingThreadsSpin->setRange(0, 64);
+    encodingThreadsSpin->setSpecialValueText(_("Auto"));
+    widgetConnections.add(
+        encodingThreadsSpin->sigValueChanged().connect(
+            [this](int n){
+                auto block = recorderConfConnection.scopedBlock();
+                recorder_->setNumEncodingThreads(n);
+            }));
+    hbox->addWidget(encodingThreadsSpin);
+    hbox->addSpacing(4);
+
+    presetLabel = new QLabel(_("Preset"));
+    hbox->addWidget(presetLabel);
+    presetCombo = new ComboBox(this);
+    widgetConnections.add(
+        presetCombo->sigCurrentIndexChanged().connect(
+            [this](int index){
+                auto block = recorderConfConnection.scopedBlock();
+                recorder_->setEncodingPreset(presetCombo->currentData().toString().toStdString());
+            }));
+    hbox->addWidget(presetCombo);
+    hbox->addSpacing(4);
+
+    hbox->addWidget(new QLabel(_("Max queued frames")));
+    maxQueuedFramesSpin = new SpinBox(this);
+    maxQueuedFramesSpin->setRange(0, 9999);
+    maxQueuedFramesSpin->setSpecialValueText(_("Unlimited"));
+    maxQueuedFramesSpin->setToolTip(
+        _("Frames captured in the online and direct modes are dropped while this number of frames "
+          "are waiting for encoding."));
+    widgetConnections.add(
+        maxQueuedFramesSpin->sigValueChanged().connect(
+            [this](int n){
+                auto block = recorderConfConnection.scopedBlock();
+                recorder_->setMaxNumQueuedFrames(n);
+            }));
+    hbox->addWidget(maxQueuedFramesSpin);
     hbox->addStretch();
     vbox->addLayout(hbox);
 
@@ -408,6 +464,7 @@ void MovieRecorderDialog::updateWidgetsWithRecorderConfigurations()
         auto block = recorderConfConnection.scopedBlock();
         recorder_->setCurrentEncoder(validEncoderIndex);
     }
+    updatePresetCombo();
 
     directoryEntry->blockSignals(true);
     directoryEntry->setText(recorder_->outputDirectory().c_str());
@@ -435,6 +492,10 @@ void MovieRecorderDialog::updateWidgetsWithRecorderConfigurations()
     imageWidthSpin->setValue(recorder_->imageWidth());
     imageHeightSpin->setEnabled(isImageSizeSpecified);
     imageHeightSpin->setValue(recorder_->imageHeight());
+    offscreenCheck->setChecked(recorder_->isOffscreenRenderingEnabled());
+
+    encodingThreadsSpin->setValue(recorder_->numEncodingThreads());
+    maxQueuedFramesSpin->setValue(recorder_->maxNumQueuedFrames());
 
     if(MovieRecorder::isMouseCursorCaptureAvailable()){
         mouseCursorCheck->setChecked(recorder_->isMouseCursorCaptureEnabled());
@@ -480,6 +541,33 @@ void MovieRecorderDialog::updateViewCombo()
 }
 
 
+void MovieRecorderDialog::updatePresetCombo()
+{
+    presetCombo->blockSignals(true);
+
+    presetCombo->clear();
+    vector<string> presets;
+    int encoderIndex = recorder_->currentEncoderIndex();
+    auto encoders = recorder_->encoders();
+    if(encoderIndex >= 0 && encoderIndex < static_cast<int>(encoders.size())){
+        presets = encoders[encoderIndex]->encodingPresets();
+    }
+    presetCombo->addItem(_("Default"), QString());
+    auto currentPreset = recorder_->encodingPreset();
+    for(auto& preset : presets){
+        presetCombo->addItem(preset.c_str(), QString(preset.c_str()));
+        if(preset == currentPreset){
+            presetCombo->setCurrentIndex(presetCombo->count() - 1);
+        }
+    }
+    bool hasPresets = !presets.empty();
+    presetLabel->setVisible(hasPresets);
+    presetCombo->setVisible(hasPresets);
+
+    presetCombo->blockSignals(false);
+}
+
+
 void MovieRecorderDialog::onTargetViewComboIndexChanged(int index)
 {
     auto block = recorderConfConnection.scopedBlock();
@@ -47,6 +47,7 @@ protected:
 private:
     void updateWidgetsWithRecorderConfigurations();
     void updateViewCombo();
+    void updatePresetCombo();
     void onTargetViewComboIndexChanged(int index);
     void onRecordingStateChanged(bool on);
     void onRecordingButtonToggled(bool on);
@@ -79,6 +80,11 @@ private:
     CheckBox* imageSizeCheck;
     SpinBox* imageWidthSpin;
     SpinBox* imageHeightSpin;
+    CheckBox* offscreenCheck;
+    SpinBox* encodingThreadsSpin;
+    ComboBox* presetCombo;
+    QLabel* presetLabel;
+    SpinBox* maxQueuedFramesSpin;
     CheckBox* mouseCursorCheck;
     ToggleButton* recordingToggle;
 };
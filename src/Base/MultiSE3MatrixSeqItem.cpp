@@ -18,6 +18,18 @@ template<> void MultiSeqItem<MultiSE3MatrixSeq>::initializeClass(ExtensionManage
         new MultiSeqItemCreationPanel(_("Number of SE3 values in a frame")));
 }
 
+
+template<> bool MultiSeqItem<MultiSE3MatrixSeq>::storeSeqAsBinaryData(Archive& archive)
+{
+    return storeElementsAsBinaryData(archive);
+}
+
+
+template<> bool MultiSeqItem<MultiSE3MatrixSeq>::restoreSeqFromBinaryData(const Archive& archive)
+{
+    return restoreElementsFromBinaryData(archive);
+}
+
 #ifdef _WIN32
 template class MultiSeqItem<MultiSE3MatrixSeq>;
 #endif
@@ -15,6 +15,8 @@ typedef MultiSeqItem<MultiSE3MatrixSeq> MultiSE3MatrixSeqItem;
 typedef MultiSE3MatrixSeqItem::Ptr MultiSE3MatrixSeqItemPtr;
 
 template<> void MultiSeqItem<MultiSE3MatrixSeq>::initializeClass(ExtensionManager* ext);
+template<> bool MultiSeqItem<MultiSE3MatrixSeq>::storeSeqAsBinaryData(Archive& archive);
+template<> bool MultiSeqItem<MultiSE3MatrixSeq>::restoreSeqFromBinaryData(const Archive& archive);
 
 }
 
@@ -18,6 +18,18 @@ template<> void MultiSeqItem<MultiSE3Seq>::initializeClass(ExtensionManager* ext
         new MultiSeqItemCreationPanel(_("Number of SE3 values in a frame")));
 }
 
+
+template<> bool MultiSeqItem<MultiSE3Seq>::storeSeqAsBinaryData(Archive& archive)
+{
+    return storeElementsAsBinaryData(archive);
+}
+
+
+template<> bool MultiSeqItem<MultiSE3Seq>::restoreSeqFromBinaryData(const Archive& archive)
+{
+    return restoreElementsFromBinaryData(archive);
+}
+
 #ifdef _WIN32
 template class MultiSeqItem<MultiSE3Seq>;
 #endif
@@ -15,6 +15,8 @@ typedef MultiSeqItem<MultiSE3Seq> MultiSE3SeqItem;
 typedef MultiSE3SeqItem::Ptr MultiSE3SeqItemPtr;
 
 template<> void MultiSeqItem<MultiSE3Seq>::initializeClass(ExtensionManager* ext);
+template<> bool MultiSeqItem<MultiSE3Seq>::storeSeqAsBinaryData(Archive& archive);
+template<> bool MultiSeqItem<MultiSE3Seq>::restoreSeqFromBinaryData(const Archive& archive);
 
 }
 
@@ -7,7 +7,10 @@
 #define CNOID_BASE_MULTI_SEQ_ITEM_H
 
 #include "AbstractSeqItem.h"
+#include "Archive.h"
 #include <cnoid/MultiSeq>
+#include <vector>
+#include <cstring>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -48,6 +51,54 @@ protected:
         return new MultiSeqItem<MultiSeqType>(*this);
     }
 
+    /**
+       The binary data storage is enabled by specializing these functions with the following
+       functions for the sequence types whose elements can be copied as raw memory.
+    */
+    virtual bool storeSeqAsBinaryData(Archive& /* archive */) override { return false; }
+    virtual bool restoreSeqFromBinaryData(const Archive& /* archive */) override { return false; }
+
+    bool storeElementsAsBinaryData(Archive& archive) {
+        typedef typename MultiSeqType::value_type Element;
+        const int numFrames = seq_->numFrames();
+        const int numParts = seq_->numParts();
+        const size_t frameSize = numParts * sizeof(Element);
+        std::vector<char> data(numFrames * frameSize);
+        for(int i=0; frameSize > 0 && i < numFrames; ++i){
+            memcpy(&data[i * frameSize], &seq_->frame(i)[0], frameSize);
+        }
+        if(!archive.writeBinaryData("seq_data", data.data(), data.size())){
+            return false;
+        }
+        archive.write("num_frames", numFrames);
+        archive.write("num_parts", numParts);
+        archive.write("frame_rate", seq_->frameRate());
+        archive.write("element_size", static_cast<int>(sizeof(Element)));
+        return true;
+    }
+
+    bool restoreElementsFromBinaryData(const Archive& archive) {
+        typedef typename MultiSeqType::value_type Element;
+        int numFrames, numParts, elementSize;
+        double frameRate;
+        if(!archive.read("num_frames", numFrames) || !archive.read("num_parts", numParts) ||
+           !archive.read("frame_rate", frameRate) || !archive.read("element_size", elementSize) ||
+           elementSize != static_cast<int>(sizeof(Element))){
+            return false;
+        }
+        std::vector<char> data;
+        const size_t frameSize = numParts * sizeof(Element);
+        if(!archive.readBinaryData("seq_data", data) || data.size() != numFrames * frameSize){
+            return false;
+        }
+        seq_->setFrameRate(frameRate);
+        seq_->setDimension(numFrames, numParts);
+        for(int i=0; frameSize > 0 && i < numFrames; ++i){
+            memcpy(reinterpret_cast<char*>(&seq_->frame(i)[0]), &data[i * frameSize], frameSize);
+        }
+        return true;
+    }
+
 private:
     std::shared_ptr<MultiSeqType> seq_;
 };
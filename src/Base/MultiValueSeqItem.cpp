@@ -48,6 +48,18 @@ template<> void MultiSeqItem<MultiValueSeq>::initializeClass(ExtensionManager* e
         ItemManager::PRIORITY_CONVERSION);
 }
 
+
+template<> bool MultiSeqItem<MultiValueSeq>::storeSeqAsBinaryData(Archive& archive)
+{
+    return storeElementsAsBinaryData(archive);
+}
+
+
+template<> bool MultiSeqItem<MultiValueSeq>::restoreSeqFromBinaryData(const Archive& archive)
+{
+    return restoreElementsFromBinaryData(archive);
+}
+
 #ifdef _WIN32
 template class MultiSeqItem<MultiValueSeq>;
 #endif
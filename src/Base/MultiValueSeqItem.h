@@ -15,6 +15,8 @@ typedef MultiSeqItem<MultiValueSeq> MultiValueSeqItem;
 typedef MultiValueSeqItem::Ptr MultiValueSeqItemPtr;
 
 template<> void MultiSeqItem<MultiValueSeq>::initializeClass(ExtensionManager* ext);
+template<> bool MultiSeqItem<MultiValueSeq>::storeSeqAsBinaryData(Archive& archive);
+template<> bool MultiSeqItem<MultiValueSeq>::restoreSeqFromBinaryData(const Archive& archive);
 
 }
 
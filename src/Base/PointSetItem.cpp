@@ -9,22 +9,92 @@
 #include "MenuManager.h"
 #include "PutPropertyFunction.h"
 #include "Archive.h"
+#include "LazyCaller.h"
+#include "MessageView.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/SceneWidget>
 #include <cnoid/SceneWidgetEventHandler>
 #include <cnoid/SceneDrawables>
 #include <cnoid/SceneMarkers>
 #include <cnoid/PointSetUtil>
+#include <cnoid/PointSetOctree>
 #include <cnoid/PolyhedralRegion>
+#include <cnoid/SceneNodeClassRegistry>
+#include <cnoid/SceneRenderer>
 #include <cnoid/CloneMap>
 #include <cnoid/Exception>
+#include <fmt/format.h>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
+// The streaming load is applied to the files having more points than this
+constexpr int StreamingLoadThreshold = 1000000;
+constexpr int InitialLoadChunkSize = 262144;
+constexpr int MaxLoadChunkSize = 4194304;
+
+constexpr double DefaultLODThreshold = 2.0;
+constexpr float AttentionPointSnapDistance = 0.01f;
+
+template<class ArrayType>
+void appendArray(ArrayType& array, const ArrayType& elements)
+{
+    const size_t n = array.size();
+    array.resize(n + elements.size());
+    std::copy(elements.begin(), elements.end(), array.begin() + n);
+}
+
+/**
+   This node renders the points of a point set with the level of detail given by the octree.
+   The points of an octree node are rendered with the samples of the node if the interval of
+   the samples on the screen is smaller than the threshold, and with the points of the child
+   nodes otherwise. The nodes outside the view volume are not rendered. The original point set
+   is the child of this node so that it is used by the renderers that do not support this node.
+*/
+class SgPointSetLOD : public SgGroup
+{
+public:
+    SgPointSetLOD();
+    void setContents(SgPointSet* pointSet, shared_ptr<PointSetOctree> octree);
+    void render(SceneRenderer* renderer);
+
+    bool isEnabled;
+    double threshold;
+
+private:
+    SgPointSetPtr pointSet;
+    shared_ptr<PointSetOctree> octree;
+    vector<SgPointSetPtr> nodePointSets;
+
+    SgPointSet* getNodePointSet(int nodeIndex);
+};
+
+typedef ref_ptr<SgPointSetLOD> SgPointSetLODPtr;
+
+void registerPointSetLOD()
+{
+    auto& registry = SceneNodeClassRegistry::instance();
+    if(!registry.hasRegistration<SgPointSetLOD>()){
+        registry.registerClass<SgPointSetLOD, SgGroup>();
+
+        SceneRenderer::addExtension(
+            [](SceneRenderer* renderer){
+                auto functions = renderer->renderingFunctions();
+                functions->setFunction<SgPointSetLOD>(
+                    [=](SgNode* node){
+                        static_cast<SgPointSetLOD*>(node)->render(renderer);
+                    });
+            });
+    }
+}
+
 class ScenePointSet;
 
 class ScenePointSet : public SgPosTransform, public SceneWidgetEventHandler
@@ -35,6 +105,10 @@ public:
     weak_ref_ptr<PointSetItem> weakPointSetItem;
     SgPointSetPtr orgPointSet;
     SgPointSetPtr visiblePointSet;
+    SgPointSetLODPtr lod;
+    shared_ptr<PointSetOctree> octree;
+    SgVertexArrayPtr octreeVertices;
+    int octreeNumVertices;
     SgUpdate update;
     SgShapePtr voxels;
     float voxelSize;
@@ -53,6 +127,9 @@ public:
 
     void setPointSize(double size);
     void setVoxelSize(double size);
+    void setLODEnabled(bool on);
+    void setLODThreshold(double threshold);
+    PointSetOctree* getOctree();
     int numAttentionPoints() const;
     Vector3 attentionPoint(int index) const;
     void clearAttentionPoints(bool doNotify);
@@ -87,10 +164,22 @@ public:
     ScenePointSetPtr scene;
     ScopedConnection pointSetUpdateConnection;
     Signal<void(const PolyhedralRegion& region)> sigPointsInRegionRemoved;
+    Selection pcdDataType;
+    bool isStreamingLoadEnabled;
+    std::thread loadThread;
+    std::atomic<bool> isLoadCanceled;
+    int loadId;
 
     Impl(PointSetItem* self);
     Impl(PointSetItem* self, const Impl& org, CloneMap* cloneMap);
+    ~Impl();
     void initialize();
+    bool loadPCD(const std::string& filename, std::ostream& os);
+    void cancelLoading();
+    void loadRemainingPoints(std::shared_ptr<PCDLoader> loader, int id, weak_ref_ptr<PointSetItem> weakSelf);
+    void appendLoadedPoints(
+        int id, SgVertexArrayPtr vertices, SgNormalArrayPtr normals, SgColorArrayPtr colors, bool isLast);
+    bool saveAsPCD(const std::string& filename, std::ostream& os);
     void setRenderingMode(int mode);
     bool onEditableChanged(bool on);
     void removePoints(const PolyhedralRegion& region);
@@ -103,49 +192,21 @@ public:
 }
 
 
-static bool loadPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
-{
-    try {
-        cnoid::loadPCD(item->pointSet(), filename);
-        os << item->pointSet()->vertices()->size() << " points have been loaded.";
-        item->pointSet()->notifyUpdate();
-        return true;
-    } catch (boost::exception& ex) {
-        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
-            os << *message;
-        }
-    }
-    return false;
-}
-
-
-static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
-{
-    try {
-        cnoid::savePCD(item->pointSet(), filename, item->offsetPosition());
-        return true;
-    } catch (boost::exception& ex) {
-        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
-            os << *message;
-        }
-    }
-    return false;
-}
-
-
 void PointSetItem::initializeClass(ExtensionManager* ext)
 {
     static bool initialized = false;
     if(!initialized){
+        registerPointSetLOD();
+        
         ItemManager& im = ext->itemManager();
         im.registerClass<PointSetItem>(N_("PointSetItem"));
         im.addCreationPanel<PointSetItem>();
         im.addLoaderAndSaver<PointSetItem>(
             _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
             [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
-                return ::loadPCD(item, filename, os); },
+                return item->impl->loadPCD(filename, os); },
             [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
-                return ::saveAsPCD(item, filename, os); },
+                return item->impl->saveAsPCD(filename, os); },
             ItemManager::PRIORITY_CONVERSION);
         
         initialized = true;
@@ -161,10 +222,12 @@ PointSetItem::PointSetItem()
 
 
 PointSetItem::Impl::Impl(PointSetItem* self)
-    : self(self)
+    : self(self),
+      pcdDataType(3, CNOID_GETTEXT_DOMAIN_NAME)
 {
     pointSet = new SgPointSet;
     scene = new ScenePointSet(this);
+    isStreamingLoadEnabled = true;
 
     initialize();
 }
@@ -178,11 +241,13 @@ PointSetItem::PointSetItem(const PointSetItem& org, CloneMap* cloneMap)
 
 
 PointSetItem::Impl::Impl(PointSetItem* self, const Impl& org, CloneMap* cloneMap)
-    : self(self)
+    : self(self),
+      pcdDataType(org.pcdDataType)
 {
     pointSet = CloneMap::getClone(org.pointSet, cloneMap);
     scene = new ScenePointSet(this);
     scene->T() = org.scene->T();
+    isStreamingLoadEnabled = org.isStreamingLoadEnabled;
 
     initialize();
 }
@@ -190,6 +255,12 @@ PointSetItem::Impl::Impl(PointSetItem* self, const Impl& org, CloneMap* cloneMap
 
 void PointSetItem::Impl::initialize()
 {
+    pcdDataType.setSymbol(PCD_ASCII, N_("ASCII"));
+    pcdDataType.setSymbol(PCD_BINARY, N_("Binary"));
+    pcdDataType.setSymbol(PCD_BINARY_COMPRESSED, N_("Binary compressed"));
+    isLoadCanceled = false;
+    loadId = 0;
+    
     pointSetUpdateConnection.reset(
         pointSet->sigUpdated().connect([&](const SgUpdate&){ self->notifyUpdate(); }));
 }
@@ -201,6 +272,166 @@ PointSetItem::~PointSetItem()
 }
 
 
+PointSetItem::Impl::~Impl()
+{
+    cancelLoading();
+}
+
+
+bool PointSetItem::Impl::loadPCD(const std::string& filename, std::ostream& os)
+{
+    cancelLoading();
+
+    auto loader = std::make_shared<PCDLoader>();
+    SgVertexArrayPtr vertices = new SgVertexArray;
+    SgNormalArrayPtr normals;
+    SgColorArrayPtr colors;
+    int numPoints = 0;
+    
+    try {
+        loader->open(filename);
+        numPoints = loader->numPoints();
+        if(loader->hasNormals()){
+            normals = new SgNormalArray;
+        }
+        if(loader->hasColors()){
+            colors = new SgColorArray;
+        }
+        int numPointsToRead = numPoints;
+        if(isStreamingLoadEnabled && numPoints > StreamingLoadThreshold){
+            numPointsToRead = InitialLoadChunkSize;
+        }
+        vertices->reserve(numPointsToRead);
+        do {
+            loader->readPoints(numPointsToRead - vertices->size(), *vertices, normals, colors);
+        } while(static_cast<int>(vertices->size()) < numPointsToRead && !loader->atEnd());
+
+        if(vertices->empty() && loader->atEnd()){
+            throw file_read_error() << error_info_message(_("No valid points"));
+        }
+    } catch (boost::exception& ex) {
+        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+            os << *message;
+        }
+        return false;
+    }
+
+    pcdDataType.select(loader->dataType());
+    pointSet->setVertices(vertices);
+    pointSet->setNormals(normals);
+    pointSet->normalIndices().clear();
+    pointSet->setColors(colors);
+    pointSet->colorIndices().clear();
+
+    if(loader->atEnd()){
+        os << format(_("{0} points have been loaded."), vertices->size());
+    } else {
+        os << format(_("{0} of {1} points have been loaded. "
+                       "The remaining points are being loaded in the background."),
+                     vertices->size(), numPoints);
+        const int id = loadId;
+        weak_ref_ptr<PointSetItem> weakSelf(self);
+        loadThread = std::thread([this, loader, id, weakSelf](){ loadRemainingPoints(loader, id, weakSelf); });
+    }
+
+    pointSet->notifyUpdate();
+    
+    return true;
+}
+
+
+void PointSetItem::Impl::cancelLoading()
+{
+    if(loadThread.joinable()){
+        isLoadCanceled = true;
+        loadThread.join();
+        isLoadCanceled = false;
+    }
+    // The chunks that have already been posted are discarded
+    ++loadId;
+}
+
+
+void PointSetItem::Impl::loadRemainingPoints
+(std::shared_ptr<PCDLoader> loader, int id, weak_ref_ptr<PointSetItem> weakSelf)
+{
+    int chunkSize = InitialLoadChunkSize;
+
+    try {
+        while(!loader->atEnd() && !isLoadCanceled){
+            // The chunk size is increased so that the number of the scene updates is kept small
+            chunkSize = std::min(chunkSize * 2, MaxLoadChunkSize);
+            SgVertexArrayPtr vertices = new SgVertexArray;
+            vertices->reserve(chunkSize);
+            SgNormalArrayPtr normals = loader->hasNormals() ? new SgNormalArray : nullptr;
+            SgColorArrayPtr colors = loader->hasColors() ? new SgColorArray : nullptr;
+            loader->readPoints(chunkSize, *vertices, normals, colors);
+            const bool isLast = loader->atEnd();
+            callLater([weakSelf, id, vertices, normals, colors, isLast](){
+                    if(auto item = weakSelf.lock()){
+                        item->impl->appendLoadedPoints(id, vertices, normals, colors, isLast);
+                    }
+                });
+        }
+    } catch (boost::exception& ex) {
+        string message;
+        if(std::string const * m = boost::get_error_info<error_info_message>(ex)){
+            message = *m;
+        }
+        callLater([weakSelf, id, message](){
+                if(auto item = weakSelf.lock()){
+                    if(item->impl->loadId == id){
+                        MessageView::instance()->putln(
+                            format(_("Loading the points of \"{0}\" failed: {1}"), item->displayName(), message),
+                            MessageView::Error);
+                    }
+                }
+            });
+    }
+}
+
+
+void PointSetItem::Impl::appendLoadedPoints
+(int id, SgVertexArrayPtr vertices, SgNormalArrayPtr normals, SgColorArrayPtr colors, bool isLast)
+{
+    if(id != loadId){
+        return;
+    }
+    auto orgVertices = pointSet->getOrCreateVertices();
+    const size_t numOrgVertices = orgVertices->size();
+    appendArray(*orgVertices, *vertices);
+
+    // The attributes are only appended when they correspond to the existing vertices
+    if(normals && pointSet->hasNormals() && pointSet->normals()->size() == numOrgVertices){
+        appendArray(*pointSet->normals(), *normals);
+    }
+    if(colors && pointSet->hasColors() && pointSet->colors()->size() == numOrgVertices){
+        appendArray(*pointSet->colors(), *colors);
+    }
+    
+    pointSet->notifyUpdate();
+
+    if(isLast){
+        MessageView::instance()->putln(
+            format(_("{0} points of \"{1}\" have been loaded."), orgVertices->size(), self->displayName()));
+    }
+}
+
+
+bool PointSetItem::Impl::saveAsPCD(const std::string& filename, std::ostream& os)
+{
+    try {
+        cnoid::savePCD(pointSet, filename, self->offsetPosition(), pcdDataType.which());
+        return true;
+    } catch (boost::exception& ex) {
+        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+            os << *message;
+        }
+    }
+    return false;
+}
+
+
 Item* PointSetItem::doCloneItem(CloneMap* cloneMap) const
 {
     return new PointSetItem(*this, cloneMap);
@@ -354,6 +585,54 @@ bool PointSetItem::Impl::onEditableChanged(bool on)
 }
 
 
+void PointSetItem::setLODEnabled(bool on)
+{
+    impl->scene->setLODEnabled(on);
+}
+
+
+bool PointSetItem::isLODEnabled() const
+{
+    return impl->scene->lod->isEnabled;
+}
+
+
+void PointSetItem::setLODThreshold(double threshold)
+{
+    impl->scene->setLODThreshold(threshold);
+}
+
+
+double PointSetItem::lodThreshold() const
+{
+    return impl->scene->lod->threshold;
+}
+
+
+void PointSetItem::setStreamingLoadEnabled(bool on)
+{
+    impl->isStreamingLoadEnabled = on;
+}
+
+
+bool PointSetItem::isStreamingLoadEnabled() const
+{
+    return impl->isStreamingLoadEnabled;
+}
+
+
+void PointSetItem::setPCDDataType(int type)
+{
+    impl->pcdDataType.select(type);
+}
+
+
+int PointSetItem::pcdDataType() const
+{
+    return impl->pcdDataType.which();
+}
+
+
 int PointSetItem::numAttentionPoints() const
 {
     return impl->scene->numAttentionPoints();
@@ -429,20 +708,68 @@ void PointSetItem::removePoints(const PolyhedralRegion& region)
 }
 
 
-void PointSetItem::Impl::removePoints(const PolyhedralRegion& region)
+void PointSetItem::findPointsInRegion(const PolyhedralRegion& region, std::vector<int>& out_indices)
 {
-    vector<int> indicesToRemove;
-    const Isometry3 T = scene->T();
-    SgVertexArray orgPoints(*pointSet->vertices());
-    const int numOrgPoints = orgPoints.size();
+    if(auto octree = impl->scene->getOctree()){
+        octree->findPointsInRegion(region, offsetPosition(), out_indices);
+    } else {
+        out_indices.clear();
+    }
+}
+
 
-    for(int i=0; i < numOrgPoints; ++i){
-        if(region.checkInside(T * orgPoints[i].cast<Vector3::Scalar>())){
-            indicesToRemove.push_back(i);
+SgPointSet* PointSetItem::getDownsampledPointSet(double voxelSize)
+{
+    SgPointSet* downsampled = new SgPointSet;
+    auto octree = impl->scene->getOctree();
+    if(!octree){
+        return downsampled;
+    }
+    vector<int> indices;
+    octree->downsampleByVoxelGrid(voxelSize, indices);
+    const int n = indices.size();
+    const SgPointSet* orgPointSet = impl->pointSet;
+
+    auto& vertices = *downsampled->getOrCreateVertices();
+    const auto& orgVertices = *orgPointSet->vertices();
+    vertices.resize(n);
+    for(int i=0; i < n; ++i){
+        vertices[i] = orgVertices[indices[i]];
+    }
+    if(orgPointSet->hasNormals()){
+        const auto& orgNormals = *orgPointSet->normals();
+        const auto& orgIndices = orgPointSet->normalIndices();
+        auto& normals = *downsampled->getOrCreateNormals();
+        normals.resize(n);
+        for(int i=0; i < n; ++i){
+            normals[i] = orgNormals[orgIndices.empty() ? indices[i] : orgIndices[indices[i]]];
+        }
+    }
+    if(orgPointSet->hasColors()){
+        const auto& orgColors = *orgPointSet->colors();
+        const auto& orgIndices = orgPointSet->colorIndices();
+        auto& colors = *downsampled->getOrCreateColors();
+        colors.resize(n);
+        for(int i=0; i < n; ++i){
+            colors[i] = orgColors[orgIndices.empty() ? indices[i] : orgIndices[indices[i]]];
         }
     }
+    downsampled->setPointSize(pointSize());
+    
+    return downsampled;
+}
+
+
+void PointSetItem::Impl::removePoints(const PolyhedralRegion& region)
+{
+    vector<int> indicesToRemove;
+    if(auto octree = scene->getOctree()){
+        octree->findPointsInRegion(region, scene->T(), indicesToRemove);
+    }
 
     if(!indicesToRemove.empty()){
+        const SgVertexArray orgPoints(*pointSet->vertices());
+        const int numOrgPoints = orgPoints.size();
         SgVertexArray& points = *pointSet->vertices();
         points.clear();
         int j = 0;
@@ -538,8 +865,16 @@ void PointSetItem::doPutProperties(PutPropertyFunction& putProperty)
     putProperty.decimals(4)
         (_("Voxel size"), voxelSize(),
          [=](double size){ scene->setVoxelSize(size); return true; });
+    putProperty(_("Level of detail"), isLODEnabled(),
+                [=](bool on){ scene->setLODEnabled(on); return true; });
+    putProperty.min(0.1).decimals(1)
+        (_("LOD threshold (px)"), lodThreshold(),
+         [=](double threshold){ scene->setLODThreshold(threshold); return true; });
     
     putProperty(_("Editable"), isEditable(), [&](bool on){ return impl->onEditableChanged(on); });
+    putProperty(_("Streaming load"), impl->isStreamingLoadEnabled, changeProperty(impl->isStreamingLoadEnabled));
+    putProperty(_("PCD data type"), impl->pcdDataType,
+                [&](int type){ return impl->pcdDataType.select(type); });
     const SgVertexArray* points = impl->pointSet->vertices();
     putProperty(_("Num points"), static_cast<int>(points ? points->size() : 0));
     putProperty(_("Translation"), str(Vector3(offsetPosition().translation())),
@@ -586,7 +921,11 @@ bool PointSetItem::store(Archive& archive)
     archive.write("rendering_mode", scene->renderingMode.selectedSymbol());
     archive.write("point_size", pointSize());
     archive.write("voxel_size", scene->voxelSize);
+    archive.write("level_of_detail", isLODEnabled());
+    archive.write("lod_threshold", lodThreshold());
     archive.write("is_editable", isEditable());
+    archive.write("streaming_load", impl->isStreamingLoadEnabled);
+    archive.write("pcd_data_type", impl->pcdDataType.selectedSymbol());
     
     return true;
 }
@@ -618,7 +957,10 @@ bool PointSetItem::restore(const Archive& archive)
     }
     scene->setPointSize(archive.get({ "point_size", "pointSize" }, pointSize()));
     scene->setVoxelSize(archive.get({ "voxel_size", "voxelSize" }, voxelSize()));
+    scene->setLODEnabled(archive.get("level_of_detail", isLODEnabled()));
+    scene->setLODThreshold(archive.get("lod_threshold", lodThreshold()));
     setEditable(archive.get({ "is_editable", "isEditable" }, isEditable()));
+    archive.read("streaming_load", impl->isStreamingLoadEnabled);
 
     std::string filename, formatId;
     if(archive.read("file", filename) && archive.read("format", formatId)){
@@ -626,7 +968,13 @@ bool PointSetItem::restore(const Archive& archive)
         if(filename.empty()){
             return false; // Invalid relocatable path
         }
-        return load(filename, archive.currentParentItem(), formatId);
+        if(!load(filename, archive.currentParentItem(), formatId)){
+            return false;
+        }
+    }
+    // The data type stored in the archive overrides the one of the loaded file
+    if(archive.read("pcd_data_type", symbol)){
+        impl->pcdDataType.select(symbol);
     }
     
     // Restoration succeeds when there is no associated file information
@@ -642,6 +990,8 @@ ScenePointSet::ScenePointSet(PointSetItem::Impl* pointSetItemImpl)
       renderingMode(PointSetItem::N_RENDERING_MODES)
 {
     visiblePointSet = new SgPointSet;
+    lod = new SgPointSetLOD;
+    octreeNumVertices = 0;
 
     voxels = new SgShape;
     voxels->getOrCreateMaterial();
@@ -683,6 +1033,51 @@ void ScenePointSet::setVoxelSize(double size)
 }
 
 
+void ScenePointSet::setLODEnabled(bool on)
+{
+    if(on != lod->isEnabled){
+        lod->isEnabled = on;
+        if(renderingMode.is(PointSetItem::POINT) && invariant){
+            updateVisualization(false);
+        }
+    }
+}
+
+
+void ScenePointSet::setLODThreshold(double threshold)
+{
+    if(threshold != lod->threshold){
+        lod->threshold = threshold;
+        if(renderingMode.is(PointSetItem::POINT) && invariant){
+            updateVisualization(false);
+        }
+    }
+}
+
+
+/**
+   The octree is rebuilt when the vertex array of the point set has been replaced or resized.
+   \return nullptr if the point set has no points
+*/
+PointSetOctree* ScenePointSet::getOctree()
+{
+    auto vertices = orgPointSet->vertices();
+    if(!vertices || vertices->empty()){
+        octree.reset();
+        octreeVertices.reset();
+        return nullptr;
+    }
+    if(!octree || vertices != octreeVertices || static_cast<int>(vertices->size()) != octreeNumVertices){
+        // A new instance is created because the current one may be shared with the LOD node
+        octree = make_shared<PointSetOctree>();
+        octree->build(vertices);
+        octreeVertices = vertices;
+        octreeNumVertices = vertices->size();
+    }
+    return octree.get();
+}
+
+
 int ScenePointSet::numAttentionPoints() const
 {
     return attentionPointMarkerGroup ? attentionPointMarkerGroup->numChildren() : 0;
@@ -776,16 +1171,20 @@ void ScenePointSet::updateVisualization(bool updateContents)
 {
     if(invariant){
         removeChild(invariant);
-        invariant->removeChild(visiblePointSet);
+        invariant->removeChild(lod);
         invariant->removeChild(voxels);
     }
     invariant = new SgInvariantGroup;
+
+    if(updateContents){
+        octree.reset();
+    }
     
     if(renderingMode.is(PointSetItem::POINT)){
         if(updateContents){
             updateVisiblePointSet();
         }
-        invariant->addChild(visiblePointSet);
+        invariant->addChild(lod);
     } else {
         if(updateContents){
             updateVoxels();
@@ -806,17 +1205,28 @@ void ScenePointSet::updateVisiblePointSet()
     visiblePointSet->setColors(orgPointSet->colors());
     visiblePointSet->colorIndices() = orgPointSet->colorIndices();
     visiblePointSet->notifyUpdate(update);
+
+    shared_ptr<PointSetOctree> lodOctree;
+    // The LOD node does not support the indexed normals and colors
+    if(orgPointSet->normalIndices().empty() && orgPointSet->colorIndices().empty() && getOctree()){
+        lodOctree = octree;
+    }
+    lod->setContents(visiblePointSet, lodOctree);
 }
 
 
 void ScenePointSet::updateVoxels()
 {
     SgMeshPtr mesh;
-    if(orgPointSet->hasVertices()){
+    if(auto octree = getOctree()){
+        // One box is created for each occupied voxel instead of each point
+        vector<int> pointIndices;
+        vector<Vector3f> centers;
+        octree->downsampleByVoxelGrid(voxelSize, pointIndices, &centers);
+        const int n = centers.size();
+        
         mesh = new SgMesh;
         mesh->setSolid(true);
-        const SgVertexArray& points = *orgPointSet->vertices();
-        const int n = points.size();
         SgVertexArray& vertices = *mesh->getOrCreateVertices();
         vertices.reserve(n * 8);
         SgNormalArray& normals = *mesh->setNormals(new SgNormalArray(6));
@@ -832,7 +1242,7 @@ void ScenePointSet::updateVoxels()
         const float s = voxelSize / 2.0;
         for(int i=0; i < n; ++i){
             const int top = vertices.size();
-            const Vector3f& p = points[i];
+            const Vector3f& p = centers[i];
             const float x0 = p.x() + s;
             const float x1 = p.x() - s;
             const float y0 = p.y() + s;
@@ -868,26 +1278,18 @@ void ScenePointSet::updateVoxels()
                 normalIndices.push_back(normalIndex);
             }
         }
-        if(orgPointSet->hasColors()){
-            SgColorArray& colors = *mesh->setColors(orgPointSet->colors());
-            const int m = colors.size();
-            const SgIndexArray& orgColorIndices = orgPointSet->colorIndices();
+        const SgColorArray* orgColors = orgPointSet->colors();
+        const SgIndexArray& orgColorIndices = orgPointSet->colorIndices();
+        if(orgColors && (!orgColorIndices.empty() || orgColors->size() == orgPointSet->vertices()->size())){
+            // The color of each voxel is the color of its representative point
+            SgColorArray& colors = *mesh->setColors(new SgColorArray(n));
             SgIndexArray& colorIndices = mesh->colorIndices();
-            if(orgColorIndices.empty()){
-                colorIndices.reserve(m * 36);
-                for(int i=0; i < m; ++i){
-                    for(int j=0; j < 36; ++j){
-                        colorIndices.push_back(i);
-                    }
-                }
-            } else {
-                const int l = orgColorIndices.size();
-                colorIndices.reserve(l * 36);
-                for(int i=0; i < l; ++i){
-                    const int index = orgColorIndices[l];
-                    for(int j=0; j < 36; ++j){
-                        colorIndices.push_back(index);
-                    }
+            colorIndices.reserve(n * 36);
+            for(int i=0; i < n; ++i){
+                const int index = pointIndices[i];
+                colors[i] = (*orgColors)[orgColorIndices.empty() ? index : orgColorIndices[index]];
+                for(int j=0; j < 36; ++j){
+                    colorIndices.push_back(i);
                 }
             }
         }
@@ -905,12 +1307,22 @@ bool ScenePointSet::onButtonPressEvent(SceneWidgetEvent* event)
     bool processed = false;
     
     if(event->button() == Qt::LeftButton){
+        // The picked position is snapped to the nearest point of the point set
+        Vector3 point = event->point();
+        if(auto octree = getOctree()){
+            const Isometry3& T = this->T();
+            int index = octree->findNearestPoint(
+                (T.inverse() * point).cast<float>(), AttentionPointSnapDistance);
+            if(index >= 0){
+                point = T * (*orgPointSet->vertices())[index].cast<double>();
+            }
+        }
         if(event->modifiers() & Qt::ControlModifier){
-            if(!removeAttentionPoint(event->point(), 0.01, true)){
-                addAttentionPoint(event->point(), true);
+            if(!removeAttentionPoint(point, 0.01, true)){
+                addAttentionPoint(point, true);
             }
         } else {
-            setAttentionPoint(event->point(), true);
+            setAttentionPoint(point, true);
         }
         processed = true;
     }
@@ -960,4 +1372,142 @@ void ScenePointSet::onRegionFixed(const PolyhedralRegion& region)
     }
 }
 
+
+SgPointSetLOD::SgPointSetLOD()
+    : SgGroup(findClassId<SgPointSetLOD>())
+{
+    isEnabled = true;
+    threshold = DefaultLODThreshold;
+}
+
+
+void SgPointSetLOD::setContents(SgPointSet* pointSet, shared_ptr<PointSetOctree> octree)
+{
+    if(pointSet != this->pointSet){
+        clearChildren();
+        if(pointSet){
+            addChild(pointSet);
+        }
+        this->pointSet = pointSet;
+    }
+    this->octree = octree;
+    nodePointSets.clear();
+    if(octree){
+        nodePointSets.resize(octree->numNodes());
+    }
+}
+
+
+SgPointSet* SgPointSetLOD::getNodePointSet(int nodeIndex)
+{
+    auto& nodePointSet = nodePointSets[nodeIndex];
+    if(!nodePointSet){
+        const auto& node = octree->node(nodeIndex);
+        const int* indices;
+        int n;
+        if(node.isLeaf()){
+            indices = &octree->pointIndices()[node.pointBegin];
+            n = node.numPoints();
+        } else {
+            indices = &octree->sampleIndices()[node.sampleBegin];
+            n = node.sampleEnd - node.sampleBegin;
+        }
+        nodePointSet = new SgPointSet;
+        auto& vertices = *nodePointSet->getOrCreateVertices();
+        const auto& orgVertices = *pointSet->vertices();
+        vertices.resize(n);
+        for(int i=0; i < n; ++i){
+            vertices[i] = orgVertices[indices[i]];
+        }
+        if(pointSet->hasNormals() && pointSet->normals()->size() == orgVertices.size()){
+            auto& normals = *nodePointSet->getOrCreateNormals();
+            const auto& orgNormals = *pointSet->normals();
+            normals.resize(n);
+            for(int i=0; i < n; ++i){
+                normals[i] = orgNormals[indices[i]];
+            }
+        }
+        if(pointSet->hasColors() && pointSet->colors()->size() == orgVertices.size()){
+            auto& colors = *nodePointSet->getOrCreateColors();
+            const auto& orgColors = *pointSet->colors();
+            colors.resize(n);
+            for(int i=0; i < n; ++i){
+                colors[i] = orgColors[indices[i]];
+            }
+        }
+    }
+    nodePointSet->setPointSize(pointSet->pointSize());
+    return nodePointSet;
+}
+
+
+void SgPointSetLOD::render(SceneRenderer* renderer)
+{
+    if(!pointSet){
+        return;
+    }
+    if(!isEnabled || !octree || octree->node(0).isLeaf()){
+        renderer->renderNode(pointSet);
+        return;
+    }
+
+    const Affine3& M = renderer->currentModelTransform();
+    const Isometry3& C = renderer->currentCameraPosition();
+    const Matrix4& P = renderer->projectionMatrix();
+    const Matrix4 PVM = P * C.inverse().matrix() * M.matrix();
+    const Vector3f cameraPosition = (M.inverse() * C.translation()).cast<float>();
+    const double scale = M.linear().col(0).norm();
+    // The projected size of the unit length at the unit distance in front of the camera
+    const double pixelRatio = renderer->projectedPixelSizeRatio(C * Vector3(0.0, 0.0, -1.0));
+    const bool isPerspective = (P(3, 3) == 0.0);
+
+    vector<int> stack;
+    stack.push_back(0);
+    while(!stack.empty()){
+        const int nodeIndex = stack.back();
+        stack.pop_back();
+        const auto& node = octree->node(nodeIndex);
+
+        // View frustum culling with the corners of the node cube in the clip coordinate
+        int outsideFlags = 0x3f;
+        for(int i=0; i < 8; ++i){
+            const float h = node.halfSize;
+            const Vector3f p = node.center + Vector3f((i & 1) ? h : -h, (i & 2) ? h : -h, (i & 4) ? h : -h);
+            const Vector4 q = PVM * Vector4(p.x(), p.y(), p.z(), 1.0);
+            int flags = 0;
+            if(q.x() < -q.w()) flags |= 1;
+            if(q.x() >  q.w()) flags |= 2;
+            if(q.y() < -q.w()) flags |= 4;
+            if(q.y() >  q.w()) flags |= 8;
+            if(q.z() < -q.w()) flags |= 16;
+            if(q.z() >  q.w()) flags |= 32;
+            outsideFlags &= flags;
+        }
+        if(outsideFlags){
+            continue;
+        }
+
+        if(node.isLeaf()){
+            renderer->renderNode(getNodePointSet(nodeIndex));
+            continue;
+        }
+
+        double error = node.sampleSpacing * scale * pixelRatio;
+        if(isPerspective){
+            const Vector3f d = (cameraPosition - node.center).cwiseAbs() - Vector3f::Constant(node.halfSize);
+            const double distance = d.cwiseMax(0.0f).norm() * scale;
+            error = (distance > 0.0) ? (error / distance) : std::numeric_limits<double>::max();
+        }
+        if(error <= threshold){
+            renderer->renderNode(getNodePointSet(nodeIndex));
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    stack.push_back(node.children[i]);
+                }
+            }
+        }
+    }
+}
+
 }
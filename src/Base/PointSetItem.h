@@ -66,6 +66,28 @@ public:
     void setEditable(bool on);
     bool isEditable() const;
 
+    /**
+       When the level of detail is enabled, the points are rendered with the samples of the
+       octree nodes whose sample intervals on the screen are smaller than the threshold.
+    */
+    void setLODEnabled(bool on);
+    bool isLODEnabled() const;
+    //! The threshold of the sample interval in pixels
+    void setLODThreshold(double threshold);
+    double lodThreshold() const;
+
+    /**
+       When this is enabled, the points of a large PCD file are loaded in a background thread
+       after the first part of them is displayed. The loaded points are appended to the point
+       set chunk by chunk.
+    */
+    void setStreamingLoadEnabled(bool on);
+    bool isStreamingLoadEnabled() const;
+
+    //! The data type used to save the point set as a PCD file. See PCDDataType.
+    void setPCDDataType(int type);
+    int pcdDataType() const;
+
     int numAttentionPoints() const;
     Vector3 attentionPoint(int index) const;
     void clearAttentionPoints();
@@ -80,6 +102,12 @@ public:
 
     void removePoints(const PolyhedralRegion& region);
 
+    //! Get the indices of the points inside the region given in the world coordinate
+    void findPointsInRegion(const PolyhedralRegion& region, std::vector<int>& out_indices);
+
+    //! Create a point set consisting of one point per occupied voxel
+    SgPointSet* getDownsampledPointSet(double voxelSize);
+
     SignalProxy<void(const PolyhedralRegion& region)> sigPointsInRegionRemoved();
 
     virtual bool store(Archive& archive) override;
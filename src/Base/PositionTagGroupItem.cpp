@@ -12,6 +12,7 @@
 #include "PutPropertyFunction.h"
 #include "MenuManager.h"
 #include "UnifiedEditHistory.h"
+#include "MessageView.h"
 #include "EditRecord.h"
 #include <cnoid/CloneMap>
 #include <cnoid/PositionTagGroup>
@@ -23,6 +24,7 @@
 #include <QLabel>
 #include <QDialogButtonBox>
 #include <map>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -916,9 +918,65 @@ void PositionTagGroupItem::doPutProperties(PutPropertyFunction& putProperty)
 }
 
 
+/**
+   Each tag is stored as the translation, the rotation quaternion (w, x, y, z) and
+   the attitude flag in the binary data storage mode.
+*/
+static constexpr int NumBinaryTagElements = 8;
+
+
+static bool writeTagsAsBinaryData(PositionTagGroup* tagGroup, Archive& archive)
+{
+    vector<double> data;
+    data.reserve(tagGroup->numTags() * NumBinaryTagElements);
+    for(auto& tag : *tagGroup){
+        auto p = tag->translation();
+        Quaternion q(tag->rotation());
+        data.insert(data.end(),
+                    { p.x(), p.y(), p.z(), q.w(), q.x(), q.y(), q.z(), tag->hasAttitude() ? 1.0 : 0.0 });
+    }
+    return archive.writeBinaryData("tag_data", data.data(), data.size() * sizeof(double));
+}
+
+
+static bool readTagsFromBinaryData(PositionTagGroup* tagGroup, const Archive& archive)
+{
+    vector<char> data;
+    if(!archive.readBinaryData("tag_data", data) ||
+       data.size() % (NumBinaryTagElements * sizeof(double)) != 0){
+        return false;
+    }
+    const int numTags = data.size() / (NumBinaryTagElements * sizeof(double));
+    vector<double> elements(numTags * NumBinaryTagElements);
+    memcpy(elements.data(), data.data(), data.size());
+    const double* e = elements.data();
+    for(int i=0; i < numTags; ++i){
+        PositionTagPtr tag = new PositionTag;
+        if(e[7] != 0.0){
+            Isometry3 T;
+            T.translation() << e[0], e[1], e[2];
+            T.linear() = Quaternion(e[3], e[4], e[5], e[6]).normalized().toRotationMatrix();
+            tag->setPosition(T);
+        } else {
+            tag->setTranslation(Vector3(e[0], e[1], e[2]));
+        }
+        tagGroup->append(tag);
+        e += NumBinaryTagElements;
+    }
+    return true;
+}
+
+
 bool PositionTagGroupItem::store(Archive& archive)
 {
-    impl->tagGroup->write(&archive);
+    if(archive.isBinaryDataStorageEnabled() && !impl->tagGroup->empty()){
+        impl->tagGroup->write(&archive, false);
+        if(!writeTagsAsBinaryData(impl->tagGroup, archive)){
+            impl->tagGroup->write(&archive);
+        }
+    } else {
+        impl->tagGroup->write(&archive);
+    }
 
     archive.setFloatingNumberFormat("%.9g");
     cnoid::write(archive, "offset_translation", impl->T_offset.translation());
@@ -957,7 +1015,18 @@ bool PositionTagGroupItem::restore(const Archive& archive)
     if(archive.read("transparency", t)){
         setTransparency(t);
     }
-    return impl->tagGroup->read(&archive);
+    if(!impl->tagGroup->read(&archive)){
+        return false;
+    }
+    if(archive.hasBinaryData("tag_data")){
+        if(!readTagsFromBinaryData(impl->tagGroup, archive)){
+            MessageView::instance()->putln(
+                format(_("The tags of {0} cannot be loaded from the binary data file."), displayName()),
+                MessageView::Error);
+            return false;
+        }
+    }
+    return true;
 }
 
 
@@ -35,6 +35,7 @@ namespace {
 
 bool defaultLayoutInclusionMode = true;
 bool isLayoutInclusionMode = true;
+bool isBinaryDataStorageMode = false;
 bool isTemporaryItemSaveCheckAvailable = true;
 int projectBeingLoadedCounter = 0;
 MainWindow* mainWindow = nullptr;
@@ -169,6 +170,7 @@ ProjectManager::Impl::Impl(ProjectManager* self, ExtensionManager* ext)
 {
     config = AppConfig::archive()->openMapping("ProjectManager");
     ::isLayoutInclusionMode = config->get({ "include_layout", "store_perspective" }, defaultLayoutInclusionMode);
+    ::isBinaryDataStorageMode = config->get("binary_data_storage", false);
     saveDialog = nullptr;
     isMainInstance = true;
 
@@ -205,6 +207,7 @@ ProjectManager::Impl::~Impl()
 {
     if(isMainInstance){
         config->write("include_layout", ::isLayoutInclusionMode);
+        config->write("binary_data_storage", ::isBinaryDataStorageMode);
     }
     if(saveDialog){
         delete saveDialog;
@@ -281,6 +284,18 @@ void ProjectManager::setLayoutInclusionMode(bool on)
 }
 
 
+bool ProjectManager::isBinaryDataStorageMode() const
+{
+    return ::isBinaryDataStorageMode;
+}
+
+
+void ProjectManager::setBinaryDataStorageMode(bool on)
+{
+    ::isBinaryDataStorageMode = on;
+}
+
+
 SignalProxy<void()> ProjectManager::sigProjectCleared()
 {
     return impl->sigProjectCleared;
@@ -673,6 +688,7 @@ bool ProjectManager::Impl::saveProject(const string& filename, Item* item, bool
 
     ArchivePtr archive = new Archive;
     archive->initSharedInfo(filename, isSubProject);
+    archive->setBinaryDataStorageEnabled(::isBinaryDataStorageMode);
 
     ArchivePtr itemArchive = itemTreeArchiver.store(archive, item);
 
@@ -55,6 +55,13 @@ public:
     bool isLayoutInclusionMode() const;
     void setLayoutInclusionMode(bool on);
 
+    /**
+       When this mode is enabled, the items that support the binary data storage write their
+       large data into the binary side-car file of the project file instead of the project file.
+    */
+    bool isBinaryDataStorageMode() const;
+    void setBinaryDataStorageMode(bool on);
+
     SignalProxy<void()> sigProjectCleared();
 
     /**
@@ -24,6 +24,7 @@
 #include <cnoid/CoordinateAxesOverlay>
 #include <cnoid/ConnectionSet>
 #include <QOpenGLWidget>
+#include <QOpenGLFramebufferObject>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QElapsedTimer>
@@ -131,6 +132,8 @@ public:
     GLSLSceneRenderer* glslRenderer;
     GL1SceneRenderer* gl1Renderer;
     GLuint prevDefaultFramebufferObject;
+    unique_ptr<QOpenGLFramebufferObject> offscreenFramebuffer;
+    unique_ptr<QOpenGLFramebufferObject> offscreenResolveFramebuffer;
     bool isRendering;
     bool needToUpdatePreprocessedNodeTree;
     bool needToClearGLOnFrameBufferChange;
@@ -330,6 +333,7 @@ public:
     void showEditModePopupMenu(const QPoint& globalPos);
 
     void setScreenSize(int width, int height);
+    QImage renderOffscreenImage(int width, int height);
     void updateIndicator(const std::string& text);
     bool storeState(Archive& archive);
     void writeCameraPath(Mapping& archive, const std::string& key, int cameraIndex);
@@ -589,6 +593,13 @@ SceneWidget::~SceneWidget()
 
 SceneWidget::Impl::~Impl()
 {
+    if(offscreenFramebuffer && isValid()){
+        makeCurrent();
+        offscreenFramebuffer.reset();
+        offscreenResolveFramebuffer.reset();
+        doneCurrent();
+    }
+    
     delete renderer;
 
     if(lastMouseMoveEvent){
@@ -2796,6 +2807,59 @@ QImage SceneWidget::getImage()
 }
 
 
+QImage SceneWidget::renderOffscreenImage(int width, int height)
+{
+    return impl->renderOffscreenImage(width, height);
+}
+
+
+QImage SceneWidget::Impl::renderOffscreenImage(int width, int height)
+{
+    if(!isValid() || width <= 0 || height <= 0){
+        return QImage();
+    }
+
+    makeCurrent();
+
+    if(!offscreenFramebuffer || offscreenFramebuffer->size() != QSize(width, height)){
+        QOpenGLFramebufferObjectFormat fboFormat;
+        fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        fboFormat.setSamples(std::max(format().samples(), 0));
+        offscreenFramebuffer.reset(new QOpenGLFramebufferObject(width, height, fboFormat));
+        if(fboFormat.samples() > 0){
+            offscreenResolveFramebuffer.reset(new QOpenGLFramebufferObject(width, height));
+        } else {
+            offscreenResolveFramebuffer.reset();
+        }
+    }
+
+    offscreenFramebuffer->bind();
+    renderer->setDefaultFramebufferObject(offscreenFramebuffer->handle());
+    renderer->setViewport(0, 0, width, height);
+
+    isRendering = true;
+    renderer->render();
+    isRendering = false;
+
+    QImage image;
+    if(offscreenResolveFramebuffer){
+        QOpenGLFramebufferObject::blitFramebuffer(
+            offscreenResolveFramebuffer.get(), offscreenFramebuffer.get());
+        image = offscreenResolveFramebuffer->toImage();
+    } else {
+        image = offscreenFramebuffer->toImage();
+    }
+
+    offscreenFramebuffer->release();
+    renderer->setDefaultFramebufferObject(defaultFramebufferObject());
+    // The viewport of the widget is restored in the next paintGL call
+    needToUpdateViewportInformation = true;
+    doneCurrent();
+
+    return image.convertToFormat(QImage::Format_RGB32);
+}
+
+
 void SceneWidget::setScreenSize(int width, int height)
 {
     impl->setScreenSize(width, height);
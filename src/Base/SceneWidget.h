@@ -167,6 +167,14 @@ public:
 
     bool saveImage(const std::string& filename);
     QImage getImage();
+
+    /**
+       Render the scene into an offscreen frame buffer of the specified size and return the image.
+       The image does not depend on the size and visibility of the widget, but the widget must have
+       been shown once so that its OpenGL context is initialized. A null image is returned otherwise.
+    */
+    QImage renderOffscreenImage(int width, int height);
+
     void setScreenSize(int width, int height);
 
     void updateIndicator(const std::string& text);
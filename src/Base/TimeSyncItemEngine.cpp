@@ -6,10 +6,15 @@
 #include "ExtensionManager.h"
 #include "LazyCaller.h"
 #include <cnoid/ConnectionSet>
+#include <cnoid/SceneGraph>
+#include <cnoid/ThreadPool>
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include <set>
+#include <memory>
+#include <thread>
+#include <cstdlib>
 
 using namespace std;
 using namespace cnoid;
@@ -49,6 +54,13 @@ public:
     set<ItemInfo*> activeItemInfos;
     LazyCaller refreshActiveItemsLater;
 
+    // Used for updating the engines concurrently during the playback
+    int maxNumConcurrentThreads;
+    unique_ptr<ThreadPool> threadPool;
+    vector<TimeSyncItemEnginePtr> enginesToUpdate;
+    vector<vector<TimeSyncItemEngine*>> concurrentEngineGroups;
+    unordered_map<Referenced*, int> targetToEngineGroupIndexMap;
+
     ScopedConnectionSet connections;
 
     Impl();
@@ -63,6 +75,8 @@ public:
     bool onPlaybackInitialized(double time);
     void onPlaybackStarted(double time);
     bool onTimeChanged(double time);
+    void updateEnginesConcurrently(double time);
+    void updateEngineGroup(vector<TimeSyncItemEngine*>& engines, double time);
     double onPlaybackStopped(double time, bool isStoppedManually);
 };
 
@@ -98,6 +112,11 @@ TimeSyncItemEngineManager::Impl::Impl()
     currentTime = 0.0;
     isDoingPlayback = false;
 
+    maxNumConcurrentThreads = std::thread::hardware_concurrency();
+    if(char* CNOID_TIME_SYNC_ENGINE_THREADS = getenv("CNOID_TIME_SYNC_ENGINE_THREADS")){
+        maxNumConcurrentThreads = atoi(CNOID_TIME_SYNC_ENGINE_THREADS);
+    }
+
     rootItem = RootItem::instance();
 
     connections.add(
@@ -371,6 +390,11 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
     bool isActive = false;
     currentTime = time;
 
+    // The scene updates caused by the engines are aggregated into a single notification
+    SgUpdateTransaction sceneUpdateTransaction;
+
+    enginesToUpdate.clear();
+
     auto it1 = activeItemInfos.begin();
     while(it1 != activeItemInfos.end()){
         bool doErase = false;
@@ -392,7 +416,7 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
                     continue;
                 }
             }
-            isActive |= engine->onTimeChanged(time);
+            enginesToUpdate.push_back(engine);
             ++it2;
         }
         if(doErase){
@@ -402,10 +426,75 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
         }
     }
 
+    if(isDoingPlayback && maxNumConcurrentThreads >= 2){
+        updateEnginesConcurrently(time);
+    }
+
+    // The notifications are done in the main thread in the same order as the sequential update
+    for(auto& engine : enginesToUpdate){
+        if(engine->isUpdatedConcurrently_){
+            engine->isUpdatedConcurrently_ = false;
+            isActive |= engine->isActiveInConcurrentTimeChange_;
+            isActive |= engine->onConcurrentTimeChangeFinished(time);
+        } else {
+            isActive |= engine->onTimeChanged(time);
+        }
+    }
+    enginesToUpdate.clear();
+
     return isActive;
 }
 
 
+void TimeSyncItemEngineManager::Impl::updateEnginesConcurrently(double time)
+{
+    int numGroups = 0;
+    for(auto& engine : enginesToUpdate){
+        if(auto target = engine->concurrentTimeChangeTarget()){
+            auto inserted = targetToEngineGroupIndexMap.emplace(target, numGroups);
+            if(inserted.second){
+                if(numGroups == static_cast<int>(concurrentEngineGroups.size())){
+                    concurrentEngineGroups.emplace_back();
+                }
+                ++numGroups;
+            }
+            concurrentEngineGroups[inserted.first->second].push_back(engine);
+            engine->isUpdatedConcurrently_ = true;
+        }
+    }
+    targetToEngineGroupIndexMap.clear();
+
+    if(numGroups >= 2){
+        if(!threadPool){
+            threadPool.reset(new ThreadPool(maxNumConcurrentThreads - 1));
+        }
+        for(int i=1; i < numGroups; ++i){
+            auto& engines = concurrentEngineGroups[i];
+            threadPool->start([this, &engines, time](){ updateEngineGroup(engines, time); });
+        }
+    }
+    if(numGroups >= 1){
+        // The main thread also updates a group
+        updateEngineGroup(concurrentEngineGroups[0], time);
+    }
+    if(numGroups >= 2){
+        threadPool->wait();
+    }
+
+    for(int i=0; i < numGroups; ++i){
+        concurrentEngineGroups[i].clear();
+    }
+}
+
+
+void TimeSyncItemEngineManager::Impl::updateEngineGroup(vector<TimeSyncItemEngine*>& engines, double time)
+{
+    for(auto& engine : engines){
+        engine->isActiveInConcurrentTimeChange_ = engine->onTimeChangedConcurrently(time);
+    }
+}
+
+
 double TimeSyncItemEngineManager::Impl::onPlaybackStopped(double time, bool isStoppedManually)
 {
     double maxLastValidTime = 0.0;
@@ -452,6 +541,8 @@ TimeSyncItemEngine::TimeSyncItemEngine(Item* item)
     isActive_ = false;
     isTimeSyncForcedToBeMaintained_ = false;
     isUpdatingOngoingTime_ = false;
+    isUpdatedConcurrently_ = false;
+    isActiveInConcurrentTimeChange_ = false;
 }
 
 
@@ -485,6 +576,24 @@ bool TimeSyncItemEngine::isTimeSyncAlwaysMaintained() const
 }
 
 
+Referenced* TimeSyncItemEngine::concurrentTimeChangeTarget()
+{
+    return nullptr;
+}
+
+
+bool TimeSyncItemEngine::onTimeChangedConcurrently(double /* time */)
+{
+    return false;
+}
+
+
+bool TimeSyncItemEngine::onConcurrentTimeChangeFinished(double time)
+{
+    return onTimeChanged(time);
+}
+
+
 void TimeSyncItemEngine::activate()
 {
     isActive_ = true;
@@ -26,6 +26,17 @@ public:
     virtual double onPlaybackStopped(double time, bool isStoppedManually);
     virtual bool isTimeSyncAlwaysMaintained() const;
 
+    /**
+       An engine can return the object updated by the engine to update the time concurrently with
+       the other engines during the playback. In that case, onTimeChangedConcurrently is called in
+       a worker thread instead of onTimeChanged, and onConcurrentTimeChangeFinished is then called
+       in the main thread, where the notifications of the update should be done. The engines that
+       return the same object are sequentially updated in the same thread.
+    */
+    virtual Referenced* concurrentTimeChangeTarget();
+    virtual bool onTimeChangedConcurrently(double time);
+    virtual bool onConcurrentTimeChangeFinished(double time);
+
     void startOngoingTimeUpdate();
     void startOngoingTimeUpdate(double time);
     bool isUpdatingOngoingTime() const { return isUpdatingOngoingTime_; }
@@ -41,6 +52,8 @@ private:
     bool isActive_;
     bool isTimeSyncForcedToBeMaintained_;
     bool isUpdatingOngoingTime_;
+    bool isUpdatedConcurrently_;
+    bool isActiveInConcurrentTimeChange_;
 
     friend class TimeSyncItemEngineManager;
 
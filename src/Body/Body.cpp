@@ -194,13 +194,19 @@ Link* Body::doCreateLink(const Link* org, CloneMap* cloneMap) const
 void Body::cloneShapes(CloneMap& cloneMap)
 {
     const int n = linkTraverse_.numLinks();
+    vector<SgNodePtr> visualNodes;
+    vector<SgNodePtr> collisionNodes;
     for(int i=0; i < n; ++i){
         Link* link = linkTraverse_[i];
-        for(auto& node : *link->visualShape()){
-            link->addVisualShapeNode(node->cloneNode(cloneMap));
-        }
-        for(auto& node : *link->collisionShape()){
-            link->addCollisionShapeNode(node->cloneNode(cloneMap));
+        // The shape nodes are replaced with the clones, which are shared by the visual and collision shapes
+        visualNodes.assign(link->visualShape()->begin(), link->visualShape()->end());
+        collisionNodes.assign(link->collisionShape()->begin(), link->collisionShape()->end());
+        link->clearShapeNodes();
+        for(auto& node : visualNodes){
+            link->addVisualShapeNode(cloneMap.getClone<SgNode>(node));
+        }
+        for(auto& node : collisionNodes){
+            link->addCollisionShapeNode(cloneMap.getClone<SgNode>(node));
         }
     }
 }
@@ -445,3 +445,31 @@ void BodyCollisionDetector::detectCollisions(Link* link, std::function<void(cons
         impl->collisionDetector->detectCollisions(*handle, callback);
     }
 }
+
+
+bool BodyCollisionDetector::checkCollision()
+{
+    return impl->collisionDetector->checkCollision();
+}
+
+
+bool BodyCollisionDetector::checkCollision(Link* link)
+{
+    if(auto handle = findGeometryHandle(link)){
+        return impl->collisionDetector->checkCollision(*handle);
+    }
+    return false;
+}
+
+
+bool BodyCollisionDetector::checkCollision(Link* link1, Link* link2)
+{
+    auto handle1 = findGeometryHandle(link1);
+    if(handle1){
+        auto handle2 = findGeometryHandle(link2);
+        if(handle2){
+            return impl->collisionDetector->checkCollision(*handle1, *handle2);
+        }
+    }
+    return false;
+}
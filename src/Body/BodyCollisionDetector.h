@@ -44,6 +44,16 @@ public:
     //! \note Geometry handle map must be enabled to use this function
     void detectCollisions(Link* link, std::function<void(const CollisionPair& collisionPair)> callback);
 
+    /**
+       These functions only check whether there is a collision or not, and they return
+       as soon as the first collision is found without calculating the contact points.
+    */
+    bool checkCollision();
+    //! \note Geometry handle map must be enabled to use this function
+    bool checkCollision(Link* link);
+    //! \note Geometry handle map must be enabled to use this function
+    bool checkCollision(Link* link1, Link* link2);
+
     [[deprecated("Use setGeometryHandleMapEnabled.")]]
     void enableGeometryHandleMap(bool on);
 
@@ -85,6 +85,8 @@ static const double DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO = 5.0;
 static const double DEFAULT_CONTACT_CULLING_DISTANCE = 0.005;
 static const double DEFAULT_CONTACT_CULLING_DEPTH = 0.05;
 
+static const int DEFAULT_MAX_NUM_CONVEX_HULLS = 16;
+
 
 // test for mobile robots with wheels
 //static const double DEFAULT_CONTACT_CORRECTION_DEPTH = 0.005;
@@ -225,6 +227,16 @@ public:
         
     std::vector<LinkPair*> constrainedLinkPairs;
 
+    // The geometries of a sleepable sub body are set static while the sub body is sleeping
+    struct SleepableSubBodyInfo
+    {
+        DySubBody* subBody;
+        vector<GeometryHandle> geometries;
+        bool isGeometryStatic;
+    };
+    vector<SleepableSubBodyInfo> sleepableSubBodyInfos;
+    bool hasWokenSubBodies;
+
     int globalNumConstraintVectors;
 
     int globalNumContactNormalVectors;
@@ -282,6 +294,8 @@ public:
     void initialize(void);
     void initializeContactMaterials();
     ContactMaterialEx* createContactMaterialFromMaterialPair(int material1, int material2);
+    void addBodyToCollisionDetector(DyBody* body, bool isSelfCollisionDetectionEnabled);
+    void updateStaticGeometriesOfSleepingSubBodies();
     void solve();
     void setConstraintPoints();
     void extractConstraintPoints(const CollisionPair& collisionPair);
@@ -391,6 +405,7 @@ ConstraintForceSolver::Impl::Impl(DyWorldBase& world)
 
     bodyIndexToCollisionDetectionModeMap.clear();
     is2Dmode = false;
+    hasWokenSubBodies = false;
 }
 
 
@@ -559,6 +574,7 @@ void ConstraintForceSolver::Impl::initialize(void)
     constrainedLinkPairs.clear();
     extraJointLinkPairs.clear();
     constrain2dLinkPairs.clear();
+    sleepableSubBodyInfos.clear();
 
     initializeContactMaterials();
 
@@ -569,7 +585,7 @@ void ConstraintForceSolver::Impl::initialize(void)
 
         auto collisionDetectionMode =  bodyIndexToCollisionDetectionModeMap[bodyIndex];
         if(collisionDetectionMode & BodyToBodyCollision){
-            bodyCollisionDetector.addBody(body, collisionDetectionMode & SelfCollision);
+            addBodyToCollisionDetector(body, collisionDetectionMode & SelfCollision);
         }
     }
 
@@ -587,6 +603,70 @@ void ConstraintForceSolver::Impl::initialize(void)
 }
 
 
+/**
+   The geometry used for the collision detection of a link can be specified by the "collision_geometry" key
+   of the link or body information. The value is "mesh" (default), "convex_hull" or "convex_decomposition".
+   The maximum number of the hulls in the decomposition is specified by the "max_num_convex_hulls" key.
+   These settings are only available with AISTCollisionDetector.
+*/
+void ConstraintForceSolver::Impl::addBodyToCollisionDetector(DyBody* body, bool isSelfCollisionDetectionEnabled)
+{
+    auto aistCollisionDetector = dynamic_cast<AISTCollisionDetector*>(bodyCollisionDetector.collisionDetector());
+    const bool isSleepingEnabled = world.isSleepingEnabled();
+
+    if(!aistCollisionDetector && !isSleepingEnabled){
+        bodyCollisionDetector.addBody(body, isSelfCollisionDetectionEnabled);
+        return;
+    }
+
+    const Mapping* bodyInfo = body->info();
+    const string bodyCollisionGeometry = bodyInfo->get("collision_geometry", "mesh");
+    const int bodyMaxNumConvexHulls = bodyInfo->get("max_num_convex_hulls", DEFAULT_MAX_NUM_CONVEX_HULLS);
+
+    unordered_map<DySubBody*, int> subBodyToInfoIndexMap;
+    bodyCollisionDetector.addBody(
+        body, isSelfCollisionDetectionEnabled,
+        [&](Link* link, GeometryHandle geometry) -> Referenced* {
+            if(aistCollisionDetector){
+                const Mapping* linkInfo = link->info();
+                string collisionGeometry = linkInfo->get("collision_geometry", bodyCollisionGeometry);
+                if(collisionGeometry == "convex_hull"){
+                    aistCollisionDetector->setGeometryConvexHulls(geometry, 1);
+                } else if(collisionGeometry == "convex_decomposition"){
+                    aistCollisionDetector->setGeometryConvexHulls(
+                        geometry, linkInfo->get("max_num_convex_hulls", bodyMaxNumConvexHulls));
+                }
+            }
+            if(isSleepingEnabled){
+                auto subBody = static_cast<DyLink*>(link)->subBody();
+                if(subBody->isSleepable()){
+                    auto inserted = subBodyToInfoIndexMap.emplace(subBody, sleepableSubBodyInfos.size());
+                    if(inserted.second){
+                        sleepableSubBodyInfos.push_back({ subBody, {}, false });
+                    }
+                    sleepableSubBodyInfos[inserted.first->second].geometries.push_back(geometry);
+                }
+            }
+            return link;
+        });
+}
+
+
+void ConstraintForceSolver::Impl::updateStaticGeometriesOfSleepingSubBodies()
+{
+    auto collisionDetector = bodyCollisionDetector.collisionDetector();
+    for(auto& info : sleepableSubBodyInfos){
+        bool isSleeping = info.subBody->isSleeping();
+        if(isSleeping != info.isGeometryStatic){
+            for(auto& geometry : info.geometries){
+                collisionDetector->setGeometrySleeping(geometry, isSleeping);
+            }
+            info.isGeometryStatic = isSleeping;
+        }
+    }
+}
+
+
 void ConstraintForceSolver::Impl::initializeContactMaterials()
 {
     if(!orgMaterialTable){
@@ -657,7 +737,14 @@ void ConstraintForceSolver::Impl::solve()
         }
     }
 
-    bodyCollisionDetector.updatePositions();
+    if(!sleepableSubBodyInfos.empty()){
+        updateStaticGeometriesOfSleepingSubBodies();
+    }
+
+    // The link is explicitly given as the object of the geometry when the sleeping is enabled
+    bodyCollisionDetector.updatePositions(
+        [](Referenced* object, Isometry3*& out_position){
+            out_position = &(static_cast<Link*>(object)->position()); });
 
     globalNumConstraintVectors = 0;
     globalNumFrictionVectors = 0;
@@ -667,6 +754,22 @@ void ConstraintForceSolver::Impl::solve()
 
     setConstraintPoints();
 
+    /*
+      The contacts of the woken sub bodies with the static objects and the other sleeping
+      sub bodies have not been detected, so the constraint points are extracted again.
+      This is repeated while the extraction wakes up other sub bodies, which happens in a stack
+      of bodies, and it finishes because the number of the sleeping sub bodies decreases.
+    */
+    while(hasWokenSubBodies){
+        hasWokenSubBodies = false;
+        updateStaticGeometriesOfSleepingSubBodies();
+        globalNumConstraintVectors = 0;
+        globalNumFrictionVectors = 0;
+        areThereImpacts = false;
+        constrainedLinkPairs.clear();
+        setConstraintPoints();
+    }
+
     if(CFS_PUT_NUM_CONTACT_POINTS){
         cout << globalNumContactNormalVectors;
     }
@@ -753,7 +856,10 @@ void ConstraintForceSolver::Impl::setConstraintPoints()
     }
 
     for(size_t i=0; i < constrain2dLinkPairs.size(); ++i){
-        set2dConstraintPoints(constrain2dLinkPairs[i]);
+        // The constraint is not necessary while the sub body is sleeping
+        if(!constrain2dLinkPairs[i]->link[1]->subBody()->isSleeping()){
+            set2dConstraintPoints(constrain2dLinkPairs[i]);
+        }
     }
 }
 
@@ -792,6 +898,23 @@ void ConstraintForceSolver::Impl::extractConstraintPoints(const CollisionPair& c
         pLinkPair = &linkPair;
     }
 
+    /*
+      A sleeping sub body is woken by a moving sub body. The resting sub bodies do not wake
+      the sleeping ones so that the sub bodies in contact can fall asleep one by one.
+    */
+    auto subBody0 = pLinkPair->link[0]->subBody();
+    auto subBody1 = pLinkPair->link[1]->subBody();
+    if(subBody0->isSleeping() && !subBody1->isStatic() && !subBody1->isResting()){
+        subBody0->wakeUp();
+        hasWokenSubBodies = true;
+    } else if(subBody1->isSleeping() && !subBody0->isStatic() && !subBody0->isResting()){
+        subBody1->wakeUp();
+        hasWokenSubBodies = true;
+    }
+    if(subBody0->isStatic() && subBody1->isStatic()){
+        return;
+    }
+
     const vector<Collision>& collisions = collisionPair.collisions();
 
     auto& collisionHandler = pLinkPair->contactMaterial->collisionHandler;
@@ -31,6 +31,9 @@ void DySubBody::initialize(DyLink* rootLink, std::multimap<Link*, ForceSensor*>&
     body_ = rootLink->body();
     forwardDynamicsCBM_ = nullptr;
     isStatic_ = true;
+    isSleepable_ = false;
+    isSleeping_ = false;
+    numRestingSteps = 0;
     
     bool hasHighGainJoints = false;
 
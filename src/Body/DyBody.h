@@ -30,7 +30,21 @@ public:
     std::vector<DyLink*>& links(){ return links_; }
     int numLinks() const { return links_.size(); }
     DyLink* link(int localIndex){ return links_[localIndex]; }
-    bool isStatic() const { return isStatic_; }
+    /**
+       \note This returns true while the sub body is sleeping so that the constraint force solver
+       treats the sub body as a static object.
+    */
+    bool isStatic() const { return isStatic_ || isSleeping_; }
+
+    //! The sub body can sleep when the sleeping of DyWorldBase is enabled and it is a passive body
+    bool isSleepable() const { return isSleepable_; }
+    bool isSleeping() const { return isSleeping_; }
+    //! True if the sub body has been awake and its velocities have been below the sleeping thresholds
+    bool isResting() const { return numRestingSteps > 0; }
+    void wakeUp(){
+        isSleeping_ = false;
+        numRestingSteps = 0;
+    }
 
     ForwardDynamics* forwardDynamics(){ return forwardDynamics_.get(); }
     ForwardDynamicsCBM* forwardDynamicsCBM(){ return forwardDynamicsCBM_; }
@@ -56,6 +70,11 @@ private:
     std::vector<ForceSensor*> forceSensors_;
 
     bool isStatic_;
+
+    // Used in DyWorldBase
+    bool isSleepable_;
+    bool isSleeping_;
+    int numRestingSteps;
     
     // Used in ConstraintForceSolver
     bool hasConstrainedLinks;
@@ -68,6 +87,7 @@ private:
     void extractLinksInSubBody(
         DyLink* link, std::multimap<Link*, ForceSensor*>& forceSensorMap, bool& hasHighgainJoints);
 
+    friend class DyWorldBase;
     friend class ConstraintForceSolver;
 };
 
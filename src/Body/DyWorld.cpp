@@ -3,6 +3,10 @@
 */
 
 #include "DyWorld.h"
+#include <cnoid/ThreadPool>
+#include <algorithm>
+#include <thread>
+#include <cmath>
 
 using namespace std;
 using namespace cnoid;
@@ -22,6 +26,13 @@ DyWorldBase::DyWorldBase()
     sensorsAreEnabled = false;
     isOldAccelSensorCalcMode = false;
     numRegisteredLinkPairs = 0;
+    numIntegrationThreads_ = 1;
+    integrationGrainSize_ = 32;
+    isSleepingEnabled_ = false;
+    sleepingLinearVelocity_ = 0.01;
+    sleepingAngularVelocity_ = 0.05;
+    sleepingTime_ = 0.5;
+    numStepsToSleep = 0;
 }
 
 
@@ -71,6 +82,16 @@ void DyWorldBase::setOldAccelSensorCalcMode(bool on)
 }
 
 
+void DyWorldBase::setParallelIntegration(int numThreads, int grainSize)
+{
+    if(numThreads <= 0){
+        numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    numIntegrationThreads_ = numThreads;
+    integrationGrainSize_ = std::max(1, grainSize);
+}
+
+
 void DyWorldBase::initialize()
 {
     for(auto& subBody : subBodies_){
@@ -86,6 +107,206 @@ void DyWorldBase::initialize()
         forwardDynamics->setOldAccelSensorCalcMode(isOldAccelSensorCalcMode);
         forwardDynamics->initialize();
     }
+
+    initializeIntegrationTasks();
+    initializeSleeping();
+}
+
+
+void DyWorldBase::initializeIntegrationTasks()
+{
+    integrationTasks.clear();
+
+    if(numIntegrationThreads_ >= 2){
+        int begin = 0;
+        int numLinks = 0;
+        const int n = subBodies_.size();
+        for(int i=0; i < n; ++i){
+            numLinks += subBodies_[i]->numLinks();
+            bool isLastSubBodyOfBody =
+                (i == n - 1) || (subBodies_[i + 1]->rootLink()->body() != subBodies_[i]->rootLink()->body());
+            if(isLastSubBodyOfBody && numLinks >= integrationGrainSize_){
+                integrationTasks.emplace_back(begin, i + 1);
+                begin = i + 1;
+                numLinks = 0;
+            }
+        }
+        if(begin < n){
+            integrationTasks.emplace_back(begin, n);
+        }
+    }
+
+    if(integrationTasks.size() >= 2){
+        int numWorkerThreads = std::min(numIntegrationThreads_, static_cast<int>(integrationTasks.size())) - 1;
+        if(!threadPool || threadPool->size() != numWorkerThreads){
+            threadPool.reset(new ThreadPool(numWorkerThreads));
+        }
+    } else {
+        integrationTasks.clear();
+        threadPool.reset();
+    }
+}
+
+
+/**
+   The sub bodies of a body are always processed in the same task because they share the
+   objects of the body such as the devices. The result does not depend on the number of threads
+   because each sub body is processed independently of the others.
+*/
+template<class Function> void DyWorldBase::forEachSubBody(Function func)
+{
+    if(integrationTasks.empty()){
+        for(auto& subBody : subBodies_){
+            func(subBody);
+        }
+    } else {
+        auto processTask = [this, &func](const std::pair<int, int>& task){
+            for(int i = task.first; i < task.second; ++i){
+                func(subBodies_[i]);
+            }
+        };
+        const int n = integrationTasks.size();
+        for(int i=1; i < n; ++i){
+            auto& task = integrationTasks[i];
+            threadPool->start([&processTask, &task](){ processTask(task); });
+        }
+        processTask(integrationTasks[0]);
+        threadPool->wait();
+    }
+}
+
+
+void DyWorldBase::setSleepingEnabled(bool on)
+{
+    isSleepingEnabled_ = on;
+}
+
+
+void DyWorldBase::setSleepingThresholds(double linearVelocity, double angularVelocity, double time)
+{
+    sleepingLinearVelocity_ = linearVelocity;
+    sleepingAngularVelocity_ = angularVelocity;
+    sleepingTime_ = time;
+}
+
+
+int DyWorldBase::numSleepingSubBodies() const
+{
+    int n = 0;
+    for(auto& subBody : subBodies_){
+        if(subBody->isSleeping()){
+            ++n;
+        }
+    }
+    return n;
+}
+
+
+void DyWorldBase::initializeSleeping()
+{
+    numStepsToSleep = std::max(1, static_cast<int>(std::ceil(sleepingTime_ / timeStep_)));
+
+    for(auto& subBody : subBodies_){
+        subBody->isSleeping_ = false;
+        subBody->numRestingSteps = 0;
+        bool isSleepable = isSleepingEnabled_ && !subBody->isStatic_ && !subBody->forwardDynamicsCBM();
+        if(isSleepable){
+            if(subBody->rootLink()->body()->hasVirtualJointForces()){
+                isSleepable = false;
+            } else {
+                for(auto& link : subBody->links()){
+                    int mode = link->actuationMode();
+                    if(mode != Link::StateNone && mode != Link::JointEffort){
+                        isSleepable = false;
+                        break;
+                    }
+                }
+            }
+        }
+        subBody->isSleepable_ = isSleepable;
+    }
+
+    if(isSleepingEnabled_){
+        auto disableSleeping = [](Link* link){
+            if(link){
+                static_cast<DyLink*>(link)->subBody()->isSleepable_ = false;
+            }
+        };
+        for(auto& body : bodies_){
+            for(int i=0; i < body->numExtraJoints(); ++i){
+                auto& extraJoint = body->extraJoint(i);
+                disableSleeping(extraJoint.link(0));
+                disableSleeping(extraJoint.link(1));
+            }
+        }
+        for(auto& extraJoint : extraJoints_){
+            for(int i=0; i < 2; ++i){
+                if(auto body = this->body(extraJoint.bodyName(i))){
+                    for(auto& subBody : body->subBodies()){
+                        subBody->isSleepable_ = false;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void DyWorldBase::wakeUpDisturbedSubBodies()
+{
+    if(!isSleepingEnabled_){
+        return;
+    }
+    for(auto& subBody : subBodies_){
+        if(subBody->isSleeping_){
+            for(auto& link : subBody->links()){
+                if(link->F_ext() != Vector6::Zero() || link->u() != 0.0){
+                    subBody->wakeUp();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/**
+   The sleeping states are updated after the integration. A sub body must be resting for
+   numStepsToSleep steps to fall asleep, which prevents a body from sleeping at the moment
+   its velocity happens to be zero, e.g. at the top of a bounce.
+*/
+void DyWorldBase::updateSleepingStates()
+{
+    const double vmax2 = sleepingLinearVelocity_ * sleepingLinearVelocity_;
+    const double wmax2 = sleepingAngularVelocity_ * sleepingAngularVelocity_;
+
+    for(auto& subBody : subBodies_){
+        if(!subBody->isSleepable_ || subBody->isSleeping_){
+            continue;
+        }
+        bool isResting = true;
+        for(auto& link : subBody->links()){
+            if(link->v().squaredNorm() > vmax2 || link->w().squaredNorm() > wmax2 || link->u() != 0.0){
+                isResting = false;
+                break;
+            }
+        }
+        if(!isResting){
+            subBody->numRestingSteps = 0;
+        } else if(++subBody->numRestingSteps >= numStepsToSleep){
+            subBody->isSleeping_ = true;
+            for(auto& link : subBody->links()){
+                link->v().setZero();
+                link->w().setZero();
+                link->vo().setZero();
+                link->dv().setZero();
+                link->dw().setZero();
+                link->dvo().setZero();
+                link->dq() = 0.0;
+                link->ddq() = 0.0;
+            }
+        }
+    }
 }
 
 
@@ -99,18 +320,24 @@ void DyWorldBase::setVirtualJointForces()
 
 void DyWorldBase::calcNextState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->calcNextState();
+    forEachSubBody(
+        [](DySubBody* subBody){
+            if(!subBody->isSleeping()){
+                subBody->forwardDynamics()->calcNextState();
+            }
+        });
+
+    if(isSleepingEnabled_){
+        updateSleepingStates();
     }
+    
     currentTime_ += timeStep_;
 }
 
 
 void DyWorldBase::refreshState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->refreshState();
-    }
+    forEachSubBody([](DySubBody* subBody){ subBody->forwardDynamics()->refreshState(); });
 }
 
 
@@ -10,10 +10,13 @@
 #include "ExtraJoint.h"
 #include <string>
 #include <map>
+#include <memory>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+class ThreadPool;
+
 class CNOID_EXPORT DyWorldBase
 {
 public:
@@ -74,6 +77,38 @@ public:
     */
     void setRungeKuttaMethod();
 
+    /**
+       \brief Integrate the sub bodies in parallel
+       \param numThreads The number of threads used for the integration including the calling thread.
+       The value 1 disables the parallel integration, and the value 0 means the number of the hardware threads.
+       \param grainSize The minimum number of links integrated in a task. The sub bodies of a body are
+       always integrated in the same task.
+       \note This must be called before initialize() is called.
+       The results do not depend on the number of threads because the integration of each sub body is
+       independent of the others after the constraint forces are applied.
+    */
+    void setParallelIntegration(int numThreads, int grainSize = 32);
+    int numIntegrationThreads() const { return numIntegrationThreads_; }
+    int integrationGrainSize() const { return integrationGrainSize_; }
+
+    /**
+       \brief Enable the sleeping of the resting sub bodies
+       A sleeping sub body is not integrated and is treated as a static object by the constraint
+       force solver. A sub body falls asleep when the velocities of all its links have been below
+       the thresholds for the specified time, and it wakes up when it is touched by an awake body,
+       when an external force or a joint torque is applied to it, or when DySubBody::wakeUp is called.
+       Only the sub bodies whose joints are passive or torque-controlled and which are not connected
+       by extra joints can sleep, and a sub body does not sleep while a joint torque is applied to it.
+       \note This must be called before initialize() is called.
+    */
+    void setSleepingEnabled(bool on);
+    bool isSleepingEnabled() const { return isSleepingEnabled_; }
+    void setSleepingThresholds(double linearVelocity, double angularVelocity, double time);
+    double sleepingLinearVelocity() const { return sleepingLinearVelocity_; }
+    double sleepingAngularVelocity() const { return sleepingAngularVelocity_; }
+    double sleepingTime() const { return sleepingTime_; }
+    int numSleepingSubBodies() const;
+
     /**
        \brief initialize this world. This must be called after all bodies are registered.
     */
@@ -100,6 +135,10 @@ public:
     void clearExtraJoints() { extraJoints_.clear(); }
     void addExtraJoint(ExtraJoint& extraJoint){ extraJoints_.push_back(extraJoint); }
 
+protected:
+    //! This must be called before the constraint forces are calculated
+    void wakeUpDisturbedSubBodies();
+
 private:
     double currentTime_;
     double timeStep_;
@@ -126,7 +165,23 @@ private:
 
     std::vector<ExtraJoint> extraJoints_;
 
-    void extractInternalBodies(Link* link);    
+    int numIntegrationThreads_;
+    int integrationGrainSize_;
+    // The ranges of the sub body indices integrated as a task
+    std::vector<std::pair<int, int>> integrationTasks;
+    std::unique_ptr<ThreadPool> threadPool;
+
+    bool isSleepingEnabled_;
+    double sleepingLinearVelocity_;
+    double sleepingAngularVelocity_;
+    double sleepingTime_;
+    int numStepsToSleep;
+
+    void extractInternalBodies(Link* link);
+    void initializeIntegrationTasks();
+    void initializeSleeping();
+    void updateSleepingStates();
+    template<class Function> void forEachSubBody(Function func);
 };
 
 template <class TConstraintForceSolver> class DyWorld : public DyWorldBase
@@ -143,6 +198,7 @@ public:
 
     virtual void calcNextState(){
         DyWorldBase::setVirtualJointForces();
+        DyWorldBase::wakeUpDisturbedSubBodies();
         constraintForceSolver.solve();
         DyWorldBase::calcNextState();
     }
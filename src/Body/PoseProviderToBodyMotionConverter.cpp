@@ -9,6 +9,9 @@
 #include "BodyMotion.h"
 #include "ZMPSeq.h"
 #include "PoseProvider.h"
+#include <cnoid/ThreadPool>
+#include <cmath>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -17,6 +20,7 @@ using namespace cnoid;
 PoseProviderToBodyMotionConverter::PoseProviderToBodyMotionConverter()
 {
     setFullTimeRange();
+    clearUpdateTimeRange();
     allLinkPositionOutputMode = true;
 }
 
@@ -41,8 +45,34 @@ void PoseProviderToBodyMotionConverter::setAllLinkPositionOutput(bool on)
 }
 
 
+void PoseProviderToBodyMotionConverter::setUpdateTimeRange(double lower, double upper)
+{
+    updateLowerTime = lower;
+    updateUpperTime = upper;
+}
+
+
+void PoseProviderToBodyMotionConverter::clearUpdateTimeRange()
+{
+    updateLowerTime = -std::numeric_limits<double>::max();
+    updateUpperTime = std::numeric_limits<double>::max();
+}
+
+
 bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
 {
+    return convert(body, std::vector<PoseProvider*>{ provider }, motion);
+}
+
+
+bool PoseProviderToBodyMotionConverter::convert
+(Body* body, const std::vector<PoseProvider*>& providers, BodyMotion& motion)
+{
+    if(providers.empty()){
+        return false;
+    }
+    PoseProvider* provider = providers.front();
+    
     const double frameRate = motion.frameRate();
     const int beginningFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
     const int endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
@@ -50,10 +80,69 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
     
     motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
+    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
+
+    const int beginningFrameToUpdate = static_cast<int>(
+        std::max(static_cast<double>(beginningFrame), std::floor(frameRate * updateLowerTime)));
+    const int endingFrameToUpdate = static_cast<int>(
+        std::min(static_cast<double>(endingFrame), std::ceil(frameRate * updateUpperTime)));
+    const int numFramesToUpdate = endingFrameToUpdate - beginningFrameToUpdate + 1;
+    if(numFramesToUpdate <= 0){
+        return true;
+    }
+
+    const int numBlocks = std::min(static_cast<int>(providers.size()), numFramesToUpdate);
+    if(numBlocks == 1){
+        return convertFrames(body, provider, motion, zmpseq, beginningFrameToUpdate, endingFrameToUpdate);
+    }
 
+    const int blockSize = numFramesToUpdate / numBlocks;
+    const int remainder = numFramesToUpdate % numBlocks;
+    vector<int> blockBeginningFrames(numBlocks + 1);
+    int frame = beginningFrameToUpdate;
+    for(int i=0; i < numBlocks; ++i){
+        blockBeginningFrames[i] = frame;
+        frame += (i < remainder) ? (blockSize + 1) : blockSize;
+    }
+    blockBeginningFrames[numBlocks] = frame;
+
+    vector<BodyPtr> workerBodies(numBlocks);
+    for(int i=1; i < numBlocks; ++i){
+        workerBodies[i] = body->clone();
+    }
+    vector<char> results(numBlocks, false);
+    
+    ThreadPool threadPool(numBlocks - 1);
+    for(int i=1; i < numBlocks; ++i){
+        threadPool.start(
+            [&, i](){
+                results[i] = convertFrames(
+                    workerBodies[i], providers[i], motion, zmpseq,
+                    blockBeginningFrames[i], blockBeginningFrames[i+1] - 1);
+            });
+    }
+    results[0] = convertFrames(
+        body, provider, motion, zmpseq, blockBeginningFrames[0], blockBeginningFrames[1] - 1);
+    threadPool.wait();
+
+    for(auto& result : results){
+        if(!result){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool PoseProviderToBodyMotionConverter::convertFrames
+(Body* body, PoseProvider* provider, BodyMotion& motion, ZMPSeq& zmpseq, int beginningFrame, int endingFrame)
+{
+    const double frameRate = motion.frameRate();
+    const int numJoints = body->numJoints();
+    const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
+    
     MultiValueSeq& qseq = *motion.jointPosSeq();
     MultiSE3Seq& pseq = *motion.linkPosSeq();
-    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
     bool isZmpValid = false;
 
     Link* rootLink = body->rootLink();
@@ -77,7 +166,6 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     std::vector<stdx::optional<double>> jointPositions(numJoints);
 
     for(int frame = beginningFrame; frame <= endingFrame; ++frame){
-
         provider->seek(frame / frameRate);
 
         const int baseLinkIndex = provider->baseLinkIndex();
@@ -5,6 +5,7 @@
 #ifndef CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 #define CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -12,6 +13,7 @@ namespace cnoid {
 class Body;
 class BodyMotion;
 class PoseProvider;
+class ZMPSeq;
 
 class CNOID_EXPORT PoseProviderToBodyMotionConverter
 {
@@ -20,12 +22,35 @@ public:
     void setTimeRange(double lower, double upper);
     void setFullTimeRange();
     void setAllLinkPositionOutput(bool on);
+
+    /**
+       Limit the frames to regenerate to the specified time range.
+       The length of the motion is still determined by the time range given by setTimeRange
+       and the frames outside the update range are kept as they are.
+    */
+    void setUpdateTimeRange(double lower, double upper);
+    void clearUpdateTimeRange();
+    
     bool convert(Body* body, PoseProvider* provider, BodyMotion& motion);
 
+    /**
+       The frames are divided into the same number of blocks as the providers, and each block
+       is sampled by a different provider in a separate thread. The first provider is used
+       in the calling thread with the given body, and a clone of the body is used with each of
+       the other providers, which must not share any state with the other providers.
+    */
+    bool convert(Body* body, const std::vector<PoseProvider*>& providers, BodyMotion& motion);
+
 private:
     double lowerTime;
     double upperTime;
+    double updateLowerTime;
+    double updateUpperTime;
     bool allLinkPositionOutputMode;
+
+    bool convertFrames(
+        Body* body, PoseProvider* provider, BodyMotion& motion, ZMPSeq& zmpseq,
+        int beginningFrame, int endingFrame);
 };
 
 }
@@ -473,11 +473,17 @@ void SceneBody::updateLinkPositions()
 
 void SceneBody::updateLinkPositions(SgUpdate& update)
 {
+    /*
+      The updates of the links are notified as a transaction so that the upper nodes shared by
+      the links are notified only once. The transaction is merged into the outer one if the
+      positions are updated in a frame driven by a transaction.
+    */
+    SgUpdateTransaction transaction(update);
     const int n = sceneLinks_.size();
     for(int i=0; i < n; ++i){
         SceneLinkPtr& sLink = sceneLinks_[i];
         sLink->setPosition(sLink->link()->position());
-        sLink->notifyUpdate(update);
+        transaction.addModifiedObject(sLink);
     }
 }
 
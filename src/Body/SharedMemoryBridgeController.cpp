@@ -0,0 +1,120 @@
+/**
+   This controller relays the control of a body to a controller running in another process.
+   The states and commands are exchanged through the shared memory region created by
+   SharedMemoryControllerChannel, and the simulation proceeds in lockstep with the process.
+
+   The following options are available:
+   - shm=<name>: The name of the shared memory region. The default name is "/cnoid-<body name>".
+   - torque, position, velocity: The actuation mode of the joints. The default mode is torque.
+   - timeout=<seconds>: The time to wait for the commands of each step. The default value is 1.
+   - connection-timeout=<seconds>: The time to wait for the connection of the process.
+     The default value is 30. A negative value means waiting without timeout.
+*/
+
+#include "SharedMemoryControllerChannel.h"
+#include <cnoid/SimpleController>
+#include <cctype>
+
+using namespace std;
+using namespace cnoid;
+
+class SharedMemoryBridgeController : public SimpleController
+{
+    SimpleControllerIO* io;
+    BodyPtr ioBody;
+    SharedMemoryControllerChannel channel;
+    string name;
+    int actuationMode;
+    double timeout;
+    double connectionTimeout;
+    bool isConnectionNotified;
+
+public:
+    virtual bool initialize(SimpleControllerIO* io) override
+    {
+        this->io = io;
+        ioBody = io->body();
+
+        name = "/cnoid-";
+        for(auto& c : ioBody->name()){
+            name.push_back(isalnum(c) ? c : '_');
+        }
+        actuationMode = Link::JointEffort;
+        timeout = 1.0;
+        connectionTimeout = 30.0;
+
+        for(auto& option : io->options()){
+            if(option == "torque"){
+                actuationMode = Link::JointEffort;
+            } else if(option == "position"){
+                actuationMode = Link::JointDisplacement;
+            } else if(option == "velocity"){
+                actuationMode = Link::JointVelocity;
+            } else if(option.compare(0, 4, "shm=") == 0){
+                name = option.substr(4);
+                if(name.empty() || name[0] != '/'){
+                    name.insert(0, "/");
+                }
+            } else if(option.compare(0, 8, "timeout=") == 0){
+                timeout = std::stod(option.substr(8));
+            } else if(option.compare(0, 19, "connection-timeout=") == 0){
+                connectionTimeout = std::stod(option.substr(19));
+            } else {
+                io->os() << "SharedMemoryBridgeController: Unknown option \"" << option << "\"." << endl;
+            }
+        }
+
+        for(auto& joint : ioBody->joints()){
+            joint->setActuationMode(actuationMode);
+            io->enableIO(joint);
+        }
+        for(auto& link : ioBody->links()){
+            io->enableInput(link, LinkPosition | LinkTwist);
+        }
+        for(auto& device : ioBody->devices()){
+            io->enableInput(device);
+        }
+
+        if(!channel.create(name, ioBody, io->timeStep())){
+            io->os() << channel.errorMessage() << endl;
+            return false;
+        }
+        io->os() << "SharedMemoryBridgeController: Shared memory \"" << name
+                 << "\" is ready for the controller process." << endl;
+
+        isConnectionNotified = false;
+
+        return true;
+    }
+
+    virtual bool control() override
+    {
+        channel.writeState(ioBody, io->currentTime());
+        channel.publishState();
+
+        bool isConnected = channel.isConnected();
+        if(!channel.waitForCommand(isConnected ? timeout : connectionTimeout)){
+            if(channel.isConnected()){
+                io->os() << "SharedMemoryBridgeController: The controller process does not respond." << endl;
+            } else {
+                io->os() << "SharedMemoryBridgeController: The controller process is not connected." << endl;
+            }
+            return false;
+        }
+        if(!isConnectionNotified){
+            io->os() << "SharedMemoryBridgeController: The controller process has been connected." << endl;
+            isConnectionNotified = true;
+        }
+
+        channel.readCommand(ioBody);
+
+        return true;
+    }
+
+    virtual void stop() override
+    {
+        channel.close();
+    }
+};
+
+CNOID_IMPLEMENT_SIMPLE_CONTROLLER_FACTORY(SharedMemoryBridgeController)
@@ -0,0 +1,634 @@
+#include "SharedMemoryControllerChannel.h"
+#include "Body.h"
+#include "Camera.h"
+#include "RangeCamera.h"
+#include "RangeSensor.h"
+#include <fmt/format.h>
+#include <atomic>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr uint32_t Magic = 0x434e4f53; // "CNOS"
+constexpr uint32_t Version = 1;
+constexpr size_t Alignment = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Lock-free 64-bit atomics are required.");
+
+inline size_t align(size_t size)
+{
+    return (size + Alignment - 1) & ~(Alignment - 1);
+}
+
+/**
+   The sequence counters are waited by spinning. The thread yields the processor after a number
+   of spins so that the waiting does not starve the other process on a machine with few cores.
+*/
+template<class Predicate>
+bool spinWait(Predicate predicate, double timeout, const std::atomic<int32_t>& isTerminated)
+{
+    constexpr int NumSpinsBeforeYield = 1000;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::duration<double>(std::max(timeout, 0.0));
+    int count = 0;
+    while(!predicate()){
+        if(isTerminated.load(std::memory_order_acquire)){
+            return false;
+        }
+        if(++count >= NumSpinsBeforeYield){
+            std::this_thread::yield();
+            if(timeout >= 0.0 && std::chrono::steady_clock::now() > deadline){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+namespace cnoid {
+
+struct SharedMemoryControllerChannel::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t totalSize;
+    int32_t numJoints;
+    int32_t numLinks;
+    int32_t numDevices;
+    int32_t reserved;
+    double timeStep;
+    double time;
+    int64_t jointStateOffset;
+    int64_t jointCommandOffset;
+    int64_t linkStateOffset;
+    int64_t deviceSlotOffset;
+
+    // The counters are put in the different cache lines to avoid false sharing
+    alignas(64) std::atomic<uint64_t> stateSequence;
+    alignas(64) std::atomic<uint64_t> commandSequence;
+    alignas(64) std::atomic<int32_t> isConnected;
+    std::atomic<int32_t> isTerminated;
+};
+
+class SharedMemoryControllerChannel::Impl
+{
+public:
+    string name;
+    int fd;
+    unsigned char* memory;
+    size_t size;
+    bool isOwner;
+    uint64_t stateSequence;
+    vector<const void*> lastPayloadData;
+    vector<uint32_t> lastPayloadRevisions;
+
+    Impl();
+};
+
+}
+
+
+SharedMemoryControllerChannel::Impl::Impl()
+{
+    fd = -1;
+    memory = nullptr;
+    size = 0;
+    isOwner = false;
+    stateSequence = 0;
+}
+
+
+SharedMemoryControllerChannel::SharedMemoryControllerChannel()
+{
+    header = nullptr;
+    impl = new Impl;
+}
+
+
+SharedMemoryControllerChannel::~SharedMemoryControllerChannel()
+{
+    close();
+    delete impl;
+}
+
+
+bool SharedMemoryControllerChannel::create(const std::string& name, Body* body, double timeStep)
+{
+    close();
+
+#ifdef _WIN32
+    errorMessage_ = _("The shared memory controller channel is not supported on this platform.");
+    return false;
+#else
+    const int numJoints = body->numJoints();
+    const int numLinks = body->numLinks();
+    const int numDevices = body->numDevices();
+
+    size_t offset = align(sizeof(Header));
+    const size_t jointStateOffset = offset;
+    offset = align(offset + sizeof(JointState) * numJoints);
+    const size_t jointCommandOffset = offset;
+    offset = align(offset + sizeof(JointCommand) * numJoints);
+    const size_t linkStateOffset = offset;
+    offset = align(offset + sizeof(LinkState) * numLinks);
+    const size_t deviceSlotOffset = offset;
+    offset = align(offset + sizeof(DeviceSlot) * numDevices);
+
+    vector<DeviceSlot> slots(numDevices);
+    for(int i=0; i < numDevices; ++i){
+        auto device = body->device(i);
+        auto& slot = slots[i];
+        std::memset(&slot, 0, sizeof(slot));
+        slot.stateSize = device->stateSize();
+        slot.stateOffset = offset;
+        offset = align(offset + sizeof(double) * slot.stateSize);
+
+        /*
+          The payload capacity is determined by the specification of the device.
+          Note that the image of a range camera is not transferred.
+        */
+        size_t capacity = 0;
+        if(auto rangeCamera = dynamic_cast<RangeCamera*>(device)){
+            slot.payloadType = PointPayload;
+            capacity = sizeof(Vector3f) * rangeCamera->resolutionX() * rangeCamera->resolutionY();
+        } else if(auto camera = dynamic_cast<Camera*>(device)){
+            if(camera->imageType() != Camera::NO_IMAGE){
+                slot.payloadType = ImagePayload;
+                const int nc = (camera->imageType() == Camera::COLOR_IMAGE) ? 3 : 1;
+                capacity = nc * camera->resolutionX() * camera->resolutionY();
+            }
+        } else if(auto rangeSensor = dynamic_cast<RangeSensor*>(device)){
+            slot.payloadType = RangeDataPayload;
+            capacity = sizeof(double) * rangeSensor->numYawSamples() * rangeSensor->numPitchSamples();
+        }
+        if(capacity > 0){
+            slot.payloadOffset = offset;
+            slot.payloadCapacity = capacity;
+            offset = align(offset + capacity);
+        }
+    }
+    const size_t totalSize = offset;
+
+    ::shm_unlink(name.c_str());
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" cannot be created: {1}"), name, strerror(errno));
+        return false;
+    }
+    if(::ftruncate(fd, totalSize) != 0){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" cannot be allocated: {1}"), name, strerror(errno));
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory = ::mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(memory == MAP_FAILED){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" cannot be mapped: {1}"), name, strerror(errno));
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    impl->name = name;
+    impl->fd = fd;
+    impl->memory = static_cast<unsigned char*>(memory);
+    impl->size = totalSize;
+    impl->isOwner = true;
+    impl->stateSequence = 0;
+    impl->lastPayloadData.assign(numDevices, nullptr);
+
+    header = new(memory) Header;
+    header->totalSize = totalSize;
+    header->numJoints = numJoints;
+    header->numLinks = numLinks;
+    header->numDevices = numDevices;
+    header->reserved = 0;
+    header->timeStep = timeStep;
+    header->time = 0.0;
+    header->jointStateOffset = jointStateOffset;
+    header->jointCommandOffset = jointCommandOffset;
+    header->linkStateOffset = linkStateOffset;
+    header->deviceSlotOffset = deviceSlotOffset;
+    header->stateSequence.store(0);
+    header->commandSequence.store(0);
+    header->isConnected.store(0);
+    header->isTerminated.store(0);
+    std::copy(slots.begin(), slots.end(), reinterpret_cast<DeviceSlot*>(impl->memory + deviceSlotOffset));
+
+    // The initial commands keep the current joint states
+    for(int i=0; i < numJoints; ++i){
+        auto joint = body->joint(i);
+        auto& command = jointCommands()[i];
+        command.q = joint->q_target();
+        command.dq = joint->dq_target();
+        command.u = joint->u();
+    }
+
+    // The other side accepts the region after the magic number is set
+    std::atomic_thread_fence(std::memory_order_release);
+    header->version = Version;
+    header->magic = Magic;
+
+    errorMessage_.clear();
+    return true;
+#endif
+}
+
+
+bool SharedMemoryControllerChannel::open(const std::string& name)
+{
+    close();
+
+#ifdef _WIN32
+    errorMessage_ = _("The shared memory controller channel is not supported on this platform.");
+    return false;
+#else
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if(fd < 0){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" cannot be opened: {1}"), name, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" is not ready."), name);
+        ::close(fd);
+        return false;
+    }
+    const size_t size = st.st_size;
+    void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(memory == MAP_FAILED){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" cannot be mapped: {1}"), name, strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    auto header_ = static_cast<Header*>(memory);
+    if(header_->magic != Magic || header_->version != Version || header_->totalSize != size){
+        errorMessage_ = fmt::format(_("Shared memory \"{0}\" is not a valid controller channel."), name);
+        ::munmap(memory, size);
+        ::close(fd);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    impl->name = name;
+    impl->fd = fd;
+    impl->memory = static_cast<unsigned char*>(memory);
+    impl->size = size;
+    impl->isOwner = false;
+    impl->lastPayloadRevisions.assign(header_->numDevices, 0);
+
+    header = header_;
+    // The states published before the connection are skipped
+    impl->stateSequence = header->commandSequence.load(std::memory_order_acquire);
+    header->isConnected.store(1, std::memory_order_release);
+
+    errorMessage_.clear();
+    return true;
+#endif
+}
+
+
+void SharedMemoryControllerChannel::close()
+{
+#ifndef _WIN32
+    if(header){
+        if(impl->isOwner){
+            terminate();
+        } else {
+            header->isConnected.store(0, std::memory_order_release);
+        }
+        ::munmap(impl->memory, impl->size);
+        ::close(impl->fd);
+        if(impl->isOwner){
+            ::shm_unlink(impl->name.c_str());
+        }
+        header = nullptr;
+        impl->memory = nullptr;
+        impl->fd = -1;
+        impl->size = 0;
+        impl->isOwner = false;
+    }
+#endif
+}
+
+
+int SharedMemoryControllerChannel::numJoints() const
+{
+    return header->numJoints;
+}
+
+
+int SharedMemoryControllerChannel::numLinks() const
+{
+    return header->numLinks;
+}
+
+
+int SharedMemoryControllerChannel::numDevices() const
+{
+    return header->numDevices;
+}
+
+
+double SharedMemoryControllerChannel::timeStep() const
+{
+    return header->timeStep;
+}
+
+
+double SharedMemoryControllerChannel::time() const
+{
+    return header->time;
+}
+
+
+SharedMemoryControllerChannel::JointState* SharedMemoryControllerChannel::jointStates()
+{
+    return reinterpret_cast<JointState*>(impl->memory + header->jointStateOffset);
+}
+
+
+SharedMemoryControllerChannel::JointCommand* SharedMemoryControllerChannel::jointCommands()
+{
+    return reinterpret_cast<JointCommand*>(impl->memory + header->jointCommandOffset);
+}
+
+
+SharedMemoryControllerChannel::LinkState* SharedMemoryControllerChannel::linkStates()
+{
+    return reinterpret_cast<LinkState*>(impl->memory + header->linkStateOffset);
+}
+
+
+SharedMemoryControllerChannel::DeviceSlot& SharedMemoryControllerChannel::deviceSlot(int index)
+{
+    return reinterpret_cast<DeviceSlot*>(impl->memory + header->deviceSlotOffset)[index];
+}
+
+
+double* SharedMemoryControllerChannel::deviceState(int index)
+{
+    return reinterpret_cast<double*>(impl->memory + deviceSlot(index).stateOffset);
+}
+
+
+unsigned char* SharedMemoryControllerChannel::devicePayload(int index)
+{
+    auto& slot = deviceSlot(index);
+    return slot.payloadCapacity > 0 ? impl->memory + slot.payloadOffset : nullptr;
+}
+
+
+void SharedMemoryControllerChannel::writeState(const Body* body, double time)
+{
+    header->time = time;
+
+    const int nj = std::min(body->numJoints(), header->numJoints);
+    auto states = jointStates();
+    for(int i=0; i < nj; ++i){
+        auto joint = body->joint(i);
+        auto& state = states[i];
+        state.q = joint->q();
+        state.dq = joint->dq();
+        state.ddq = joint->ddq();
+        state.u = joint->u();
+    }
+
+    const int nl = std::min(body->numLinks(), header->numLinks);
+    auto linkStates_ = linkStates();
+    for(int i=0; i < nl; ++i){
+        auto link = body->link(i);
+        auto& state = linkStates_[i];
+        Eigen::Map<Vector3>(state.p) = link->p();
+        Eigen::Map<Vector4>(state.quaternion) = Quaternion(link->R()).coeffs();
+        Eigen::Map<Vector3>(state.v) = link->v();
+        Eigen::Map<Vector3>(state.w) = link->w();
+    }
+
+    const int nd = std::min(body->numDevices(), header->numDevices);
+    for(int i=0; i < nd; ++i){
+        auto device = body->device(i);
+        auto& slot = deviceSlot(i);
+        if(device->stateSize() == slot.stateSize){
+            device->writeState(deviceState(i));
+        }
+        if(slot.payloadType == NoPayload){
+            continue;
+        }
+        const void* data = nullptr;
+        const void* src = nullptr;
+        size_t size = 0;
+        if(slot.payloadType == PointPayload){
+            auto camera = static_cast<const RangeCamera*>(device);
+            auto points = camera->sharedPoints();
+            data = points.get();
+            if(data != impl->lastPayloadData[i] && !points->empty()){
+                src = points->front().data();
+                size = sizeof(Vector3f) * points->size();
+                slot.width = camera->resolutionX();
+                slot.height = camera->resolutionY();
+                slot.numComponents = 3;
+            }
+        } else if(slot.payloadType == ImagePayload){
+            auto image = static_cast<const Camera*>(device)->sharedImage();
+            data = image.get();
+            if(data != impl->lastPayloadData[i] && !image->empty()){
+                src = image->pixels();
+                size = image->width() * image->height() * image->numComponents();
+                slot.width = image->width();
+                slot.height = image->height();
+                slot.numComponents = image->numComponents();
+            }
+        } else if(slot.payloadType == RangeDataPayload){
+            auto rangeData = static_cast<const RangeSensor*>(device)->sharedRangeData();
+            data = rangeData.get();
+            if(data != impl->lastPayloadData[i] && !rangeData->empty()){
+                src = rangeData->data();
+                size = sizeof(double) * rangeData->size();
+            }
+        }
+        impl->lastPayloadData[i] = data;
+        if(src){
+            if(size > static_cast<size_t>(slot.payloadCapacity)){
+                // The data exceeding the capacity determined by the device specification is not sent
+                size = 0;
+            } else {
+                std::memcpy(devicePayload(i), src, size);
+            }
+            slot.payloadSize = size;
+            ++slot.payloadRevision;
+        }
+    }
+}
+
+
+void SharedMemoryControllerChannel::readCommand(Body* body)
+{
+    const int nj = std::min(body->numJoints(), header->numJoints);
+    auto commands = jointCommands();
+    for(int i=0; i < nj; ++i){
+        auto joint = body->joint(i);
+        auto& command = commands[i];
+        joint->q_target() = command.q;
+        joint->dq_target() = command.dq;
+        joint->u() = command.u;
+    }
+}
+
+
+void SharedMemoryControllerChannel::readState(Body* body)
+{
+    const int nj = std::min(body->numJoints(), header->numJoints);
+    auto states = jointStates();
+    for(int i=0; i < nj; ++i){
+        auto joint = body->joint(i);
+        auto& state = states[i];
+        joint->q() = state.q;
+        joint->dq() = state.dq;
+        joint->ddq() = state.ddq;
+        joint->u() = state.u;
+    }
+
+    const int nl = std::min(body->numLinks(), header->numLinks);
+    auto linkStates_ = linkStates();
+    for(int i=0; i < nl; ++i){
+        auto link = body->link(i);
+        auto& state = linkStates_[i];
+        link->p() = Eigen::Map<const Vector3>(state.p);
+        link->R() = Quaternion(Eigen::Map<const Vector4>(state.quaternion)).toRotationMatrix();
+        link->v() = Eigen::Map<const Vector3>(state.v);
+        link->w() = Eigen::Map<const Vector3>(state.w);
+    }
+
+    const int nd = std::min(body->numDevices(), header->numDevices);
+    for(int i=0; i < nd; ++i){
+        auto device = body->device(i);
+        auto& slot = deviceSlot(i);
+        if(device->stateSize() == slot.stateSize){
+            device->readState(deviceState(i));
+        }
+        if(slot.payloadType == NoPayload || slot.payloadRevision == impl->lastPayloadRevisions[i]){
+            continue;
+        }
+        impl->lastPayloadRevisions[i] = slot.payloadRevision;
+        const unsigned char* payload = devicePayload(i);
+        if(slot.payloadType == PointPayload){
+            if(auto camera = dynamic_cast<RangeCamera*>(device)){
+                auto& points = camera->newPoints();
+                points.resize(slot.payloadSize / sizeof(Vector3f));
+                if(!points.empty()){
+                    std::memcpy(points.front().data(), payload, slot.payloadSize);
+                }
+            }
+        } else if(slot.payloadType == ImagePayload){
+            if(auto camera = dynamic_cast<Camera*>(device)){
+                auto& image = camera->newImage();
+                if(slot.payloadSize > 0){
+                    image.setSize(slot.width, slot.height, slot.numComponents);
+                    std::memcpy(image.pixels(), payload, slot.payloadSize);
+                } else {
+                    image.reset();
+                }
+            }
+        } else if(slot.payloadType == RangeDataPayload){
+            if(auto sensor = dynamic_cast<RangeSensor*>(device)){
+                auto& rangeData = sensor->newRangeData();
+                rangeData.resize(slot.payloadSize / sizeof(double));
+                if(!rangeData.empty()){
+                    std::memcpy(rangeData.data(), payload, slot.payloadSize);
+                }
+            }
+        }
+    }
+}
+
+
+void SharedMemoryControllerChannel::writeCommand(const Body* body)
+{
+    const int nj = std::min(body->numJoints(), header->numJoints);
+    auto commands = jointCommands();
+    for(int i=0; i < nj; ++i){
+        auto joint = body->joint(i);
+        auto& command = commands[i];
+        command.q = joint->q_target();
+        command.dq = joint->dq_target();
+        command.u = joint->u();
+    }
+}
+
+
+void SharedMemoryControllerChannel::publishState()
+{
+    header->stateSequence.store(++impl->stateSequence, std::memory_order_release);
+}
+
+
+bool SharedMemoryControllerChannel::waitForCommand(double timeout)
+{
+    const uint64_t sequence = impl->stateSequence;
+    auto& commandSequence = header->commandSequence;
+    return spinWait(
+        [&](){ return commandSequence.load(std::memory_order_acquire) == sequence; },
+        timeout, header->isTerminated);
+}
+
+
+bool SharedMemoryControllerChannel::waitForState(double timeout)
+{
+    auto& stateSequence = header->stateSequence;
+    uint64_t sequence = 0;
+    if(!spinWait(
+           [&](){
+               sequence = stateSequence.load(std::memory_order_acquire);
+               return sequence != impl->stateSequence; },
+           timeout, header->isTerminated)){
+        return false;
+    }
+    impl->stateSequence = sequence;
+    return true;
+}
+
+
+void SharedMemoryControllerChannel::publishCommand()
+{
+    header->commandSequence.store(impl->stateSequence, std::memory_order_release);
+}
+
+
+bool SharedMemoryControllerChannel::isConnected() const
+{
+    return header && header->isConnected.load(std::memory_order_acquire);
+}
+
+
+bool SharedMemoryControllerChannel::isTerminated() const
+{
+    return !header || header->isTerminated.load(std::memory_order_acquire);
+}
+
+
+void SharedMemoryControllerChannel::terminate()
+{
+    if(header){
+        header->isTerminated.store(1, std::memory_order_release);
+    }
+}
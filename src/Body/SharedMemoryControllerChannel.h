@@ -0,0 +1,160 @@
+#ifndef CNOID_BODY_SHARED_MEMORY_CONTROLLER_CHANNEL_H
+#define CNOID_BODY_SHARED_MEMORY_CONTROLLER_CHANNEL_H
+
+#include <string>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class implements the communication between the simulator and a controller running in
+   another process using a POSIX shared memory region.
+
+   The simulator side creates the region with the create function, and the controller process
+   attaches to it with the open function. The region contains the joint states, the joint commands,
+   the link states and the device states of a body as plain arrays, and the data is exchanged
+   without any serialization. The image, point cloud and range data of vision sensors are also
+   put in the region as the payloads of the devices.
+
+   The simulator and the controller are synchronized by two sequence counters in the region.
+   The simulator writes the states and increments the state sequence, and the controller writes
+   the commands and sets the command sequence to the state sequence it has processed. Waiting for
+   the counters is done by spinning, so the control loop can be run at kHz rates without any
+   system call.
+*/
+class CNOID_EXPORT SharedMemoryControllerChannel
+{
+public:
+    struct JointState {
+        double q;
+        double dq;
+        double ddq;
+        double u;
+    };
+
+    struct JointCommand {
+        double q;
+        double dq;
+        double u;
+    };
+
+    struct LinkState {
+        double p[3];
+        //! The rotation as a quaternion of the order x, y, z, w
+        double quaternion[4];
+        double v[3];
+        double w[3];
+    };
+
+    enum PayloadType { NoPayload, ImagePayload, PointPayload, RangeDataPayload };
+
+    struct DeviceSlot {
+        int32_t stateSize;
+        int32_t payloadType;
+        int64_t stateOffset;
+        int64_t payloadOffset;
+        int64_t payloadCapacity;
+        //! The size of the current payload in bytes
+        int64_t payloadSize;
+        //! The image size of ImagePayload. The width and height are also set for PointPayload.
+        int32_t width;
+        int32_t height;
+        int32_t numComponents;
+        //! This is incremented when the payload is updated
+        uint32_t payloadRevision;
+    };
+
+    SharedMemoryControllerChannel();
+    ~SharedMemoryControllerChannel();
+
+    SharedMemoryControllerChannel(const SharedMemoryControllerChannel&) = delete;
+    SharedMemoryControllerChannel& operator=(const SharedMemoryControllerChannel&) = delete;
+
+    /**
+       Create the shared memory region for the body. This is called by the simulator side.
+       The existing region with the same name is replaced.
+       \param name The name of the region, which must begin with '/'
+    */
+    bool create(const std::string& name, Body* body, double timeStep);
+
+    //! Attach to the region created by the simulator. This is called by the controller process.
+    bool open(const std::string& name);
+
+    //! The region is unlinked if this object has created it.
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+    const std::string& errorMessage() const { return errorMessage_; }
+
+    int numJoints() const;
+    int numLinks() const;
+    int numDevices() const;
+    double timeStep() const;
+    //! The simulation time of the current state
+    double time() const;
+
+    JointState* jointStates();
+    JointCommand* jointCommands();
+    LinkState* linkStates();
+    DeviceSlot& deviceSlot(int index);
+    double* deviceState(int index);
+    unsigned char* devicePayload(int index);
+
+    /**
+       Copy the states of the body into the region. Only the device payloads updated since the
+       last call are copied. This is called by the simulator side.
+    */
+    void writeState(const Body* body, double time);
+
+    //! Copy the commands in the region to the joints according to their actuation modes.
+    void readCommand(Body* body);
+
+    /**
+       Copy the states in the region to the body. This is called by the controller process.
+       The images, points and range data of the devices are replaced when their payloads have
+       been updated.
+    */
+    void readState(Body* body);
+
+    //! Copy the joint commands of the body into the region.
+    void writeCommand(const Body* body);
+
+    //! The simulator side notifies the controller of the new state.
+    void publishState();
+
+    /**
+       The simulator side waits until the controller processes the current state.
+       \param timeout The timeout in seconds. A negative value means waiting without timeout.
+       \return false if the timeout expires or the channel is terminated.
+    */
+    bool waitForCommand(double timeout);
+
+    /**
+       The controller process waits until the simulator publishes a new state.
+       \return false if the timeout expires or the channel is terminated.
+    */
+    bool waitForState(double timeout);
+
+    //! The controller process notifies the simulator that the commands for the current state are ready.
+    void publishCommand();
+
+    bool isConnected() const;
+    bool isTerminated() const;
+    //! Notify the other side that the communication has finished
+    void terminate();
+
+    class Impl;
+
+private:
+    struct Header;
+    Header* header;
+    Impl* impl;
+    std::string errorMessage_;
+};
+
+}
+
+#endif
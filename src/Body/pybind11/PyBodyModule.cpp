@@ -17,6 +17,8 @@ namespace py = pybind11;
 
 namespace {
 
+typedef py::call_guard<py::gil_scoped_release> release_gil;
+
 using Matrix4RM = Eigen::Matrix<double, 4, 4, Eigen::RowMajor>;
 
 }
@@ -46,12 +48,12 @@ PYBIND11_MODULE(Body, m)
         .def("setShapeLoadingEnabled", &AbstractBodyLoader::setShapeLoadingEnabled)
         .def("setDefaultDivisionNumber", &AbstractBodyLoader::setDefaultDivisionNumber)
         .def("setDefaultCreaseAngle", &AbstractBodyLoader::setDefaultCreaseAngle)
-        .def("load", &AbstractBodyLoader::load)
+        .def("load", &AbstractBodyLoader::load, release_gil())
         ;
 
     py::class_<BodyLoader, AbstractBodyLoader>(m, "BodyLoader")
         .def(py::init<>())
-        .def("load", (Body*(BodyLoader::*)(const string&))&BodyLoader::load)
+        .def("load", (Body*(BodyLoader::*)(const string&))&BodyLoader::load, release_gil())
         .def("lastActualBodyLoader", &BodyLoader::lastActualBodyLoader)
         ;
 
@@ -6,7 +6,11 @@
 #include "../Device.h"
 #include "../Link.h"
 #include "../ForceSensor.h"
+#include "../Camera.h"
+#include "../RangeCamera.h"
+#include "../RangeSensor.h"
 #include <cnoid/PyUtil>
+#include <cnoid/PyArrayView>
 
 using namespace std;
 using namespace cnoid;
@@ -16,6 +20,42 @@ namespace {
 
 using Matrix4RM = Eigen::Matrix<double, 4, 4, Eigen::RowMajor>;
 
+/*
+  The following functions return read-only arrays sharing the current sensor data.
+  The data is kept alive by the arrays even if the sensor replaces it with new data.
+*/
+
+py::array getCameraImageArray(const Camera& camera)
+{
+    auto image = camera.sharedImage();
+    static unsigned char dummy;
+    const unsigned char* pixels = image->empty() ? &dummy : image->pixels();
+    const int nc = image->numComponents();
+    return makePyArrayView<unsigned char>(
+        pixels, { image->height(), image->width(), nc }, { image->width() * nc, nc, 1 },
+        makePySharedPtrCapsule(image), false);
+}
+
+py::array getRangeCameraPointArray(const RangeCamera& camera)
+{
+    auto points = camera.sharedPoints();
+    static Vector3f dummy;
+    const float* data = points->empty() ? dummy.data() : points->front().data();
+    return makePyArrayView<float>(
+        data, { static_cast<py::ssize_t>(points->size()), 3 }, { sizeof(Vector3f), sizeof(float) },
+        makePySharedPtrCapsule(points), false);
+}
+
+py::array getRangeSensorRangeDataArray(const RangeSensor& sensor)
+{
+    std::shared_ptr<const RangeSensor::RangeData> rangeData = sensor.sharedRangeData();
+    static double dummy;
+    const double* data = rangeData->empty() ? &dummy : rangeData->data();
+    return makePyArrayView<double>(
+        data, { static_cast<py::ssize_t>(rangeData->size()) }, { sizeof(double) },
+        makePySharedPtrCapsule(rangeData), false);
+}
+
 }
 
 namespace cnoid {
@@ -49,6 +89,54 @@ void exportPyDeviceTypes(py::module& m)
         .def("getLink", (Link*(Device::*)())&Device::link)
         ;
 
+    py::class_<VisionSensor, VisionSensorPtr, Device>(m, "VisionSensor")
+        .def_property("frameRate", &VisionSensor::frameRate, &VisionSensor::setFrameRate)
+        .def("setFrameRate", &VisionSensor::setFrameRate)
+        ;
+
+    py::class_<Camera, CameraPtr, VisionSensor> camera(m, "Camera");
+
+    py::enum_<Camera::ImageType>(camera, "ImageType")
+        .value("NO_IMAGE", Camera::NO_IMAGE)
+        .value("COLOR_IMAGE", Camera::COLOR_IMAGE)
+        .value("GRAYSCALE_IMAGE", Camera::GRAYSCALE_IMAGE)
+        .export_values();
+
+    camera
+        .def(py::init<>())
+        .def_property("imageType", &Camera::imageType, &Camera::setImageType)
+        .def("setImageType", &Camera::setImageType)
+        .def_property("fieldOfView", &Camera::fieldOfView, &Camera::setFieldOfView)
+        .def("setFieldOfView", &Camera::setFieldOfView)
+        .def_property_readonly("resolutionX", &Camera::resolutionX)
+        .def_property_readonly("resolutionY", &Camera::resolutionY)
+        .def("setResolution", &Camera::setResolution)
+        .def("imageArray", &getCameraImageArray)
+        ;
+
+    py::class_<RangeCamera, RangeCameraPtr, Camera>(m, "RangeCamera")
+        .def(py::init<>())
+        .def_property_readonly("numPoints", &RangeCamera::numPoints)
+        .def_property("minDistance", &RangeCamera::minDistance, &RangeCamera::setMinDistance)
+        .def("setMinDistance", &RangeCamera::setMinDistance)
+        .def_property("maxDistance", &RangeCamera::maxDistance, &RangeCamera::setMaxDistance)
+        .def("setMaxDistance", &RangeCamera::setMaxDistance)
+        .def("pointArray", &getRangeCameraPointArray)
+        ;
+
+    py::class_<RangeSensor, RangeSensorPtr, VisionSensor>(m, "RangeSensor")
+        .def(py::init<>())
+        .def_property("yawRange", &RangeSensor::yawRange, &RangeSensor::setYawRange)
+        .def("setYawRange", &RangeSensor::setYawRange)
+        .def_property("pitchRange", &RangeSensor::pitchRange, &RangeSensor::setPitchRange)
+        .def("setPitchRange", &RangeSensor::setPitchRange)
+        .def_property("minDistance", &RangeSensor::minDistance, &RangeSensor::setMinDistance)
+        .def("setMinDistance", &RangeSensor::setMinDistance)
+        .def_property("maxDistance", &RangeSensor::maxDistance, &RangeSensor::setMaxDistance)
+        .def("setMaxDistance", &RangeSensor::setMaxDistance)
+        .def("rangeDataArray", &getRangeSensorRangeDataArray)
+        ;
+
     PyDeviceList<Device>(m, "DeviceList");
     PyDeviceList<ForceSensor>(m, "ForceSensorList");
 }
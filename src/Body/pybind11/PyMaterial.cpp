@@ -72,7 +72,8 @@ void exportPyMaterial(py::module& m)
     py::class_<MaterialTable, MaterialTablePtr, Referenced>(m, "MaterialTable")
         .def(py::init<>())
         .def(py::init<const MaterialTable&>())
-        .def("load", [](MaterialTable& self, const std::string& filename){ return self.load(filename); })
+        .def("load", [](MaterialTable& self, const std::string& filename){ return self.load(filename); },
+             py::call_guard<py::gil_scoped_release>())
         .def_property_readonly("maxMaterialId", &MaterialTable::maxMaterialId)
         .def("material", &MaterialTable::material)
         .def("contactMaterial",
@@ -22,6 +22,7 @@
 #include <cnoid/IdPair>
 #include <fmt/format.h>
 #include <mutex>
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include "gettext.h"
@@ -97,6 +98,12 @@ public:
     bool isKinematicWalkingEnabled;
     bool isOldAccelSensorMode;
     bool hasNonRootFreeJoints;
+    int numIntegrationThreads;
+    int integrationGrainSize;
+    bool isSleepingEnabled;
+    double sleepingLinearVelocity;
+    double sleepingAngularVelocity;
+    double sleepingTime;
 
     stdx::optional<int> forcedBodyPositionFunctionId;
     std::mutex forcedBodyPositionMutex;
@@ -169,6 +176,12 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     is2Dmode = false;
     isOldAccelSensorMode = false;
     hasNonRootFreeJoints = false;
+    numIntegrationThreads = 1;
+    integrationGrainSize = 32;
+    isSleepingEnabled = false;
+    sleepingLinearVelocity = world.sleepingLinearVelocity();
+    sleepingAngularVelocity = world.sleepingAngularVelocity();
+    sleepingTime = world.sleepingTime();
 
     mv = MessageView::instance();
 }
@@ -200,6 +213,12 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self, const Impl& org)
     isKinematicWalkingEnabled = org.isKinematicWalkingEnabled;
     is2Dmode = org.is2Dmode;
     isOldAccelSensorMode = org.isOldAccelSensorMode;
+    numIntegrationThreads = org.numIntegrationThreads;
+    integrationGrainSize = org.integrationGrainSize;
+    isSleepingEnabled = org.isSleepingEnabled;
+    sleepingLinearVelocity = org.sleepingLinearVelocity;
+    sleepingAngularVelocity = org.sleepingAngularVelocity;
+    sleepingTime = org.sleepingTime;
 
     mv = MessageView::instance();
 }
@@ -330,6 +349,32 @@ void AISTSimulatorItem::setKinematicWalkingEnabled(bool on)
 }
 
 
+void AISTSimulatorItem::setNumIntegrationThreads(int n)
+{
+    impl->numIntegrationThreads = std::max(0, n);
+}
+
+
+void AISTSimulatorItem::setIntegrationGrainSize(int numLinks)
+{
+    impl->integrationGrainSize = std::max(1, numLinks);
+}
+
+
+void AISTSimulatorItem::setSleepingEnabled(bool on)
+{
+    impl->isSleepingEnabled = on;
+}
+
+
+void AISTSimulatorItem::setSleepingThresholds(double linearVelocity, double angularVelocity, double time)
+{
+    impl->sleepingLinearVelocity = linearVelocity;
+    impl->sleepingAngularVelocity = angularVelocity;
+    impl->sleepingTime = time;
+}
+
+
 void AISTSimulatorItem::setConstraintForceOutputEnabled(bool /* on */)
 {
 
@@ -415,6 +460,9 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     world.setOldAccelSensorCalcMode(isOldAccelSensorMode);
     world.setTimeStep(self->worldTimeStep());
     world.setCurrentTime(0.0);
+    world.setParallelIntegration(numIntegrationThreads, integrationGrainSize);
+    world.setSleepingEnabled(isSleepingEnabled && dynamicsMode.is(FORWARD_DYNAMICS));
+    world.setSleepingThresholds(sleepingLinearVelocity, sleepingAngularVelocity, sleepingTime);
 
     ConstraintForceSolver& cfs = world.constraintForceSolver;
     cfs.setMaterialTable(self->worldItem()->materialTable());
@@ -686,6 +734,9 @@ void AISTSimulatorItem::Impl::doSetForcedPosition()
     rootLink->v().setZero();
     rootLink->w().setZero();
     rootLink->vo().setZero();
+    for(auto& subBody : forcedPositionBody->subBodies()){
+        subBody->wakeUp();
+    }
     forcedPositionBody->calcSpatialForwardKinematics();
 }
 
@@ -724,6 +775,13 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
     putProperty(_("Old accel sensor mode"), isOldAccelSensorMode, changeProperty(isOldAccelSensorMode));
+    putProperty.min(0)(_("Integration threads"), numIntegrationThreads, changeProperty(numIntegrationThreads));
+    putProperty.min(1)(_("Integration grain size"), integrationGrainSize, changeProperty(integrationGrainSize));
+    putProperty(_("Sleeping"), isSleepingEnabled, changeProperty(isSleepingEnabled));
+    putProperty.reset().decimals(3).min(0.0);
+    putProperty(_("Sleeping velocity"), sleepingLinearVelocity, changeProperty(sleepingLinearVelocity));
+    putProperty(_("Sleeping angular velocity"), sleepingAngularVelocity, changeProperty(sleepingAngularVelocity));
+    putProperty.decimals(2)(_("Sleeping time"), sleepingTime, changeProperty(sleepingTime));
 }
 
 
@@ -750,6 +808,12 @@ bool AISTSimulatorItem::Impl::store(Archive& archive)
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
     archive.write("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.write("integration_threads", numIntegrationThreads);
+    archive.write("integration_grain_size", integrationGrainSize);
+    archive.write("sleeping", isSleepingEnabled);
+    archive.write("sleeping_linear_velocity", sleepingLinearVelocity);
+    archive.write("sleeping_angular_velocity", sleepingAngularVelocity);
+    archive.write("sleeping_time", sleepingTime);
     return true;
 }
 
@@ -782,5 +846,11 @@ bool AISTSimulatorItem::Impl::restore(const Archive& archive)
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
     archive.read("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.read("integration_threads", numIntegrationThreads);
+    archive.read("integration_grain_size", integrationGrainSize);
+    archive.read("sleeping", isSleepingEnabled);
+    archive.read("sleeping_linear_velocity", sleepingLinearVelocity);
+    archive.read("sleeping_angular_velocity", sleepingAngularVelocity);
+    archive.read("sleeping_time", sleepingTime);
     return true;
 }
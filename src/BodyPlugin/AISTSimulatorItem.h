@@ -43,6 +43,21 @@ public:
     void set2Dmode(bool on);
     void setKinematicWalkingEnabled(bool on);
 
+    /**
+       Set the number of threads used to integrate the bodies. The value 0 means the number
+       of the hardware threads. The results of the simulation do not depend on this value.
+    */
+    void setNumIntegrationThreads(int n);
+    //! Set the minimum number of links integrated by a thread in a task
+    void setIntegrationGrainSize(int numLinks);
+
+    /**
+       Enable the sleeping of the resting passive bodies. See DyWorldBase::setSleepingEnabled
+       for the details.
+    */
+    void setSleepingEnabled(bool on);
+    void setSleepingThresholds(double linearVelocity, double angularVelocity, double time);
+
     [[deprecated("This function does nothing. Set Link::LinkContactState to Link::sensingMode from a controller.")]]
     void setConstraintForceOutputEnabled(bool on);
 
@@ -40,6 +40,8 @@ public:
     Impl(BodyMotionEngine* self, BodyItem* bodyItem, BodyMotionItem* motionItem);
     void updateExtraSeqEngines();
     bool onTimeChanged(double time);
+    bool updateBodyKinematicState(double time);
+    bool onBodyKinematicStateUpdated(double time);
     double onPlaybackStopped(double time, bool isStoppedManually);    
 };
 
@@ -150,7 +152,36 @@ bool BodyMotionEngine::onTimeChanged(double time)
 }
 
 
+Referenced* BodyMotionEngine::concurrentTimeChangeTarget()
+{
+    return impl->body;
+}
+
+
+bool BodyMotionEngine::onTimeChangedConcurrently(double time)
+{
+    return impl->updateBodyKinematicState(time);
+}
+
+
+bool BodyMotionEngine::onConcurrentTimeChangeFinished(double time)
+{
+    return impl->onBodyKinematicStateUpdated(time);
+}
+
+
 bool BodyMotionEngine::Impl::onTimeChanged(double time)
+{
+    bool isActive = updateBodyKinematicState(time);
+    isActive |= onBodyKinematicStateUpdated(time);
+    return isActive;
+}
+
+
+/**
+   This function only updates the body object so that it can be executed in a worker thread.
+*/
+bool BodyMotionEngine::Impl::updateBodyKinematicState(double time)
 {
     bool isActive = false;
     bool needFk = false;
@@ -204,6 +235,14 @@ bool BodyMotionEngine::Impl::onTimeChanged(double time)
     if(needFk){
         body->calcForwardKinematics();
     }
+
+    return isActive;
+}
+
+
+bool BodyMotionEngine::Impl::onBodyKinematicStateUpdated(double time)
+{
+    bool isActive = false;
     
     for(size_t i=0; i < extraSeqEngines.size(); ++i){
         isActive |= extraSeqEngines[i]->onTimeChanged(time);
@@ -34,6 +34,9 @@ public:
         
     virtual void onPlaybackStarted(double time) override;
     virtual bool onTimeChanged(double time) override;
+    virtual Referenced* concurrentTimeChangeTarget() override;
+    virtual bool onTimeChangedConcurrently(double time) override;
+    virtual bool onConcurrentTimeChangeFinished(double time) override;
     virtual double onPlaybackStopped(double time, bool isStoppedManually) override;
     
 private:
@@ -16,10 +16,12 @@
 #include "SimpleControllerItem.h"
 #include "BodyMotionControllerItem.h"
 #include "RegionIntrusionDetectorItem.h"
+#include "MultiRegionIntrusionDetectorItem.h"
 #include "ControllerLogItem.h"
 #include "BodyContactPointLoggerItem.h"
 #include "SubSimulatorItem.h"
 #include "GLVisionSimulatorItem.h"
+#include "RayCastRangeSensorSimulatorItem.h"
 #include "SimulationScriptItem.h"
 #include "BodyMotionItem.h"
 #include "ZMPSeqItem.h"
@@ -109,10 +111,12 @@ bool BodyPlugin::initialize()
     SimpleControllerItem::initializeClass(this);
     BodyMotionControllerItem::initializeClass(this);
     RegionIntrusionDetectorItem::initializeClass(this);
+    MultiRegionIntrusionDetectorItem::initializeClass(this);
     ControllerLogItem::initializeClass(this);
     BodyContactPointLoggerItem::initializeClass(this);
     SubSimulatorItem::initializeClass(this);
     GLVisionSimulatorItem::initializeClass(this);
+    RayCastRangeSensorSimulatorItem::initializeClass(this);
     SimulationScriptItem::initializeClass(this);
     BodyMotionItem::initializeClass(this);
     WorldLogFileItem::initializeClass(this);
@@ -7,6 +7,7 @@
 #include "SimulatorItem.h"
 #include "WorldItem.h"
 #include "FisheyeLensConverter.h"
+#include "NameListUtil.h"
 #include <cnoid/ItemManager>
 #include <cnoid/MessageView>
 #include <cnoid/PutPropertyFunction>
@@ -25,8 +26,6 @@
 #include <cnoid/SceneLights>
 #include <cnoid/CloneMap>
 #include <cnoid/EigenUtil>
-#include <cnoid/StringUtil>
-#include <cnoid/Tokenizer>
 #include <QThread>
 #include <QApplication>
 #include <QOpenGLContext>
@@ -61,33 +60,6 @@ enum ScreenId {
     BACK_SCREEN = FisheyeLensConverter::BACK_SCREEN
 };
 
-string getNameListString(const vector<string>& names)
-{
-    string nameList;
-    if(!names.empty()){
-        size_t n = names.size() - 1;
-        for(size_t i=0; i < n; ++i){
-            nameList += names[i];
-            nameList += ", ";
-        }
-        nameList += names.back();
-    }
-    return nameList;
-}
-
-bool updateNames(const string& nameListString, string& out_newNameListString, vector<string>& out_names)
-{
-    out_names.clear();
-    for(auto& token : Tokenizer<CharSeparator<char>>(nameListString, CharSeparator<char>(","))){
-        auto name = trimmed(token);
-        if(!name.empty()){
-            out_names.push_back(name);
-        }
-    }
-    out_newNameListString = nameListString;
-    return true;
-}
-
 class QThreadEx : public QThread
 {
     std::function<void()> function;
@@ -8,13 +8,13 @@
 #include "WorldItem.h"
 #include "BodySelectionManager.h"
 #include <cnoid/RootItem>
-#include <cnoid/BodyState>
 #include <cnoid/Archive>
 #include <cnoid/MainWindow>
 #include <cnoid/ExtensionManager>
 #include <cnoid/MainMenu>
 #include <cnoid/TimeBar>
 #include <cnoid/MessageView>
+#include <cnoid/LazyCaller>
 #include <cnoid/SpinBox>
 #include <cnoid/Buttons>
 #include <cnoid/CheckBox>
@@ -24,12 +24,18 @@
 #include <cnoid/BodyCollisionDetector>
 #include <cnoid/AISTCollisionDetector>
 #include <cnoid/IdPair>
+#include <cnoid/ThreadPool>
 #include <QDialogButtonBox>
 #include <QBoxLayout>
 #include <QFrame>
 #include <QLabel>
 #include <fmt/format.h>
 #include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "gettext.h"
 
 using namespace std;
@@ -38,10 +44,11 @@ using fmt::format;
 
 namespace {
 
-bool USE_DUPLICATED_BODY = false;
-
 KinematicFaultChecker* checkerInstance = nullptr;
 
+// Upper limit of the number of sub-frame poses checked between two consecutive frames
+const int MaxNumSubFrames = 100;
+
 #if defined(_MSC_VER) && _MSC_VER < 1800
 inline long lround(double x) {
     return static_cast<long>((x > 0.0) ? floor(x + 0.5) : ceil(x -0.5));
@@ -70,14 +77,17 @@ public:
         
     DoubleSpinBox velocityLimitRatioSpin;
     CheckBox collisionCheck;
+    CheckBox interFrameCollisionCheck;
+    DoubleSpinBox interFrameResolutionSpin;
 
     CheckBox onlyTimeBarRangeCheck;
+    SpinBox numThreadsSpin;
+    PushButton* applyButton;
 
     int numFaults;
     vector<int> lastPosFaultFrames;
     vector<int> lastVelFaultFrames;
-    typedef IdPair<CollisionDetector::GeometryHandle> GeometryPair;
-    typedef std::map<GeometryPair, int> LastCollisionFrameMap;
+    typedef std::map<IdPair<int>, int> LastCollisionFrameMap;
     LastCollisionFrameMap lastCollisionFrames;
 
     double frameRate;
@@ -85,17 +95,96 @@ public:
     double translationMargin;
     double velocityLimitRatio;
 
+    /**
+       A collision found by a worker thread. The time of the collision is
+       (frame - 1 + ratio) / frameRate, where ratio is 1.0 for the collision
+       at the frame itself and less than 1.0 for the collision found in the
+       interpolated pose between the previous frame and the frame.
+    */
+    struct CollisionRecord
+    {
+        int frame;
+        double ratio;
+        int linkIndex0;
+        int linkIndex1;
+    };
+
+    struct FrameChunk
+    {
+        int beginningFrame;
+        int endingFrame;
+        vector<CollisionRecord> collisions;
+        bool isDone;
+    };
+
+    struct CollisionCheckWorker
+    {
+        BodyPtr body;
+        BodyCollisionDetector bodyCollisionDetector;
+        vector<Isometry3> prevLinkPositions;
+        vector<double> linkRadii;
+    };
+
+    struct CheckRequest
+    {
+        BodyItemPtr bodyItem;
+        BodyMotionItemPtr motionItem;
+        vector<bool> linkSelection;
+        double beginningTime;
+        double endingTime;
+    };
+    vector<CheckRequest> pendingRequests;
+
+    // The state of the running check
+    bool isChecking;
+    bool isAsyncCheck;
+    BodyPtr body;
+    shared_ptr<const MultiValueSeq> qseq;
+    shared_ptr<const MultiSE3Seq> pseq;
+    bool checkPosition;
+    bool checkVelocity;
+    vector<bool> linkSelection;
+    int numJoints;
+    int numLinks;
+    int beginningFrame;
+    int endingFrame;
+    int currentFrame;
+    int currentChunkIndex;
+    bool doInterFrameCollisionCheck;
+    double interFrameResolution;
+    vector<FrameChunk> frameChunks;
+    vector<unique_ptr<CollisionCheckWorker>> workers;
+    unique_ptr<ThreadPool> threadPool;
+    std::atomic<int> nextChunkIndex;
+    std::mutex chunkMutex;
+    std::condition_variable chunkCondition;
+
     Impl();
+    ~Impl();
     bool store(Archive& archive);
     void restore(const Archive& archive);
     void apply();
+    void startNextRequest();
+    void onCheckFinished();
+    void onChunkCompletedAsync();
     int checkFaults(
         BodyItem* bodyItem, BodyMotionItem* motionItem,
         bool checkPosition, bool checkVelocity, bool checkCollision,
-        vector<bool> linkSelection, double beginningTime, double endingTime);
-    void putJointPositionFault(int frame, Link* joint);
-    void putJointVelocityFault(int frame, Link* joint);
-    void putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair);
+        const vector<bool>& linkSelection, double beginningTime, double endingTime);
+    bool startCheck(
+        BodyItem* bodyItem, BodyMotionItem* motionItem,
+        bool checkPosition, bool checkVelocity, bool checkCollision,
+        const vector<bool>& linkSelection, double beginningTime, double endingTime, bool isAsync);
+    bool processFrames(bool doWait);
+    void finishCheck();
+    void putJointPositionFault(int frame, Link* joint, double q);
+    void putJointVelocityFault(int frame, Link* joint, double dq);
+    void checkCollisionsWithWorker(CollisionCheckWorker* worker);
+    void checkCollisionsInFrameChunk(CollisionCheckWorker* worker, FrameChunk& chunk);
+    void setFramePose(Body* body, int frame);
+    void setInterpolatedFramePose(Body* body, int frame, double ratio);
+    void detectCollisionsAt(CollisionCheckWorker* worker, int frame, double ratio, FrameChunk& chunk);
+    void putSelfCollision(Body* body, const CollisionRecord& collision);
 };
 
 }
@@ -209,6 +298,20 @@ KinematicFaultChecker::Impl::Impl()
     collisionCheck.setText(_("Self-collision check"));
     collisionCheck.setChecked(true);
     hbox->addWidget(&collisionCheck);
+    hbox->addSpacing(10);
+
+    interFrameCollisionCheck.setText(_("Inter-frame check"));
+    interFrameCollisionCheck.setChecked(false);
+    hbox->addWidget(&interFrameCollisionCheck);
+    hbox->addSpacing(10);
+
+    hbox->addWidget(new QLabel(_("Resolution")));
+    interFrameResolutionSpin.setDecimals(3);
+    interFrameResolutionSpin.setRange(0.001, 1.0);
+    interFrameResolutionSpin.setSingleStep(0.001);
+    interFrameResolutionSpin.setValue(0.01);
+    hbox->addWidget(&interFrameResolutionSpin);
+    hbox->addWidget(new QLabel("[m]"));
 
     hbox->addStretch();
     vbox->addLayout(hbox);
@@ -219,12 +322,21 @@ KinematicFaultChecker::Impl::Impl()
     onlyTimeBarRangeCheck.setText(_("Time bar's range only"));
     onlyTimeBarRangeCheck.setChecked(false);
     hbox->addWidget(&onlyTimeBarRangeCheck);
+    hbox->addSpacing(10);
+
+    hbox->addWidget(new QLabel(_("Threads")));
+    numThreadsSpin.setRange(1, 256);
+    numThreadsSpin.setValue(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    hbox->addWidget(&numThreadsSpin);
     hbox->addStretch();
     vbox->addLayout(hbox);
 
     vbox->addWidget(new HSeparator);
 
-    PushButton* applyButton = new PushButton(_("&Apply"));
+    isChecking = false;
+    isAsyncCheck = false;
+
+    applyButton = new PushButton(_("&Apply"));
     applyButton->setDefault(true);
     QDialogButtonBox* buttonBox = new QDialogButtonBox(this);
     buttonBox->addButton(applyButton, QDialogButtonBox::AcceptRole);
@@ -234,6 +346,14 @@ KinematicFaultChecker::Impl::Impl()
 }
 
 
+KinematicFaultChecker::Impl::~Impl()
+{
+    if(threadPool){
+        threadPool->wait();
+    }
+}
+
+
 bool KinematicFaultChecker::Impl::store(Archive& archive)
 {
     archive.write("checkJointPositions", positionCheck.isChecked());
@@ -245,7 +365,10 @@ bool KinematicFaultChecker::Impl::store(Archive& archive)
                   (allJointsRadio.isChecked() ? "all" :
                    (selectedJointsRadio.isChecked() ? "selected" : "non-selected")));
     archive.write("checkSelfCollisions", collisionCheck.isChecked());
+    archive.write("checkInterFrameCollisions", interFrameCollisionCheck.isChecked());
+    archive.write("interFrameResolution", interFrameResolutionSpin.value());
     archive.write("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked());
+    archive.write("numThreads", numThreadsSpin.value());
     return true;
 }
 
@@ -268,62 +391,117 @@ void KinematicFaultChecker::Impl::restore(const Archive& archive)
         }
     }
     collisionCheck.setChecked(archive.get("checkSelfCollisions", collisionCheck.isChecked()));
+    interFrameCollisionCheck.setChecked(
+        archive.get("checkInterFrameCollisions", interFrameCollisionCheck.isChecked()));
+    interFrameResolutionSpin.setValue(archive.get("interFrameResolution", interFrameResolutionSpin.value()));
     onlyTimeBarRangeCheck.setChecked(archive.get("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked()));
+    numThreadsSpin.setValue(archive.get("numThreads", numThreadsSpin.value()));
 }
 
 
+/**
+   The check is processed asynchronously so that the event loop keeps running while the worker
+   threads check the collisions. The selected motions are checked one by one.
+*/
 void KinematicFaultChecker::Impl::apply()
 {
+    if(isChecking || !pendingRequests.empty()){
+        return;
+    }
+    
     auto items = RootItem::instance()->selectedItems<BodyMotionItem>();
     if(items.empty()){
         mv->notify(_("No BodyMotionItems are selected."));
-    } else {
-        for(size_t i=0; i < items.size(); ++i){
-            BodyMotionItem* motionItem = items.get(i);
-            BodyItem* bodyItem = motionItem->findOwnerItem<BodyItem>();
-            if(!bodyItem){
-                mv->notify(format(_("{} is not owned by any BodyItem. Check skiped."), motionItem->displayName()));
-            } else {
-                mv->putln();
-                mv->notify(format(_("Applying the Kinematic Fault Checker to {} ..."),
-                                  motionItem->headItem()->displayName()));
-                
-                vector<bool> linkSelection;
-                if(allJointsRadio.isChecked()){
-                    linkSelection.resize(bodyItem->body()->numLinks(), true);
-                } else {
-                    linkSelection = BodySelectionManager::instance()->linkSelection(bodyItem);
-                    if(nonSelectedJointsRadio.isChecked()){
-                        linkSelection.flip();
-                    }
-                }
-                
-                double beginningTime = 0.0;
-                double endingTime = motionItem->motion()->getTimeLength();
-                std::numeric_limits<double>::max();
-                if(onlyTimeBarRangeCheck.isChecked()){
-                    TimeBar* timeBar = TimeBar::instance();
-                    beginningTime = timeBar->minTime();
-                    endingTime = timeBar->maxTime();
-                }
-                
-                int n = checkFaults(bodyItem, motionItem,
-                                    positionCheck.isChecked(),
-                                    velocityCheck.isChecked(),
-                                    collisionCheck.isChecked(),
-                                    linkSelection,
-                                    beginningTime, endingTime);
-                
-                if(n > 0){
-                    if(n == 1){
-                        mv->notify(_("A fault has been detected."));
-                    } else {
-                        mv->notify(format(_("{} faults have been detected."), n));
-                    }
-                } else {
-                    mv->notify(_("No faults have been detected."));
-                }
+        return;
+    }
+    
+    for(size_t i=0; i < items.size(); ++i){
+        BodyMotionItem* motionItem = items.get(i);
+        BodyItem* bodyItem = motionItem->findOwnerItem<BodyItem>();
+        if(!bodyItem){
+            mv->notify(format(_("{} is not owned by any BodyItem. Check skiped."), motionItem->displayName()));
+            continue;
+        }
+        CheckRequest request;
+        request.bodyItem = bodyItem;
+        request.motionItem = motionItem;
+        if(allJointsRadio.isChecked()){
+            request.linkSelection.resize(bodyItem->body()->numLinks(), true);
+        } else {
+            request.linkSelection = BodySelectionManager::instance()->linkSelection(bodyItem);
+            if(nonSelectedJointsRadio.isChecked()){
+                request.linkSelection.flip();
+            }
+        }
+        request.beginningTime = 0.0;
+        request.endingTime = motionItem->motion()->getTimeLength();
+        if(onlyTimeBarRangeCheck.isChecked()){
+            TimeBar* timeBar = TimeBar::instance();
+            request.beginningTime = timeBar->minTime();
+            request.endingTime = timeBar->maxTime();
+        }
+        pendingRequests.push_back(request);
+    }
+
+    if(!pendingRequests.empty()){
+        applyButton->setEnabled(false);
+        std::reverse(pendingRequests.begin(), pendingRequests.end());
+        startNextRequest();
+    }
+}
+
+
+void KinematicFaultChecker::Impl::startNextRequest()
+{
+    while(!pendingRequests.empty()){
+        auto request = pendingRequests.back();
+        pendingRequests.pop_back();
+
+        mv->putln();
+        mv->notify(format(_("Applying the Kinematic Fault Checker to {} ..."),
+                          request.motionItem->headItem()->displayName()));
+
+        bool started = startCheck(
+            request.bodyItem, request.motionItem,
+            positionCheck.isChecked(), velocityCheck.isChecked(), collisionCheck.isChecked(),
+            request.linkSelection, request.beginningTime, request.endingTime, true);
+
+        if(started){
+            if(!processFrames(false)){
+                // The check is continued by onChunkCompletedAsync
+                return;
             }
+            finishCheck();
+        }
+        onCheckFinished();
+    }
+
+    applyButton->setEnabled(true);
+}
+
+
+void KinematicFaultChecker::Impl::onCheckFinished()
+{
+    int n = numFaults;
+    if(n > 0){
+        if(n == 1){
+            mv->notify(_("A fault has been detected."));
+        } else {
+            mv->notify(format(_("{} faults have been detected."), n));
+        }
+    } else {
+        mv->notify(_("No faults have been detected."));
+    }
+}
+
+
+void KinematicFaultChecker::Impl::onChunkCompletedAsync()
+{
+    if(isChecking && isAsyncCheck){
+        if(processFrames(false)){
+            finishCheck();
+            onCheckFinished();
+            startNextRequest();
         }
     }
 }
@@ -343,50 +521,69 @@ int KinematicFaultChecker::checkFaults
 
 int KinematicFaultChecker::Impl::checkFaults
 (BodyItem* bodyItem, BodyMotionItem* motionItem,
- bool checkPosition, bool checkVelocity, bool checkCollision, vector<bool> linkSelection,
+ bool checkPosition, bool checkVelocity, bool checkCollision, const vector<bool>& linkSelection,
  double beginningTime, double endingTime)
+{
+    if(isChecking){
+        return 0;
+    }
+    if(startCheck(bodyItem, motionItem, checkPosition, checkVelocity, checkCollision,
+                  linkSelection, beginningTime, endingTime, false)){
+        processFrames(true);
+        finishCheck();
+    }
+    return numFaults;
+}
+
+
+/**
+   \return false if there are no frames to check
+*/
+bool KinematicFaultChecker::Impl::startCheck
+(BodyItem* bodyItem, BodyMotionItem* motionItem,
+ bool checkPosition, bool checkVelocity, bool checkCollision, const vector<bool>& linkSelection,
+ double beginningTime, double endingTime, bool isAsync)
 {
     numFaults = 0;
 
-    auto body = bodyItem->body();
+    body = bodyItem->body();
     auto motion = motionItem->motion();
-    auto qseq = motion->jointPosSeq();;
-    auto pseq = motion->linkPosSeq();
     
-    if((!checkPosition && !checkVelocity && !checkCollision) || body->isStaticModel() || !qseq->getNumFrames()){
-        return numFaults;
+    if((!checkPosition && !checkVelocity && !checkCollision) || body->isStaticModel() ||
+       !motion->jointPosSeq()->getNumFrames()){
+        body.reset();
+        return false;
     }
 
-    BodyState orgKinematicState;
-    
-    if(USE_DUPLICATED_BODY){
-        body = body->clone();
-    } else {
-        bodyItem->storeKinematicState(orgKinematicState);
-    }
-
-    BodyCollisionDetector bodyCollisionDetector;
-    WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
-    if(worldItem){
-        bodyCollisionDetector.setCollisionDetector(worldItem->collisionDetector()->clone());
-    } else {
-        bodyCollisionDetector.setCollisionDetector(new AISTCollisionDetector);
-    }
+    /*
+      The body is only referred to for the names and the limits of the links.
+      The sequences are copied so that the motion can be edited while the check is running
+      asynchronously, and the poses are set to the clones of the body owned by the workers.
+    */
+    qseq = make_shared<MultiValueSeq>(*motion->jointPosSeq());
+    pseq = make_shared<MultiSE3Seq>(*motion->linkPosSeq());
 
-    bodyCollisionDetector.addBody(body, true);
-    bodyCollisionDetector.makeReady();
+    this->checkPosition = checkPosition;
+    this->checkVelocity = checkVelocity;
+    this->linkSelection = linkSelection;
+    this->linkSelection.resize(body->numLinks(), false);
+    isAsyncCheck = isAsync;
+    isChecking = true;
 
-    const int numJoints = std::min(body->numJoints(), qseq->numParts());
-    const int numLinks = std::min(body->numLinks(), pseq->numParts());
+    numJoints = std::min(body->numJoints(), qseq->numParts());
+    numLinks = std::min(body->numLinks(), pseq->numParts());
 
     frameRate = motion->frameRate();
-    double stepRatio2 = 2.0 / frameRate;
     angleMargin = radian(angleMarginSpin.value());
     translationMargin = translationMarginSpin.value();
     velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
+    doInterFrameCollisionCheck = interFrameCollisionCheck.isChecked();
+    interFrameResolution = interFrameResolutionSpin.value();
 
-    int beginningFrame = std::max(0, (int)(beginningTime * frameRate));
-    int endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * frameRate));
+    beginningFrame = std::max(0, (int)(beginningTime * frameRate));
+    endingFrame = std::min((qseq->numFrames() - 1), (int)lround(endingTime * frameRate));
+    currentFrame = beginningFrame;
+    currentChunkIndex = 0;
 
     lastPosFaultFrames.clear();
     lastPosFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
@@ -394,13 +591,88 @@ int KinematicFaultChecker::Impl::checkFaults
     lastVelFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
     lastCollisionFrames.clear();
 
-    if(checkCollision){
-        Link* root = body->rootLink();
-        root->p().setZero();
-        root->R().setIdentity();
+    frameChunks.clear();
+    workers.clear();
+
+    if(checkCollision && endingFrame >= beginningFrame){
+        const int numFrames = endingFrame - beginningFrame + 1;
+        const int numThreads = std::min(numThreadsSpin.value(), numFrames);
+
+        // Small chunks let the results of the first frames be output early
+        const int chunkSize = std::max(1, std::min(100, numFrames / (numThreads * 4)));
+        for(int frame = beginningFrame; frame <= endingFrame; frame += chunkSize){
+            frameChunks.emplace_back();
+            auto& chunk = frameChunks.back();
+            chunk.beginningFrame = frame;
+            chunk.endingFrame = std::min(frame + chunkSize - 1, endingFrame);
+            chunk.isDone = false;
+        }
+
+        WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
+        for(int i=0; i < numThreads; ++i){
+            auto worker = new CollisionCheckWorker;
+            worker->body = body->clone();
+            auto& detector = worker->bodyCollisionDetector;
+            if(worldItem){
+                detector.setCollisionDetector(worldItem->collisionDetector()->clone());
+            } else {
+                detector.setCollisionDetector(new AISTCollisionDetector);
+            }
+            detector.addBody(worker->body, true);
+            detector.makeReady();
+
+            if(doInterFrameCollisionCheck){
+                for(auto& link : worker->body->links()){
+                    double radius = 0.0;
+                    if(auto shape = link->collisionShape()){
+                        auto bbox = shape->boundingBox();
+                        if(!bbox.empty()){
+                            radius = bbox.min().cwiseAbs().cwiseMax(bbox.max().cwiseAbs()).norm();
+                        }
+                    }
+                    worker->linkRadii.push_back(radius);
+                }
+            }
+            workers.emplace_back(worker);
+        }
+
+        nextChunkIndex = 0;
+        threadPool.reset(new ThreadPool(numThreads));
+        for(auto& worker : workers){
+            auto pWorker = worker.get();
+            threadPool->start([this, pWorker](){ checkCollisionsWithWorker(pWorker); });
+        }
     }
-        
-    for(int frame = beginningFrame; frame <= endingFrame; ++frame){
+
+    return true;
+}
+
+
+/**
+   Process the frames in order while the collision check of the frames has been finished.
+   \param doWait The frames whose collision check is not finished are waited for if this is true.
+   Otherwise the function returns when it reaches such a frame.
+   \return true if all the frames have been processed
+*/
+bool KinematicFaultChecker::Impl::processFrames(bool doWait)
+{
+    const double stepRatio2 = 2.0 / frameRate;
+    const int numChunks = frameChunks.size();
+    
+    for( ; currentFrame <= endingFrame; ++currentFrame){
+        const int frame = currentFrame;
+        FrameChunk* chunk = nullptr;
+        if(currentChunkIndex < numChunks){
+            chunk = &frameChunks[currentChunkIndex];
+            if(frame == chunk->beginningFrame){
+                std::unique_lock<std::mutex> lock(chunkMutex);
+                if(doWait){
+                    chunkCondition.wait(lock, [chunk](){ return chunk->isDone; });
+                } else if(!chunk->isDone){
+                    return false;
+                }
+            }
+        }
 
         int prevFrame = (frame == beginningFrame) ? beginningFrame : frame - 1;
         int nextFrame = (frame == endingFrame) ? endingFrame : frame + 1;
@@ -408,7 +680,6 @@ int KinematicFaultChecker::Impl::checkFaults
         for(int i=0; i < numJoints; ++i){
             Link* joint = body->joint(i);
             double q = qseq->at(frame, i);
-            joint->q() = q;
             if(joint->index() >= 0 && linkSelection[joint->index()]){
                 if(checkPosition){
                     bool fault = false;
@@ -418,74 +689,223 @@ int KinematicFaultChecker::Impl::checkFaults
                         fault = (q > (joint->q_upper() - translationMargin) || q < (joint->q_lower() + translationMargin));
                     }
                     if(fault){
-                        putJointPositionFault(frame, joint);
+                        putJointPositionFault(frame, joint, q);
                     }
                 }
                 if(checkVelocity){
                     double dq = (qseq->at(nextFrame, i) - qseq->at(prevFrame, i)) / stepRatio2;
-                    joint->dq() = dq;
                     if(dq > (joint->dq_upper() * velocityLimitRatio) || dq < (joint->dq_lower() * velocityLimitRatio)){
-                        putJointVelocityFault(frame, joint);
+                        putJointVelocityFault(frame, joint, dq);
                     }
                 }
             }
         }
 
-        if(checkCollision){
-
-            Link* link = body->link(0);
-            if(!pseq->empty())
-            {
-                const SE3& p = pseq->at(frame, 0);
-                link->p() = p.translation();
-                link->R() = p.rotation().toRotationMatrix();
+        if(chunk){
+            for(auto& collision : chunk->collisions){
+                if(collision.frame == frame){
+                    putSelfCollision(body, collision);
+                }
             }
-            else
-            {
-                link->p() = Vector3d(0., 0., 0.);
-                link->R() = Matrix3d::Identity();
+            if(frame == chunk->endingFrame){
+                ++currentChunkIndex;
             }
+        }
+    }
+
+    return true;
+}
+
+
+void KinematicFaultChecker::Impl::finishCheck()
+{
+    if(threadPool){
+        threadPool->wait();
+        threadPool.reset();
+    }
+    workers.clear();
+    frameChunks.clear();
+    qseq.reset();
+    pseq.reset();
+    body.reset();
+    isChecking = false;
+}
+
+
+void KinematicFaultChecker::Impl::checkCollisionsWithWorker(CollisionCheckWorker* worker)
+{
+    const int numChunks = frameChunks.size();
+    while(true){
+        int index = nextChunkIndex++;
+        if(index >= numChunks){
+            break;
+        }
+        auto& chunk = frameChunks[index];
+        checkCollisionsInFrameChunk(worker, chunk);
+        {
+            std::lock_guard<std::mutex> lock(chunkMutex);
+            chunk.isDone = true;
+        }
+        chunkCondition.notify_all();
+        if(isAsyncCheck){
+            callLater([this](){ onChunkCompletedAsync(); });
+        }
+    }
+}
 
-            body->calcForwardKinematics();
 
-            for(int i=1; i < numLinks; ++i){
-                link = body->link(i);
-                if(!pseq->empty())
-                {
-                    const SE3& p = pseq->at(frame, i);
-                    link->p() = p.translation();
-                    link->R() = p.rotation().toRotationMatrix();
+void KinematicFaultChecker::Impl::checkCollisionsInFrameChunk(CollisionCheckWorker* worker, FrameChunk& chunk)
+{
+    Body* body = worker->body;
+    auto& prevPositions = worker->prevLinkPositions;
+    const int n = body->numLinks();
+    prevPositions.resize(n);
+
+    int frame = chunk.beginningFrame;
+    bool hasPrevFrame = false;
+    if(doInterFrameCollisionCheck && frame > beginningFrame){
+        setFramePose(body, frame - 1);
+        hasPrevFrame = true;
+    }
+    
+    for( ; frame <= chunk.endingFrame; ++frame){
+        if(hasPrevFrame){
+            for(int i=0; i < n; ++i){
+                prevPositions[i] = body->link(i)->T();
+            }
+        }
+        
+        setFramePose(body, frame);
+
+        if(hasPrevFrame){
+            /*
+              The displacement of any point on a link between the frames is bounded
+              by the translation of the link origin plus the rotation angle multiplied
+              by the radius of the link shape. Interpolated poses are checked so that
+              the bound of the displacement between the checked poses is within the
+              resolution and the collisions between the frames are not missed.
+            */
+            double maxDisplacement = 0.0;
+            for(int i=0; i < n; ++i){
+                Link* link = body->link(i);
+                const Isometry3& T0 = prevPositions[i];
+                double translation = (link->p() - T0.translation()).norm();
+                double angle = AngleAxis(T0.linear().transpose() * link->R()).angle();
+                double d = translation + angle * worker->linkRadii[i];
+                if(d > maxDisplacement){
+                    maxDisplacement = d;
+                }
+            }
+            int numSubFrames = std::min(MaxNumSubFrames, (int)ceil(maxDisplacement / interFrameResolution));
+            if(numSubFrames > 1){
+                for(int j=1; j < numSubFrames; ++j){
+                    double ratio = (double)j / numSubFrames;
+                    setInterpolatedFramePose(body, frame, ratio);
+                    detectCollisionsAt(worker, frame, ratio, chunk);
                 }
+                setFramePose(body, frame);
             }
+        }
+
+        detectCollisionsAt(worker, frame, 1.0, chunk);
+
+        hasPrevFrame = doInterFrameCollisionCheck;
+    }
+}
+
+
+void KinematicFaultChecker::Impl::setFramePose(Body* body, int frame)
+{
+    for(int i=0; i < numJoints; ++i){
+        body->joint(i)->q() = qseq->at(frame, i);
+    }
+
+    Link* link = body->rootLink();
+    if(!pseq->empty()){
+        const SE3& p = pseq->at(frame, 0);
+        link->p() = p.translation();
+        link->R() = p.rotation().toRotationMatrix();
+    } else {
+        link->p().setZero();
+        link->R().setIdentity();
+    }
 
-            bodyCollisionDetector.updatePositions();
+    body->calcForwardKinematics();
 
-            bodyCollisionDetector.detectCollisions(
-                [&](const CollisionPair& collisionPair){
-                    putSelfCollision(body, frame, collisionPair);
-                });
+    if(!pseq->empty()){
+        for(int i=1; i < numLinks; ++i){
+            link = body->link(i);
+            const SE3& p = pseq->at(frame, i);
+            link->p() = p.translation();
+            link->R() = p.rotation().toRotationMatrix();
         }
     }
+}
+
 
-    if(!USE_DUPLICATED_BODY){
-        bodyItem->restoreKinematicState(orgKinematicState);
+/**
+   Set the pose interpolated between the previous frame of the frame (ratio = 0.0)
+   and the frame (ratio = 1.0)
+*/
+void KinematicFaultChecker::Impl::setInterpolatedFramePose(Body* body, int frame, double ratio)
+{
+    const int prevFrame = frame - 1;
+    
+    for(int i=0; i < numJoints; ++i){
+        double q0 = qseq->at(prevFrame, i);
+        double q1 = qseq->at(frame, i);
+        body->joint(i)->q() = q0 + ratio * (q1 - q0);
     }
 
-    return numFaults;
+    auto setInterpolatedLinkPosition = [&](Link* link, int index){
+        const SE3& p0 = pseq->at(prevFrame, index);
+        const SE3& p1 = pseq->at(frame, index);
+        link->p() = p0.translation() + ratio * (p1.translation() - p0.translation());
+        link->R() = p0.rotation().slerp(ratio, p1.rotation()).toRotationMatrix();
+    };
+
+    Link* link = body->rootLink();
+    if(!pseq->empty()){
+        setInterpolatedLinkPosition(link, 0);
+    } else {
+        link->p().setZero();
+        link->R().setIdentity();
+    }
+
+    body->calcForwardKinematics();
+
+    if(!pseq->empty()){
+        for(int i=1; i < numLinks; ++i){
+            setInterpolatedLinkPosition(body->link(i), i);
+        }
+    }
+}
+
+
+void KinematicFaultChecker::Impl::detectCollisionsAt
+(CollisionCheckWorker* worker, int frame, double ratio, FrameChunk& chunk)
+{
+    auto& detector = worker->bodyCollisionDetector;
+    detector.updatePositions();
+    detector.detectCollisions(
+        [&](const CollisionPair& collisionPair){
+            auto link0 = static_cast<Link*>(collisionPair.object(0));
+            auto link1 = static_cast<Link*>(collisionPair.object(1));
+            chunk.collisions.push_back({ frame, ratio, link0->index(), link1->index() });
+        });
 }
 
 
-void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
+void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint, double q)
 {
     if(frame > lastPosFaultFrames[joint->jointId()] + 1){
-        double q, l, u, m;
+        double l, u, m;
         if(joint->isRevoluteJoint()){
-            q = degree(joint->q());
+            q = degree(q);
             l = degree(joint->q_lower());
             u = degree(joint->q_upper());
             m = degree(angleMargin);
         } else {
-            q = joint->q();
             l = joint->q_lower();
             u = joint->q_upper();
             m = translationMargin;
@@ -505,16 +925,15 @@ void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
 }
 
 
-void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
+void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint, double dq)
 {
     if(frame > lastVelFaultFrames[joint->jointId()] + 1){
-        double dq, l, u;
+        double l, u;
         if(joint->isRevoluteJoint()){
-            dq = degree(joint->dq());
+            dq = degree(dq);
             l = degree(joint->dq_lower());
             u = degree(joint->dq_upper());
         } else {
-            dq = joint->dq();
             l = joint->dq_lower();
             u = joint->dq_upper();
         }
@@ -531,14 +950,15 @@ void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
 }
 
 
-void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair)
+void KinematicFaultChecker::Impl::putSelfCollision(Body* body, const CollisionRecord& collision)
 {
+    const int frame = collision.frame;
     bool putMessage = false;
-    GeometryPair gPair(collisionPair.geometries());
-    auto p = lastCollisionFrames.find(gPair);
+    IdPair<int> linkPair(collision.linkIndex0, collision.linkIndex1);
+    auto p = lastCollisionFrames.find(linkPair);
     if(p == lastCollisionFrames.end()){
         putMessage = true;
-        lastCollisionFrames[gPair] = frame;
+        lastCollisionFrames[linkPair] = frame;
     } else {
         if(frame > p->second + 1){
             putMessage = true;
@@ -547,10 +967,10 @@ void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const
     }
 
     if(putMessage){
-        Link* link0 = static_cast<Link*>(collisionPair.object(0));
-        Link* link1 = static_cast<Link*>(collisionPair.object(1));
+        Link* link0 = body->link(collision.linkIndex0);
+        Link* link1 = body->link(collision.linkIndex1);
         os << format(_("{0:7.3f} [s]: Collision between {1} and {2}"),
-                     (frame / frameRate), link0->name(), link1->name()) << endl;
+                     ((frame - 1 + collision.ratio) / frameRate), link0->name(), link1->name()) << endl;
         numFaults++;
     }
 }
@@ -0,0 +1,890 @@
+#include "MultiRegionIntrusionDetectorItem.h"
+#include <cnoid/ItemManager>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/Body>
+#include <cnoid/BodyCollisionDetector>
+#include <cnoid/DigitalIoDevice>
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/EigenArchive>
+#include <cnoid/Selection>
+#include <fmt/format.h>
+#include <algorithm>
+#include <sstream>
+#include <map>
+#include <limits>
+#include <cmath>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+typedef CollisionDetector::GeometryHandle GeometryHandle;
+
+struct Region
+{
+    string name;
+    MultiRegionIntrusionDetectorItem::RegionType type;
+    Vector3 boxSize;
+    // Counterclockwise convex polygon of the cross section extruded from -height / 2 to height / 2
+    vector<Vector2> polygon;
+    double height;
+    Isometry3 offset;
+    int ioSignalNumber;
+
+    // Members for the detection
+    BodyPtr body;
+    GeometryHandle handle;
+    Vector3 bboxMin;
+    Vector3 bboxMax;
+    bool isIntruded;
+
+    Region() : isIntruded(false) { }
+    bool contains(const Vector3& p) const;
+};
+
+struct LinkInfo
+{
+    Link* link;
+    GeometryHandle handle;
+    Vector3 localBBoxCenter;
+    Vector3 localBBoxHalfSize;
+    /*
+      The centroid of the vertices is used to detect the state where the link is completely
+      inside a region without any intersection between their surfaces. The centroid of a link
+      that is inside a convex region is always inside the region.
+    */
+    Vector3 localCentroid;
+    Vector3 bboxMin;
+    Vector3 bboxMax;
+};
+
+double cross2(const Vector2& a, const Vector2& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+// Andrew's monotone chain algorithm
+vector<Vector2> getConvexHull(vector<Vector2> points)
+{
+    vector<Vector2> hull;
+    const int n = points.size();
+    if(n < 3){
+        return hull;
+    }
+    std::sort(points.begin(), points.end(),
+              [](const Vector2& a, const Vector2& b){
+                  return (a.x() < b.x()) || (a.x() == b.x() && a.y() < b.y()); });
+
+    hull.resize(2 * n);
+    int k = 0;
+    for(int i=0; i < n; ++i){
+        while(k >= 2 && cross2(hull[k-1] - hull[k-2], points[i] - hull[k-2]) <= 0.0){
+            --k;
+        }
+        hull[k++] = points[i];
+    }
+    for(int i = n - 2, t = k + 1; i >= 0; --i){
+        while(k >= t && cross2(hull[k-1] - hull[k-2], points[i] - hull[k-2]) <= 0.0){
+            --k;
+        }
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+
+    if(hull.size() < 3){
+        hull.clear();
+    }
+    return hull;
+}
+
+bool Region::contains(const Vector3& p) const
+{
+    const Vector3 q = offset.inverse() * p;
+    if(std::abs(q.z()) > height / 2.0){
+        return false;
+    }
+    const Vector2 q2 = q.head<2>();
+    const int n = polygon.size();
+    for(int i=0; i < n; ++i){
+        const Vector2& a = polygon[i];
+        const Vector2& b = polygon[(i + 1) % n];
+        if(cross2(b - a, q2 - a) < 0.0){
+            return false;
+        }
+    }
+    return true;
+}
+
+SgMesh* createPrismMesh(const vector<Vector2>& polygon, double height)
+{
+    auto mesh = new SgMesh;
+    const int n = polygon.size();
+    auto& vertices = *mesh->getOrCreateVertices(n * 2);
+    const float z = height / 2.0;
+    for(int i=0; i < n; ++i){
+        const Vector2& p = polygon[i];
+        vertices[i] << p.x(), p.y(), -z;
+        vertices[i + n] << p.x(), p.y(), z;
+    }
+    for(int i=1; i < n - 1; ++i){
+        mesh->addTriangle(0, i + 1, i);
+        mesh->addTriangle(n, n + i, n + i + 1);
+    }
+    for(int i=0; i < n; ++i){
+        const int j = (i + 1) % n;
+        mesh->addTriangle(i, j, n + j);
+        mesh->addTriangle(i, n + j, n + i);
+    }
+    mesh->updateBoundingBox();
+    return mesh;
+}
+
+void transformBoundingBox
+(const Isometry3& T, const Vector3& center, const Vector3& halfSize, Vector3& out_min, Vector3& out_max)
+{
+    const Vector3 c = T * center;
+    const Vector3 h = T.linear().cwiseAbs() * halfSize;
+    out_min = c - h;
+    out_max = c + h;
+}
+
+void setBoxShape(Region& region, const Vector3& size)
+{
+    region.type = MultiRegionIntrusionDetectorItem::BoxRegion;
+    region.boxSize = size;
+    const double x = size.x() / 2.0;
+    const double y = size.y() / 2.0;
+    region.polygon = { Vector2(-x, -y), Vector2(x, -y), Vector2(x, y), Vector2(-x, y) };
+    region.height = size.z();
+}
+
+
+string getPolygonString(const vector<Vector2>& polygon)
+{
+    string s;
+    for(size_t i=0; i < polygon.size(); ++i){
+        if(i > 0){
+            s += ", ";
+        }
+        s += format("{0} {1}", polygon[i].x(), polygon[i].y());
+    }
+    return s;
+}
+
+
+// The format is "x1 y1, x2 y2, x3 y3, ..."
+bool parsePolygonString(const string& s, vector<Vector2>& out_polygon)
+{
+    out_polygon.clear();
+    istringstream is(s);
+    string vertex;
+    while(getline(is, vertex, ',')){
+        istringstream vs(vertex);
+        double x, y;
+        if(!(vs >> x >> y)){
+            return false;
+        }
+        string rest;
+        if(vs >> rest){
+            return false;
+        }
+        out_polygon.emplace_back(x, y);
+    }
+    return true;
+}
+
+
+bool checkBoundingBoxOverlap(const Vector3& min1, const Vector3& max1, const Vector3& min2, const Vector3& max2)
+{
+    return (min1.array() <= max2.array()).all() && (min2.array() <= max1.array()).all();
+}
+
+}
+
+namespace cnoid {
+
+class MultiRegionIntrusionDetectorItem::Impl
+{
+public:
+    MultiRegionIntrusionDetectorItem* self;
+    vector<Region> regions;
+    unique_ptr<BodyCollisionDetector> bodyCollisionDetector;
+    vector<LinkInfo> linkInfos;
+    DigitalIoDevicePtr ioDevice;
+
+    // Regions sharing an IO signal are merged with the logical OR
+    map<int, bool> signalStates;
+    bool signalStatesChanged;
+
+    SgGroupPtr markerGroup;
+
+    Impl(MultiRegionIntrusionDetectorItem* self);
+    Impl(MultiRegionIntrusionDetectorItem* self, Impl& org);
+    int addRegion(Region& region);
+    bool initialize(ControllerIO* io);
+    void initializeRegion(Region& region);
+    void initializeLinkInfo(Link* link, GeometryHandle handle);
+    bool control();
+    void updateMarkers();
+    SgNode* createRegionMarker(const Region& region);
+    void putRegionProperties(int index, PutPropertyFunction& putProperty);
+    bool setNumRegions(int n);
+    bool setRegionType(Region& region, int type);
+    void storeRegion(const Region& region, Mapping& node);
+    bool restoreRegion(const Mapping& node);
+};
+
+}
+
+
+void MultiRegionIntrusionDetectorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager()
+        .registerClass<MultiRegionIntrusionDetectorItem, ControllerItem>(N_("MultiRegionIntrusionDetector"))
+        .addCreationPanel<MultiRegionIntrusionDetectorItem>();
+}
+
+
+MultiRegionIntrusionDetectorItem::MultiRegionIntrusionDetectorItem()
+{
+    impl = new Impl(this);
+}
+
+
+MultiRegionIntrusionDetectorItem::MultiRegionIntrusionDetectorItem(const MultiRegionIntrusionDetectorItem& org)
+    : ControllerItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+MultiRegionIntrusionDetectorItem::Impl::Impl(MultiRegionIntrusionDetectorItem* self)
+    : self(self)
+{
+    signalStatesChanged = false;
+}
+
+
+MultiRegionIntrusionDetectorItem::Impl::Impl(MultiRegionIntrusionDetectorItem* self, Impl& org)
+    : Impl(self)
+{
+    for(auto& orgRegion : org.regions){
+        Region region;
+        region.name = orgRegion.name;
+        region.type = orgRegion.type;
+        region.boxSize = orgRegion.boxSize;
+        region.polygon = orgRegion.polygon;
+        region.height = orgRegion.height;
+        region.offset = orgRegion.offset;
+        region.ioSignalNumber = orgRegion.ioSignalNumber;
+        regions.push_back(region);
+    }
+}
+
+
+MultiRegionIntrusionDetectorItem::~MultiRegionIntrusionDetectorItem()
+{
+    delete impl;
+}
+
+
+Item* MultiRegionIntrusionDetectorItem::doCloneItem(CloneMap* /* cloneMap */) const
+{
+    return new MultiRegionIntrusionDetectorItem(*this);
+}
+
+
+int MultiRegionIntrusionDetectorItem::addBoxRegion
+(const std::string& name, const Vector3& size, const Isometry3& offset, int ioSignalNumber)
+{
+    if(size.minCoeff() <= 0.0){
+        return -1;
+    }
+    Region region;
+    region.name = name;
+    setBoxShape(region, size);
+    region.offset = offset;
+    region.ioSignalNumber = ioSignalNumber;
+    return impl->addRegion(region);
+}
+
+
+int MultiRegionIntrusionDetectorItem::addConvexPrismRegion
+(const std::string& name, const std::vector<Vector2>& polygon, double height,
+ const Isometry3& offset, int ioSignalNumber)
+{
+    if(height <= 0.0){
+        return -1;
+    }
+    Region region;
+    region.name = name;
+    region.type = ConvexPrismRegion;
+    region.boxSize.setZero();
+    region.polygon = getConvexHull(polygon);
+    if(region.polygon.empty()){
+        return -1;
+    }
+    region.height = height;
+    region.offset = offset;
+    region.ioSignalNumber = ioSignalNumber;
+    return impl->addRegion(region);
+}
+
+
+int MultiRegionIntrusionDetectorItem::Impl::addRegion(Region& region)
+{
+    regions.push_back(region);
+    updateMarkers();
+    return regions.size() - 1;
+}
+
+
+void MultiRegionIntrusionDetectorItem::removeRegion(int index)
+{
+    impl->regions.erase(impl->regions.begin() + index);
+    impl->updateMarkers();
+}
+
+
+void MultiRegionIntrusionDetectorItem::clearRegions()
+{
+    impl->regions.clear();
+    impl->updateMarkers();
+}
+
+
+int MultiRegionIntrusionDetectorItem::numRegions() const
+{
+    return impl->regions.size();
+}
+
+
+const std::string& MultiRegionIntrusionDetectorItem::regionName(int index) const
+{
+    return impl->regions[index].name;
+}
+
+
+MultiRegionIntrusionDetectorItem::RegionType MultiRegionIntrusionDetectorItem::regionType(int index) const
+{
+    return impl->regions[index].type;
+}
+
+
+Vector3 MultiRegionIntrusionDetectorItem::regionSize(int index) const
+{
+    auto& region = impl->regions[index];
+    if(region.type == BoxRegion){
+        return region.boxSize;
+    }
+    return Vector3(0.0, 0.0, region.height);
+}
+
+
+const std::vector<Vector2>& MultiRegionIntrusionDetectorItem::regionPolygon(int index) const
+{
+    return impl->regions[index].polygon;
+}
+
+
+void MultiRegionIntrusionDetectorItem::setRegionOffset(int index, const Isometry3& T)
+{
+    impl->regions[index].offset = T;
+    impl->updateMarkers();
+}
+
+
+const Isometry3& MultiRegionIntrusionDetectorItem::regionOffset(int index) const
+{
+    return impl->regions[index].offset;
+}
+
+
+void MultiRegionIntrusionDetectorItem::setRegionIoSignalNumber(int index, int no)
+{
+    impl->regions[index].ioSignalNumber = no;
+}
+
+
+int MultiRegionIntrusionDetectorItem::regionIoSignalNumber(int index) const
+{
+    return impl->regions[index].ioSignalNumber;
+}
+
+
+bool MultiRegionIntrusionDetectorItem::isRegionIntruded(int index) const
+{
+    return impl->regions[index].isIntruded;
+}
+
+
+bool MultiRegionIntrusionDetectorItem::initialize(ControllerIO* io)
+{
+    return impl->initialize(io);
+}
+
+
+bool MultiRegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
+{
+    auto body = io->body();
+    ioDevice = body->findDevice<DigitalIoDevice>();
+    if(!ioDevice){
+        io->os() << format(_("\"{0}\" cannot work with \"{1}\" because it does not have a digital IO device."),
+                           self->name(), body->name()) << endl;
+        return false;
+    }
+
+    signalStates.clear();
+    for(auto& region : regions){
+        if(region.ioSignalNumber < 0 || region.ioSignalNumber >= ioDevice->numSignalLines()){
+            io->os() << format(_("The I/O signal number {0} of region \"{1}\" in \"{2}\" is not valid for \"{3}\"."),
+                               region.ioSignalNumber, region.name, self->name(), body->name()) << endl;
+            return false;
+        }
+        signalStates[region.ioSignalNumber] = false;
+    }
+
+    if(!bodyCollisionDetector){
+        bodyCollisionDetector = make_unique<BodyCollisionDetector>(new AISTCollisionDetector);
+        bodyCollisionDetector->setGeometryHandleMapEnabled(true);
+    }
+    bodyCollisionDetector->clearBodies();
+
+    for(auto& region : regions){
+        initializeRegion(region);
+    }
+
+    bodyCollisionDetector->addBody(body, false);
+
+    linkInfos.clear();
+    for(auto& link : body->links()){
+        if(auto handle = bodyCollisionDetector->findGeometryHandle(link)){
+            initializeLinkInfo(link, *handle);
+        }
+    }
+
+    bodyCollisionDetector->makeReady();
+
+    signalStatesChanged = false;
+
+    return true;
+}
+
+
+void MultiRegionIntrusionDetectorItem::Impl::initializeRegion(Region& region)
+{
+    region.body = new Body;
+    auto link = region.body->rootLink();
+    link->setJointType(Link::FixedJoint);
+    auto shape = new SgShape;
+    shape->setMesh(createPrismMesh(region.polygon, region.height));
+    link->addCollisionShapeNode(shape);
+    link->setPosition(region.offset);
+    bodyCollisionDetector->addBody(region.body, false);
+    region.handle = *bodyCollisionDetector->findGeometryHandle(link);
+
+    auto& bbox = shape->mesh()->boundingBox();
+    transformBoundingBox(region.offset, bbox.center(), bbox.size() / 2.0, region.bboxMin, region.bboxMax);
+    region.isIntruded = false;
+}
+
+
+void MultiRegionIntrusionDetectorItem::Impl::initializeLinkInfo(Link* link, GeometryHandle handle)
+{
+    MeshExtractor meshExtractor;
+    BoundingBox bbox;
+    Vector3 sum = Vector3::Zero();
+    int numVertices = 0;
+    meshExtractor.extract(
+        link->collisionShape(),
+        [&](SgMesh* mesh){
+            const Affine3& T = meshExtractor.currentTransform();
+            for(auto& v : *mesh->vertices()){
+                const Vector3 p = T * v.cast<Affine3::Scalar>();
+                bbox.expandBy(p);
+                sum += p;
+            }
+            numVertices += mesh->vertices()->size();
+        });
+
+    if(numVertices > 0){
+        LinkInfo info;
+        info.link = link;
+        info.handle = handle;
+        info.localBBoxCenter = bbox.center();
+        info.localBBoxHalfSize = bbox.size() / 2.0;
+        info.localCentroid = sum / numVertices;
+        linkInfos.push_back(info);
+    }
+}
+
+
+void MultiRegionIntrusionDetectorItem::input()
+{
+    impl->bodyCollisionDetector->updatePositions();
+}
+
+
+bool MultiRegionIntrusionDetectorItem::control()
+{
+    return impl->control();
+}
+
+
+bool MultiRegionIntrusionDetectorItem::Impl::control()
+{
+    Vector3 bodyBBoxMin = Vector3::Constant(std::numeric_limits<double>::max());
+    Vector3 bodyBBoxMax = Vector3::Constant(std::numeric_limits<double>::lowest());
+    for(auto& info : linkInfos){
+        transformBoundingBox(
+            info.link->position(), info.localBBoxCenter, info.localBBoxHalfSize, info.bboxMin, info.bboxMax);
+        bodyBBoxMin = bodyBBoxMin.cwiseMin(info.bboxMin);
+        bodyBBoxMax = bodyBBoxMax.cwiseMax(info.bboxMax);
+    }
+
+    auto collisionDetector = bodyCollisionDetector->collisionDetector();
+
+    for(auto& region : regions){
+        region.isIntruded = false;
+        if(!checkBoundingBoxOverlap(region.bboxMin, region.bboxMax, bodyBBoxMin, bodyBBoxMax)){
+            continue;
+        }
+        for(auto& info : linkInfos){
+            if(checkBoundingBoxOverlap(region.bboxMin, region.bboxMax, info.bboxMin, info.bboxMax)){
+                if(collisionDetector->checkCollision(region.handle, info.handle) ||
+                   region.contains(info.link->position() * info.localCentroid)){
+                    region.isIntruded = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for(auto& kv : signalStates){
+        kv.second = false;
+    }
+    for(auto& region : regions){
+        if(region.isIntruded){
+            signalStates[region.ioSignalNumber] = true;
+        }
+    }
+    for(auto& kv : signalStates){
+        if(ioDevice->out(kv.first) != kv.second){
+            signalStatesChanged = true;
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+void MultiRegionIntrusionDetectorItem::output()
+{
+    if(impl->signalStatesChanged){
+        for(auto& kv : impl->signalStates){
+            if(impl->ioDevice->out(kv.first) != kv.second){
+                impl->ioDevice->setOut(kv.first, kv.second, true);
+            }
+        }
+        impl->signalStatesChanged = false;
+    }
+}
+
+
+void MultiRegionIntrusionDetectorItem::stop()
+{
+    impl->ioDevice.reset();
+    impl->bodyCollisionDetector->clearBodies();
+    impl->linkInfos.clear();
+    for(auto& region : impl->regions){
+        region.body.reset();
+    }
+}
+
+
+SgNode* MultiRegionIntrusionDetectorItem::getScene()
+{
+    if(!impl->markerGroup){
+        impl->markerGroup = new SgGroup;
+        impl->markerGroup->setAttribute(SgObject::MetaScene);
+        impl->updateMarkers();
+    }
+    return impl->markerGroup;
+}
+
+
+void MultiRegionIntrusionDetectorItem::Impl::updateMarkers()
+{
+    if(markerGroup){
+        markerGroup->clearChildren();
+        for(auto& region : regions){
+            markerGroup->addChild(createRegionMarker(region));
+        }
+        markerGroup->notifyUpdate();
+    }
+}
+
+
+SgNode* MultiRegionIntrusionDetectorItem::Impl::createRegionMarker(const Region& region)
+{
+    const int n = region.polygon.size();
+    auto lineSet = new SgLineSet;
+    auto& vertices = *lineSet->getOrCreateVertices(n * 2);
+    const float z = region.height / 2.0;
+    for(int i=0; i < n; ++i){
+        const Vector2& p = region.polygon[i];
+        vertices[i] << p.x(), p.y(), -z;
+        vertices[i + n] << p.x(), p.y(), z;
+    }
+    lineSet->setLineWidth(2.0f);
+    lineSet->reserveNumLines(n * 3);
+    for(int i=0; i < n; ++i){
+        const int j = (i + 1) % n;
+        lineSet->addLine(i, j);
+        lineSet->addLine(i + n, j + n);
+        lineSet->addLine(i, i + n);
+    }
+    auto material = lineSet->getOrCreateMaterial();
+    material->setDiffuseColor(Vector3f(1.0f, 0.0f, 0.0f));
+
+    auto transform = new SgPosTransform(region.offset);
+    transform->addChild(lineSet);
+    return transform;
+}
+
+
+void MultiRegionIntrusionDetectorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty.min(0)(_("Number of regions"), numRegions(),
+                       [&](int n){ return impl->setNumRegions(n); });
+
+    for(size_t i=0; i < impl->regions.size(); ++i){
+        impl->putRegionProperties(i, putProperty);
+    }
+}
+
+
+void MultiRegionIntrusionDetectorItem::Impl::putRegionProperties(int index, PutPropertyFunction& putProperty)
+{
+    auto& region = regions[index];
+    const int no = index + 1;
+
+    putProperty(format(_("Region {0} name"), no), region.name,
+                [this, index](const string& name){ regions[index].name = name; return true; });
+
+    Selection type({ N_("Box"), N_("Convex prism") }, CNOID_GETTEXT_DOMAIN_NAME);
+    type.select(region.type);
+    putProperty(format(_("Region {0} type"), no), type,
+                [this, index](int which){ return setRegionType(regions[index], which); });
+
+    if(region.type == BoxRegion){
+        putProperty(format(_("Region {0} box size"), no), str(region.boxSize),
+                    [this, index](const string& s){
+                        Vector3 size;
+                        if(toVector3(s, size) && size.minCoeff() > 0.0){
+                            setBoxShape(regions[index], size);
+                            updateMarkers();
+                            return true;
+                        }
+                        return false;
+                    });
+    } else {
+        putProperty(format(_("Region {0} polygon"), no), getPolygonString(region.polygon),
+                    [this, index](const string& s){
+                        vector<Vector2> polygon;
+                        if(parsePolygonString(s, polygon)){
+                            polygon = getConvexHull(polygon);
+                            if(!polygon.empty()){
+                                regions[index].polygon = polygon;
+                                updateMarkers();
+                                return true;
+                            }
+                        }
+                        return false;
+                    });
+        putProperty.min(0.0)(format(_("Region {0} height"), no), region.height,
+                             [this, index](double h){
+                                 if(h <= 0.0){
+                                     return false;
+                                 }
+                                 regions[index].height = h;
+                                 updateMarkers();
+                                 return true;
+                             });
+    }
+
+    putProperty(format(_("Region {0} offset"), no), str(Vector3(region.offset.translation())),
+                [this, index](const string& s){
+                    Vector3 p;
+                    if(toVector3(s, p)){
+                        regions[index].offset.translation() = p;
+                        updateMarkers();
+                        return true;
+                    }
+                    return false;
+                });
+
+    auto rpy = rpyFromRot(region.offset.linear());
+    putProperty(format(_("Region {0} yaw angle"), no), degree(rpy.z()),
+                [this, index](double a){
+                    regions[index].offset.linear() = rotFromRpy(Vector3(0.0, 0.0, radian(a)));
+                    updateMarkers();
+                    return true;
+                });
+
+    putProperty.min(0)
+        (format(_("Region {0} I/O signal number"), no), region.ioSignalNumber,
+         [this, index](int signalNo){ regions[index].ioSignalNumber = signalNo; return true; });
+}
+
+
+bool MultiRegionIntrusionDetectorItem::Impl::setNumRegions(int n)
+{
+    if(n < 0){
+        return false;
+    }
+    if(n < static_cast<int>(regions.size())){
+        regions.resize(n);
+    } else {
+        while(static_cast<int>(regions.size()) < n){
+            // A new region is a unit box given the I/O signal number following the last region
+            Region region;
+            region.name = format("region{0}", regions.size() + 1);
+            setBoxShape(region, Vector3(1.0, 1.0, 1.0));
+            region.offset.setIdentity();
+            region.ioSignalNumber = regions.empty() ? 0 : regions.back().ioSignalNumber + 1;
+            regions.push_back(region);
+        }
+    }
+    updateMarkers();
+    return true;
+}
+
+
+bool MultiRegionIntrusionDetectorItem::Impl::setRegionType(Region& region, int type)
+{
+    if(type == region.type){
+        return true;
+    }
+    if(type == BoxRegion){
+        // The box covering the current polygon
+        Vector2 pmin = Vector2::Constant(std::numeric_limits<double>::max());
+        Vector2 pmax = Vector2::Constant(std::numeric_limits<double>::lowest());
+        for(auto& p : region.polygon){
+            pmin = pmin.cwiseMin(p);
+            pmax = pmax.cwiseMax(p);
+        }
+        const Vector2 center = (pmin + pmax) / 2.0;
+        region.offset.translation() += region.offset.linear() * Vector3(center.x(), center.y(), 0.0);
+        setBoxShape(region, Vector3(pmax.x() - pmin.x(), pmax.y() - pmin.y(), region.height));
+    } else if(type == ConvexPrismRegion){
+        // The polygon and height of the box are taken over as they are
+        region.type = ConvexPrismRegion;
+        region.boxSize.setZero();
+    } else {
+        return false;
+    }
+    updateMarkers();
+    return true;
+}
+
+
+bool MultiRegionIntrusionDetectorItem::store(Archive& archive)
+{
+    if(!impl->regions.empty()){
+        auto listing = archive.createListing("regions");
+        for(auto& region : impl->regions){
+            impl->storeRegion(region, *listing->newMapping());
+        }
+    }
+    return true;
+}
+
+
+void MultiRegionIntrusionDetectorItem::Impl::storeRegion(const Region& region, Mapping& node)
+{
+    if(!region.name.empty()){
+        node.write("name", region.name, DOUBLE_QUOTED);
+    }
+    if(region.type == BoxRegion){
+        node.write("type", "box");
+        write(node, "box_size", region.boxSize);
+    } else {
+        node.write("type", "convex_prism");
+        auto& polygon = *node.createFlowStyleListing("polygon");
+        for(auto& p : region.polygon){
+            polygon.append(p.x());
+            polygon.append(p.y());
+        }
+        node.write("height", region.height);
+    }
+    if(!region.offset.translation().isZero()){
+        write(node, "translation", region.offset.translation());
+    }
+    AngleAxis aa(region.offset.linear());
+    if(aa.angle() != 0.0){
+        writeDegreeAngleAxis(node, "rotation", aa);
+    }
+    node.write("io_signal_number", region.ioSignalNumber);
+}
+
+
+bool MultiRegionIntrusionDetectorItem::restore(const Archive& archive)
+{
+    impl->regions.clear();
+    auto listing = archive.findListing("regions");
+    if(listing->isValid()){
+        for(int i=0; i < listing->size(); ++i){
+            if(auto node = listing->at(i)->toMapping()){
+                if(!impl->restoreRegion(*node)){
+                    archive.throwException(format(_("Region {0} of \"{1}\" is not valid."), i, name()));
+                }
+            }
+        }
+    }
+    impl->updateMarkers();
+    return true;
+}
+
+
+bool MultiRegionIntrusionDetectorItem::Impl::restoreRegion(const Mapping& node)
+{
+    string name;
+    node.read("name", name);
+    Isometry3 offset = Isometry3::Identity();
+    Vector3 p;
+    if(read(node, "translation", p)){
+        offset.translation() = p;
+    }
+    AngleAxis aa;
+    if(readDegreeAngleAxis(node, "rotation", aa)){
+        offset.linear() = aa.toRotationMatrix();
+    }
+    int ioSignalNumber = node.get("io_signal_number", 0);
+
+    string type = node.get("type", "box");
+    if(type == "box"){
+        Vector3 size;
+        if(read(node, "box_size", size)){
+            return self->addBoxRegion(name, size, offset, ioSignalNumber) >= 0;
+        }
+    } else if(type == "convex_prism"){
+        auto& polygonNode = *node.findListing("polygon");
+        double height;
+        if(polygonNode.isValid() && node.read("height", height)){
+            vector<Vector2> polygon;
+            for(int i=0; i + 1 < polygonNode.size(); i += 2){
+                polygon.emplace_back(polygonNode[i].toDouble(), polygonNode[i + 1].toDouble());
+            }
+            return self->addConvexPrismRegion(name, polygon, height, offset, ioSignalNumber) >= 0;
+        }
+    }
+    return false;
+}
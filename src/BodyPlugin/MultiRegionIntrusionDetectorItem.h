@@ -0,0 +1,86 @@
+#ifndef CNOID_BODY_PLUGIN_MULTI_REGION_INTRUSION_DETECTOR_ITEM_H
+#define CNOID_BODY_PLUGIN_MULTI_REGION_INTRUSION_DETECTOR_ITEM_H
+
+#include "ControllerItem.h"
+#include <cnoid/RenderableItem>
+#include <vector>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This item detects the intrusion of the links of the target body into multiple regions
+   and outputs the intrusion state of each region to the digital IO signal assigned to it.
+   A region is a box or a convex prism whose center is the origin of the region coordinate frame.
+   The prism extends from -height / 2 to height / 2 along the z axis, so that a box region
+   describes the same volume as the box region of RegionIntrusionDetectorItem. All the regions are checked in a single pass where the pairs of a region
+   and a link whose bounding boxes do not overlap are culled before the collision check.
+*/
+class CNOID_EXPORT MultiRegionIntrusionDetectorItem : public ControllerItem, public RenderableItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    MultiRegionIntrusionDetectorItem();
+    ~MultiRegionIntrusionDetectorItem();
+
+    enum RegionType { BoxRegion, ConvexPrismRegion };
+
+    //! \return The index of the added region
+    int addBoxRegion(
+        const std::string& name, const Vector3& size, const Isometry3& offset, int ioSignalNumber);
+
+    /**
+       \param polygon The vertices of the cross section on the x-y plane. The convex hull of the vertices
+       is used as the actual cross section.
+       \return The index of the added region or -1 if the polygon or the height is invalid
+    */
+    int addConvexPrismRegion(
+        const std::string& name, const std::vector<Vector2>& polygon, double height,
+        const Isometry3& offset, int ioSignalNumber);
+
+    void removeRegion(int index);
+    void clearRegions();
+    int numRegions() const;
+
+    const std::string& regionName(int index) const;
+    RegionType regionType(int index) const;
+    //! Box size for the box region. (0, 0, height) for the convex prism region.
+    Vector3 regionSize(int index) const;
+    const std::vector<Vector2>& regionPolygon(int index) const;
+    void setRegionOffset(int index, const Isometry3& T);
+    const Isometry3& regionOffset(int index) const;
+    void setRegionIoSignalNumber(int index, int no);
+    int regionIoSignalNumber(int index) const;
+
+    //! The intrusion state detected in the last control step
+    bool isRegionIntruded(int index) const;
+
+    virtual bool initialize(ControllerIO* io) override;
+    virtual void input() override;
+    virtual bool control() override;
+    virtual void output() override;
+    virtual void stop() override;
+
+    // RenderableItem function. This returns the region markers.
+    virtual SgNode* getScene() override;
+
+    class Impl;
+
+protected:
+    MultiRegionIntrusionDetectorItem(const MultiRegionIntrusionDetectorItem& org);
+    virtual Item* doCloneItem(CloneMap* cloneMap) const override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    Impl* impl;
+};
+
+typedef ref_ptr<MultiRegionIntrusionDetectorItem> MultiRegionIntrusionDetectorItemPtr;
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include "NameListUtil.h"
+#include <cnoid/StringUtil>
+#include <cnoid/Tokenizer>
+
+using namespace std;
+
+namespace cnoid {
+
+string getNameListString(const vector<string>& names)
+{
+    string nameList;
+    if(!names.empty()){
+        size_t n = names.size() - 1;
+        for(size_t i=0; i < n; ++i){
+            nameList += names[i];
+            nameList += ", ";
+        }
+        nameList += names.back();
+    }
+    return nameList;
+}
+
+
+bool updateNames(const string& nameListString, string& out_newNameListString, vector<string>& out_names)
+{
+    out_names.clear();
+    for(auto& token : Tokenizer<CharSeparator<char>>(nameListString, CharSeparator<char>(","))){
+        auto name = trimmed(token);
+        if(!name.empty()){
+            out_names.push_back(name);
+        }
+    }
+    out_newNameListString = nameListString;
+    return true;
+}
+
+}
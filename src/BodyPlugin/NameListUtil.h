@@ -0,0 +1,21 @@
+#ifndef CNOID_BODYPLUGIN_NAME_LIST_UTIL_H
+#define CNOID_BODYPLUGIN_NAME_LIST_UTIL_H
+
+#include <string>
+#include <vector>
+
+namespace cnoid {
+
+/*
+  The functions to edit a list of names such as the target bodies and sensors of a sensor simulator item
+  as a comma separated string property.
+*/
+
+std::string getNameListString(const std::vector<std::string>& names);
+
+//! \return true to accept the string as the new property value
+bool updateNames(const std::string& nameListString, std::string& out_newNameListString, std::vector<std::string>& out_names);
+
+}
+
+#endif
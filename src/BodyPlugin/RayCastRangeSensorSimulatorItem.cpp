@@ -0,0 +1,1049 @@
+#include "RayCastRangeSensorSimulatorItem.h"
+#include "SimulatorItem.h"
+#include "NameListUtil.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/ValueTreeUtil>
+#include <cnoid/Body>
+#include <cnoid/RangeSensor>
+#include <cnoid/RangeCamera>
+#include <cnoid/MeshExtractor>
+#include <cnoid/MeshRayIntersector>
+#include <cnoid/SceneDrawables>
+#include <cnoid/SceneCameras>
+#include <cnoid/ThreadPool>
+#include <fmt/format.h>
+#include <atomic>
+#include <random>
+#include <set>
+#include <limits>
+#include <cmath>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const int MaxNumLeafGeometries = 2;
+const int NumRaysPerChunk = 256;
+
+/**
+   The triangles of a link integrated in the link coordinate frame
+*/
+struct LinkGeometry
+{
+    Link* link;
+    SgMeshPtr mesh;
+    MeshRayIntersector intersector;
+    vector<int> triangleColorIndices;
+    vector<Vector3f> colors;
+    Vector3 localCenter;
+    Vector3 localHalfSize;
+    Vector3 worldMin;
+    Vector3 worldMax;
+    Isometry3 T_inv;
+};
+
+struct GeometryNode
+{
+    Vector3 min;
+    Vector3 max;
+    // The index of the first geometry for a leaf node and the index of the second child for an inner node.
+    // The first child of an inner node is always the next node.
+    int index;
+    // Zero for an inner node
+    int numGeometries;
+};
+
+/**
+   The two-level BVH of the world. The bottom level is the BVH of each link geometry, which is
+   static in the link frame. The top level is the BVH of the link bounding boxes, whose topology
+   is determined at the initialization and whose bounding boxes are refitted to the current link
+   positions by the refit function.
+*/
+class WorldRayCaster
+{
+public:
+    vector<unique_ptr<LinkGeometry>> geometries;
+    vector<int> geometryOrder;
+    vector<GeometryNode> nodes;
+
+    void clear();
+    void addLink(Link* link, SgNode* shape);
+    void build();
+    void refit();
+    bool castRay(const Vector3& origin, const Vector3& direction, double& io_t, Vector3f* out_color) const;
+
+private:
+    int buildNode(int begin, int end, const vector<Vector3>& centers);
+    void updateNodeBox(GeometryNode& node, const Vector3& min, const Vector3& max);
+};
+
+class SensorInfo : public Referenced
+{
+public:
+    Device* device;
+    RangeSensor* rangeSensor;
+    RangeCamera* rangeCamera;
+    SimulationBody* simBody;
+    Matrix3 R_optical;
+
+    // The rays are indexed by "sweep * numAcross + across".
+    // The sweep is the yaw column of a range sensor and the pixel row from the top of a range camera.
+    int numSweeps;
+    int numAcross;
+    // The directions in the optical frame. The directions of a range camera have the unit depth.
+    vector<Vector3> directions;
+    double minDistance;
+    double maxDistance;
+    vector<double> distances;
+    bool hasImage;
+    vector<Vector3f> colors;
+
+    double cycleTime;
+    double elapsedTime;
+    int nextSweep;
+    bool wasDeviceOn;
+
+    std::mt19937 randomNumber;
+    std::uniform_real_distribution<> detectionProbability;
+    std::normal_distribution<> distanceErrorDistribution;
+
+    SensorInfo(Device* device, SimulationBody* simBody);
+    int numRays() const { return numSweeps * numAcross; }
+};
+
+typedef ref_ptr<SensorInfo> SensorInfoPtr;
+
+}
+
+namespace cnoid {
+
+class RayCastRangeSensorSimulatorItem::Impl
+{
+public:
+    RayCastRangeSensorSimulatorItem* self;
+    ostream& os;
+    SimulatorItem* simulatorItem;
+    double worldTimeStep;
+    double currentTime;
+    vector<SensorInfoPtr> sensors;
+    WorldRayCaster rayCaster;
+    bool isRayCasterUpdated;
+    unique_ptr<ThreadPool> threadPool;
+    int numActualThreads;
+
+    vector<string> bodyNames;
+    string bodyNameListString;
+    vector<string> sensorNames;
+    string sensorNameListString;
+    double maxFrameRate;
+    bool isVisionDataRecordingEnabled;
+    Selection geometryType;
+    bool isRollingScanEnabled;
+    int numThreads;
+
+    Impl(RayCastRangeSensorSimulatorItem* self);
+    Impl(RayCastRangeSensorSimulatorItem* self, const Impl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    bool initializeSensor(SensorInfo* sensor);
+    void onPostDynamics();
+    void castSensorRays(SensorInfo* sensor, int sweepBegin, int sweepEnd);
+    void outputSensorData(SensorInfo* sensor, double delay);
+    void outputRangeSensorData(SensorInfo* sensor);
+    void outputRangeCameraData(SensorInfo* sensor);
+    void clearSensorData(SensorInfo* sensor);
+    void notifySensorStateChange(SensorInfo* sensor);
+    void finalizeSimulation();
+    void doPutProperties(PutPropertyFunction& putProperty);
+    bool store(Archive& archive);
+    bool restore(const Archive& archive);
+
+    template<typename Type> void setProperty(Type& variable, const Type& value){
+        if(value != variable){
+            variable = value;
+            self->notifyUpdate();
+        }
+    }
+};
+
+}
+
+
+void WorldRayCaster::clear()
+{
+    geometries.clear();
+    geometryOrder.clear();
+    nodes.clear();
+}
+
+
+void WorldRayCaster::addLink(Link* link, SgNode* shape)
+{
+    if(!shape){
+        return;
+    }
+
+    unique_ptr<LinkGeometry> geometry(new LinkGeometry);
+    geometry->link = link;
+    geometry->mesh = new SgMesh;
+    auto mesh = geometry->mesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+
+    MeshExtractor meshExtractor;
+    meshExtractor.extract(
+        shape,
+        [&](SgMesh* srcMesh){
+            if(!srcMesh->hasVertices()){
+                return;
+            }
+            const Affine3& T = meshExtractor.currentTransform();
+            const int offset = vertices.size();
+            for(auto& v : *srcMesh->vertices()){
+                vertices.push_back((T * v.cast<Affine3::Scalar>()).cast<float>());
+            }
+            const int colorIndex = geometry->colors.size();
+            auto material = meshExtractor.currentShape()->material();
+            geometry->colors.push_back(material ? material->diffuseColor() : Vector3f(1.0f, 1.0f, 1.0f));
+
+            const int numTriangles = srcMesh->numTriangles();
+            for(int i=0; i < numTriangles; ++i){
+                auto triangle = srcMesh->triangle(i);
+                mesh->addTriangle(triangle[0] + offset, triangle[1] + offset, triangle[2] + offset);
+                geometry->triangleColorIndices.push_back(colorIndex);
+            }
+        });
+
+    if(mesh->numTriangles() == 0){
+        return;
+    }
+
+    geometry->intersector.build(mesh);
+    if(geometry->intersector.empty()){
+        return;
+    }
+
+    Vector3f min = Vector3f::Constant(std::numeric_limits<float>::max());
+    Vector3f max = Vector3f::Constant(std::numeric_limits<float>::lowest());
+    for(auto& v : vertices){
+        min = min.cwiseMin(v);
+        max = max.cwiseMax(v);
+    }
+    geometry->localCenter = ((min + max) / 2.0f).cast<double>();
+    geometry->localHalfSize = ((max - min) / 2.0f).cast<double>();
+
+    geometries.push_back(std::move(geometry));
+}
+
+
+void WorldRayCaster::build()
+{
+    nodes.clear();
+    const int n = geometries.size();
+    geometryOrder.resize(n);
+    vector<Vector3> centers(n);
+    for(int i=0; i < n; ++i){
+        geometryOrder[i] = i;
+        auto& geometry = geometries[i];
+        centers[i] = geometry->link->T() * geometry->localCenter;
+    }
+    if(n > 0){
+        nodes.reserve(2 * n);
+        buildNode(0, n, centers);
+    }
+    refit();
+}
+
+
+int WorldRayCaster::buildNode(int begin, int end, const vector<Vector3>& centers)
+{
+    const int nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    const int n = end - begin;
+    Vector3 cmin = Vector3::Constant(std::numeric_limits<double>::max());
+    Vector3 cmax = Vector3::Constant(std::numeric_limits<double>::lowest());
+    for(int i = begin; i < end; ++i){
+        const Vector3& c = centers[geometryOrder[i]];
+        cmin = cmin.cwiseMin(c);
+        cmax = cmax.cwiseMax(c);
+    }
+    int axis;
+    const double extent = (cmax - cmin).maxCoeff(&axis);
+
+    if(n <= MaxNumLeafGeometries || extent <= 0.0){
+        nodes[nodeIndex].index = begin;
+        nodes[nodeIndex].numGeometries = n;
+    } else {
+        const int middle = begin + n / 2;
+        std::nth_element(
+            geometryOrder.begin() + begin, geometryOrder.begin() + middle, geometryOrder.begin() + end,
+            [&](int a, int b){ return centers[a][axis] < centers[b][axis]; });
+        buildNode(begin, middle, centers);
+        const int secondChild = buildNode(middle, end, centers);
+        nodes[nodeIndex].index = secondChild;
+        nodes[nodeIndex].numGeometries = 0;
+    }
+
+    return nodeIndex;
+}
+
+
+void WorldRayCaster::updateNodeBox(GeometryNode& node, const Vector3& min, const Vector3& max)
+{
+    node.min = node.min.cwiseMin(min);
+    node.max = node.max.cwiseMax(max);
+}
+
+
+void WorldRayCaster::refit()
+{
+    for(auto& geometry : geometries){
+        const Isometry3& T = geometry->link->T();
+        const Vector3 center = T * geometry->localCenter;
+        const Vector3 halfSize = T.linear().cwiseAbs() * geometry->localHalfSize;
+        geometry->worldMin = center - halfSize;
+        geometry->worldMax = center + halfSize;
+        geometry->T_inv = T.inverse();
+    }
+
+    // The children of a node always follow the node
+    for(int i = nodes.size() - 1; i >= 0; --i){
+        auto& node = nodes[i];
+        node.min = Vector3::Constant(std::numeric_limits<double>::max());
+        node.max = Vector3::Constant(std::numeric_limits<double>::lowest());
+        if(node.numGeometries > 0){
+            const int end = node.index + node.numGeometries;
+            for(int j = node.index; j < end; ++j){
+                auto& geometry = geometries[geometryOrder[j]];
+                updateNodeBox(node, geometry->worldMin, geometry->worldMax);
+            }
+        } else {
+            auto& child1 = nodes[i + 1];
+            auto& child2 = nodes[node.index];
+            updateNodeBox(node, child1.min, child1.max);
+            updateNodeBox(node, child2.min, child2.max);
+        }
+    }
+}
+
+
+static bool intersectBox
+(const GeometryNode& node, const Vector3& origin, const Vector3& invDirection, double tmax)
+{
+    double t0 = 0.0;
+    double t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        double tnear = (node.min[i] - origin[i]) * invDirection[i];
+        double tfar = (node.max[i] - origin[i]) * invDirection[i];
+        if(tnear > tfar){
+            std::swap(tnear, tfar);
+        }
+        if(tnear > t0){
+            t0 = tnear;
+        }
+        if(tfar < t1){
+            t1 = tfar;
+        }
+        if(t0 > t1){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   \param io_t The upper limit of the ray parameter, which is updated with the parameter of the hit point.
+   \param out_color The color of the hit point is returned if this is not null.
+*/
+bool WorldRayCaster::castRay
+(const Vector3& origin, const Vector3& direction, double& io_t, Vector3f* out_color) const
+{
+    if(nodes.empty()){
+        return false;
+    }
+
+    const Vector3 invDirection = direction.cwiseInverse();
+    double tmax = io_t;
+    const LinkGeometry* hitGeometry = nullptr;
+    int hitTriangle = -1;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        const int nodeIndex = stack[--stackSize];
+        const GeometryNode& node = nodes[nodeIndex];
+        if(!intersectBox(node, origin, invDirection, tmax)){
+            continue;
+        }
+        if(node.numGeometries > 0){
+            const int end = node.index + node.numGeometries;
+            for(int i = node.index; i < end; ++i){
+                auto geometry = geometries[geometryOrder[i]].get();
+                // The ray parameter is not changed by the rigid transformation
+                const Vector3 localOrigin = geometry->T_inv * origin;
+                const Vector3 localDirection = geometry->T_inv.linear() * direction;
+                int triangle;
+                if(geometry->intersector.intersect(localOrigin, localDirection, tmax, false, &triangle)){
+                    hitGeometry = geometry;
+                    hitTriangle = triangle;
+                }
+            }
+        } else {
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = nodeIndex + 1;
+        }
+    }
+
+    if(!hitGeometry){
+        return false;
+    }
+
+    io_t = tmax;
+
+    if(out_color){
+        // Simple shading with the light from the sensor
+        auto triangle = hitGeometry->mesh->triangle(hitTriangle);
+        const auto& vertices = *hitGeometry->mesh->vertices();
+        const Vector3f& v0 = vertices[triangle[0]];
+        const Vector3f normal = (vertices[triangle[1]] - v0).cross(vertices[triangle[2]] - v0);
+        const Vector3f localDirection = (hitGeometry->T_inv.linear() * direction).cast<float>();
+        float c = 1.0f;
+        const float norms = normal.norm() * localDirection.norm();
+        if(norms > 0.0f){
+            c = fabsf(normal.dot(localDirection)) / norms;
+        }
+        const Vector3f& color = hitGeometry->colors[hitGeometry->triangleColorIndices[hitTriangle]];
+        *out_color = color * (0.3f + 0.7f * c);
+    }
+
+    return true;
+}
+
+
+SensorInfo::SensorInfo(Device* device, SimulationBody* simBody)
+    : device(device),
+      simBody(simBody)
+{
+    rangeSensor = dynamic_cast<RangeSensor*>(device);
+    rangeCamera = dynamic_cast<RangeCamera*>(device);
+    numSweeps = 0;
+    numAcross = 0;
+    hasImage = false;
+}
+
+
+void RayCastRangeSensorSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager().registerClass<RayCastRangeSensorSimulatorItem, SubSimulatorItem>(
+        N_("RayCastRangeSensorSimulatorItem"));
+    ext->itemManager().addCreationPanel<RayCastRangeSensorSimulatorItem>();
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem()
+{
+    impl = new Impl(this);
+    setName("RayCastRangeSensorSimulator");
+}
+
+
+RayCastRangeSensorSimulatorItem::Impl::Impl(RayCastRangeSensorSimulatorItem* self)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      geometryType(RayCastRangeSensorSimulatorItem::N_GEOMETRY_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
+{
+    simulatorItem = nullptr;
+    maxFrameRate = 1000.0;
+    isVisionDataRecordingEnabled = false;
+    geometryType.setSymbol(RayCastRangeSensorSimulatorItem::VISUAL_GEOMETRY, N_("Visual"));
+    geometryType.setSymbol(RayCastRangeSensorSimulatorItem::COLLISION_GEOMETRY, N_("Collision"));
+    geometryType.select(RayCastRangeSensorSimulatorItem::VISUAL_GEOMETRY);
+    isRollingScanEnabled = false;
+    numThreads = 0;
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+RayCastRangeSensorSimulatorItem::Impl::Impl(RayCastRangeSensorSimulatorItem* self, const Impl& org)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      bodyNames(org.bodyNames),
+      sensorNames(org.sensorNames),
+      geometryType(org.geometryType)
+{
+    simulatorItem = nullptr;
+    bodyNameListString = getNameListString(bodyNames);
+    sensorNameListString = getNameListString(sensorNames);
+    maxFrameRate = org.maxFrameRate;
+    isVisionDataRecordingEnabled = org.isVisionDataRecordingEnabled;
+    isRollingScanEnabled = org.isRollingScanEnabled;
+    numThreads = org.numThreads;
+}
+
+
+Item* RayCastRangeSensorSimulatorItem::doCloneItem(CloneMap* /* cloneMap */) const
+{
+    return new RayCastRangeSensorSimulatorItem(*this);
+}
+
+
+RayCastRangeSensorSimulatorItem::~RayCastRangeSensorSimulatorItem()
+{
+    delete impl;
+}
+
+
+void RayCastRangeSensorSimulatorItem::setTargetBodies(const std::string& names)
+{
+    updateNames(names, impl->bodyNameListString, impl->bodyNames);
+    notifyUpdate();
+}
+
+
+void RayCastRangeSensorSimulatorItem::setTargetSensors(const std::string& names)
+{
+    updateNames(names, impl->sensorNameListString, impl->sensorNames);
+    notifyUpdate();
+}
+
+
+void RayCastRangeSensorSimulatorItem::setMaxFrameRate(double rate)
+{
+    impl->setProperty(impl->maxFrameRate, rate);
+}
+
+
+void RayCastRangeSensorSimulatorItem::setVisionDataRecordingEnabled(bool on)
+{
+    impl->setProperty(impl->isVisionDataRecordingEnabled, on);
+}
+
+
+void RayCastRangeSensorSimulatorItem::setGeometryType(int type)
+{
+    if(type != impl->geometryType.which()){
+        impl->geometryType.select(type);
+        notifyUpdate();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::setRollingScanEnabled(bool on)
+{
+    impl->setProperty(impl->isRollingScanEnabled, on);
+}
+
+
+void RayCastRangeSensorSimulatorItem::setNumThreads(int n)
+{
+    impl->setProperty(impl->numThreads, n);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    this->simulatorItem = simulatorItem;
+    worldTimeStep = simulatorItem->worldTimeStep();
+    currentTime = 0.0;
+    sensors.clear();
+    rayCaster.clear();
+
+    std::set<string> bodyNameSet(bodyNames.begin(), bodyNames.end());
+    std::set<string> sensorNameSet(sensorNames.begin(), sensorNames.end());
+    const bool useCollisionShapes = geometryType.is(RayCastRangeSensorSimulatorItem::COLLISION_GEOMETRY);
+
+    for(auto& simBody : simulatorItem->simulationBodies()){
+        Body* body = simBody->body();
+
+        for(auto& link : body->links()){
+            rayCaster.addLink(link, useCollisionShapes ? link->collisionShape() : link->visualShape());
+        }
+
+        if(bodyNameSet.empty() || bodyNameSet.find(body->name()) != bodyNameSet.end()){
+            for(int i=0; i < body->numDevices(); ++i){
+                Device* device = body->device(i);
+                if(dynamic_cast<RangeSensor*>(device) || dynamic_cast<RangeCamera*>(device)){
+                    if(sensorNameSet.empty() || sensorNameSet.find(device->name()) != sensorNameSet.end()){
+                        SensorInfoPtr sensor = new SensorInfo(device, simBody);
+                        if(initializeSensor(sensor)){
+                            os << format(_("{0} detected range sensor \"{1}\" of {2} as a target.\n"),
+                                         self->displayName(), device->name(), body->name());
+                            sensors.push_back(sensor);
+                        } else {
+                            os << format(_("{0}: Target sensor \"{1}\" cannot be initialized.\n"),
+                                         self->displayName(), device->name());
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if(sensors.empty()){
+        os << format(_("{} has no target sensors"), self->displayName()) << endl;
+        return false;
+    }
+
+    rayCaster.build();
+    isRayCasterUpdated = true;
+
+    numActualThreads = numThreads;
+    if(numActualThreads <= 0){
+        numActualThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if(numActualThreads > 1){
+        threadPool.reset(new ThreadPool(numActualThreads));
+    }
+
+    simulatorItem->addPostDynamicsFunction([&](){ onPostDynamics(); });
+
+    return true;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::initializeSensor(SensorInfo* sensor)
+{
+    sensor->directions.clear();
+
+    if(auto rangeSensor = sensor->rangeSensor){
+        sensor->R_optical = rangeSensor->opticalFrameRotation();
+        const int numYawSamples = rangeSensor->numYawSamples();
+        const int numPitchSamples = rangeSensor->numPitchSamples();
+        const double yawStep = rangeSensor->yawStep();
+        const double pitchStep = rangeSensor->pitchStep();
+        sensor->numSweeps = numYawSamples;
+        sensor->numAcross = numPitchSamples;
+        sensor->directions.reserve(sensor->numRays());
+        // The same directions as the ones assumed by GLVisionSimulatorItem and SensorVisualizerItem
+        for(int yaw=0; yaw < numYawSamples; ++yaw){
+            const double yawAngle = yaw * yawStep - rangeSensor->yawRange() / 2.0;
+            for(int pitch=0; pitch < numPitchSamples; ++pitch){
+                const double pitchAngle = pitch * pitchStep - rangeSensor->pitchRange() / 2.0;
+                const double cosPitchAngle = cos(pitchAngle);
+                sensor->directions.emplace_back(
+                    cosPitchAngle * sin(-yawAngle), sin(pitchAngle), -cosPitchAngle * cos(yawAngle));
+            }
+        }
+        sensor->minDistance = rangeSensor->minDistance();
+        sensor->maxDistance = rangeSensor->maxDistance();
+        sensor->cycleTime = 1.0 / std::max(0.1, std::min(rangeSensor->scanRate(), maxFrameRate));
+        if(isVisionDataRecordingEnabled){
+            rangeSensor->setRangeDataStateClonable(true);
+        }
+        if(rangeSensor->errorDeviation() > 0.0){
+            sensor->distanceErrorDistribution.param(
+                std::normal_distribution<>::param_type(0.0, rangeSensor->errorDeviation()));
+        }
+
+    } else if(auto rangeCamera = sensor->rangeCamera){
+        if(rangeCamera->lensType() != Camera::NORMAL_LENS){
+            return false;
+        }
+        const int width = rangeCamera->resolutionX();
+        const int height = rangeCamera->resolutionY();
+        if(width <= 0 || height <= 0){
+            return false;
+        }
+        sensor->R_optical = rangeCamera->opticalFrameRotation();
+        sensor->numSweeps = height;
+        sensor->numAcross = width;
+        sensor->directions.reserve(sensor->numRays());
+        const double aspectRatio = static_cast<double>(width) / height;
+        const double tanHalfFovy = tan(SgPerspectiveCamera::fovy(aspectRatio, rangeCamera->fieldOfView()) / 2.0);
+        const double tanHalfFovx = aspectRatio * tanHalfFovy;
+        // The rows are ordered from the top as the point data of GLVisionSimulatorItem
+        for(int row=0; row < height; ++row){
+            const double y = (1.0 - 2.0 * (row + 0.5) / height) * tanHalfFovy;
+            for(int col=0; col < width; ++col){
+                const double x = (2.0 * (col + 0.5) / width - 1.0) * tanHalfFovx;
+                sensor->directions.emplace_back(x, y, -1.0);
+            }
+        }
+        sensor->minDistance = rangeCamera->nearClipDistance();
+        sensor->maxDistance = rangeCamera->farClipDistance();
+        sensor->hasImage = (rangeCamera->imageType() != Camera::NO_IMAGE);
+        sensor->cycleTime = 1.0 / std::max(0.1, std::min(rangeCamera->frameRate(), maxFrameRate));
+        if(isVisionDataRecordingEnabled){
+            rangeCamera->setImageStateClonable(true);
+        }
+        if(rangeCamera->errorDeviation() > 0.0){
+            sensor->distanceErrorDistribution.param(
+                std::normal_distribution<>::param_type(0.0, rangeCamera->errorDeviation()));
+        }
+    } else {
+        return false;
+    }
+
+    if(sensor->numRays() == 0 || sensor->maxDistance <= sensor->minDistance){
+        return false;
+    }
+
+    sensor->distances.resize(sensor->numRays());
+    if(sensor->hasImage){
+        sensor->colors.resize(sensor->numRays());
+    }
+    sensor->elapsedTime = 0.0;
+    sensor->nextSweep = 0;
+    sensor->wasDeviceOn = false;
+
+    return true;
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::onPostDynamics()
+{
+    currentTime = simulatorItem->currentTime();
+    isRayCasterUpdated = false;
+
+    for(auto& sensor : sensors){
+        if(!sensor->device->on()){
+            if(sensor->wasDeviceOn){
+                clearSensorData(sensor);
+                sensor->wasDeviceOn = false;
+            }
+            continue;
+        }
+        if(!sensor->wasDeviceOn){
+            sensor->elapsedTime = isRollingScanEnabled ? 0.0 : sensor->cycleTime;
+            sensor->nextSweep = 0;
+            sensor->wasDeviceOn = true;
+        }
+
+        if(!isRollingScanEnabled){
+            if(sensor->elapsedTime >= sensor->cycleTime){
+                castSensorRays(sensor, 0, sensor->numSweeps);
+                outputSensorData(sensor, 0.0);
+                sensor->elapsedTime -= sensor->cycleTime;
+            }
+        } else {
+            // The sweep i is taken at the time i / numSweeps * cycleTime from the onset of the scan
+            const double phase = sensor->elapsedTime / sensor->cycleTime;
+            const int sweepEnd =
+                std::min(sensor->numSweeps, static_cast<int>(floor(phase * sensor->numSweeps)) + 1);
+            if(sweepEnd > sensor->nextSweep){
+                castSensorRays(sensor, sensor->nextSweep, sweepEnd);
+                sensor->nextSweep = sweepEnd;
+            }
+            if(sensor->nextSweep == sensor->numSweeps){
+                outputSensorData(sensor, sensor->elapsedTime);
+                sensor->elapsedTime -= sensor->cycleTime;
+                sensor->nextSweep = 0;
+            }
+        }
+
+        sensor->elapsedTime += worldTimeStep;
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::castSensorRays(SensorInfo* sensor, int sweepBegin, int sweepEnd)
+{
+    if(!isRayCasterUpdated){
+        rayCaster.refit();
+        isRayCasterUpdated = true;
+    }
+
+    Device* device = sensor->device;
+    const Isometry3 T = device->link()->T() * device->T_local();
+    const Matrix3 R = T.linear() * sensor->R_optical;
+    const Vector3 p = T.translation();
+    const double minDistance = sensor->minDistance;
+    const double rayLength = sensor->maxDistance - minDistance;
+
+    auto castRays = [this, sensor, &R, &p, minDistance, rayLength](int begin, int end){
+        Vector3f color;
+        Vector3f* pColor = sensor->hasImage ? &color : nullptr;
+        for(int i = begin; i < end; ++i){
+            const Vector3 direction = R * sensor->directions[i];
+            // The objects nearer than the min distance are not detected like the near clip plane
+            const Vector3 origin = p + minDistance * direction;
+            double t = rayLength;
+            if(rayCaster.castRay(origin, direction, t, pColor)){
+                sensor->distances[i] = minDistance + t;
+                if(pColor){
+                    sensor->colors[i] = color;
+                }
+            } else {
+                sensor->distances[i] = std::numeric_limits<double>::infinity();
+            }
+        }
+    };
+
+    const int begin = sweepBegin * sensor->numAcross;
+    const int end = sweepEnd * sensor->numAcross;
+
+    if(!threadPool || end - begin <= NumRaysPerChunk){
+        castRays(begin, end);
+    } else {
+        std::atomic<int> counter(begin);
+        const int numThreads = std::min(numActualThreads, (end - begin) / NumRaysPerChunk + 1);
+        for(int i=0; i < numThreads; ++i){
+            threadPool->start(
+                [&](){
+                    int chunkBegin;
+                    while((chunkBegin = counter.fetch_add(NumRaysPerChunk)) < end){
+                        castRays(chunkBegin, std::min(chunkBegin + NumRaysPerChunk, end));
+                    }
+                });
+        }
+        threadPool->wait();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::outputSensorData(SensorInfo* sensor, double delay)
+{
+    if(sensor->rangeSensor){
+        outputRangeSensorData(sensor);
+        sensor->rangeSensor->setDelay(delay);
+    } else {
+        outputRangeCameraData(sensor);
+        sensor->rangeCamera->setDelay(delay);
+    }
+    notifySensorStateChange(sensor);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::outputRangeSensorData(SensorInfo* sensor)
+{
+    auto rangeSensor = sensor->rangeSensor;
+    const int numYawSamples = sensor->numSweeps;
+    const int numPitchSamples = sensor->numAcross;
+    const double detectionRate = rangeSensor->detectionRate();
+    const double errorDeviation = rangeSensor->errorDeviation();
+
+    auto rangeData = std::make_shared<RangeSensor::RangeData>(sensor->numRays());
+    auto& data = *rangeData;
+
+    // The noises are added in the fixed order so that the result is reproducible
+    for(int pitch=0; pitch < numPitchSamples; ++pitch){
+        for(int yaw=0; yaw < numYawSamples; ++yaw){
+            double distance = sensor->distances[yaw * numPitchSamples + pitch];
+            if(detectionRate < 1.0){
+                if(sensor->detectionProbability(sensor->randomNumber) > detectionRate){
+                    distance = std::numeric_limits<double>::infinity();
+                }
+            }
+            if(errorDeviation > 0.0 && std::isfinite(distance)){
+                distance += sensor->distanceErrorDistribution(sensor->randomNumber);
+            }
+            data[pitch * numYawSamples + yaw] = distance;
+        }
+    }
+
+    rangeSensor->setRangeData(rangeData);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::outputRangeCameraData(SensorInfo* sensor)
+{
+    auto rangeCamera = sensor->rangeCamera;
+    const int width = sensor->numAcross;
+    const int height = sensor->numSweeps;
+    const bool isOrganized = rangeCamera->isOrganized();
+    const double detectionRate = rangeCamera->detectionRate();
+    const double errorDeviation = rangeCamera->errorDeviation();
+    const double minDistance = rangeCamera->minDistance();
+    const double maxDistance = rangeCamera->maxDistance();
+    const Matrix3f Ro = sensor->R_optical.cast<float>();
+    const bool hasRo = !sensor->R_optical.isIdentity();
+    const bool isGrayscale = (rangeCamera->imageType() == Camera::GRAYSCALE_IMAGE);
+    const int numComponents = isGrayscale ? 1 : 3;
+    const int cx = width / 2;
+    const int cy = height / 2;
+    constexpr float inf = numeric_limits<float>::infinity();
+
+    auto points = std::make_shared<RangeCamera::PointData>();
+    points->reserve(sensor->numRays());
+    std::shared_ptr<Image> image;
+    unsigned char* pixels = nullptr;
+    if(sensor->hasImage){
+        image = std::make_shared<Image>();
+        if(isOrganized){
+            image->setSize(width, height, numComponents);
+        } else {
+            image->setSize(width * height, 1, numComponents);
+        }
+        pixels = image->pixels();
+    }
+    bool isDense = true;
+
+    for(int row=0; row < height; ++row){
+        for(int col=0; col < width; ++col){
+            const int index = row * width + col;
+            const double depth = sensor->distances[index];
+            Vector3f p;
+            bool isDetected = std::isfinite(depth);
+            if(isDetected){
+                p = (depth * sensor->directions[index]).cast<float>();
+                const double distance = p.norm();
+                if(distance < minDistance || distance > maxDistance){
+                    isDetected = false;
+                } else if(detectionRate < 1.0 &&
+                          sensor->detectionProbability(sensor->randomNumber) > detectionRate){
+                    isDetected = false;
+                } else if(errorDeviation > 0.0){
+                    p *= (distance + sensor->distanceErrorDistribution(sensor->randomNumber)) / distance;
+                }
+            }
+            if(!isDetected){
+                if(!isOrganized){
+                    continue;
+                }
+                // The same representation as GLVisionSimulatorItem. The y axis is upward.
+                const int y = height - 1 - row;
+                p.x() = (col == cx) ? 0.0f : (col - cx) * inf;
+                p.y() = (y == cy) ? 0.0f : (y - cy) * inf;
+                p.z() = -inf;
+                isDense = false;
+            }
+            points->push_back(hasRo ? Vector3f(Ro * p) : p);
+
+            if(pixels){
+                Vector3f color = Vector3f::Zero();
+                if(std::isfinite(depth)){
+                    color = sensor->colors[index].cwiseMin(1.0f).cwiseMax(0.0f) * 255.0f;
+                }
+                if(isGrayscale){
+                    pixels[0] = 0.299f * color[0] + 0.587f * color[1] + 0.114f * color[2];
+                } else {
+                    pixels[0] = color[0];
+                    pixels[1] = color[1];
+                    pixels[2] = color[2];
+                }
+                pixels += numComponents;
+            }
+        }
+    }
+
+    if(image){
+        if(!isOrganized){
+            image->setSize((pixels - image->pixels()) / numComponents, 1, numComponents);
+        }
+        rangeCamera->setImage(image);
+    }
+    rangeCamera->setPoints(points);
+    rangeCamera->setDense(isDense);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::clearSensorData(SensorInfo* sensor)
+{
+    if(sensor->rangeSensor){
+        sensor->rangeSensor->clearRangeData();
+    } else {
+        sensor->rangeCamera->clearImage();
+        sensor->rangeCamera->clearPoints();
+    }
+    notifySensorStateChange(sensor);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::notifySensorStateChange(SensorInfo* sensor)
+{
+    if(isVisionDataRecordingEnabled){
+        sensor->device->notifyStateChange();
+    } else {
+        sensor->simBody->notifyUnrecordedDeviceStateChange(sensor->device);
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::finalizeSimulation()
+{
+    threadPool.reset();
+    sensors.clear();
+    rayCaster.clear();
+}
+
+
+void RayCastRangeSensorSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    SubSimulatorItem::doPutProperties(putProperty);
+    impl->doPutProperties(putProperty);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("Target bodies"), bodyNameListString,
+                [&](const string& names){ return updateNames(names, bodyNameListString, bodyNames); });
+    putProperty(_("Target sensors"), sensorNameListString,
+                [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
+    putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
+    putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty(_("Geometry"), geometryType, [&](int index){ return geometryType.select(index); });
+    putProperty(_("Rolling scan"), isRollingScanEnabled, changeProperty(isRollingScanEnabled));
+    putProperty.min(0)(_("Number of threads"), numThreads, changeProperty(numThreads));
+}
+
+
+bool RayCastRangeSensorSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    return impl->store(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::store(Archive& archive)
+{
+    writeElements(archive, "target_bodies", bodyNames, true);
+    writeElements(archive, "target_sensors", sensorNames, true);
+    archive.write("max_frame_rate", maxFrameRate);
+    archive.write("record_vision_data", isVisionDataRecordingEnabled);
+    archive.write("geometry", geometryType.selectedSymbol());
+    archive.write("rolling_scan", isRollingScanEnabled);
+    archive.write("num_threads", numThreads);
+    return true;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    return impl->restore(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::restore(const Archive& archive)
+{
+    readElements(archive, "target_bodies", bodyNames);
+    bodyNameListString = getNameListString(bodyNames);
+    readElements(archive, "target_sensors", sensorNames);
+    sensorNameListString = getNameListString(sensorNames);
+    archive.read("max_frame_rate", maxFrameRate);
+    archive.read("record_vision_data", isVisionDataRecordingEnabled);
+    string symbol;
+    if(archive.read("geometry", symbol)){
+        geometryType.select(symbol);
+    }
+    archive.read("rolling_scan", isRollingScanEnabled);
+    archive.read("num_threads", numThreads);
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef CNOID_BODY_PLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+#define CNOID_BODY_PLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This item simulates range sensors and range cameras by casting the rays of the sensors
+   against the meshes of the simulation bodies on the CPU. The rays are cast in the exact
+   yaw / pitch directions of range sensors and in the pixel directions of range cameras,
+   so the result does not depend on any rendering resolution and no OpenGL context is required.
+
+   Each link has a triangle BVH built in the link coordinate frame, and the bounding boxes of
+   the links are organized in a top-level BVH which is refitted to the current link positions
+   at every step. The rays are processed by worker threads.
+
+   If the rolling scan is enabled, a scan is taken over the scan cycle. The yaw columns of a
+   range sensor or the rows of a range camera are cast at the simulation steps corresponding
+   to their own timestamps, so the motions of the sensor and the objects during the scan are
+   reflected in the data.
+
+   \note Only the color of the material is output for the image of a range camera. The objects
+   that are not simulation bodies are not detected.
+*/
+class CNOID_EXPORT RayCastRangeSensorSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    RayCastRangeSensorSimulatorItem();
+    RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org);
+    ~RayCastRangeSensorSimulatorItem();
+
+    enum GeometryType { VISUAL_GEOMETRY, COLLISION_GEOMETRY, N_GEOMETRY_TYPES };
+
+    void setTargetBodies(const std::string& bodyNames);
+    void setTargetSensors(const std::string& sensorNames);
+    void setMaxFrameRate(double rate);
+    void setVisionDataRecordingEnabled(bool on);
+    void setGeometryType(int type);
+    void setRollingScanEnabled(bool on);
+    //! 0 means the number of the hardware threads
+    void setNumThreads(int n);
+
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
+    virtual void finalizeSimulation() override;
+
+    class Impl;
+
+protected:
+    virtual Item* doCloneItem(CloneMap* cloneMap) const override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    Impl* impl;
+};
+
+typedef ref_ptr<RayCastRangeSensorSimulatorItem> RayCastRangeSensorSimulatorItemPtr;
+
+}
+
+#endif
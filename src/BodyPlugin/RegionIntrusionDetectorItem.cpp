@@ -228,9 +228,7 @@ void RegionIntrusionDetectorItem::input()
 bool RegionIntrusionDetectorItem::control()
 {
     bool prevIntrusion = impl->isIntruding;
-    impl->isIntruding = false;
-    impl->bodyCollisionDetector->detectCollisions(
-        [this](const CollisionPair&){ impl->isIntruding = true; });
+    impl->isIntruding = impl->bodyCollisionDetector->checkCollision();
     impl->intrusionChanged = (impl->isIntruding != prevIntrusion);
     return false;
 }
@@ -12,6 +12,7 @@
 #include "WorldLogFileItem.h"
 #include "CollisionSeqItem.h"
 #include "CollisionSeqEngine.h"
+#include "BodyElementOverwriteItem.h"
 #include <cnoid/ExtensionManager>
 #include <cnoid/ItemManager>
 #include <cnoid/MenuManager>
@@ -290,6 +291,8 @@ public:
     bool hasActiveFreeBodies;
     bool recordCollisionData;
     bool isSceneViewEditModeBlockedDuringSimulation;
+    bool isBodyInstancingMode;
+    bool isBodyInstancingApplied;
 
     string controllerOptionString_;
 
@@ -346,6 +349,7 @@ public:
     ~Impl();
     void findTargetItems(Item* item, bool isUnderBodyItem, ItemList<Item>& out_targetItems);
     void clearSimulation();
+    void registerSharedShapeNodes(BodyItem* bodyItem, map<string, Body*>& modelFileToPrototypeBodyMap);
     void setSimulatorItemToControllerItem(ControllerItem* controllerItem);
     void resetSimulatorItemForControllerItem(ControllerItem* controllerItem);
     bool startSimulation(bool doReset);
@@ -830,7 +834,13 @@ void SimulationBody::cloneShapesOnce()
         if(!impl->simImpl){
             // throw exception
         }
-        impl->body_->cloneShapes(impl->simImpl->cloneMap);
+        if(impl->simImpl->isBodyInstancingApplied){
+            // The clone map of the simulator item maps the shared shape nodes to themselves
+            CloneMap cloneMap;
+            impl->body_->cloneShapes(cloneMap);
+        } else {
+            impl->body_->cloneShapes(impl->simImpl->cloneMap);
+        }
         impl->areShapesCloned = true;
     }
 }
@@ -1286,6 +1296,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     isDoingSimulationLoop = false;
     recordCollisionData = false;
     isSceneViewEditModeBlockedDuringSimulation = false;
+    isBodyInstancingMode = false;
+    isBodyInstancingApplied = false;
 
     timeBar = TimeBar::instance();
 }
@@ -1315,6 +1327,7 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     isAllLinkPositionOutputMode = org.isAllLinkPositionOutputMode;
     isDeviceStateOutputEnabled = org.isDeviceStateOutputEnabled;
     recordCollisionData = org.recordCollisionData;
+    isBodyInstancingMode = org.isBodyInstancingMode;
     controllerOptionString_ = org.controllerOptionString_;
 }
     
@@ -1392,6 +1405,18 @@ bool SimulatorItem::isRecordingEnabled() const
 }
 
 
+void SimulatorItem::setBodyInstancingMode(bool on)
+{
+    impl->isBodyInstancingMode = on;
+}
+
+
+bool SimulatorItem::isBodyInstancingMode() const
+{
+    return impl->isBodyInstancingMode;
+}
+
+
 void SimulatorItem::setTimeRangeMode(int mode)
 {
     if(mode == ActiveControlTime){
@@ -1652,6 +1677,63 @@ SimulationBody* SimulatorItem::createSimulationBody(Body* orgBody)
 }
 
 
+static bool haveSameShapeStructure(Body* body1, Body* body2)
+{
+    const int numLinks = body1->numLinks();
+    if(body2->numLinks() != numLinks){
+        return false;
+    }
+    for(int i=0; i < numLinks; ++i){
+        auto link1 = body1->link(i);
+        auto link2 = body2->link(i);
+        if(link1->visualShape()->numChildren() != link2->visualShape()->numChildren() ||
+           link1->collisionShape()->numChildren() != link2->collisionShape()->numChildren()){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   The shape nodes of a body are registered in the clone map so that the clone of the body shares
+   the nodes. The nodes of the first body loaded from a model file are shared by the other bodies
+   loaded from the same file if the bodies are not modified after loading.
+*/
+void SimulatorItem::Impl::registerSharedShapeNodes
+(BodyItem* bodyItem, map<string, Body*>& modelFileToPrototypeBodyMap)
+{
+    Body* orgBody = bodyItem->body();
+    Body* prototype = orgBody;
+
+    const string& filename = bodyItem->filePath();
+    if(!filename.empty() && bodyItem->isConsistentWithFile() &&
+       bodyItem->descendantItems<BodyElementOverwriteItem>().empty()){
+        auto inserted = modelFileToPrototypeBodyMap.emplace(filename, orgBody);
+        if(!inserted.second && haveSameShapeStructure(inserted.first->second, orgBody)){
+            prototype = inserted.first->second;
+        }
+    }
+
+    const int numLinks = orgBody->numLinks();
+    for(int i=0; i < numLinks; ++i){
+        auto orgLink = orgBody->link(i);
+        auto prototypeLink = prototype->link(i);
+        for(auto& shapes : { make_pair(orgLink->visualShape(), prototypeLink->visualShape()),
+                             make_pair(orgLink->collisionShape(), prototypeLink->collisionShape()) }){
+            const int numNodes = shapes.first->numChildren();
+            for(int j=0; j < numNodes; ++j){
+                if(prototype == orgBody){
+                    cloneMap.setOriginalAsClone(shapes.first->child(j));
+                } else {
+                    cloneMap.setClone(shapes.first->child(j), shapes.second->child(j));
+                }
+            }
+        }
+    }
+}
+
+
 void SimulatorItem::Impl::setSimulatorItemToControllerItem(ControllerItem* controllerItem)
 {
     controllerItem->setSimulatorItem(self);
@@ -1702,6 +1784,8 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     }
 
     cloneMap.clear();
+    isBodyInstancingApplied = isBodyInstancingMode;
+    map<string, Body*> modelFileToPrototypeBodyMap;
 
     currentFrame = 0;
     worldTimeStep_ = self->worldTimeStep();
@@ -1734,6 +1818,9 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
         if(auto bodyItem = dynamic_cast<BodyItem*>(targetItem.get())){
             auto orgBody = bodyItem->body();
+            if(isBodyInstancingApplied){
+                registerSharedShapeNodes(bodyItem, modelFileToPrototypeBodyMap);
+            }
             SimulationBodyPtr simBody = self->createSimulationBody(orgBody, cloneMap);
             if(!simBody){
                 // Old API
@@ -2351,6 +2438,8 @@ void SimulatorItem::Impl::flushRecords()
 
     if(!isRecordingEnabled){
         const double time = frame / worldFrameRate;
+        // The scene updates of all the bodies are notified at once
+        SgUpdateTransaction sceneUpdateTransaction;
         for(auto& simBody : activeSimBodies){
             simBody->impl->notifyRecords(time);
         }
@@ -2823,6 +2912,7 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(controllerOptionString_));
     putProperty(_("Block scene view edit mode"), isSceneViewEditModeBlockedDuringSimulation,
                 [&](bool on){ self->setSceneViewEditModeBlockedDuringSimulation(on); return true; });
+    putProperty(_("Body instancing"), isBodyInstancingMode, changeProperty(isBodyInstancingMode));
 }
 
 
@@ -2851,6 +2941,7 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("record_collision_data", recordCollisionData);
     archive.write("controller_options", controllerOptionString_, DOUBLE_QUOTED);
     archive.write("block_scene_view_edit_mode", isSceneViewEditModeBlockedDuringSimulation);
+    archive.write("body_instancing", isBodyInstancingMode);
     
     ListingPtr idseq = new Listing;
     idseq->setFlowStyle(true);
@@ -2941,6 +3032,7 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
     archive.read({ "controller_options", "controllerOptions" }, controllerOptionString_);
     archive.read({ "block_scene_view_edit_mode", "scene_view_edit_mode_blocking" },
                  isSceneViewEditModeBlockedDuringSimulation);
+    archive.read("body_instancing", isBodyInstancingMode);
 
     archive.addPostProcess([&](){ restoreTimeSyncItemEngines(archive); });
     
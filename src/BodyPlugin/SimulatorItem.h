@@ -188,6 +188,16 @@ public:
     const std::string& controllerOptionString() const;
 
     void setSceneViewEditModeBlockedDuringSimulation(bool on);    
+
+    /**
+       When the body instancing mode is enabled, the shape nodes of the original bodies are shared
+       with the simulation bodies instead of being cloned, and the bodies loaded from the same model
+       file share the shape nodes of one of them. Only the mutable states of the bodies are cloned.
+       A simulator item that modifies the shapes of a simulation body must call
+       SimulationBody::cloneShapesOnce in its initialization.
+    */
+    void setBodyInstancingMode(bool on);
+    bool isBodyInstancingMode() const;
     
     /**
        For sub simulators
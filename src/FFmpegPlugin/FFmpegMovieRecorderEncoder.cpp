@@ -1,6 +1,11 @@
 #include "FFmpegMovieRecorderEncoder.h"
 #include <fmt/format.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -17,11 +22,119 @@ using fmt::format;
 
 namespace {
 
-void YCbCrfromRGB(double& Y, double& Cb, double& Cr, const double R, const double G, const double B) 
+#ifdef _WIN32
+const char* encoderName = "libopenh264";
+#else
+const char* encoderName = "libx264";
+#endif
+
+/*
+  The conversion uses the BT.601 limited range coefficients scaled by 256 so that it can be done
+  with the integer arithmetic. The results are the same as the floating point formula within the
+  rounding error.
+*/
+inline uint8_t toY(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+//! The arguments are the sums of the four pixels in a 2x2 block
+inline uint8_t toCb(int r4, int g4, int b4)
+{
+    return ((-38 * r4 - 74 * g4 + 112 * b4 + 512) >> 10) + 128;
+}
+
+inline uint8_t toCr(int r4, int g4, int b4)
+{
+    return ((112 * r4 - 94 * g4 - 18 * b4 + 512) >> 10) + 128;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+// Sum up the adjacent pairs of the 32-bit integers in a and b
+inline __m128i addAdjacentPairs(__m128i a, __m128i b)
+{
+    __m128 fa = _mm_castsi128_ps(a);
+    __m128 fb = _mm_castsi128_ps(b);
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(even, odd);
+}
+
+// The pixels are 0xAARRGGBB values, which are stored in the order of B, G, R, A in memory
+void convertLumaRow(const uint32_t* src, uint8_t* dest, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coeffs = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    const __m128i offset = _mm_set1_epi32(128 + (16 << 8));
+
+    int x = 0;
+    for(; x + 8 <= width; x += 8){
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 4));
+        // Each pixel gives the two partial sums 25B + 129G and 66R
+        __m128i s0 = _mm_madd_epi16(_mm_unpacklo_epi8(p0, zero), coeffs);
+        __m128i s1 = _mm_madd_epi16(_mm_unpackhi_epi8(p0, zero), coeffs);
+        __m128i s2 = _mm_madd_epi16(_mm_unpacklo_epi8(p1, zero), coeffs);
+        __m128i s3 = _mm_madd_epi16(_mm_unpackhi_epi8(p1, zero), coeffs);
+        __m128i y0 = _mm_srai_epi32(_mm_add_epi32(addAdjacentPairs(s0, s1), offset), 8);
+        __m128i y1 = _mm_srai_epi32(_mm_add_epi32(addAdjacentPairs(s2, s3), offset), 8);
+        __m128i y = _mm_packs_epi32(y0, y1);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(y, y));
+    }
+    for(; x < width; ++x){
+        const uint32_t p = src[x];
+        dest[x] = toY((p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff);
+    }
+}
+
+#else
+
+void convertLumaRow(const uint32_t* src, uint8_t* dest, int width)
+{
+    for(int x = 0; x < width; ++x){
+        const uint32_t p = src[x];
+        dest[x] = toY((p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff);
+    }
+}
+
+#endif
+
+void convertChromaRow(const uint32_t* src0, const uint32_t* src1, uint8_t* destCb, uint8_t* destCr, int width)
+{
+    const int n = width / 2;
+    for(int x = 0; x < n; ++x){
+        const uint32_t p0 = src0[2 * x];
+        const uint32_t p1 = src0[2 * x + 1];
+        const uint32_t p2 = src1[2 * x];
+        const uint32_t p3 = src1[2 * x + 1];
+        // The red and blue components are summed up at once as they do not overflow to each other
+        const uint32_t rb = (p0 & 0xff00ff) + (p1 & 0xff00ff) + (p2 & 0xff00ff) + (p3 & 0xff00ff);
+        const int g = ((p0 >> 8) & 0xff) + ((p1 >> 8) & 0xff) + ((p2 >> 8) & 0xff) + ((p3 >> 8) & 0xff);
+        const int r = rb >> 16;
+        const int b = rb & 0xffff;
+        destCb[x] = toCb(r, g, b);
+        destCr[x] = toCr(r, g, b);
+    }
+}
+
+/**
+   Convert the rows of the image in the range [rowBegin, rowEnd), where the row indices must be even.
+*/
+void convertRows(const QImage& image, AVFrame* avFrame, int width, int rowBegin, int rowEnd)
 {
-    Y = 0.257 * R + 0.504 * G + 0.098 * B + 16.0;
-    Cb = -0.148 * R - 0.291 * G + 0.439 * B + 128.0;
-    Cr = 0.439 * R - 0.368 * G - 0.071 * B + 128.0;
+    for(int y = rowBegin; y < rowEnd; y += 2){
+        auto src0 = reinterpret_cast<const uint32_t*>(image.constScanLine(y));
+        auto src1 = reinterpret_cast<const uint32_t*>(image.constScanLine(y + 1));
+        convertLumaRow(src0, avFrame->data[0] + y * avFrame->linesize[0], width);
+        convertLumaRow(src1, avFrame->data[0] + (y + 1) * avFrame->linesize[0], width);
+        const int cy = y / 2;
+        convertChromaRow(
+            src0, src1,
+            avFrame->data[1] + cy * avFrame->linesize[1],
+            avFrame->data[2] + cy * avFrame->linesize[2],
+            width);
+    }
 }
 
 }
@@ -43,10 +156,22 @@ bool FFmpegMovieRecorderEncoder::initializeEncoding(int width, int height, int f
     this->width = width;
     this->height = height;
     this->frameRate = frameRate;
+    numThreads = numEncodingThreads();
+    preset = encodingPreset();
     
     return true;
 }
 
+
+std::vector<std::string> FFmpegMovieRecorderEncoder::encodingPresets() const
+{
+#ifdef _WIN32
+    return std::vector<std::string>();
+#else
+    return { "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow" };
+#endif
+}
+
     
 bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
 {
@@ -66,11 +191,6 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
 
     format_context->pb = io_context;
 
-#ifdef _WIN32
-    const char* encoderName = "libopenh264";
-#else
-    const char* encoderName = "libx264";
-#endif
     AVCodec* codec = avcodec_find_encoder_by_name(encoderName);
     if(!codec){
         setErrorMessage(format(_("Encoder \"{0}\" is not found."), encoderName));
@@ -93,6 +213,14 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
     codec_context->gop_size = 10;
     codec_context->max_b_frames = 1;
     codec_context->pix_fmt = AVPixelFormat::AV_PIX_FMT_YUV420P;
+    codec_context->thread_count = numThreads;
+
+    if(!preset.empty()){
+        if(av_opt_set(codec_context->priv_data, "preset", preset.c_str(), 0) < 0){
+            setErrorMessage(format(_("Preset \"{0}\" is not supported by encoder \"{1}\"."), preset, encoderName));
+            return false;
+        }
+    }
 
     if(format_context->oformat->flags & AVFMT_GLOBALHEADER){
         codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
@@ -142,7 +270,19 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
         return false;
     }
 
-    int img_size = codec_context->height * codec_context->width;
+    /*
+      The color conversion is done by the calling thread and the threads of the pool,
+      each of which converts a band of rows.
+    */
+    int numConversionThreads = numThreads;
+    if(numConversionThreads <= 0){
+        numConversionThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), 8);
+    }
+    numConversionThreads = std::max(1, std::min(numConversionThreads, height / 16));
+    if(numConversionThreads > 1){
+        threadPool.reset(new ThreadPool(numConversionThreads - 1));
+    }
+
     bool failed = false;
 
     while(true){
@@ -186,6 +326,7 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
         }
     }
 
+    threadPool.reset();
     av_frame_free(&avFrame);
     avcodec_free_context(&codec_context);
     avformat_free_context(format_context);
@@ -204,32 +345,32 @@ bool FFmpegMovieRecorderEncoder::copyCapturedImageToAVFrame(CapturedImagePtr cap
         return false;
     }
 
-    // copy into frame
     QImage image;
     if(stdx::get_variant_index(captured->image) == 0){
         image = stdx::get<QPixmap>(captured->image).toImage();
     } else {
         image = stdx::get<QImage>(captured->image);
     }
-    int width = image.width();
-    int height = image.height();
-
-    for(int y = 0; y < height; ++y){
-        for (int x = 0; x < width; ++x){
-            QRgb rgb = image.pixel(x, y);
-            double Y, Cb, Cr;
-            YCbCrfromRGB(Y, Cb, Cr, qRed(rgb), qGreen(rgb), qBlue(rgb));
-            avFrame->data[0][y * avFrame->linesize[0] + x] = Y;
-        }
+    if(image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32){
+        image = image.convertToFormat(QImage::Format_RGB32);
     }
-    for(int y = 0; y < height / 2; ++y){
-        for(int x = 0; x < width / 2; ++x){
-            QRgb rgb = image.pixel(2 * x, 2 * y);
-            double Y, Cb, Cr;
-            YCbCrfromRGB(Y, Cb, Cr, qRed(rgb), qGreen(rgb), qBlue(rgb));
-            avFrame->data[1][y * avFrame->linesize[1] + x] = Cb;
-            avFrame->data[2][y * avFrame->linesize[2] + x] = Cr;
+    int width = std::min(image.width(), avFrame->width);
+    int height = std::min(image.height(), avFrame->height) & ~1;
+
+    if(!threadPool){
+        convertRows(image, avFrame, width, 0, height);
+    } else {
+        int numBands = threadPool->size() + 1;
+        int bandHeight = ((height / 2 + numBands - 1) / numBands) * 2;
+        for(int i = 1; i < numBands; ++i){
+            int rowBegin = std::min(i * bandHeight, height);
+            int rowEnd = std::min(rowBegin + bandHeight, height);
+            threadPool->start(
+                [&image, avFrame, width, rowBegin, rowEnd](){
+                    convertRows(image, avFrame, width, rowBegin, rowEnd); });
         }
+        convertRows(image, avFrame, width, 0, std::min(bandHeight, height));
+        threadPool->wait();
     }
     
     avFrame->pts = captured->frame;
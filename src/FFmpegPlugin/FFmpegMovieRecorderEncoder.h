@@ -2,6 +2,8 @@
 #define CNOID_FFMPEG_PLUGIN_FFMPEG_MOVIE_RECORDER_ENCODER_H
 
 #include <cnoid/MovieRecorder>
+#include <cnoid/ThreadPool>
+#include <memory>
 extern "C" {
 #include <libavutil/frame.h>
 }
@@ -14,12 +16,16 @@ public:
     virtual std::string formatName() const override;
     virtual bool initializeEncoding(int width, int height, int frameRate) override;
     virtual bool doEncoding(std::string fileBasename) override;
+    virtual std::vector<std::string> encodingPresets() const override;
     bool copyCapturedImageToAVFrame(CapturedImagePtr captured, AVFrame* avFrame);
     
 private:
     int width;
     int height;
     int frameRate;
+    int numThreads;
+    std::string preset;
+    std::unique_ptr<ThreadPool> threadPool;
 };
 
 }
@@ -14,6 +14,7 @@
 #include <cnoid/LazyCaller>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
+#include <cnoid/ConnectionSet>
 #include <fmt/format.h>
 #include <unordered_map>
 #include <regex>
@@ -70,6 +71,10 @@ public:
     }
 };
 
+enum ComparisonOperator {
+    NoComparison, Equal, NotEqual, Less, Greater, LessEqual, GreaterEqual
+};
+
 }
     
     
@@ -124,6 +129,27 @@ public:
     regex boolPattern;
     regex stringPattern;
     regex variablePattern; // for the default variable expression syntax
+    bool isEvaluatingVariableTermToCompile;
+
+    // The expressions of the statements are compiled into the following forms not to parse them repeatedly
+    struct CompiledTerm {
+        stdx::optional<MprVariable::Value> constant;
+        function<stdx::optional<MprVariable::Value>()> variableValue;
+        string label;
+    };
+    struct CompiledExpression {
+        bool isCompiled;
+        bool isValid;
+        vector<CompiledTerm> terms;
+        vector<char> operators;
+        int comparisonOperator;
+        string error;
+        // Resolved at the first execution of an assign statement
+        function<bool(MprVariable::Value value)> assignValue;
+        CompiledExpression() : isCompiled(false), isValid(false), comparisonOperator(NoComparison) { }
+    };
+    unordered_map<MprStatement*, CompiledExpression> compiledExpressionMap;
+    ScopedConnectionSet programConnections;
 
     Impl(MprControllerItemBase* self);
     bool initialize(ControllerIO* io);
@@ -148,9 +174,15 @@ public:
     bool interpretIfStatement(MprIfStatement* statement);
     bool interpretWhileStatement(MprWhileStatement* statement);
     bool interpretCallStatement(MprCallStatement* statement);
-    stdx::optional<bool> evalConditionalExpression(const string& expression);
-    stdx::optional<MprVariable::Value> getTermValue(string::const_iterator& pos, string::const_iterator end);
-    stdx::optional<string> getComparisonOperator(string::const_iterator& pos, string::const_iterator end);
+    void compileProgram(MprProgram* program);
+    CompiledExpression& getCompiledExpression(MprStatement* statement);
+    void compileConditionalExpression(const string& expression, CompiledExpression& compiled);
+    void compileAssignmentExpression(MprAssignStatement* statement, CompiledExpression& compiled);
+    bool compileTerm(
+        string::const_iterator& pos, string::const_iterator end, CompiledTerm& out_term, CompiledExpression& compiled);
+    int compileComparisonOperator(string::const_iterator& pos, string::const_iterator end);
+    stdx::optional<MprVariable::Value> evalTerm(const CompiledTerm& term);
+    stdx::optional<bool> evalConditionalExpression(MprConditionStatement* statement);
     bool interpretAssignStatement(MprAssignStatement* statement);
     bool applyBinaryOperation(MprVariable::Value& lhsValue, char op, const MprVariable::Value& rhsValue);
     bool interpretSetSignalStatement(MprSignalStatement* statement);
@@ -190,6 +222,7 @@ MprControllerItemBase::Impl::Impl(MprControllerItemBase* self)
     isControlActive = false;
     speedRatio = 1.0;
     currentLog = new MprControllerLog;
+    isEvaluatingVariableTermToCompile = false;
 }
 
 
@@ -347,6 +380,11 @@ bool MprControllerItemBase::Impl::initialize(ControllerIO* io)
         return false;
     }
 
+    compileProgram(startupProgram);
+    for(auto& kv : otherProgramMap){
+        compileProgram(kv.second);
+    }
+
     iterator = currentProgram->begin();
 
     auto body = io->body();
@@ -495,17 +533,60 @@ MprVariable* MprControllerItemBase::Impl::findVariable(const GeneralId& id)
 
 stdx::optional<MprVariable::Value> MprControllerItemBase::evalExpressionAsVariableValue
 (std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd)
+{
+    if(auto variableValue = compileExpressionAsVariableValue(io_expressionBegin, expressionEnd)){
+        return variableValue();
+    }
+    return stdx::nullopt;
+}
+
+
+std::function<stdx::optional<MprVariable::Value>()> MprControllerItemBase::compileExpressionAsVariableValue
+(std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd)
 {
     std::smatch match;
     if(regex_search(io_expressionBegin, expressionEnd, match, impl->variablePattern)){
         io_expressionBegin = match[0].second;
         GeneralId id(std::stoi(match.str(1)));
-        if(auto variable = impl->findVariable(id)){
-            return variable->value();
-        }
-        impl->io->os() << format(_("Variable {0} is not defined."), id.label()) << endl;
+        // A variable that is not defined yet may be added by an assign statement later
+        MprVariable* variable = impl->findVariable(id);
+        auto impl_ = impl;
+        return
+            [impl_, id, variable]() mutable -> stdx::optional<MprVariable::Value> {
+                if(!variable){
+                    variable = impl_->findVariable(id);
+                    if(!variable){
+                        impl_->io->os() << format(_("Variable {0} is not defined."), id.label()) << endl;
+                        return stdx::nullopt;
+                    }
+                }
+                return variable->value();
+            };
     }
-    return stdx::nullopt;
+
+    /*
+      A subclass that customizes the variable expressions by overriding evalExpressionAsVariableValue
+      without overriding this function is supported by evaluating the term with the overridden function
+      at the evaluation time. The term is evaluated once here to find its end. The flag prevents the
+      default evalExpressionAsVariableValue, which calls this function, from recursing.
+    */
+    if(impl->isEvaluatingVariableTermToCompile){
+        return nullptr;
+    }
+    auto termEnd = io_expressionBegin;
+    impl->isEvaluatingVariableTermToCompile = true;
+    evalExpressionAsVariableValue(termEnd, expressionEnd);
+    impl->isEvaluatingVariableTermToCompile = false;
+    if(termEnd == io_expressionBegin){
+        return nullptr;
+    }
+    string term(io_expressionBegin, termEnd);
+    io_expressionBegin = termEnd;
+    return
+        [this, term]() -> stdx::optional<MprVariable::Value> {
+            auto pos = term.cbegin();
+            return evalExpressionAsVariableValue(pos, term.cend());
+        };
 }
 
 
@@ -806,6 +887,8 @@ void MprControllerItemBase::Impl::clear()
     programStack.clear();
     processorStack.clear();
     topLevelProgramToSharedNameMap.clear();
+    programConnections.disconnect();
+    compiledExpressionMap.clear();
 }
 
 
@@ -840,7 +923,7 @@ bool MprControllerItemBase::Impl::interpretGroupStatement(MprGroupStatement* sta
 
 bool MprControllerItemBase::Impl::interpretIfStatement(MprIfStatement* statement)
 {
-    auto condition = evalConditionalExpression(statement->condition());
+    auto condition = evalConditionalExpression(statement);
 
     if(!condition){
         return false;
@@ -881,7 +964,7 @@ bool MprControllerItemBase::Impl::interpretIfStatement(MprIfStatement* statement
 
 bool MprControllerItemBase::Impl::interpretWhileStatement(MprWhileStatement* statement)
 {
-    auto condition = evalConditionalExpression(statement->condition());
+    auto condition = evalConditionalExpression(statement);
 
     if(!condition){
         return false;
@@ -920,45 +1003,73 @@ bool MprControllerItemBase::Impl::interpretCallStatement(MprCallStatement* state
 }
 
 
-template<class LhsType, class RhsType>
-static stdx::optional<bool> checkNumericalComparison(const string& op, LhsType lhs, RhsType rhs)
-{
-    if(op == "="){
-        return lhs == rhs;
-    } else if(op == "!="){
-        return lhs != rhs;
-    } else if(op == "<"){
-        return lhs < rhs;
-    } else if(op == ">"){
-        return lhs > rhs;
-    } else if(op == "<="){
-        return lhs <= rhs;
-    } else if(op == ">="){
-        return lhs >= rhs;
+void MprControllerItemBase::Impl::compileProgram(MprProgram* program)
+{
+    program->traverseStatements(
+        [this](MprStatement* statement){
+            if(dynamic_cast<MprConditionStatement*>(statement) || dynamic_cast<MprAssignStatement*>(statement)){
+                getCompiledExpression(statement);
+            }
+        });
+
+    // The compiled expressions are only invalidated when the program is edited
+    programConnections.add(
+        program->sigStatementUpdated().connect(
+            [this](MprStatement* statement){ compiledExpressionMap.erase(statement); }));
+
+    // The removed statement may include sub-statements
+    programConnections.add(
+        program->sigStatementRemoved().connect(
+            [this](MprStatement*, MprProgram*){ compiledExpressionMap.clear(); }));
+}
+
+
+MprControllerItemBase::Impl::CompiledExpression&
+MprControllerItemBase::Impl::getCompiledExpression(MprStatement* statement)
+{
+    auto& compiled = compiledExpressionMap[statement];
+    if(!compiled.isCompiled){
+        if(auto conditionStatement = dynamic_cast<MprConditionStatement*>(statement)){
+            compileConditionalExpression(conditionStatement->condition(), compiled);
+        } else if(auto assignStatement = dynamic_cast<MprAssignStatement*>(statement)){
+            compileAssignmentExpression(assignStatement, compiled);
+        }
+        compiled.isCompiled = true;
     }
-    return stdx::nullopt;
+    return compiled;
 }
 
 
-stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(const string& expression)
+static void addCompileError(string& io_error, const string& message)
+{
+    if(!io_error.empty()){
+        io_error += "\n";
+    }
+    io_error += message;
+}
+
+
+void MprControllerItemBase::Impl::compileConditionalExpression
+(const string& expression, CompiledExpression& compiled)
 {
     if(expression.empty()){
-        io->os() << _("Empty conditional expression.") << endl;
-        return stdx::nullopt;
+        addCompileError(compiled.error, _("Empty conditional expression."));
+        return;
     }
     auto pos = expression.cbegin();
     auto end = expression.cend();
 
     bool isExpressionValid = false;
-    stdx::optional<string> pCmpOp;
-    stdx::optional<MprVariable::Value> pRhs;
-    stdx::optional<MprVariable::Value> pLhs = getTermValue(pos, end);
-    if(pLhs){
+    CompiledTerm lhs;
+    if(compileTerm(pos, end, lhs, compiled)){
+        compiled.terms.push_back(std::move(lhs));
         if(pos == end){
             isExpressionValid = true;
-        } else if((pCmpOp = getComparisonOperator(pos, end))){
+        } else if((compiled.comparisonOperator = compileComparisonOperator(pos, end)) != NoComparison){
             if(pos != end){
-                if((pRhs = getTermValue(pos, end))){
+                CompiledTerm rhs;
+                if(compileTerm(pos, end, rhs, compiled)){
+                    compiled.terms.push_back(std::move(rhs));
                     if(pos == end){
                         isExpressionValid = true;
                     }
@@ -967,7 +1078,178 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
         }
     }
     if(!isExpressionValid){
-        io->os() << format(_("Conditional expression \"{0}\" is invalid."), expression) << endl;
+        addCompileError(compiled.error, format(_("Conditional expression \"{0}\" is invalid."), expression));
+        return;
+    }
+
+    compiled.isValid = true;
+}
+
+
+void MprControllerItemBase::Impl::compileAssignmentExpression
+(MprAssignStatement* statement, CompiledExpression& compiled)
+{
+    auto expression = statement->valueExpression();
+    if(expression.empty()){
+        addCompileError(
+            compiled.error,
+            format(_("Expression assigned to variable {0} is empty."), statement->variableExpression()));
+        return;
+    }
+
+    auto pos = expression.cbegin();
+    auto end = expression.cend();
+    std::smatch match;
+    bool isNextTermOperator = false;
+        
+    while(pos != end){
+        bool isValidTerm = true;
+        if(!isNextTermOperator){
+            auto pos0 = pos;
+            CompiledTerm term;
+            if(compileTerm(pos, end, term, compiled)){
+                term.label = string(pos0, pos);
+                compiled.terms.push_back(std::move(term));
+                isNextTermOperator = true;
+            } else {
+                isValidTerm = false;
+            }
+        } else {
+            if(regex_search(pos, end, match, operatorPattern)){
+                compiled.operators.push_back(match.str(1)[0]);
+                pos = match[0].second;
+                isNextTermOperator = false;
+            } else {
+                isValidTerm = false;
+            }
+        }
+        if(!isValidTerm){
+            string invalidTerm;
+            if(regex_search(pos, end, match, termPattern)){
+                invalidTerm = match.str(1);
+            }
+            addCompileError(compiled.error, format(_("Term \"{0}\" is invalid."), invalidTerm));
+            return;
+        }
+    }
+
+    if(compiled.terms.empty()){
+        return;
+    } else if(!isNextTermOperator){
+        addCompileError(
+            compiled.error, format(_("Expression ends with operator {0}."), compiled.operators.back()));
+        return;
+    }
+
+    compiled.isValid = true;
+}
+
+
+bool MprControllerItemBase::Impl::compileTerm
+(string::const_iterator& pos, string::const_iterator end, CompiledTerm& out_term, CompiledExpression& compiled)
+{
+    std::smatch match;
+
+    if(regex_search(pos, end,  match, stringPattern)){
+        out_term.constant = match.str(1);
+        pos = match[0].second;
+                
+    } else if(regex_search(pos, end, match, floatPattern)){
+        out_term.constant = std::stod(match.str(0));
+        pos = match[0].second;
+            
+    } else if(regex_search(pos, end, match, intPattern)){
+        errno = 0;
+        long number = strtol(match.str(0).c_str(), nullptr, 10);
+        if(errno == ERANGE || number < INT_MIN || number > INT_MAX){
+            addCompileError(compiled.error, format(_("Integer value {0} is out of range."), match.str(0)));
+            return false;
+        }
+        out_term.constant = std::stoi(match.str(0));
+        pos = match[0].second;
+
+    } else if(regex_search(pos, end, match, boolPattern)){
+        auto label = match.str(1);
+        std::transform(label.begin(), label.end(), label.begin(), ::tolower);
+        out_term.constant = (label == "true") ? true : false;
+        pos = match[0].second;
+                
+    } else {
+        out_term.variableValue = self->compileExpressionAsVariableValue(pos, end);
+        if(!out_term.variableValue){
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+int MprControllerItemBase::Impl::compileComparisonOperator
+(string::const_iterator& pos, string::const_iterator end)
+{
+    std::smatch match;
+    if(regex_search(pos, end,  match, cmpOperatorPattern)){
+        pos = match[0].second;
+        auto op = match.str(1);
+        if(op == "="){
+            return Equal;
+        } else if(op == "!="){
+            return NotEqual;
+        } else if(op == "<"){
+            return Less;
+        } else if(op == ">"){
+            return Greater;
+        } else if(op == "<="){
+            return LessEqual;
+        } else if(op == ">="){
+            return GreaterEqual;
+        }
+    }
+    return NoComparison;
+}
+
+
+stdx::optional<MprVariable::Value> MprControllerItemBase::Impl::evalTerm(const CompiledTerm& term)
+{
+    if(term.constant){
+        return term.constant;
+    }
+    return term.variableValue();
+}
+
+
+template<class LhsType, class RhsType>
+static stdx::optional<bool> checkNumericalComparison(int op, const LhsType& lhs, const RhsType& rhs)
+{
+    switch(op){
+    case Equal:        return lhs == rhs;
+    case NotEqual:     return lhs != rhs;
+    case Less:         return lhs < rhs;
+    case Greater:      return lhs > rhs;
+    case LessEqual:    return lhs <= rhs;
+    case GreaterEqual: return lhs >= rhs;
+    default: break;
+    }
+    return stdx::nullopt;
+}
+
+
+stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(MprConditionStatement* statement)
+{
+    auto& compiled = getCompiledExpression(statement);
+    if(!compiled.isValid){
+        io->os() << compiled.error << endl;
+        return stdx::nullopt;
+    }
+
+    stdx::optional<MprVariable::Value> pRhs;
+    stdx::optional<MprVariable::Value> pLhs = evalTerm(compiled.terms[0]);
+    if(pLhs && compiled.terms.size() >= 2){
+        pRhs = evalTerm(compiled.terms[1]);
+    }
+    if(!pLhs || (compiled.terms.size() >= 2 && !pRhs)){
+        io->os() << format(_("Conditional expression \"{0}\" is invalid."), statement->condition()) << endl;
         return stdx::nullopt;
     }
 
@@ -979,7 +1261,7 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
             
     stdx::optional<bool> pResult;
     auto& rhs = *pRhs;
-    string& cmpOp = *pCmpOp;
+    int cmpOp = compiled.comparisonOperator;
 
     int rhsValueType = MprVariable::valueType(rhs);
     switch(MprVariable::valueType(lhs)){
@@ -1004,14 +1286,14 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
         break;
     }
     case MprVariable::Bool:
-        if(rhsValueType == MprVariable::Bool && cmpOp == "="){
+        if(rhsValueType == MprVariable::Bool && cmpOp == Equal){
             pResult = checkNumericalComparison(
                 cmpOp, MprVariable::boolValue(lhs), MprVariable::boolValue(rhs));
         }
         break;
 
     case MprVariable::String:
-        if(rhsValueType == MprVariable::String && cmpOp == "="){
+        if(rhsValueType == MprVariable::String && cmpOp == Equal){
             pResult = checkNumericalComparison(
                 cmpOp, MprVariable::stringValue(lhs), MprVariable::stringValue(rhs));
         }
@@ -1024,144 +1306,52 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
 
     return pResult;
 }
-    
-    
-stdx::optional<MprVariable::Value> MprControllerItemBase::Impl::getTermValue
-(string::const_iterator& pos, string::const_iterator end)
-{
-    stdx::optional<MprVariable::Value> value;
-    std::smatch match;
-
-    if(regex_search(pos, end,  match, stringPattern)){
-        value = match.str(1);
-        pos = match[0].second;
-                
-    } else if(regex_search(pos, end, match, floatPattern)){
-        value = std::stod(match.str(0));
-        pos = match[0].second;
-            
-    } else if(regex_search(pos, end, match, intPattern)){
-        errno = 0;
-        long number = strtol(match.str(0).c_str(), nullptr, 10);
-        if(errno == ERANGE || number < INT_MIN || number > INT_MAX){
-            io->os() << format(_("Integer value {0} is out of range."), match.str(0)) << endl;
-        } else {
-            value = std::stoi(match.str(0));
-            pos = match[0].second;
-        }
-    } else if(regex_search(pos, end, match, boolPattern)){
-        auto label = match.str(1);
-        std::transform(label.begin(), label.end(), label.begin(), ::tolower);
-        value = (label == "true") ? true : false;
-        pos = match[0].second;
-                
-    } else {
-        value = self->evalExpressionAsVariableValue(pos, end);
-    }
-    
-    return value;
-}
-
-
-stdx::optional<string> MprControllerItemBase::Impl::getComparisonOperator
-(string::const_iterator& pos, string::const_iterator end)
-{
-    std::smatch match;
-    if(regex_search(pos, end,  match, cmpOperatorPattern)){
-        pos = match[0].second;
-        return match.str(1);
-    }
-    return stdx::nullopt;
-}
 
 
 bool MprControllerItemBase::Impl::interpretAssignStatement(MprAssignStatement* statement)
 {
-    auto& expression = statement->valueExpression();
-    if(expression.empty()){
-        io->os() << format(_("Expression assigned to variable {0} is empty."),
-                           statement->variableExpression()) << endl;
-        return false;
-    }
-
-    vector<MprVariable::Value> termValues;
-    vector<char> operators;
-    vector<string> termStrings;
-    string invalidTerm;
-    auto pos = expression.cbegin();
-    auto end = expression.cend();
-    std::smatch match;
-    bool isValidExpression = true;
-    bool isNextTermOperator = false;
-        
-    while(pos != end){
-        if(!isNextTermOperator){
-            auto pos0 = pos;
-            if(auto term = getTermValue(pos, end)){
-                termValues.push_back(*term);
-                termStrings.push_back(string(pos0, pos));
-                isNextTermOperator = true;
-            } else {
-                if(regex_search(pos, end, match, termPattern)){
-                    invalidTerm = match.str(1);
-                } else {
-                    invalidTerm = string(match[0].first, match[0].second);
-                }
-                isValidExpression = false;
-            }
-        } else {
-            if(regex_search(pos, end, match, operatorPattern)){
-                char op = match.str(1)[0];
-                operators.push_back(op);
-                pos = match[0].second;
-                isNextTermOperator = false;
-            } else {
-                invalidTerm = string(match[0].first, match[0].second);
-                isValidExpression = false;
-            }
-        }
-        if(!isValidExpression){
-            io->os() << format(_("Term \"{0}\" is invalid."), invalidTerm) << endl;
-            break;
+    auto& compiled = getCompiledExpression(statement);
+    if(!compiled.isValid){
+        if(!compiled.error.empty()){
+            io->os() << compiled.error << endl;
         }
+        return false;
     }
 
-    if(termValues.empty()){
-        isValidExpression = false;
-    } else if(!isNextTermOperator){
-        io->os() << format(_("Expression ends with operator {0}."), operators.back()) << endl;
-        isValidExpression = false;
-    }
-    if(!isValidExpression){
+    auto& terms = compiled.terms;
+    auto pValue = evalTerm(terms[0]);
+    if(!pValue){
+        io->os() << format(_("Term \"{0}\" is invalid."), terms[0].label) << endl;
         return false;
     }
+    MprVariable::Value value = std::move(*pValue);
 
-    size_t termIndex = 0;
-    size_t operatorIndex = 0;
-    MprVariable::Value value = termValues[termIndex++];
-    while(operatorIndex < operators.size()){
-        char op = operators[operatorIndex++];
-        if(!applyBinaryOperation(value, op, termValues[termIndex++])){
-            isValidExpression = false;
+    const int numOperators = compiled.operators.size();
+    for(int i=0; i < numOperators; ++i){
+        auto& rhsTerm = terms[i + 1];
+        auto pRhs = evalTerm(rhsTerm);
+        if(!pRhs){
+            io->os() << format(_("Term \"{0}\" is invalid."), rhsTerm.label) << endl;
+            return false;
+        }
+        char op = compiled.operators[i];
+        if(!applyBinaryOperation(value, op, *pRhs)){
             io->os() << format(_("Type mismatch in expresion \"{0} {1} {2}\""),
-                               termStrings[termIndex-2],
-                               op,
-                               termStrings[termIndex-1]) << endl;
-            break;
+                               terms[i].label, op, rhsTerm.label) << endl;
+            return false;
         }
     }
     
-    bool assigned = false;
-    if(isValidExpression){
-        auto assignValue =
+    if(!compiled.assignValue){
+        compiled.assignValue =
             self->evalExpressionAsVariableToAssginValue(statement->variableExpression());
-        if(assignValue && assignValue(value)){
-            assigned = true;
-            ++iterator;
-        }
+    }
+    if(compiled.assignValue && compiled.assignValue(value)){
+        ++iterator;
+        return true;
     }
 
-    return assigned;
+    return false;
 }
 
 
@@ -95,6 +95,15 @@ protected:
     void setVariableListSync(MprVariableList* listInGui, MprVariableList* listInController);
     virtual stdx::optional<MprVariable::Value> evalExpressionAsVariableValue(
         std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd);
+    /**
+       The expressions in the programs are compiled when the controller is initialized, and this function
+       is used to compile a variable term into a function that returns the current value of the variable.
+       Return nullptr if the expression does not begin with a variable expression.
+       The default implementation compiles the default variable syntax, and the other terms accepted by
+       evalExpressionAsVariableValue are compiled into the functions that call it at the evaluation time.
+    */
+    virtual std::function<stdx::optional<MprVariable::Value>()> compileExpressionAsVariableValue(
+        std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd);
     virtual std::function<bool(MprVariable::Value value)> evalExpressionAsVariableToAssginValue(
         const std::string& expression);
 
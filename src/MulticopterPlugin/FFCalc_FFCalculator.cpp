@@ -99,6 +99,8 @@ void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkFo
 
     const int numIP = degreeNumber;
 
+    const double repLength = std::pow (_linkVolume, 1.0/3.0);
+
     for (const auto& triAttr : _triAttrAry)
     {
         const GaussTriangle3d tri (triAttr.triangle(), _linkState.trans());
@@ -127,43 +129,91 @@ void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkFo
 
             const double coefIP = cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area();
 
-            double velPerp;
-            double velPara;
-            Vector3 vePara;
-
-            Vector3 velRelative = fluid.velocity - _linkState.translationalVelocityAt(posIP);
-            _calcVectorDecomp (velRelative, -tri.normal(), &velPerp, &velPara, &vePara);
-
-            if (velPerp >= TINY_VELOCITY)
-            {
-                double pressure = 0.5 * fluid.density * std::pow (std::max (0.0, velPerp), 2);
-                Vector3 force = -tri.normal() * pressure;
-                pLinkForceN->addForce (coefIP * force, posIP);
-            }
-
-            if (velPara >= TINY_VELOCITY)
-            {
-
-                double repLength = std::pow (_linkVolume, 1.0/3.0);
-
-                double coefReynolds = fluid.density * velPara * repLength / fluid.viscosity;
-
-                if (coefReynolds < 4.0e5)
-                {
-                    Vector3 forceT = 0.664 * velPara * vePara *
-                                     std::sqrt (fluid.viscosity * fluid.density * velPara / repLength);
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-                else
-                {
-                    double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
-                    if (coefReynolds < 6.0e5)
-                        coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
-
-                    Vector3 forceT = coefResist * 0.5 * fluid.density * velPara * velPara * vePara;
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-            }
+            _addSurfaceForceAt (
+                posIP, tri.normal(), coefIP, fluid, _linkState.translationalVelocityAt(posIP),
+                repLength, pLinkForceN, pLinkForceT);
+        }
+    }
+    return;
+}
+
+void FFCalculator::calcSurfaceGeneral(const TriangleBuffer& triBuffer, LinkForce* pLinkForceN, LinkForce* pLinkForceT)
+{
+    const int numIP = triBuffer.size();
+    if (numIP == 0)
+        return;
+
+    const Eigen::Matrix3Xd& points  = triBuffer.points();
+    const Eigen::Matrix3Xd& normals = triBuffer.normals();
+    const Eigen::VectorXd&  coefs   = triBuffer.coefs();
+
+    // Link velocities at all the integration points: v(p) = v(0) + w x p
+    const Vector3& w = _linkState.rotationalVelocity();
+    Matrix3 wHat;
+    wHat <<  0.0,  -w.z(),  w.y(),
+             w.z(),  0.0,  -w.x(),
+            -w.y(),  w.x(),  0.0;
+    Eigen::Matrix3Xd velLink = wHat * points;
+    velLink.colwise() += _linkState.translationalVelocityAt (Vector3::Zero());
+
+    const double repLength = std::pow (_linkVolume, 1.0/3.0);
+
+    for (int iIP=0; iIP<numIP; ++iIP)
+    {
+        const Vector3 posIP = points.col(iIP);
+
+        FluidEnvironment::FluidValue fluid;
+        bool inBounds = _fluidEnv.get (posIP, fluid);
+
+        if(inBounds==true){
+            if(fluid.isFluid ==false) continue;
+        }else if(_fluidEnvAll.isFluid == true){
+            fluid=_fluidEnvAll;
+        }else continue;
+
+        _addSurfaceForceAt (
+            posIP, normals.col(iIP), coefs[iIP], fluid, velLink.col(iIP),
+            repLength, pLinkForceN, pLinkForceT);
+    }
+    return;
+}
+
+void FFCalculator::_addSurfaceForceAt (
+    const Vector3& posIP, const Vector3& normal, double coefIP, const FluidEnvironment::FluidValue& fluid,
+    const Vector3& velLink, double repLength, LinkForce* pLinkForceN, LinkForce* pLinkForceT)
+{
+    double velPerp;
+    double velPara;
+    Vector3 vePara;
+
+    Vector3 velRelative = fluid.velocity - velLink;
+    _calcVectorDecomp (velRelative, -normal, &velPerp, &velPara, &vePara);
+
+    if (velPerp >= TINY_VELOCITY)
+    {
+        double pressure = 0.5 * fluid.density * std::pow (std::max (0.0, velPerp), 2);
+        Vector3 force = -normal * pressure;
+        pLinkForceN->addForce (coefIP * force, posIP);
+    }
+
+    if (velPara >= TINY_VELOCITY)
+    {
+        double coefReynolds = fluid.density * velPara * repLength / fluid.viscosity;
+
+        if (coefReynolds < 4.0e5)
+        {
+            Vector3 forceT = 0.664 * velPara * vePara *
+                             std::sqrt (fluid.viscosity * fluid.density * velPara / repLength);
+            pLinkForceT->addForce (coefIP * forceT, posIP);
+        }
+        else
+        {
+            double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
+            if (coefReynolds < 6.0e5)
+                coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
+
+            Vector3 forceT = coefResist * 0.5 * fluid.density * velPara * velPara * vePara;
+            pLinkForceT->addForce (coefIP * forceT, posIP);
         }
     }
     return;
@@ -4,6 +4,7 @@
 
 #pragma once
 #include "FFCalc_Common.h"
+#include "FFCalc_TriangleBuffer.h"
 
 namespace Multicopter {
 namespace FFCalc {
@@ -53,6 +54,8 @@ public:
 
     void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT,int);
 
+    void calcSurfaceGeneral (const TriangleBuffer& triBuffer, LinkForce* pLinkForceN, LinkForce* pLinkForceT);
+
     void calcGravity_forDebug (LinkForce* pLinkForce);
 
 private:
@@ -64,6 +67,10 @@ private:
     void _calcVectorDecomp (
         const Vector3& vec, const Vector3& vDirection, double* normDir,
         double* normPlane, Vector3* vePlane);
+
+    void _addSurfaceForceAt (
+        const Vector3& posIP, const Vector3& normal, double coefIP, const FluidEnvironment::FluidValue& fluid,
+        const Vector3& velLink, double repLength, LinkForce* pLinkForceN, LinkForce* pLinkForceT);
 };
 
 
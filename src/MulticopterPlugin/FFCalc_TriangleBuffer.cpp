@@ -0,0 +1,64 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#include "MulticopterPluginHeader.h"
+
+namespace Multicopter {
+namespace FFCalc {
+
+void TriangleBuffer::build (const std::vector<LinkTriangleAttribute>& triAttrAry, int numIP)
+{
+    std::vector<Vector3> points;
+    std::vector<Vector3> normals;
+    std::vector<double>  coefs;
+    points.reserve (triAttrAry.size() * numIP);
+    normals.reserve (triAttrAry.size() * numIP);
+    coefs.reserve (triAttrAry.size() * numIP);
+
+    for (const auto& triAttr : triAttrAry)
+    {
+        const GaussTriangle3d tri (triAttr.triangle());
+
+        // Degenerate triangles do not contribute to the surface force
+        if (!(tri.area() > 0.0))
+            continue;
+
+        for (int iIP=0; iIP<numIP; ++iIP)
+        {
+            const double cutCoef = triAttr.cutoffCoefficient(iIP);
+            if (cutCoef < 1.0e-12)
+                continue;
+
+            points.push_back (tri.getGaussPoint(iIP,numIP));
+            normals.push_back (tri.normal());
+            coefs.push_back (cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area());
+        }
+    }
+
+    const int n = static_cast<int>(coefs.size());
+    _localPoints.resize (3, n);
+    _localNormals.resize (3, n);
+    _coefs.resize (n);
+    for (int i=0; i<n; ++i)
+    {
+        _localPoints.col(i)  = points[i];
+        _localNormals.col(i) = normals[i];
+        _coefs[i]            = coefs[i];
+    }
+    _points.resize (3, n);
+    _normals.resize (3, n);
+
+    return;
+}
+
+void TriangleBuffer::update (const Transform3& trans)
+{
+    const Matrix3 R = trans.linear();
+    _points.noalias()  = R * _localPoints;
+    _points.colwise() += trans.translation();
+    _normals.noalias() = R * _localNormals;
+    return;
+}
+
+}}
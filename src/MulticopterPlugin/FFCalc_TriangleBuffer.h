@@ -0,0 +1,66 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#pragma once
+#include "FFCalc_Common.h"
+
+#include <vector>
+
+namespace Multicopter {
+
+class LinkTriangleAttribute;
+
+namespace FFCalc {
+
+/**
+   Structure-of-arrays buffer of the Gauss integration points of a link's surface.
+
+   The integration points, the normals of the owning triangles and the constant
+   integration coefficients (cutoff coefficient * Gauss weight * triangle area)
+   are computed once in the link local frame. The global positions and normals
+   are then updated for all the points at once with a single matrix product per step.
+*/
+class TriangleBuffer
+{
+private:
+    Eigen::Matrix3Xd _localPoints;
+    Eigen::Matrix3Xd _localNormals;
+    Eigen::VectorXd  _coefs;
+
+    Eigen::Matrix3Xd _points;
+    Eigen::Matrix3Xd _normals;
+
+public:
+
+    void build (const std::vector<LinkTriangleAttribute>& triAttrAry, int numIP);
+
+    void update (const Transform3& trans);
+
+    int size() const
+    {
+        return static_cast<int>(_coefs.size());
+    }
+
+    bool empty() const
+    {
+        return _coefs.size() == 0;
+    }
+
+    const Eigen::Matrix3Xd& points() const
+    {
+        return _points;
+    }
+
+    const Eigen::Matrix3Xd& normals() const
+    {
+        return _normals;
+    }
+
+    const Eigen::VectorXd& coefs() const
+    {
+        return _coefs;
+    }
+};
+
+}}
@@ -52,6 +52,7 @@ namespace Multicopter{
     const std::string MULTICOPTER_GROUNDEFFECT="Ground Effect";
     const std::string MULTICOPTER_OUTPUT="Output Parameter";
     const std::string MULTICOPTER_TIMESTEP="Output Time Step[s]";
+    const std::string MULTICOPTER_NUMTHREADS="Number of Threads";
 
     const std::string MULTICOPTER_LOG_HEADER = std::string("Time[s],BodyName,LinkName,Position-X[m],Position-Y[m],Position-Z[m],"
                                                       "Velocity-X[m/s],Velocity-Y[m/s],Velocity-Z[m/s],"
@@ -30,6 +30,11 @@ public:
 
     bool setAirDefinitionFile(const std::string& filename);
 
+    void setFluidDensity(double density);
+    void setViscosity(double viscosity);
+    void setNumThreads(int numThreads);
+    int numThreads() const;
+
 protected:
     virtual cnoid::Item* doDuplicate() const;
     virtual void doPutProperties(PutPropertyFunction& putProperty);
@@ -51,6 +56,7 @@ private:
     bool _groundEffect;
     bool _outputParam;
     double _timeStep;
+    int _numThreads;
 
     SimulatorItem* _curSimItem;
 };
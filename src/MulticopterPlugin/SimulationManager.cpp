@@ -86,6 +86,7 @@ SimulationManager::SimulationManager()
 
     _enableLinkForceDump = false;
     _degree=4;
+    _numThreadsSim=_numThreads=1;
 
     _fluidDensitySim=_fluidDensity=0;
     _viscositySim= _viscosity=0;
@@ -119,6 +120,7 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
     _groundEffectSim=_groundEffect;
     _logFlgSim=_logFlg;
     _logIntrvSim=_logIntrv;
+    _numThreadsSim=_numThreads;
 
     _fluEnvAllSim.density=_fluidDensitySim;
     _fluEnvAllSim.viscosity=_viscositySim;
@@ -152,6 +154,15 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
 
     calculateSurfaceCuttoffCoefficient(_fluidLinkBodyMap,_linkPolygonMap);
 
+    updateLinkTriangleBuffers();
+
+    const int numThreads = std::min(_numThreadsSim, static_cast<int>(_fluidLinkBodyMap.size()));
+    if(numThreads > 1){
+        _threadPool.reset(new ThreadPool(numThreads));
+    } else {
+        _threadPool.reset();
+    }
+
     double curTime = simItem->currentTime();
     _nextLogTime         = curTime;
 
@@ -295,13 +306,20 @@ LinkAttribute
 SimulationManager::linkAttribute(const cnoid::Link* link) const
 {
     auto ret = _linkBodyMap.find(const_cast<Link*>(link));
+    if(ret == _linkBodyMap.end()){
+        return LinkAttribute();
+    }
     return std::get<1>(ret->second);
 }
 
 const std::vector<LinkTriangleAttribute>&
 SimulationManager::linkPolygon(const cnoid::Link* link) const
 {
+    static const std::vector<LinkTriangleAttribute> emptyPolygon;
     auto ret = _linkPolygonMap.find(const_cast<Link*>(link));
+    if(ret == _linkPolygonMap.end()){
+        return emptyPolygon;
+    }
     return ret->second;
 }
 
@@ -309,6 +327,18 @@ void
 SimulationManager::clearLinkPolygon()
 {
     _linkPolygonMap.clear();
+    _linkTriangleBufferMap.clear();
+}
+
+void
+SimulationManager::updateLinkTriangleBuffers()
+{
+    _linkTriangleBufferMap.clear();
+
+    const int numIP = getDegreeNumber();
+    for(auto& linkPolygon : _linkPolygonMap){
+        _linkTriangleBufferMap[linkPolygon.first].build(linkPolygon.second, numIP);
+    }
 }
 
 void
@@ -343,6 +373,10 @@ SimulationManager::finalizeSimulation(SimulatorItem* simItem, MulticopterSimulat
     clearBodyLinkMap();
     clearLinkPolygon();
     clearLinkState();
+
+    _threadPool.reset();
+    _linkForceJobs.clear();
+    _effectMaps.clear();
 }
 
 void
@@ -519,9 +553,14 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
 
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
+    _linkForceJobs.clear();
+    _effectMaps.clear();
+    _effectMaps.reserve(_bodyLinkMap.size());
 
     for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
-        std::map<int,std::tuple<double,Vector3>> effectMap;
+        _effectMaps.emplace_back();
+        std::map<int,std::tuple<double,Vector3>>& effectMap = _effectMaps.back();
+        const int effectMapIndex = _effectMaps.size() - 1;
         bool calFlag=false;
 
 
@@ -553,18 +592,11 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
         }
 
         for(auto itl = begin(linkAry) ; itl != end(linkAry) ; ++itl){
-
             try{
                 FFCalc::LinkStatePtr pLinkState;
                 pLinkState = _linkStateMap[*itl];
                 pLinkState->update (simItem->currentTime(), **itl);
-
-                std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
-                    simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
-
-                (*itl)->f_ext()   += pLinkForce->getForce();
-                (*itl)->tau_ext() += pLinkForce->getMoment();
-
+                _linkForceJobs.emplace_back(*itl, pLinkState.get(), effectMapIndex, calFlag);
             }
             catch(runtime_error& err){
                 UtilityImpl::printErrorMessage(
@@ -574,85 +606,161 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
             }
         }
     }
+
+    /*
+      The fluid forces of the links only depend on the link states updated above,
+      so they are evaluated in parallel. The rotor forces and the application of
+      the forces to the links are done in the original link order.
+    */
+    const int numJobs = _linkForceJobs.size();
+    if(!_threadPool || numJobs < 2){
+        calcLinkFluidForces(0, numJobs);
+    } else {
+        const int numThreads = std::min(_threadPool->size(), numJobs);
+        const int minSize = numJobs / numThreads;
+        int remainder = numJobs % numThreads;
+        int index = 0;
+        for(int i=0; i < numThreads; ++i){
+            int size = minSize;
+            if(remainder > 0){
+                ++size;
+                --remainder;
+            }
+            _threadPool->start([this, index, size](){ calcLinkFluidForces(index, index + size); });
+            index += size;
+        }
+        _threadPool->waitLoop();
+    }
+
+    for(auto& job : _linkForceJobs){
+        Link* link = job.link;
+        if(!job.errorMessage.empty()){
+            UtilityImpl::printErrorMessage(
+                format("{0:s} in {1:s} at {2:lf}",
+                       job.errorMessage, link->name(), simItem->currentTime()));
+            continue;
+        }
+        if(job.hasFluidOutValue){
+            _linkOutValAry.push_back(job.fluidOutValue);
+        }
+
+        try{
+            std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
+                simItem, multicopterSimItem, *link, *job.linkState, job.fluidForce,
+                _effectMaps[job.effectMapIndex], job.calFlag);
+
+            link->f_ext()   += pLinkForce->getForce();
+            link->tau_ext() += pLinkForce->getMoment();
+        }
+        catch(runtime_error& err){
+            UtilityImpl::printErrorMessage(
+                format("{0:s} in {1:s} at {2:lf}",
+                       err.what(), link->name(), simItem->currentTime()));
+            continue;
+        }
+    }
 }
 
 
-std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
-    SimulatorItem* simItem, MulticopterSimulatorItem* multicopterSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,
-    std::map<int,std::tuple<double,Vector3>> effectMap,bool calFlag=false)
+void
+SimulationManager::calcLinkFluidForces(int jobIndexBegin, int jobIndexEnd)
 {
+    for(int i=jobIndexBegin; i < jobIndexEnd; ++i){
+        LinkForceJob& job = _linkForceJobs[i];
+        try{
+            job.hasFluidOutValue = calcLinkFluidForce(*job.link, *job.linkState, &job.fluidForce, &job.fluidOutValue);
+        }
+        catch(runtime_error& err){
+            job.errorMessage = err.what();
+        }
+    }
+}
 
-    const Eigen::Vector3d loadingPoint = Vector3 (0.0, 0.0, 0.0);
-
-    std::unique_ptr<FFCalc::LinkForce> pLinkForce(new FFCalc::LinkForce(loadingPoint));
 
-    const FluidEnvironment& fluidEnv = *fluidEnvironmentSim();
+bool
+SimulationManager::calcLinkFluidForce
+(cnoid::Link& link, const FFCalc::LinkState& linkState, FFCalc::LinkForce* pLinkForce, FluidOutValue* pFluOutVal)
+{
     const LinkAttribute& linkAttr = linkAttribute(&link);
 
-    if(linkAttr.isNull()==false){
+    if(linkAttr.isNull()){
+        return false;
+    }
 
-        const std::vector<LinkTriangleAttribute>& triAttrAry = _linkPolygonMap[&link];
-        const std::vector<bool>linkForceApplyTarget = linkAttr.linkForceApplyFlgAry();
+    const FluidEnvironment& fluidEnv = *_fluEnvSim;
+    const std::vector<LinkTriangleAttribute>& triAttrAry = linkPolygon(&link);
+    const std::vector<bool>linkForceApplyTarget = linkAttr.linkForceApplyFlgAry();
 
-        FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim,link, linkAttr, linkState, triAttrAry);
+    FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim,link, linkAttr, linkState, triAttrAry);
 
-        FFCalc::LinkForce lfBuoyancy(pLinkForce->point());
-        if(linkForceApplyTarget[0] == true){
-            ffc.calcBuoyancy(&lfBuoyancy);
-            pLinkForce->add(lfBuoyancy);
-        }
+    FFCalc::LinkForce lfBuoyancy(pLinkForce->point());
+    if(linkForceApplyTarget[0] == true){
+        ffc.calcBuoyancy(&lfBuoyancy);
+        pLinkForce->add(lfBuoyancy);
+    }
 
-        FFCalc::LinkForce lfAddMass(pLinkForce->point());
-        FFCalc::LinkForce lfAddMoment(pLinkForce->point());
-        if(( linkForceApplyTarget[1] == true) || ( linkForceApplyTarget[2] == true)){
-            ffc.calcAddMass (&lfAddMass, &lfAddMoment);
-            if( linkForceApplyTarget[1] == true){
-                pLinkForce->add(lfAddMass);
-                if(linkForceApplyTarget[2] == true){
-                    pLinkForce->add(lfAddMoment);
-                }
-            }else{
+    FFCalc::LinkForce lfAddMass(pLinkForce->point());
+    FFCalc::LinkForce lfAddMoment(pLinkForce->point());
+    if(( linkForceApplyTarget[1] == true) || ( linkForceApplyTarget[2] == true)){
+        ffc.calcAddMass (&lfAddMass, &lfAddMoment);
+        if( linkForceApplyTarget[1] == true){
+            pLinkForce->add(lfAddMass);
+            if(linkForceApplyTarget[2] == true){
                 pLinkForce->add(lfAddMoment);
             }
+        }else{
+            pLinkForce->add(lfAddMoment);
         }
+    }
 
-        FFCalc::LinkForce lfSurface(pLinkForce->point());
-        FFCalc::LinkForce lfGenSurface(pLinkForce->point());
-
-        if(linkForceApplyTarget[3] == true){
+    FFCalc::LinkForce lfSurface(pLinkForce->point());
+    FFCalc::LinkForce lfGenSurface(pLinkForce->point());
+
+    if(linkForceApplyTarget[3] == true){
+        auto it = _linkTriangleBufferMap.find(&link);
+        if(it != _linkTriangleBufferMap.end()){
+            // Each buffer is only accessed by the thread processing its link
+            FFCalc::TriangleBuffer& triBuffer = it->second;
+            triBuffer.update(linkState.trans());
+            ffc.calcSurfaceGeneral (triBuffer, &lfGenSurface, &lfGenSurface);
+        } else {
             ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
-            lfSurface.add(lfGenSurface);
         }
-        pLinkForce->add(lfSurface);
-
-
-        FluidOutValue fluOutVal;
-        fluOutVal.logMode      = linkAttr.logMode();
-        fluOutVal.linkName     = link.name();
-        fluOutVal.bodyName     = link.body()->name();
-        fluOutVal.position     = link.R()*link.c()+link.p();
-        fluOutVal.velocity     = linkState.translationalVelocityAt(fluOutVal.position);
-        fluOutVal.accelerationRaw  = linkState.translationalRawAccelerationAt(fluOutVal.position);
-        fluOutVal.acceleration     = linkState.translationalAccelerationAt(fluOutVal.position);
-        fluOutVal.rotationalVelocity =linkState.rotationalVelocity();
-        fluOutVal.rotationalAccelerationRaw =linkState.rotationalRawAcceleration();
-        fluOutVal.rotationalAcceleration =linkState.rotationalAcceleration();
-        fluOutVal.buoyancyForce    = lfBuoyancy.getForce();
-        fluOutVal.addMassForce     = lfAddMass.getForce();
-        fluOutVal.addInertiaTorque = lfAddMoment.getMoment();
-        fluOutVal.surfaceForce     = lfSurface.getForce();
-
-        _linkOutValAry.push_back(fluOutVal);
+        lfSurface.add(lfGenSurface);
+    }
+    pLinkForce->add(lfSurface);
+
+    FluidOutValue& fluOutVal = *pFluOutVal;
+    fluOutVal.logMode      = linkAttr.logMode();
+    fluOutVal.linkName     = link.name();
+    fluOutVal.bodyName     = link.body()->name();
+    fluOutVal.position     = link.R()*link.c()+link.p();
+    fluOutVal.velocity     = linkState.translationalVelocityAt(fluOutVal.position);
+    fluOutVal.accelerationRaw  = linkState.translationalRawAccelerationAt(fluOutVal.position);
+    fluOutVal.acceleration     = linkState.translationalAccelerationAt(fluOutVal.position);
+    fluOutVal.rotationalVelocity =linkState.rotationalVelocity();
+    fluOutVal.rotationalAccelerationRaw =linkState.rotationalRawAcceleration();
+    fluOutVal.rotationalAcceleration =linkState.rotationalAcceleration();
+    fluOutVal.buoyancyForce    = lfBuoyancy.getForce();
+    fluOutVal.addMassForce     = lfAddMass.getForce();
+    fluOutVal.addInertiaTorque = lfAddMoment.getMoment();
+    fluOutVal.surfaceForce     = lfSurface.getForce();
 
+    return true;
+}
 
 
-    #ifdef ENABLE_MULTICOPTER_PLUGIN_DEBUG
-            if( _enableLinkForceDump == true ){
-                Debug::printLinkForceInformation(simItem->currentTime(), &link, *pLinkForce);
-            }
-    #endif
+std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
+    SimulatorItem* simItem, MulticopterSimulatorItem* multicopterSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,
+    const FFCalc::LinkForce& fluidForce, const std::map<int,std::tuple<double,Vector3>>& effectMap,bool calFlag=false)
+{
+    std::unique_ptr<FFCalc::LinkForce> pLinkForce(new FFCalc::LinkForce(fluidForce));
 
+#ifdef ENABLE_MULTICOPTER_PLUGIN_DEBUG
+    if( _enableLinkForceDump == true && linkAttribute(&link).isNull()==false ){
+        Debug::printLinkForceInformation(simItem->currentTime(), &link, *pLinkForce);
     }
+#endif
 
     list<RotorDevice*> rotorAry = targetRotorDevices(&link);
     for(auto& rotor : rotorAry){
@@ -815,6 +923,18 @@ SimulationManager::getDegreeNumber() const
     return _degree;
 }
 
+void
+SimulationManager::setNumThreads(int numThreads)
+{
+    _numThreads = std::max(numThreads, 1);
+}
+
+int
+SimulationManager::numThreads() const
+{
+    return _numThreads;
+}
+
 
 list<RotorDevice*>
 SimulationManager::targetRotorDevices() const
@@ -45,6 +45,9 @@ public:
     void setDegreeNumber(int degreeNumber);
     int getDegreeNumber() const;
 
+    void setNumThreads(int numThreads);
+    int numThreads() const;
+
     MulticopterMonitorView* multicopterMonitorView(){
         return _multicopterMonitorView;
     }
@@ -96,6 +99,21 @@ protected:
         Eigen::Vector3d rotationalAcceleration;
     };
 
+    class LinkForceJob{
+    public:
+        LinkForceJob(cnoid::Link* link, const FFCalc::LinkState* linkState, int effectMapIndex, bool calFlag)
+            : link(link), linkState(linkState), effectMapIndex(effectMapIndex), calFlag(calFlag),
+              fluidForce(Eigen::Vector3d::Zero()), hasFluidOutValue(false) { }
+        cnoid::Link* link;
+        const FFCalc::LinkState* linkState;
+        int effectMapIndex;
+        bool calFlag;
+        FFCalc::LinkForce fluidForce;
+        FluidOutValue fluidOutValue;
+        bool hasFluidOutValue;
+        std::string errorMessage;
+    };
+
     SimulationManager();
 
     ~SimulationManager();
@@ -108,6 +126,8 @@ protected:
 
     void clearLinkPolygon();
 
+    void updateLinkTriangleBuffers();
+
     void updateLinkState(double time);
 
     void clearLinkState();
@@ -136,8 +156,12 @@ protected:
 
     void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,double coefs[]);
 
+    bool calcLinkFluidForce(cnoid::Link& link, const FFCalc::LinkState& linkState, FFCalc::LinkForce* pLinkForce, FluidOutValue* pFluOutVal);
+
+    void calcLinkFluidForces(int jobIndexBegin, int jobIndexEnd);
+
     std::unique_ptr<FFCalc::LinkForce>
-    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag);
+    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState, const FFCalc::LinkForce& fluidForce, const std::map<int,std::tuple<double,cnoid::Vector3>>& effectMap,bool calFlag);
 
     std::list<RotorDevice*> targetRotorDevices() const;
     std::list<RotorDevice*> targetRotorDevices(cnoid::Link* link) const;
@@ -157,6 +181,10 @@ private:
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> > _effectLinkBodyMap;
     std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>_linkPolygonMap;
     std::map<const cnoid::Link*, FFCalc::LinkStatePtr> _linkStateMap;
+    std::map<const cnoid::Link*, FFCalc::TriangleBuffer> _linkTriangleBufferMap;
+
+    std::vector<LinkForceJob> _linkForceJobs;
+    std::vector<std::map<int,std::tuple<double,cnoid::Vector3>>> _effectMaps;
 
     std::list<RotorOutValue> _rotorOutValAry;
     std::list<FluidOutValue> _linkOutValAry;
@@ -184,6 +212,10 @@ private:
     int _effectLinkBodyMapSize;
     int _degree;
 
+    int _numThreads;
+    int _numThreadsSim;
+    std::unique_ptr<cnoid::ThreadPool> _threadPool;
+
     MulticopterMonitorView* _multicopterMonitorView;
     cnoid::AISTCollisionDetectorPtr _collisionDetector;
 
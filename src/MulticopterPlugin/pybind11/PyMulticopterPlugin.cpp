@@ -10,7 +10,11 @@ PYBIND11_MODULE(MulticopterPlugin, m)
 
     py::class_<MulticopterSimulatorItem, MulticopterSimulatorItemPtr, SubSimulatorItem>(m, "MulticopterSimulatorItem")
         .def(py::init<>())
-        .def("setAirDefinitionFile", &MulticopterSimulatorItem::setAirDefinitionFile);
+        .def("setAirDefinitionFile", &MulticopterSimulatorItem::setAirDefinitionFile)
+        .def("setFluidDensity", &MulticopterSimulatorItem::setFluidDensity)
+        .def("setViscosity", &MulticopterSimulatorItem::setViscosity)
+        .def_property_readonly("numThreads", &MulticopterSimulatorItem::numThreads)
+        .def("setNumThreads", &MulticopterSimulatorItem::setNumThreads);
     
     PyItemList<MulticopterSimulatorItem>(m, "MulticopterSimulatorItemList");
 }
@@ -18,7 +18,13 @@
 #include <cnoid/BasicSensorSimulationHelper>
 #include <cnoid/BodyItem>
 #include <cnoid/BodyCollisionDetector>
+#include <cnoid/ThreadPool>
+#include <cnoid/MessageView>
 #include <QElapsedTimer>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include "gettext.h"
 
 #ifdef GAZEBO_ODE
@@ -42,6 +48,8 @@ const bool MEASURE_PHYSICS_CALCULATION_TIME = true;
 
 const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
 
+const int MaxNumContacts = 100;
+
 typedef Eigen::Matrix<float, 3, 1> Vertex;
 
 struct Triangle {
@@ -161,6 +169,29 @@ public:
     double surfaceLayerDepth;
     bool useWorldCollisionDetector;
     BodyCollisionDetector bodyCollisionDetector;
+    int numThreads;
+    int numActualThreads;
+
+    // Variables for the parallel collision detection
+    struct GeomPair {
+        dGeomID geom1;
+        dGeomID geom2;
+        int bufferIndex;
+        int contactOffset;
+        int numContacts;
+    };
+    vector<GeomPair> geomPairs;
+    vector<int> geomPairParents;
+    unordered_map<dGeomID, int> meshToGeomPairMap;
+    vector<vector<int>> geomPairGroups;
+    int numGeomPairGroups;
+    vector<vector<dContact>> contactBuffers;
+    unique_ptr<ThreadPool> collisionThreadPool;
+
+#ifdef ODE_THREADING_IMPL
+    dThreadingImplementationID threadingImpl;
+    dThreadingThreadPoolID threadingPool;
+#endif
 
     double physicsTime;
     QElapsedTimer physicsTimer;
@@ -174,7 +205,14 @@ public:
     void clear();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(ODEBody* odeBody);
+    void initializeThreads();
+    void finalizeThreads();
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    int collideGeoms(dGeomID g1, dGeomID g2, dContact* contacts);
+    void addContactJoints(dGeomID g1, dGeomID g2, dContact* contacts, int numContacts);
+    void collideGeomPairsConcurrently();
+    int findRootGeomPair(int index);
+    void groupGeomPairs();
     void doPutProperties(PutPropertyFunction& putProperty);
     void store(Archive& archive);
     void restore(const Archive& archive);
@@ -914,6 +952,7 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self)
     is2Dmode = false;
     doFlipYZ = false;
     useWorldCollisionDetector = false;
+    numThreads = 1;
 }
 
 
@@ -943,6 +982,7 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimu
     is2Dmode = org.is2Dmode;
     doFlipYZ = org.doFlipYZ;
     useWorldCollisionDetector = org.useWorldCollisionDetector;
+    numThreads = org.numThreads;
 }
 
 
@@ -951,6 +991,11 @@ void ODESimulatorItemImpl::initialize()
     worldID = 0;
     spaceID = 0;
     contactJointGroupID = dJointGroupCreate(0);
+    numActualThreads = 1;
+#ifdef ODE_THREADING_IMPL
+    threadingImpl = nullptr;
+    threadingPool = nullptr;
+#endif
     self->SimulatorItem::setAllLinkPositionOutputMode(true);
 }
 
@@ -1049,6 +1094,12 @@ void ODESimulatorItem::useWorldCollisionDetector(bool on)
 }
 
 
+void ODESimulatorItem::setNumThreads(int n)
+{
+    impl->numThreads = n;
+}
+
+
 void ODESimulatorItem::setAllLinkPositionOutputMode(bool)
 {
     // The mode is not changed.
@@ -1067,6 +1118,8 @@ void ODESimulatorItemImpl::clear()
 {
     dJointGroupEmpty(contactJointGroupID);
 
+    finalizeThreads();
+
     if(worldID){
         dWorldDestroy(worldID);
         worldID = 0;
@@ -1137,6 +1190,8 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
         bodyCollisionDetector.makeReady();
     }
 
+    initializeThreads();
+
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime = 0;
         collisionTime = 0;
@@ -1172,6 +1227,75 @@ void ODESimulatorItemImpl::addBody(ODEBody* odeBody)
 }
 
 
+void ODESimulatorItemImpl::initializeThreads()
+{
+    numActualThreads = numThreads;
+    if(numActualThreads <= 0){
+        numActualThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if(numActualThreads <= 1){
+        return;
+    }
+
+    if(!useWorldCollisionDetector){
+        // The collision functions of ODE can only be called from multiple threads when
+        // the library is built with the thread local storage of the OU library
+        if(!dCheckConfiguration("ODE_OU")){
+            MessageView::instance()->putln(
+                _("The parallel collision detection is not available because the ODE library is not built with OU. "
+                  "The collisions are detected sequentially."), MessageView::Warning);
+        } else {
+            // The calling thread is also used as one of the threads
+            collisionThreadPool.reset(new ThreadPool(numActualThreads - 1));
+            contactBuffers.resize(numActualThreads);
+        }
+    }
+
+#ifdef ODE_THREADING_IMPL
+    if(!dCheckConfiguration("ODE_THR_builtin_impl")){
+        MessageView::instance()->putln(
+            _("The multithreaded island stepping is not available because the ODE library is not built with "
+              "the built-in threading implementation. The islands are stepped sequentially."), MessageView::Warning);
+        return;
+    }
+    threadingImpl = dThreadingAllocateMultiThreadedImplementation();
+    if(!threadingImpl){
+        MessageView::instance()->putln(
+            _("The multithreaded island stepping is not available in the ODE library."), MessageView::Warning);
+        return;
+    }
+    threadingPool = dThreadingAllocateThreadPool(numActualThreads, 0, dAllocateFlagBasicData, nullptr);
+    if(!threadingPool){
+        dThreadingFreeImplementation(threadingImpl);
+        threadingImpl = nullptr;
+        return;
+    }
+    dThreadingThreadPoolServeMultiThreadedImplementation(threadingPool, threadingImpl);
+    dWorldSetStepIslandsProcessingMaxThreadCount(worldID, numActualThreads);
+    dWorldSetStepThreadingImplementation(worldID, dThreadingImplementationGetFunctions(threadingImpl), threadingImpl);
+#endif
+}
+
+
+void ODESimulatorItemImpl::finalizeThreads()
+{
+#ifdef ODE_THREADING_IMPL
+    if(threadingImpl){
+        dThreadingImplementationShutdownProcessing(threadingImpl);
+        dThreadingFreeThreadPool(threadingPool);
+        threadingPool = nullptr;
+        if(worldID){
+            dWorldSetStepThreadingImplementation(worldID, nullptr, nullptr);
+        }
+        dThreadingFreeImplementation(threadingImpl);
+        threadingImpl = nullptr;
+    }
+#endif
+    collisionThreadPool.reset();
+    contactBuffers.clear();
+}
+
+
 void ODESimulatorItem::initializeSimulationThread()
 {
     dAllocateODEDataForThread(dAllocateMaskAll);
@@ -1192,66 +1316,215 @@ static void nearCallback(void* data, dGeomID g1, dGeomID g2)
         }
     } else {
         ODESimulatorItemImpl* impl = (ODESimulatorItemImpl*)data;
-        static const int MaxNumContacts = 100;
         dContact contacts[MaxNumContacts];
-        int numContacts = dCollide(g1, g2, MaxNumContacts, &contacts[0].geom, sizeof(dContact));
-        
-        if(numContacts > 0){
-            dBodyID body1ID = dGeomGetBody(g1);
-            dBodyID body2ID = dGeomGetBody(g2);
-            Link* crawlerlink = 0;
-            double sign = 1.0;
-            if(!impl->crawlerLinks.empty()){
-                CrawlerLinkMap::iterator p = impl->crawlerLinks.find(body1ID);
-                if(p != impl->crawlerLinks.end()){
-                    crawlerlink = p->second;
-                }
-                p = impl->crawlerLinks.find(body2ID);
-                if(p != impl->crawlerLinks.end()){
-                    crawlerlink = p->second;
-                    sign = -1.0;
-                }
+        int numContacts = impl->collideGeoms(g1, g2, contacts);
+        impl->addContactJoints(g1, g2, contacts, numContacts);
+    }
+}
+
+
+/**
+   This callback only collects the geometry pairs for the parallel collision detection.
+   The broadphase is processed in the calling thread.
+*/
+static void collectGeomPairsCallback(void* data, dGeomID g1, dGeomID g2)
+{
+    if(dGeomIsSpace(g1) || dGeomIsSpace(g2)) { 
+        dSpaceCollide2(g1, g2, data, &collectGeomPairsCallback);
+    } else {
+        ODESimulatorItemImpl* impl = (ODESimulatorItemImpl*)data;
+        impl->geomPairs.push_back({ g1, g2, 0, 0, 0 });
+    }
+}
+
+
+/**
+   This function can be executed in parallel because it only reads the simulator states.
+   \return The number of the contacts stored in the contact array
+*/
+int ODESimulatorItemImpl::collideGeoms(dGeomID g1, dGeomID g2, dContact* contacts)
+{
+    int numContacts = dCollide(g1, g2, MaxNumContacts, &contacts[0].geom, sizeof(dContact));
+    if(numContacts == 0){
+        return 0;
+    }
+    
+    Link* crawlerlink = 0;
+    double sign = 1.0;
+    if(!crawlerLinks.empty()){
+        CrawlerLinkMap::iterator p = crawlerLinks.find(dGeomGetBody(g1));
+        if(p != crawlerLinks.end()){
+            crawlerlink = p->second;
+        }
+        p = crawlerLinks.find(dGeomGetBody(g2));
+        if(p != crawlerLinks.end()){
+            crawlerlink = p->second;
+            sign = -1.0;
+        }
+    }
+
+    int numValidContacts = 0;
+    for(int i=0; i < numContacts; ++i){
+        dContact& contact = contacts[numValidContacts];
+        if(i != numValidContacts){
+            contact = contacts[i];
+        }
+        dSurfaceParameters& surface = contact.surface;
+        if(!crawlerlink){
+            //surface.mode = dContactApprox1 | dContactBounce;
+            //surface.bounce = 0.0;
+            //surface.bounce_vel = 1.0;
+            surface.mode = dContactApprox1;
+            surface.mu = friction;
+
+        } else {
+            if(contact.geom.depth > 0.001){
+                continue;
+            }
+            surface.mode = dContactFDir1 | dContactMotion1 | dContactMu2 | dContactApprox1_2 | dContactApprox1_1;
+            const Vector3 axis = crawlerlink->R() * crawlerlink->a();
+            const Vector3 n(contact.geom.normal);
+            Vector3 dir = axis.cross(n);
+            if(dir.norm() < 1.0e-5){
+                surface.mode = dContactApprox1;
+                surface.mu = friction;
+            } else {
+                dir *= sign;
+                dir.normalize();
+                contact.fdir1[0] = dir[0];
+                contact.fdir1[1] = dir[1];
+                contact.fdir1[2] = dir[2];
+                //dVector3& dpos = contact.geom.pos;
+                //Vector3 pos(dpos[0], dpos[1], dpos[2]);
+                //Vector3 v = crawlerlink->v + crawlerlink->w.cross(pos-crawlerlink->p);
+                //surface.motion1 = dir.dot(v) + crawlerlink->u;
+                surface.motion1 = crawlerlink->dq_target();
+                surface.mu = friction;
+                surface.mu2 = 0.5;
             }
-            for(int i=0; i < numContacts; ++i){
-                dSurfaceParameters& surface = contacts[i].surface;
-                if(!crawlerlink){
-                    //surface.mode = dContactApprox1 | dContactBounce;
-                    //surface.bounce = 0.0;
-                    //surface.bounce_vel = 1.0;
-                    surface.mode = dContactApprox1;
-                    surface.mu = impl->friction;
+        }
+        ++numValidContacts;
+    }
 
-                } else {
-                    if(contacts[i].geom.depth > 0.001){
-                        continue;
-                    }
-                    surface.mode = dContactFDir1 | dContactMotion1 | dContactMu2 | dContactApprox1_2 | dContactApprox1_1;
-                    const Vector3 axis = crawlerlink->R() * crawlerlink->a();
-                    const Vector3 n(contacts[i].geom.normal);
-                    Vector3 dir = axis.cross(n);
-                    if(dir.norm() < 1.0e-5){
-                        surface.mode = dContactApprox1;
-                        surface.mu = impl->friction;
-                    } else {
-                        dir *= sign;
-                        dir.normalize();
-                        contacts[i].fdir1[0] = dir[0];
-                        contacts[i].fdir1[1] = dir[1];
-                        contacts[i].fdir1[2] = dir[2];
-                        //dVector3& dpos = contacts[i].geom.pos;
-                        //Vector3 pos(dpos[0], dpos[1], dpos[2]);
-                        //Vector3 v = crawlerlink->v + crawlerlink->w.cross(pos-crawlerlink->p);
-                        //surface.motion1 = dir.dot(v) + crawlerlink->u;
-                        surface.motion1 = crawlerlink->dq_target();
-                        surface.mu = impl->friction;
-                        surface.mu2 = 0.5;
+    return numValidContacts;
+}
+
+
+void ODESimulatorItemImpl::addContactJoints(dGeomID g1, dGeomID g2, dContact* contacts, int numContacts)
+{
+    if(numContacts > 0){
+        dBodyID body1ID = dGeomGetBody(g1);
+        dBodyID body2ID = dGeomGetBody(g2);
+        for(int i=0; i < numContacts; ++i){
+            dJointID jointID = dJointCreateContact(worldID, contactJointGroupID, &contacts[i]);
+            dJointAttach(jointID, body1ID, body2ID);
+        }
+    }
+}
+
+
+int ODESimulatorItemImpl::findRootGeomPair(int index)
+{
+    while(geomPairParents[index] != index){
+        geomPairParents[index] = geomPairParents[geomPairParents[index]];
+        index = geomPairParents[index];
+    }
+    return index;
+}
+
+
+/**
+   The pairs sharing a triangle mesh geometry are put into the same group and they are
+   processed in the same thread because the temporal coherence cache of the mesh is
+   updated in the collision detection. The other geometries are not modified by dCollide.
+*/
+void ODESimulatorItemImpl::groupGeomPairs()
+{
+    const int numPairs = geomPairs.size();
+    geomPairParents.resize(numPairs);
+    meshToGeomPairMap.clear();
+    
+    for(int i=0; i < numPairs; ++i){
+        geomPairParents[i] = i;
+        for(auto geom : { geomPairs[i].geom1, geomPairs[i].geom2 }){
+            if(dGeomGetClass(geom) == dTriMeshClass){
+                auto inserted = meshToGeomPairMap.emplace(geom, i);
+                if(!inserted.second){
+                    int root1 = findRootGeomPair(i);
+                    int root2 = findRootGeomPair(inserted.first->second);
+                    if(root1 != root2){
+                        geomPairParents[std::max(root1, root2)] = std::min(root1, root2);
                     }
                 }
-                dJointID jointID = dJointCreateContact(impl->worldID, impl->contactJointGroupID, &contacts[i]);
-                dJointAttach(jointID, body1ID, body2ID);
             }
         }
     }
+
+    // The group index of each root pair is temporarily stored in its contact offset
+    numGeomPairGroups = 0;
+    for(int i=0; i < numPairs; ++i){
+        int root = findRootGeomPair(i);
+        int groupIndex;
+        if(root == i){
+            groupIndex = numGeomPairGroups++;
+            geomPairs[i].contactOffset = groupIndex;
+            if(static_cast<int>(geomPairGroups.size()) < numGeomPairGroups){
+                geomPairGroups.emplace_back();
+            }
+            geomPairGroups[groupIndex].clear();
+        } else {
+            groupIndex = geomPairs[root].contactOffset;
+        }
+        geomPairGroups[groupIndex].push_back(i);
+    }
+}
+
+
+void ODESimulatorItemImpl::collideGeomPairsConcurrently()
+{
+    geomPairs.clear();
+    dSpaceCollide(spaceID, (void*)this, &collectGeomPairsCallback);
+
+    groupGeomPairs();
+
+    std::atomic<int> nextGroupIndex(0);
+    
+    auto collide = [this, &nextGroupIndex](int bufferIndex){
+        // ODE needs the thread local data to detect collisions
+        dAllocateODEDataForThread(dAllocateMaskAll);
+        auto& buffer = contactBuffers[bufferIndex];
+        size_t bufferSize = 0;
+        int groupIndex;
+        while((groupIndex = nextGroupIndex++) < numGeomPairGroups){
+            for(auto& pairIndex : geomPairGroups[groupIndex]){
+                auto& pair = geomPairs[pairIndex];
+                if(buffer.size() < bufferSize + MaxNumContacts){
+                    buffer.resize(bufferSize + MaxNumContacts);
+                }
+                pair.bufferIndex = bufferIndex;
+                pair.contactOffset = bufferSize;
+                pair.numContacts = collideGeoms(pair.geom1, pair.geom2, &buffer[bufferSize]);
+                bufferSize += pair.numContacts;
+            }
+        }
+    };
+
+    const int numTasks = std::min(numActualThreads, numGeomPairGroups);
+    for(int i=1; i < numTasks; ++i){
+        collisionThreadPool->start([collide, i](){ collide(i); });
+    }
+    if(numTasks > 0){
+        collide(0);
+    }
+    collisionThreadPool->wait();
+
+    // The contact joints are created in the same order as the sequential collision detection
+    for(auto& pair : geomPairs){
+        if(pair.numContacts > 0){
+            addContactJoints(
+                pair.geom1, pair.geom2, &contactBuffers[pair.bufferIndex][pair.contactOffset], pair.numContacts);
+        }
+    }
 }
 
 
@@ -1289,7 +1562,11 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
         if(MEASURE_PHYSICS_CALCULATION_TIME){
             collisionTimer.start();
         }
-        dSpaceCollide(spaceID, (void*)this, &nearCallback);
+        if(collisionThreadPool){
+            collideGeomPairsConcurrently();
+        } else {
+            dSpaceCollide(spaceID, (void*)this, &nearCallback);
+        }
         if(MEASURE_PHYSICS_CALCULATION_TIME){
             collisionTime += collisionTimer.nsecsElapsed();
         }
@@ -1399,6 +1676,7 @@ void ODESimulatorItem::finalizeSimulation()
         cout << "ODE physicsTime= " << impl->physicsTime *1.0e-9 << "[s]"<< endl;
         cout << "ODE collisionTime= " << impl->collisionTime *1.0e-9 << "[s]"<< endl;
     }
+    impl->finalizeThreads();
 }
 
 
@@ -1436,6 +1714,8 @@ void ODESimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
 
     putProperty(_("Use WorldItem's Collision Detector"), useWorldCollisionDetector, changeProperty(useWorldCollisionDetector));
+
+    putProperty.min(0)(_("Number of threads"), numThreads, changeProperty(numThreads));
 }
 
 
@@ -1461,6 +1741,7 @@ void ODESimulatorItemImpl::store(Archive& archive)
     archive.write("maxCorrectingVel", maxCorrectingVel);
     archive.write("2Dmode", is2Dmode);
     archive.write("useWorldCollisionDetector", useWorldCollisionDetector);
+    archive.write("numThreads", numThreads);
 }
 
 
@@ -1491,4 +1772,5 @@ void ODESimulatorItemImpl::restore(const Archive& archive)
     if(!archive.read("useWorldCollisionDetector", useWorldCollisionDetector)){
         archive.read("UseWorldItem'sCollisionDetector", useWorldCollisionDetector);
     }
+    archive.read("numThreads", numThreads);
 }
@@ -42,6 +42,12 @@ public:
     void setSurfaceLayerDepth(double value);
     void useWorldCollisionDetector(bool on);
 
+    /**
+       The collision detection and the island stepping of ODE are processed in parallel when
+       the number of threads is more than one. Zero means the number of the hardware threads.
+    */
+    void setNumThreads(int n);
+
     virtual void setAllLinkPositionOutputMode(bool on) override;
     virtual Vector3 getGravity() const override;
 
@@ -4,6 +4,7 @@
 
 #include "BodyMotionGenerationBar.h"
 #include "PoseSeqItem.h"
+#include "PoseSeqInterpolator.h"
 #include <cnoid/BodyItem>
 #include <cnoid/PoseProvider>
 #include <cnoid/BodyMotionPoseProvider>
@@ -25,13 +26,20 @@
 #include <cnoid/Dialog>
 #include <QDialogButtonBox>
 #include <set>
+#include <thread>
+#include <limits>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
+
 const bool TRACE_FUNCTIONS = false;
+
+// Threads are not used for small numbers of frames to regenerate
+constexpr int MinNumFramesPerThread = 50;
+
 }
 
 namespace cnoid {
@@ -62,6 +70,7 @@ public:
         
     CheckBox se3Check;
     CheckBox lipSyncMixCheck;
+    SpinBox numThreadsSpin;
 
     void addSeparator(QVBoxLayout* vbox){
         vbox->addSpacing(4);
@@ -124,6 +133,12 @@ public:
             se3Check.setText(_("Put all link positions"));
             se3Check.setChecked(false);
             hbox->addWidget(&se3Check);
+
+            hbox->addSpacing(8);
+            hbox->addWidget(new QLabel(_("Threads")));
+            numThreadsSpin.setRange(1, 256);
+            numThreadsSpin.setValue(std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+            hbox->addWidget(&numThreadsSpin);
             hbox->addStretch();
             
             hbox = newRow(vbox);
@@ -275,6 +290,7 @@ public:
         archive.write("zmpMaxDistanceFromCenter", zmpMaxDistanceFromCenterSpin.value());
         archive.write("allLinkPositions", se3Check.isChecked());
         archive.write("lipSyncMix", lipSyncMixCheck.isChecked());
+        archive.write("numThreads", numThreadsSpin.value());
     }
 
     void restoreState(const Archive& archive){
@@ -298,6 +314,7 @@ public:
             
         se3Check.setChecked(archive.get("allLinkPositions", se3Check.isChecked()));
         lipSyncMixCheck.setChecked(archive.get("lipSyncMix", lipSyncMixCheck.isChecked()));
+        numThreadsSpin.setValue(archive.get("numThreads", numThreadsSpin.value()));
     }
 };
 
@@ -506,30 +523,122 @@ bool BodyMotionGenerationBar::shapeBodyMotion
     
     if(balancerToggle->isChecked() && balancer){
         result = balancer->apply(body, provider, motionItem, putMessages);
+        if(auto record = findInterpolationRecord(motionItem->motion().get(), false)){
+            record->motion.reset();
+        }
     } else {
         result = shapeBodyMotionWithSimpleInterpolation(body, provider, motionItem);
     }
 
+    if(auto interpolator = dynamic_cast<PoseSeqInterpolator*>(provider)){
+        interpolator->resetModifiedTimeRange();
+    }
+
     return result;
 }
+
+
+BodyMotionGenerationBar::InterpolationRecord*
+BodyMotionGenerationBar::findInterpolationRecord(BodyMotion* motion, bool doCreate)
+{
+    InterpolationRecord* found = nullptr;
+    auto it = interpolationRecords.begin();
+    while(it != interpolationRecords.end()){
+        auto recordedMotion = it->motion.lock();
+        if(!recordedMotion){
+            it = interpolationRecords.erase(it);
+        } else {
+            if(recordedMotion.get() == motion){
+                found = &(*it);
+            }
+            ++it;
+        }
+    }
+    if(!found && doCreate){
+        interpolationRecords.emplace_back();
+        found = &interpolationRecords.back();
+    }
+    return found;
+}
         
 
 bool BodyMotionGenerationBar::shapeBodyMotionWithSimpleInterpolation
 (BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem)
 {
+    auto converter = poseProviderToBodyMotionConverter;
+    double lowerTime = 0.0;
+    double upperTime = std::numeric_limits<double>::max();
     if(setup->onlyTimeBarRangeCheck.isChecked()){
-        poseProviderToBodyMotionConverter->setTimeRange(timeBar->minTime(), timeBar->maxTime());
+        lowerTime = timeBar->minTime();
+        upperTime = timeBar->maxTime();
+        converter->setTimeRange(lowerTime, upperTime);
     } else {
-        poseProviderToBodyMotionConverter->setFullTimeRange();
+        converter->setFullTimeRange();
     }
-    poseProviderToBodyMotionConverter->setAllLinkPositionOutput(setup->se3Check.isChecked());
+    const bool isSe3Enabled = setup->se3Check.isChecked();
+    converter->setAllLinkPositionOutput(isSe3Enabled);
         
     auto motion = motionItem->motion();
-    motion->setFrameRate(timeBar->frameRate());
+    const double frameRate = timeBar->frameRate();
+    const int numFrames = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime)) + 1;
+    const int numLinks = isSe3Enabled ? body->numLinks() : 1;
+
+    /*
+      Only the frames affected by the modification of the pose sequence are regenerated
+      when the motion has been generated from the same provider with the same conditions.
+    */
+    double updateLowerTime = 0.0;
+    double updateUpperTime = provider->endingTime();
+    bool isPartialUpdate = false;
+    auto interpolator = dynamic_cast<PoseSeqInterpolator*>(provider);
+    if(interpolator){
+        auto record = findInterpolationRecord(motion.get(), false);
+        if(record && record->provider == provider && record->frameRate == frameRate &&
+           record->numFrames == numFrames && record->numLinks == numLinks &&
+           record->lowerTime == lowerTime && record->upperTime == upperTime &&
+           motion->frameRate() == frameRate && motion->numFrames() == numFrames &&
+           motion->numJoints() == body->numJoints()){
+            isPartialUpdate = true;
+            if(!interpolator->getModifiedTimeRange(updateLowerTime, updateUpperTime)){
+                return true; // nothing has been changed
+            }
+        }
+    }
+    if(isPartialUpdate){
+        converter->setUpdateTimeRange(updateLowerTime, updateUpperTime);
+    } else {
+        converter->clearUpdateTimeRange();
+    }
+    
+    motion->setFrameRate(frameRate);
+
+    std::vector<PoseProvider*> providers;
+    providers.push_back(provider);
+    std::vector<PoseSeqInterpolatorPtr> interpolatorClones;
+    if(interpolator){
+        const double duration = std::min(updateUpperTime, upperTime) - std::max(updateLowerTime, lowerTime);
+        const int numFramesToUpdate = static_cast<int>(std::max(0.0, duration) * frameRate) + 1;
+        const int numThreads =
+            std::min(setup->numThreadsSpin.value(), std::max(1, numFramesToUpdate / MinNumFramesPerThread));
+        for(int i=1; i < numThreads; ++i){
+            interpolatorClones.push_back(interpolator->clone());
+            providers.push_back(interpolatorClones.back().get());
+        }
+    }
 
-    bool result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+    bool result = converter->convert(body, providers, *motion);
     
     if(result){
+        if(interpolator){
+            auto record = findInterpolationRecord(motion.get(), true);
+            record->motion = motion;
+            record->provider = provider;
+            record->frameRate = frameRate;
+            record->numFrames = numFrames;
+            record->numLinks = numLinks;
+            record->lowerTime = lowerTime;
+            record->upperTime = upperTime;
+        }
         motionItem->notifyUpdate();
     }
     return result;
@@ -664,6 +773,11 @@ bool BodyMotionGenerationBar::isSe3Enabled() const
     return setup->se3Check.isChecked();
 }
 
+int BodyMotionGenerationBar::numThreads() const
+{
+    return setup->numThreadsSpin.value();
+}
+
 bool BodyMotionGenerationBar::isLipSyncMixMode() const
 {
     return setup->lipSyncMixCheck.isChecked();
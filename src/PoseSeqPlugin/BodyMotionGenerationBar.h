@@ -10,6 +10,7 @@
 #include <cnoid/ConnectionSet>
 #include <cnoid/Body>
 #include <cnoid/BodyMotionItem>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -77,6 +78,7 @@ public:
     double zmpMaxDistanceFromCenter() const;
     bool isSe3Enabled() const;
     bool isLipSyncMixMode() const;
+    int numThreads() const;
             
     SignalProxy<void()> sigInterpolationParametersChanged() {
         return sigInterpolationParametersChanged_.signal();
@@ -98,6 +100,19 @@ private:
 
     LazySignal< Signal<void()> >sigInterpolationParametersChanged_;
 
+    // Conditions of the motions generated by the simple interpolation to regenerate them partially
+    struct InterpolationRecord
+    {
+        std::weak_ptr<BodyMotion> motion;
+        PoseProvider* provider;
+        double frameRate;
+        int numFrames;
+        int numLinks;
+        double lowerTime;
+        double upperTime;
+    };
+    std::vector<InterpolationRecord> interpolationRecords;
+
     ConnectionSet interpolationParameterWidgetsConnection;
 
     BodyMotionGenerationBar();
@@ -108,6 +123,7 @@ private:
 
     bool shapeBodyMotionWithSimpleInterpolation
         (BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem);
+    InterpolationRecord* findInterpolationRecord(BodyMotion* motion, bool doCreate);
             
     virtual bool storeState(Archive& archive);
     virtual bool restoreState(const Archive& archive);
@@ -28,12 +28,12 @@ enum SegmentType { UNDETERMINED, INVALID, CUBIC_SPLINE, CUBIC_CONNECTION, MIN_JE
 // coefficients for interpolatin
 struct Coeff
 {
-    double y;    // sample value
-    double yp;   // derivative value
-    double a;
-    double a_end;
-    double b;
-    double c;
+    double y = 0.0;    // sample value
+    double yp = 0.0;   // derivative value
+    double a = 0.0;
+    double a_end = 0.0;
+    double b = 0.0;
+    double c = 0.0;
 };
 
 struct LinkSample
@@ -253,6 +253,12 @@ struct ZmpSample
     typedef std::list<ZmpSample> Seq;
 };
 
+struct LipSyncSample
+{
+    double time;
+    int shapeId;
+};
+
 }
 
 namespace std {
@@ -280,6 +286,7 @@ class PoseSeqInterpolator::Impl
 public:
 
     Impl(PoseSeqInterpolator* self);
+    Impl(PoseSeqInterpolator* self, const Impl& org);
 
     PoseSeqInterpolator* self;
     BodyPtr body;
@@ -335,10 +342,6 @@ public:
         int mixType;
         int orgIndex;
     };
-    struct LipSyncSample {
-        double time;
-        int shapeId;
-    };
 
     bool isLipSyncMixEnabled;
     vector<LipSyncJoint> lipSyncJoints;
@@ -355,6 +358,10 @@ public:
     vector<bool> validIkLinkFlag;
     Vector3 waistTranslation;
 
+    // The time range of the sample sequence where the trajectory has been modified
+    double modifiedTimeLower;
+    double modifiedTimeUpper;
+
     Signal<void()> sigUpdated;
 
     void setBody(Body* body0);
@@ -368,6 +375,8 @@ public:
         double flatLiftingHeight, double flatLandingHeight,
         double impactReductionHeight, double impactReductionTime);
     void invalidateCurrentInterpolation();
+    void setWholeTimeRangeModified();
+    void resetModifiedTimeRange();
     bool interpolate(double time, int waistLinkIndex, const Vector3& waistTranslation);
     bool mixLipSyncShape();
     void calcIkJointPositions();
@@ -398,6 +407,9 @@ public:
     void adjustZmpAndFootKeyPoses();
     void insertAuxKeyPosesForStealthySteps();
     bool update();
+    void updateModifiedTimeRange(
+        vector<JointSample::Seq>& prevJointSamples, LinkInfoMap& prevIkLinkInfos,
+        ZmpSample::Seq& prevZmpSamples, vector<LipSyncSample>& prevLipSyncSeq);
     LinkInfo* getIkLinkInfo(int linkIndex);
     void onPoseInserted(PoseSeq::iterator it);
     void onPoseAboutToBeRemoved(PoseSeq::iterator it, bool isMoving);
@@ -801,6 +813,12 @@ PoseSeqInterpolator::PoseSeqInterpolator()
 }
 
 
+PoseSeqInterpolator::~PoseSeqInterpolator()
+{
+    delete impl;
+}
+
+
 PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self)
     : self(self)
 {
@@ -815,11 +833,82 @@ PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self)
     setStealthyStepParameters(2.0, 0.005, 0.005, 0.012, 0.3);
 
     isLipSyncMixEnabled = false;
+
+    setWholeTimeRangeModified();
     
     needUpdate = true;
 }
 
 
+std::shared_ptr<PoseSeqInterpolator> PoseSeqInterpolator::clone() const
+{
+    auto interpolator = make_shared<PoseSeqInterpolator>();
+    delete interpolator->impl;
+    interpolator->impl = new Impl(interpolator.get(), *impl);
+    return interpolator;
+}
+
+
+/**
+   The sample sequences are copied and the iterators to them are reset to the copied ones.
+   The pose sequence is shared with the original interpolator, but the signal connections
+   to it are not copied because the copy is only used to seek the current trajectory.
+*/
+PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self, const Impl& org)
+    : self(self),
+      poseSeq(org.poseSeq),
+      jointInfos(org.jointInfos),
+      ikLinkInfos(org.ikLinkInfos),
+      footLinkIndices(org.footLinkIndices),
+      soleCenters(org.soleCenters),
+      zmpSamples(org.zmpSamples),
+      lipSyncJoints(org.lipSyncJoints),
+      lipSyncLinkIndices(org.lipSyncLinkIndices),
+      lipSyncShapes(org.lipSyncShapes),
+      lipSyncSeq(org.lipSyncSeq),
+      validIkLinkFlag(org.validIkLinkFlag)
+{
+    if(org.body){
+        body = org.body->clone();
+    }
+    needUpdate = org.needUpdate;
+
+    isAutoZmpAdjustmentMode = org.isAutoZmpAdjustmentMode;
+    minZmpTransitionTime = org.minZmpTransitionTime;
+    zmpCenteringTimeThresh = org.zmpCenteringTimeThresh;
+    zmpTimeMarginBeforeLifting = org.zmpTimeMarginBeforeLifting;
+    zmpMaxDistanceFromCenterSqr = org.zmpMaxDistanceFromCenterSqr;
+
+    isStealthyStepMode = org.isStealthyStepMode;
+    stealthyHeightRatioThresh = org.stealthyHeightRatioThresh;
+    flatLiftingHeight = org.flatLiftingHeight;
+    flatLandingHeight = org.flatLandingHeight;
+    impactReductionHeight = org.impactReductionHeight;
+    impactReductionTime = org.impactReductionTime;
+    impactReductionVelocity = org.impactReductionVelocity;
+
+    isLipSyncMixEnabled = org.isLipSyncMixEnabled;
+    lipSyncMaxTransitionTime = org.lipSyncMaxTransitionTime;
+    timeScaleRatio = org.timeScaleRatio;
+    waistTranslation = org.waistTranslation;
+    modifiedTimeLower = org.modifiedTimeLower;
+    modifiedTimeUpper = org.modifiedTimeUpper;
+
+    for(auto& info : jointInfos){
+        info.iter = info.samples.begin();
+    }
+    for(auto& kv : ikLinkInfos){
+        LinkInfo& info = kv.second;
+        info.iter = info.samples.begin();
+        info.zIter = info.zSamples.begin();
+    }
+    zmpIter = zmpSamples.begin();
+    lipSyncIter = lipSyncSeq.begin();
+
+    invalidateCurrentInterpolation();
+}
+
+
 void PoseSeqInterpolator::setBody(Body* body)
 {
     impl->setBody(body);
@@ -845,6 +934,7 @@ void PoseSeqInterpolator::Impl::setBody(Body* body0)
         validIkLinkFlag.resize(body->numLinks(), false);
         invalidateCurrentInterpolation();
     }
+    setWholeTimeRangeModified();
     needUpdate = true;
 }
 
@@ -903,6 +993,7 @@ void PoseSeqInterpolator::setLipSyncShapes(const Mapping& info)
 */
 void PoseSeqInterpolator::Impl::setLipSyncShapes(const Mapping& info)
 {
+    setWholeTimeRangeModified();
     needUpdate = true;
 
     clearLipSyncShapes();
@@ -980,6 +1071,40 @@ void PoseSeqInterpolator::Impl::invalidateCurrentInterpolation()
 }
 
 
+void PoseSeqInterpolator::Impl::setWholeTimeRangeModified()
+{
+    modifiedTimeLower = -std::numeric_limits<double>::max();
+    modifiedTimeUpper = std::numeric_limits<double>::max();
+}
+
+
+void PoseSeqInterpolator::Impl::resetModifiedTimeRange()
+{
+    modifiedTimeLower = std::numeric_limits<double>::max();
+    modifiedTimeUpper = -std::numeric_limits<double>::max();
+}
+
+
+bool PoseSeqInterpolator::getModifiedTimeRange(double& out_lower, double& out_upper)
+{
+    if(impl->needUpdate){
+        impl->update();
+    }
+    if(impl->modifiedTimeLower > impl->modifiedTimeUpper){
+        return false;
+    }
+    out_lower = std::max(beginningTime(), impl->timeScaleRatio * impl->modifiedTimeLower);
+    out_upper = std::min(endingTime(), impl->timeScaleRatio * impl->modifiedTimeUpper);
+    return true;
+}
+
+
+void PoseSeqInterpolator::resetModifiedTimeRange()
+{
+    impl->resetModifiedTimeRange();
+}
+
+
 void PoseSeqInterpolator::setPoseSeq(PoseSeq* seq)
 {
     impl->setPoseSeq(seq);
@@ -1009,13 +1134,18 @@ void PoseSeqInterpolator::Impl::setPoseSeq(PoseSeq* seq)
             }));
     
     invalidateCurrentInterpolation();
+    setWholeTimeRangeModified();
     needUpdate = true;
 }
 
 
 void PoseSeqInterpolator::setTimeScaleRatio(double ratio)
 {
-    impl->timeScaleRatio = ratio;
+    if(ratio != impl->timeScaleRatio){
+        impl->timeScaleRatio = ratio;
+        impl->invalidateCurrentInterpolation();
+        impl->setWholeTimeRangeModified();
+    }
 }
 
 
@@ -1089,7 +1219,11 @@ void PoseSeqInterpolator::Impl::setStealthyStepParameters
 
 void PoseSeqInterpolator::enableLipSyncMix(bool on)
 {
-    impl->isLipSyncMixEnabled = on;
+    if(on != impl->isLipSyncMixEnabled){
+        impl->isLipSyncMixEnabled = on;
+        impl->invalidateCurrentInterpolation();
+        impl->setWholeTimeRangeModified();
+    }
 }
 
 
@@ -1531,19 +1665,169 @@ stdx::optional<Vector3> PoseSeqInterpolator::ZMP() const
 }
 
 
+namespace {
+
+/*
+   The number of the unchanged samples around the changed ones that are included in the
+   modified time range. The segments before and after the changed samples and the blending
+   ratio between the joint space and Cartesian space interpolations depend on them.
+*/
+constexpr int NumMarginSamples = 2;
+
+template<int dim>
+bool isSameCoeffs(const Coeff* c0, const Coeff* c1)
+{
+    for(int i=0; i < dim; ++i){
+        const Coeff& a = c0[i];
+        const Coeff& b = c1[i];
+        if(a.y != b.y || a.yp != b.yp || a.a != b.a || a.a_end != b.a_end || a.b != b.b || a.c != b.c){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isSameSample(const JointSample& s0, const JointSample& s1)
+{
+    return (s0.x == s1.x && s0.segmentType == s1.segmentType && s0.isEndPoint == s1.isEndPoint &&
+            isSameCoeffs<1>(s0.c, s1.c));
+}
+
+bool isSameSample(const LinkSample& s0, const LinkSample& s1)
+{
+    return (s0.x == s1.x && s0.segmentType == s1.segmentType && s0.isEndPoint == s1.isEndPoint &&
+            s0.isBaseLink == s1.isBaseLink && s0.isTouching == s1.isTouching &&
+            s0.isSlave == s1.isSlave && s0.isAux == s1.isAux && isSameCoeffs<6>(s0.c, s1.c));
+}
+
+bool isSameSample(const LinkZSample& s0, const LinkZSample& s1)
+{
+    return (s0.x == s1.x && s0.segmentType == s1.segmentType && s0.isEndPoint == s1.isEndPoint &&
+            s0.isTouching == s1.isTouching && isSameCoeffs<1>(s0.c, s1.c));
+}
+
+bool isSameSample(const ZmpSample& s0, const ZmpSample& s1)
+{
+    return (s0.x == s1.x && s0.segmentType == s1.segmentType && s0.isEndPoint == s1.isEndPoint &&
+            isSameCoeffs<3>(s0.c, s1.c));
+}
+
+bool isSameSample(const LipSyncSample& s0, const LipSyncSample& s1)
+{
+    return (s0.time == s1.time && s0.shapeId == s1.shapeId);
+}
+
+template<class SampleType>
+double sampleTime(const SampleType& sample)
+{
+    return sample.x;
+}
+
+double sampleTime(const LipSyncSample& sample)
+{
+    return sample.time;
+}
+
+template<class SampleType>
+bool isAuxSample(const SampleType& /* sample */)
+{
+    return false;
+}
+
+bool isAuxSample(const LinkSample& sample)
+{
+    return sample.isAux;
+}
+
+/**
+   @param begin The index of the first changed sample
+   @param end The index next to the last changed sample
+*/
+template<class SampleType>
+void expandModifiedTimeRange
+(const vector<const SampleType*>& samples, int begin, int end, double& io_lower, double& io_upper)
+{
+    const int n = samples.size();
+
+    int lower = begin - NumMarginSamples;
+    while(lower >= 0 && isAuxSample(*samples[lower])){
+        --lower;
+    }
+    if(lower < 0){
+        io_lower = -std::numeric_limits<double>::max();
+    } else {
+        io_lower = std::min(io_lower, sampleTime(*samples[lower]));
+    }
+
+    int upper = end - 1 + NumMarginSamples;
+    while(upper < n && isAuxSample(*samples[upper])){
+        ++upper;
+    }
+    if(upper >= n){
+        io_upper = std::numeric_limits<double>::max();
+    } else {
+        io_upper = std::max(io_upper, sampleTime(*samples[upper]));
+    }
+}
+
+/**
+   Compare the samples from the both ends of the sequences and expand the time range
+   so that it covers the differing part of the sequences.
+*/
+template<class SeqType>
+void expandModifiedTimeRange(const SeqType& seq0, const SeqType& seq1, double& io_lower, double& io_upper)
+{
+    typedef typename SeqType::value_type SampleType;
+    vector<const SampleType*> samples0;
+    samples0.reserve(seq0.size());
+    for(auto& sample : seq0){
+        samples0.push_back(&sample);
+    }
+    vector<const SampleType*> samples1;
+    samples1.reserve(seq1.size());
+    for(auto& sample : seq1){
+        samples1.push_back(&sample);
+    }
+
+    const int n0 = samples0.size();
+    const int n1 = samples1.size();
+    const int n = std::min(n0, n1);
+    int head = 0;
+    while(head < n && isSameSample(*samples0[head], *samples1[head])){
+        ++head;
+    }
+    if(head == n && n0 == n1){
+        return;
+    }
+    int tail = 0;
+    while(tail < n - head && isSameSample(*samples0[n0 - 1 - tail], *samples1[n1 - 1 - tail])){
+        ++tail;
+    }
+    expandModifiedTimeRange(samples0, head, n0 - tail, io_lower, io_upper);
+    expandModifiedTimeRange(samples1, head, n1 - tail, io_lower, io_upper);
+}
+
+}
+
+
 bool PoseSeqInterpolator::Impl::update()
 {
     if(!body || !poseSeq){
         return false;
     }
-    
+
+    // The previous samples are kept to detect the modified time range
+    vector<JointSample::Seq> prevJointSamples(jointInfos.size());
     for(size_t i=0; i < jointInfos.size(); ++i){
+        prevJointSamples[i].swap(jointInfos[i].samples);
         jointInfos[i].clear();
     }
-    ikLinkInfos.clear();
-    zmpSamples.clear();
-
-    lipSyncSeq.clear();
+    LinkInfoMap prevIkLinkInfos;
+    prevIkLinkInfos.swap(ikLinkInfos);
+    ZmpSample::Seq prevZmpSamples;
+    prevZmpSamples.swap(zmpSamples);
+    vector<LipSyncSample> prevLipSyncSeq;
+    prevLipSyncSeq.swap(lipSyncSeq);
 
     if(isAutoZmpAdjustmentMode || isStealthyStepMode){
         footLinkInfos.clear();
@@ -1625,6 +1909,8 @@ bool PoseSeqInterpolator::Impl::update()
 
     lipSyncIter = lipSyncSeq.begin();
 
+    updateModifiedTimeRange(prevJointSamples, prevIkLinkInfos, prevZmpSamples, prevLipSyncSeq);
+
     invalidateCurrentInterpolation();
     needUpdate = false;
 
@@ -1634,6 +1920,41 @@ bool PoseSeqInterpolator::Impl::update()
 }
 
 
+void PoseSeqInterpolator::Impl::updateModifiedTimeRange
+(vector<JointSample::Seq>& prevJointSamples, LinkInfoMap& prevIkLinkInfos,
+ ZmpSample::Seq& prevZmpSamples, vector<LipSyncSample>& prevLipSyncSeq)
+{
+    double& lower = modifiedTimeLower;
+    double& upper = modifiedTimeUpper;
+    
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        expandModifiedTimeRange(prevJointSamples[i], jointInfos[i].samples, lower, upper);
+    }
+
+    if(prevIkLinkInfos.size() != ikLinkInfos.size()){
+        setWholeTimeRangeModified();
+        return;
+    }
+    for(auto& kv : ikLinkInfos){
+        auto p = prevIkLinkInfos.find(kv.first);
+        if(p == prevIkLinkInfos.end() || p->second.isFootLink != kv.second.isFootLink){
+            setWholeTimeRangeModified();
+            return;
+        }
+        const LinkInfo& prevInfo = p->second;
+        const LinkInfo& info = kv.second;
+        expandModifiedTimeRange(prevInfo.samples, info.samples, lower, upper);
+        expandModifiedTimeRange(prevInfo.zSamples, info.zSamples, lower, upper);
+    }
+
+    expandModifiedTimeRange(prevZmpSamples, zmpSamples, lower, upper);
+
+    if(isLipSyncMixEnabled){
+        expandModifiedTimeRange(prevLipSyncSeq, lipSyncSeq, lower, upper);
+    }
+}
+
+
 void PoseSeqInterpolator::Impl::appendLinkSamples(PoseSeq::iterator poseIter, BodyKeyPose* pose)
 {
     for(auto it = pose->ikLinkBegin(); it != pose->ikLinkEnd(); ++it){
@@ -15,6 +15,14 @@ class CNOID_EXPORT PoseSeqInterpolator : public PoseProvider
 {
 public:
     PoseSeqInterpolator();
+    virtual ~PoseSeqInterpolator();
+
+    /**
+       Create a copy that has the current interpolation data and its own clone of the body.
+       The copy does not track the changes of the pose sequence any more, and it can be used to
+       seek the trajectory in another thread concurrently with the original interpolator.
+    */
+    std::shared_ptr<PoseSeqInterpolator> clone() const;
 
     void setBody(Body* body);
     virtual Body* body() const override;
@@ -53,6 +61,15 @@ public:
             
     bool update();
 
+    /**
+       Get the time range where the interpolated trajectory has been changed by the updates
+       since the last call of resetModifiedTimeRange(). The whole time range is given when
+       the change cannot be localized, such as when the body or the time scale is changed.
+       @return false if the trajectory has not been changed.
+    */
+    bool getModifiedTimeRange(double& out_lower, double& out_upper);
+    void resetModifiedTimeRange();
+
     SignalProxy<void()> sigUpdated();
             
     bool interpolate(double time);
@@ -86,6 +86,12 @@ public:
 
     virtual void detectCollisions(
         GeometryHandle geometry, std::function<void(const CollisionPair& collisionPair)> callback) override { }
+
+    virtual bool checkCollision() override { return false; }
+
+    virtual bool checkCollision(GeometryHandle) override { return false; }
+
+    virtual bool checkCollision(GeometryHandle, GeometryHandle) override { return false; }
 };
 
 CollisionDetector* factory()
@@ -157,10 +163,45 @@ CollisionDetector::~CollisionDetector()
 }
 
 
+void CollisionDetector::setGeometrySleeping(GeometryHandle geometry, bool isSleeping)
+{
+    setGeometryStatic(geometry, isSleeping);
+}
+
+
 // This function should be a pure virtual function
 void CollisionDetector::detectCollisions
 (GeometryHandle /* geometry */, std::function<void(const CollisionPair& collisionPair)> /* callback */)
 {
 
 }
-   
+
+
+bool CollisionDetector::checkCollision()
+{
+    bool detected = false;
+    detectCollisions([&](const CollisionPair&){ detected = true; });
+    return detected;
+}
+
+
+bool CollisionDetector::checkCollision(GeometryHandle geometry)
+{
+    bool detected = false;
+    detectCollisions(geometry, [&](const CollisionPair&){ detected = true; });
+    return detected;
+}
+
+
+bool CollisionDetector::checkCollision(GeometryHandle geometry1, GeometryHandle geometry2)
+{
+    bool detected = false;
+    detectCollisions(
+        geometry1,
+        [&](const CollisionPair& collisionPair){
+            if(collisionPair.geometry(0) == geometry2 || collisionPair.geometry(1) == geometry2){
+                detected = true;
+            }
+        });
+    return detected;
+}
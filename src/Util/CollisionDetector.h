@@ -47,6 +47,15 @@ public:
     virtual stdx::optional<GeometryHandle> addGeometry(SgNode* geometry) = 0;
     virtual void setCustomObject(GeometryHandle geometry, Referenced* object) = 0;
     virtual void setGeometryStatic(GeometryHandle geometry, bool isStatic = true) = 0;
+
+    /**
+       A sleeping geometry is not checked against other static or sleeping geometries like a static
+       geometry, but the sleeping state is expected to change frequently during a simulation.
+       A detector should not rebuild its internal data for the change if it can skip the pairs of
+       sleeping geometries at run time. The default implementation calls setGeometryStatic.
+    */
+    virtual void setGeometrySleeping(GeometryHandle geometry, bool isSleeping = true);
+    
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) = 0;
     virtual bool makeReady() = 0;
     
@@ -57,6 +66,17 @@ public:
     virtual void detectCollisions(std::function<void(const CollisionPair& collisionPair)> callback) = 0;
     virtual void detectCollisions(
         GeometryHandle geometry, std::function<void(const CollisionPair& collisionPair)> callback);
+
+    /**
+       The following functions only check whether there is any colliding geometry pair.
+       The check finishes when the first collision is found and the contact points are not
+       calculated, so these functions are much faster than detectCollisions when only the
+       existence of a collision is needed. The default implementations use detectCollisions
+       and a detector should override them to make them efficient.
+    */
+    virtual bool checkCollision();
+    virtual bool checkCollision(GeometryHandle geometry);
+    virtual bool checkCollision(GeometryHandle geometry1, GeometryHandle geometry2);
 };
 
 typedef ref_ptr<CollisionDetector> CollisionDetectorPtr;
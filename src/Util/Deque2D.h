@@ -403,13 +403,14 @@ private:
                         allocator.construct(p++, *q++);
                     }
                 } else {
-                    for(ElementType* r = buf; r != qend && p != pend; ++r){
-                        allocator.construct(p++, *r);
-                    }
+                    // The elements from the offset position to the buffer end come first
                     ElementType* qterm = buf + capacity_;
                     for(ElementType* r = q; r != qterm && p != pend; ++r){
                         allocator.construct(p++, *r);
                     }
+                    for(ElementType* r = buf; r != qend && p != pend; ++r){
+                        allocator.construct(p++, *r);
+                    }
                 }
             }
             // destory the old elements
@@ -549,6 +550,22 @@ public:
         resize(0, 0);
     }
 
+    /**
+       This function rearranges the buffer if necessary so that all the elements are stored
+       contiguously in the row-major order, and returns the pointer to the first element.
+       The pointer is valid until the size of the container is changed.
+    */
+    ElementType* linearizedData() {
+        if(capacity_ == 0){
+            return nullptr;
+        }
+        if(offset + size_ > capacity_){
+            reallocMemory(colSize_, size_, capacity_, true);
+            end_ = iterator(*this, buf + (size_ % capacity_));
+        }
+        return buf + offset;
+    }
+
     const Element& operator()(int rowIndex, int colIndex) const {
         return buf[(offset + (rowIndex * colSize_)) % capacity_ + colIndex];
     }
@@ -0,0 +1,331 @@
+#include "MeshRayIntersector.h"
+#include "SceneDrawables.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int MaxNumLeafTriangles = 4;
+
+struct BvhNode
+{
+    Vector3f min;
+    Vector3f max;
+    // The index of the first triangle for a leaf node and the index of the second child for an inner node.
+    // The first child of an inner node is always the next node.
+    int index;
+    // Zero for an inner node
+    int numTriangles;
+};
+
+}
+
+namespace cnoid {
+
+class MeshRayIntersector::Impl
+{
+public:
+    vector<BvhNode> nodes;
+    vector<Vector3f> vertices; // Three vertices per triangle
+    vector<int> triangleIndices;
+    vector<Vector3f> centroids;
+
+    void build(SgMesh* mesh);
+    int buildNode(int begin, int end);
+    bool intersect(
+        const Vector3& origin, const Vector3& direction, double& io_t,
+        bool doCullBackFaces, int* out_triangleIndex) const;
+    bool intersectTriangle(
+        int triangle, const Vector3& origin, const Vector3& direction, double tmax,
+        bool doCullBackFaces, double& out_t) const;
+};
+
+}
+
+
+MeshRayIntersector::MeshRayIntersector()
+{
+    impl = new Impl;
+}
+
+
+MeshRayIntersector::MeshRayIntersector(SgMesh* mesh)
+    : MeshRayIntersector()
+{
+    build(mesh);
+}
+
+
+MeshRayIntersector::~MeshRayIntersector()
+{
+    delete impl;
+}
+
+
+void MeshRayIntersector::clear()
+{
+    impl->nodes.clear();
+    impl->vertices.clear();
+    impl->triangleIndices.clear();
+}
+
+
+bool MeshRayIntersector::empty() const
+{
+    return impl->nodes.empty();
+}
+
+
+int MeshRayIntersector::numTriangles() const
+{
+    return impl->triangleIndices.size();
+}
+
+
+void MeshRayIntersector::build(SgMesh* mesh)
+{
+    clear();
+    if(mesh && mesh->hasVertices()){
+        impl->build(mesh);
+    }
+}
+
+
+void MeshRayIntersector::Impl::build(SgMesh* mesh)
+{
+    const auto& orgVertices = *mesh->vertices();
+    const int numOrgVertices = orgVertices.size();
+    const int numTriangles = mesh->numTriangles();
+
+    vertices.reserve(numTriangles * 3);
+    triangleIndices.reserve(numTriangles);
+    centroids.reserve(numTriangles);
+
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = mesh->triangle(i);
+        if(triangle[0] < numOrgVertices && triangle[1] < numOrgVertices && triangle[2] < numOrgVertices){
+            const Vector3f& v0 = orgVertices[triangle[0]];
+            const Vector3f& v1 = orgVertices[triangle[1]];
+            const Vector3f& v2 = orgVertices[triangle[2]];
+            vertices.push_back(v0);
+            vertices.push_back(v1);
+            vertices.push_back(v2);
+            triangleIndices.push_back(i);
+            centroids.push_back((v0 + v1 + v2) / 3.0f);
+        }
+    }
+
+    // The triangle index in the following process is the index in the triangleIndices array
+    vector<int> orgIndices;
+    orgIndices.swap(triangleIndices);
+    const int n = orgIndices.size();
+    triangleIndices.resize(n);
+    for(int i=0; i < n; ++i){
+        triangleIndices[i] = i;
+    }
+    if(n > 0){
+        nodes.reserve(2 * n / MaxNumLeafTriangles + 1);
+        buildNode(0, n);
+    }
+
+    // Reorder the vertices so that the triangles of a leaf node are stored contiguously
+    vector<Vector3f> sortedVertices(n * 3);
+    for(int i=0; i < n; ++i){
+        const int j = triangleIndices[i];
+        sortedVertices[i * 3] = vertices[j * 3];
+        sortedVertices[i * 3 + 1] = vertices[j * 3 + 1];
+        sortedVertices[i * 3 + 2] = vertices[j * 3 + 2];
+        triangleIndices[i] = orgIndices[j];
+    }
+    vertices.swap(sortedVertices);
+
+    centroids.clear();
+    centroids.shrink_to_fit();
+}
+
+
+int MeshRayIntersector::Impl::buildNode(int begin, int end)
+{
+    const int nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    Vector3f min = Vector3f::Constant(std::numeric_limits<float>::max());
+    Vector3f max = Vector3f::Constant(std::numeric_limits<float>::lowest());
+    Vector3f cmin = min;
+    Vector3f cmax = max;
+    for(int i = begin; i < end; ++i){
+        const int j = triangleIndices[i];
+        for(int k=0; k < 3; ++k){
+            const Vector3f& v = vertices[j * 3 + k];
+            min = min.cwiseMin(v);
+            max = max.cwiseMax(v);
+        }
+        cmin = cmin.cwiseMin(centroids[j]);
+        cmax = cmax.cwiseMax(centroids[j]);
+    }
+    nodes[nodeIndex].min = min;
+    nodes[nodeIndex].max = max;
+
+    const int n = end - begin;
+    int axis;
+    const float extent = (cmax - cmin).maxCoeff(&axis);
+
+    if(n <= MaxNumLeafTriangles || extent <= 0.0f){
+        nodes[nodeIndex].index = begin;
+        nodes[nodeIndex].numTriangles = n;
+    } else {
+        const int middle = begin + n / 2;
+        std::nth_element(
+            triangleIndices.begin() + begin, triangleIndices.begin() + middle, triangleIndices.begin() + end,
+            [&](int a, int b){ return centroids[a][axis] < centroids[b][axis]; });
+        buildNode(begin, middle);
+        const int secondChild = buildNode(middle, end);
+        nodes[nodeIndex].index = secondChild;
+        nodes[nodeIndex].numTriangles = 0;
+    }
+
+    return nodeIndex;
+}
+
+
+bool MeshRayIntersector::intersect
+(const Vector3& origin, const Vector3& direction, double& io_t, bool doCullBackFaces, int* out_triangleIndex) const
+{
+    if(impl->nodes.empty()){
+        return false;
+    }
+    return impl->intersect(origin, direction, io_t, doCullBackFaces, out_triangleIndex);
+}
+
+
+static bool intersectBox
+(const BvhNode& node, const Vector3& origin, const Vector3& invDirection, double tmax, double& out_tmin)
+{
+    double t0 = 0.0;
+    double t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        double tnear = (node.min[i] - origin[i]) * invDirection[i];
+        double tfar = (node.max[i] - origin[i]) * invDirection[i];
+        if(tnear > tfar){
+            std::swap(tnear, tfar);
+        }
+        // The comparisons are written so that NaN values do not shrink the range
+        if(tnear > t0){
+            t0 = tnear;
+        }
+        if(tfar < t1){
+            t1 = tfar;
+        }
+        if(t0 > t1){
+            return false;
+        }
+    }
+    out_tmin = t0;
+    return true;
+}
+
+
+bool MeshRayIntersector::Impl::intersect
+(const Vector3& origin, const Vector3& direction, double& io_t, bool doCullBackFaces, int* out_triangleIndex) const
+{
+    const Vector3 invDirection = direction.cwiseInverse();
+    double tmax = io_t;
+    int hitTriangle = -1;
+
+    // The depth of the tree built with the median split never exceeds this size
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        const int nodeIndex = stack[--stackSize];
+        const BvhNode& node = nodes[nodeIndex];
+        double tmin;
+        if(!intersectBox(node, origin, invDirection, tmax, tmin)){
+            continue;
+        }
+        if(node.numTriangles > 0){
+            const int end = node.index + node.numTriangles;
+            for(int i = node.index; i < end; ++i){
+                double t;
+                if(intersectTriangle(i, origin, direction, tmax, doCullBackFaces, t)){
+                    tmax = t;
+                    hitTriangle = i;
+                }
+            }
+        } else {
+            const int child1 = nodeIndex + 1;
+            const int child2 = node.index;
+            double t1, t2;
+            bool hit1 = intersectBox(nodes[child1], origin, invDirection, tmax, t1);
+            bool hit2 = intersectBox(nodes[child2], origin, invDirection, tmax, t2);
+            // Push the farther child first so that the nearer child is visited first
+            if(hit1 && hit2){
+                if(t1 <= t2){
+                    stack[stackSize++] = child2;
+                    stack[stackSize++] = child1;
+                } else {
+                    stack[stackSize++] = child1;
+                    stack[stackSize++] = child2;
+                }
+            } else if(hit1){
+                stack[stackSize++] = child1;
+            } else if(hit2){
+                stack[stackSize++] = child2;
+            }
+        }
+    }
+
+    if(hitTriangle >= 0){
+        io_t = tmax;
+        if(out_triangleIndex){
+            *out_triangleIndex = triangleIndices[hitTriangle];
+        }
+        return true;
+    }
+    return false;
+}
+
+
+/**
+   Moller-Trumbore algorithm
+*/
+bool MeshRayIntersector::Impl::intersectTriangle
+(int triangle, const Vector3& origin, const Vector3& direction, double tmax, bool doCullBackFaces, double& out_t) const
+{
+    const Vector3 v0 = vertices[triangle * 3].cast<double>();
+    const Vector3 e1 = vertices[triangle * 3 + 1].cast<double>() - v0;
+    const Vector3 e2 = vertices[triangle * 3 + 2].cast<double>() - v0;
+    const Vector3 p = direction.cross(e2);
+    const double det = e1.dot(p);
+
+    // The determinant is positive when the ray hits the front face
+    if(doCullBackFaces){
+        if(det <= 0.0){
+            return false;
+        }
+    } else if(det == 0.0){
+        return false;
+    }
+    const double invDet = 1.0 / det;
+    const Vector3 s = origin - v0;
+    const double u = s.dot(p) * invDet;
+    if(u < 0.0 || u > 1.0){
+        return false;
+    }
+    const Vector3 q = s.cross(e1);
+    const double v = direction.dot(q) * invDet;
+    if(v < 0.0 || u + v > 1.0){
+        return false;
+    }
+    const double t = e2.dot(q) * invDet;
+    if(t < 0.0 || t > tmax){
+        return false;
+    }
+    out_t = t;
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef CNOID_UTIL_MESH_RAY_INTERSECTOR_H
+#define CNOID_UTIL_MESH_RAY_INTERSECTOR_H
+
+#include "EigenTypes.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgMesh;
+
+/**
+   This class finds the intersection of a ray and the triangles of a mesh
+   using a bounding volume hierarchy of the triangles.
+   The hierarchy is built from the current vertices and triangles of the mesh,
+   so it must be rebuilt when the geometry of the mesh is modified.
+*/
+class CNOID_EXPORT MeshRayIntersector
+{
+public:
+    MeshRayIntersector();
+    MeshRayIntersector(SgMesh* mesh);
+    ~MeshRayIntersector();
+
+    MeshRayIntersector(const MeshRayIntersector&) = delete;
+    MeshRayIntersector& operator=(const MeshRayIntersector&) = delete;
+
+    void build(SgMesh* mesh);
+    void clear();
+    bool empty() const;
+    int numTriangles() const;
+
+    /**
+       Find the closest intersection of the ray "origin + t * direction" where 0 <= t <= io_t.
+       The ray must be given in the local coordinate of the mesh and the direction does not
+       have to be normalized.
+       \param io_t The upper limit of t. This is updated with the t value of the intersection.
+       \param doCullBackFaces The triangles whose back faces face the ray are skipped if this is true.
+       \param out_triangleIndex The index of the intersected triangle is returned if this is not null.
+       \return true if the intersection is found.
+    */
+    bool intersect(
+        const Vector3& origin, const Vector3& direction, double& io_t,
+        bool doCullBackFaces = false, int* out_triangleIndex = nullptr) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "PointSetOctree.h"
+#include "PolyhedralRegion.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int MaxDepth = 20;
+
+/**
+   A hash set of the voxel keys using open addressing.
+   This is used instead of std::unordered_set to avoid allocating a node for each voxel.
+*/
+class VoxelKeySet
+{
+    static constexpr uint64_t EmptyKey = ~uint64_t(0);
+    vector<uint64_t> table;
+    size_t mask;
+    size_t size_;
+
+    static size_t hash(uint64_t key){
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void rehash(size_t capacity){
+        vector<uint64_t> orgTable;
+        orgTable.swap(table);
+        table.resize(capacity, EmptyKey);
+        mask = capacity - 1;
+        for(auto& key : orgTable){
+            if(key != EmptyKey){
+                size_t i = hash(key) & mask;
+                while(table[i] != EmptyKey){
+                    i = (i + 1) & mask;
+                }
+                table[i] = key;
+            }
+        }
+    }
+
+public:
+    VoxelKeySet(){
+        size_ = 0;
+        rehash(1 << 16);
+    }
+
+    //! \return true if the key is newly inserted
+    bool insert(uint64_t key){
+        if((size_ + 1) * 2 > table.size()){
+            rehash(table.size() * 2);
+        }
+        size_t i = hash(key) & mask;
+        while(true){
+            const uint64_t k = table[i];
+            if(k == key){
+                return false;
+            } else if(k == EmptyKey){
+                table[i] = key;
+                ++size_;
+                return true;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+};
+
+
+inline float distanceToCube(const Vector3f& p, const Vector3f& center, float halfSize)
+{
+    const Vector3f d = ((p - center).cwiseAbs().array() - halfSize).cwiseMax(0.0f).matrix();
+    return d.norm();
+}
+
+}
+
+
+PointSetOctree::PointSetOctree()
+{
+    points = nullptr;
+}
+
+
+PointSetOctree::~PointSetOctree()
+{
+
+}
+
+
+void PointSetOctree::clear()
+{
+    points = nullptr;
+    nodes_.clear();
+    pointIndices_.clear();
+    sampleIndices_.clear();
+}
+
+
+void PointSetOctree::build(const SgVertexArray* points, int maxNumLeafPoints, int numSampleDivisions)
+{
+    clear();
+
+    if(!points || points->empty()){
+        return;
+    }
+    this->points = points;
+    const SgVertexArray& vertices = *points;
+    const int numPoints = vertices.size();
+
+    Vector3f min(Vector3f::Constant(std::numeric_limits<float>::max()));
+    Vector3f max(Vector3f::Constant(-std::numeric_limits<float>::max()));
+    pointIndices_.reserve(numPoints);
+    for(int i=0; i < numPoints; ++i){
+        const Vector3f& p = vertices[i];
+        if(p.allFinite()){
+            min = min.cwiseMin(p);
+            max = max.cwiseMax(p);
+            pointIndices_.push_back(i);
+        }
+    }
+    if(pointIndices_.empty()){
+        return;
+    }
+
+    maxNumLeafPoints = std::max(1, maxNumLeafPoints);
+    const int G = std::max(1, numSampleDivisions);
+    vector<int> cellStamps(G * G * G, -1);
+    vector<int> buf(pointIndices_.size());
+
+    Node root;
+    root.center = (min + max) / 2.0f;
+    // The cube is slightly enlarged so that the points on the boundary are inside it
+    root.halfSize = std::max((max - min).maxCoeff() / 2.0f * 1.0001f, 1.0e-6f);
+    root.pointBegin = 0;
+    root.pointEnd = pointIndices_.size();
+    root.depth = 0;
+    nodes_.push_back(root);
+
+    vector<int> stack;
+    stack.push_back(0);
+
+    while(!stack.empty()){
+        const int index = stack.back();
+        stack.pop_back();
+        // The node is copied because the node array may be reallocated in the loop
+        Node node = nodes_[index];
+        std::fill(node.children, node.children + 8, -1);
+        node.sampleBegin = sampleIndices_.size();
+
+        if(node.numPoints() <= maxNumLeafPoints || node.depth >= MaxDepth){
+            node.sampleEnd = node.sampleBegin;
+            node.sampleSpacing = 0.0f;
+            nodes_[index] = node;
+            continue;
+        }
+
+        // Sampling
+        const float spacing = 2.0f * node.halfSize / G;
+        const Vector3f corner = node.center - Vector3f::Constant(node.halfSize);
+        for(int i = node.pointBegin; i < node.pointEnd; ++i){
+            const int pointIndex = pointIndices_[i];
+            const Vector3f c = (vertices[pointIndex] - corner) / spacing;
+            const int x = std::min(std::max(static_cast<int>(c.x()), 0), G - 1);
+            const int y = std::min(std::max(static_cast<int>(c.y()), 0), G - 1);
+            const int z = std::min(std::max(static_cast<int>(c.z()), 0), G - 1);
+            int& stamp = cellStamps[x + G * (y + G * z)];
+            if(stamp != index){
+                stamp = index;
+                sampleIndices_.push_back(pointIndex);
+            }
+        }
+        node.sampleEnd = sampleIndices_.size();
+        node.sampleSpacing = spacing;
+
+        // Partitioning into the octants by the counting sort
+        int counts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        auto octant = [&](int pointIndex){
+            const Vector3f& p = vertices[pointIndex];
+            return (p.x() >= node.center.x() ? 1 : 0) |
+                   (p.y() >= node.center.y() ? 2 : 0) |
+                   (p.z() >= node.center.z() ? 4 : 0);
+        };
+        for(int i = node.pointBegin; i < node.pointEnd; ++i){
+            ++counts[octant(pointIndices_[i])];
+        }
+        int offsets[8];
+        int offset = node.pointBegin;
+        for(int i=0; i < 8; ++i){
+            offsets[i] = offset;
+            offset += counts[i];
+        }
+        int positions[8];
+        std::copy(offsets, offsets + 8, positions);
+        for(int i = node.pointBegin; i < node.pointEnd; ++i){
+            const int pointIndex = pointIndices_[i];
+            buf[positions[octant(pointIndex)]++] = pointIndex;
+        }
+        std::copy(buf.begin() + node.pointBegin, buf.begin() + node.pointEnd, pointIndices_.begin() + node.pointBegin);
+
+        const float h = node.halfSize / 2.0f;
+        for(int i=0; i < 8; ++i){
+            if(counts[i] > 0){
+                Node child;
+                child.center = node.center + Vector3f((i & 1) ? h : -h, (i & 2) ? h : -h, (i & 4) ? h : -h);
+                child.halfSize = h;
+                child.pointBegin = offsets[i];
+                child.pointEnd = offsets[i] + counts[i];
+                child.depth = node.depth + 1;
+                node.children[i] = nodes_.size();
+                nodes_.push_back(child);
+                stack.push_back(node.children[i]);
+            }
+        }
+        nodes_[index] = node;
+    }
+}
+
+
+void PointSetOctree::findPointsInRegion
+(const PolyhedralRegion& region, const Isometry3& T, std::vector<int>& out_indices) const
+{
+    out_indices.clear();
+    if(nodes_.empty()){
+        return;
+    }
+    const SgVertexArray& vertices = *points;
+    const int numPlanes = region.numBoundingPlanes();
+
+    vector<int> stack;
+    stack.push_back(0);
+    while(!stack.empty()){
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+
+        Vector3 corners[8];
+        const Vector3 c = node.center.cast<double>();
+        const double h = node.halfSize;
+        for(int i=0; i < 8; ++i){
+            corners[i] = T * (c + Vector3((i & 1) ? h : -h, (i & 2) ? h : -h, (i & 4) ? h : -h));
+        }
+        bool isOutside = false;
+        bool isInside = true;
+        for(int i=0; i < numPlanes; ++i){
+            const auto& plane = region.plane(i);
+            int numInsideCorners = 0;
+            for(int j=0; j < 8; ++j){
+                if(corners[j].dot(plane.normal) - plane.d >= 0.0){
+                    ++numInsideCorners;
+                }
+            }
+            if(numInsideCorners == 0){
+                isOutside = true;
+                break;
+            } else if(numInsideCorners < 8){
+                isInside = false;
+            }
+        }
+        if(isOutside){
+            continue;
+        }
+        if(isInside){
+            out_indices.insert(
+                out_indices.end(), pointIndices_.begin() + node.pointBegin, pointIndices_.begin() + node.pointEnd);
+        } else if(node.isLeaf()){
+            for(int i = node.pointBegin; i < node.pointEnd; ++i){
+                const int index = pointIndices_[i];
+                if(region.checkInside(T * vertices[index].cast<double>())){
+                    out_indices.push_back(index);
+                }
+            }
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    stack.push_back(node.children[i]);
+                }
+            }
+        }
+    }
+
+    std::sort(out_indices.begin(), out_indices.end());
+}
+
+
+int PointSetOctree::findNearestPoint(const Vector3f& point, float maxDistance) const
+{
+    int nearestIndex = -1;
+    if(nodes_.empty()){
+        return nearestIndex;
+    }
+    const SgVertexArray& vertices = *points;
+    float minDistance = maxDistance;
+
+    vector<int> stack;
+    stack.push_back(0);
+    while(!stack.empty()){
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+        if(distanceToCube(point, node.center, node.halfSize) > minDistance){
+            continue;
+        }
+        if(node.isLeaf()){
+            for(int i = node.pointBegin; i < node.pointEnd; ++i){
+                const int index = pointIndices_[i];
+                const float d = (vertices[index] - point).norm();
+                if(d <= minDistance){
+                    minDistance = d;
+                    nearestIndex = index;
+                }
+            }
+        } else {
+            for(int i=0; i < 8; ++i){
+                if(node.children[i] >= 0){
+                    stack.push_back(node.children[i]);
+                }
+            }
+        }
+    }
+
+    return nearestIndex;
+}
+
+
+void PointSetOctree::downsampleByVoxelGrid
+(float voxelSize, std::vector<int>& out_indices, std::vector<Vector3f>* out_voxelCenters) const
+{
+    out_indices.clear();
+    if(out_voxelCenters){
+        out_voxelCenters->clear();
+    }
+    if(nodes_.empty() || !(voxelSize > 0.0f)){
+        return;
+    }
+    const SgVertexArray& vertices = *points;
+    VoxelKeySet keys;
+
+    // The points are visited in the order of the octree so that the voxels in the
+    // hash set are accessed with spatial locality
+    for(auto& index : pointIndices_){
+        const Vector3f& p = vertices[index];
+        const int64_t ix = static_cast<int64_t>(std::floor(p.x() / voxelSize));
+        const int64_t iy = static_cast<int64_t>(std::floor(p.y() / voxelSize));
+        const int64_t iz = static_cast<int64_t>(std::floor(p.z() / voxelSize));
+        const uint64_t key =
+            (static_cast<uint64_t>(ix) & 0x1fffff) |
+            ((static_cast<uint64_t>(iy) & 0x1fffff) << 21) |
+            ((static_cast<uint64_t>(iz) & 0x1fffff) << 42);
+        if(keys.insert(key)){
+            out_indices.push_back(index);
+            if(out_voxelCenters){
+                out_voxelCenters->emplace_back((ix + 0.5f) * voxelSize, (iy + 0.5f) * voxelSize, (iz + 0.5f) * voxelSize);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef CNOID_UTIL_POINT_SET_OCTREE_H
+#define CNOID_UTIL_POINT_SET_OCTREE_H
+
+#include "SceneDrawables.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PolyhedralRegion;
+
+/**
+   This class is a spatial index of the points of a point set.
+   The points are recursively partitioned into octants until the number of the points in a
+   node becomes less than the specified number. The points of each node are contiguous in
+   the array returned by pointIndices().
+
+   Each internal node also has sample points, which consist of one point per occupied cell
+   of a uniform grid dividing the node cube. The samples can be used as a level of detail of
+   the points in the node.
+
+   The octree refers to the point array given to the build function, so it must be rebuilt
+   when the point array is modified.
+*/
+class CNOID_EXPORT PointSetOctree
+{
+public:
+    struct Node
+    {
+        Vector3f center;
+        float halfSize;
+        //! The index of each child node. -1 means that there is no child in the octant.
+        int children[8];
+        //! The range in pointIndices()
+        int pointBegin;
+        int pointEnd;
+        //! The range in sampleIndices(). The range is empty in a leaf node.
+        int sampleBegin;
+        int sampleEnd;
+        //! The interval of the sample grid. This is zero in a leaf node.
+        float sampleSpacing;
+        int depth;
+
+        bool isLeaf() const { return sampleSpacing == 0.0f; }
+        int numPoints() const { return pointEnd - pointBegin; }
+    };
+
+    PointSetOctree();
+    ~PointSetOctree();
+
+    PointSetOctree(const PointSetOctree&) = delete;
+    PointSetOctree& operator=(const PointSetOctree&) = delete;
+
+    /**
+       \param maxNumLeafPoints A node which has more points than this is divided
+       \param numSampleDivisions The number of the sample grid cells along each axis of a node
+    */
+    void build(const SgVertexArray* points, int maxNumLeafPoints = 4096, int numSampleDivisions = 32);
+    void clear();
+    bool empty() const { return nodes_.empty(); }
+
+    int numNodes() const { return nodes_.size(); }
+    //! The root node is the node of index 0
+    const Node& node(int index) const { return nodes_[index]; }
+    const std::vector<int>& pointIndices() const { return pointIndices_; }
+    const std::vector<int>& sampleIndices() const { return sampleIndices_; }
+
+    /**
+       Get the indices of the points inside the region.
+       \param T The transform from the coordinate of the points to that of the region
+    */
+    void findPointsInRegion(
+        const PolyhedralRegion& region, const Isometry3& T, std::vector<int>& out_indices) const;
+
+    //! \return The index of the nearest point within maxDistance, or -1 if there is no such point
+    int findNearestPoint(const Vector3f& point, float maxDistance) const;
+
+    /**
+       Select one point per occupied cell of the voxel grid aligned with the coordinate axes.
+       \param out_voxelCenters The center of the voxel of each selected point is stored if this is not null.
+    */
+    void downsampleByVoxelGrid(
+        float voxelSize, std::vector<int>& out_indices, std::vector<Vector3f>* out_voxelCenters = nullptr) const;
+
+private:
+    const SgVertexArray* points;
+    std::vector<Node> nodes_;
+    std::vector<int> pointIndices_;
+    std::vector<int> sampleIndices_;
+};
+
+}
+
+#endif
@@ -7,16 +7,33 @@
 #include <cnoid/EasyScanner>
 #include <cnoid/Exception>
 #include <cnoid/UTF8>
+#include <fmt/format.h>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace boost;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB, NUM_ELEMENTS };
 
 typedef union {
     struct {
@@ -29,50 +46,809 @@ typedef union {
 } RGBValue;
 
 
-void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
+void throwReadError(const string& message)
 {
-    SgVertexArrayPtr vertices = new SgVertexArray();
-    vertices->reserve(numPoints);
+    throw file_read_error() << error_info_message(message);
+}
 
-    const int numElements = elements.size();
 
-    SgNormalArrayPtr normals;
-    bool hasNormals = false;
-    SgColorArrayPtr colors;
-    bool hasColors = false;
-    for(int i=0; i < numElements; ++i){
-        Element element = elements[i];
-        if(element >= E_NORMAL_X && element <= E_NORMAL_Z){
-            hasNormals = true;
-            normals = new SgNormalArray();
-            normals->reserve(numPoints);
-        } else if(element == E_RGB){
-            hasColors = true;
-            colors = new SgColorArray();
+class MappedFile
+{
+public:
+    const char* data;
+    size_t size;
+
+    MappedFile();
+    ~MappedFile();
+    void open(const string& filename);
+    void close();
+
+private:
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#else
+    int fd;
+#endif
+};
+
+
+MappedFile::MappedFile()
+{
+    data = nullptr;
+    size = 0;
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = NULL;
+#else
+    fd = -1;
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+void MappedFile::open(const string& filename)
+{
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(
+        fromUTF8(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(fileHandle == INVALID_HANDLE_VALUE){
+        throwReadError(format("\"{}\" cannot be opened.", filename));
+    }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize)){
+        close();
+        throwReadError(format("The size of \"{}\" cannot be obtained.", filename));
+    }
+    size = fileSize.QuadPart;
+    if(size > 0){
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mappingHandle){
+            data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+#else
+    fd = ::open(fromUTF8(filename).c_str(), O_RDONLY);
+    if(fd < 0){
+        throwReadError(format("\"{}\" cannot be opened.", filename));
+    }
+    struct stat status;
+    if(fstat(fd, &status) != 0){
+        close();
+        throwReadError(format("The size of \"{}\" cannot be obtained.", filename));
+    }
+    size = status.st_size;
+    if(size > 0){
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED){
+            data = static_cast<const char*>(p);
+            madvise(p, size, MADV_SEQUENTIAL);
+        }
+    }
+#endif
+
+    if(!data){
+        close();
+        throwReadError(format("\"{}\" is empty or cannot be mapped to memory.", filename));
+    }
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data){
+        UnmapViewOfFile(data);
+    }
+    if(mappingHandle){
+        CloseHandle(mappingHandle);
+        mappingHandle = NULL;
+    }
+    if(fileHandle != INVALID_HANDLE_VALUE){
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(data){
+        munmap(const_cast<char*>(data), size);
+    }
+    if(fd >= 0){
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+
+/**
+   The decompression of the LZF format used in the binary_compressed data of PCD files
+*/
+bool decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* const inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while(ip < inEnd){
+        unsigned int ctrl = *ip++;
+        if(ctrl < (1 << 5)){
+            // Literal run
+            ++ctrl;
+            if(op + ctrl > outEnd || ip + ctrl > inEnd){
+                return false;
+            }
+            memcpy(op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+        } else {
+            // Back reference
+            unsigned int len = ctrl >> 5;
+            if(len == 7){
+                if(ip >= inEnd){
+                    return false;
+                }
+                len += *ip++;
+            }
+            if(ip >= inEnd){
+                return false;
+            }
+            const unsigned char* ref = op - ((ctrl & 0x1f) << 8) - 1 - *ip++;
+            len += 2;
+            if(op + len > outEnd || ref < out){
+                return false;
+            }
+            // The regions may overlap
+            for(unsigned int i=0; i < len; ++i){
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op == outEnd;
+}
+
+
+void compressLZF(const unsigned char* in, size_t inSize, vector<unsigned char>& out)
+{
+    constexpr int HashBits = 16;
+    constexpr size_t MaxOffset = 1 << 13;
+    constexpr size_t MaxRefLength = 264;
+    constexpr int MaxLiteralLength = 32;
+
+    // The table stores the position plus one so that zero means no entry
+    vector<size_t> table(1 << HashBits, 0);
+    out.clear();
+    out.reserve(inSize + inSize / 32 + 16);
+
+    size_t literalPos = out.size();
+    int numLiterals = 0;
+    out.push_back(0);
+
+    auto flushLiterals = [&](){
+        if(numLiterals > 0){
+            out[literalPos] = numLiterals - 1;
+        } else {
+            out.pop_back();
+        }
+    };
+    auto startLiterals = [&](){
+        literalPos = out.size();
+        numLiterals = 0;
+        out.push_back(0);
+    };
+    auto addLiteral = [&](unsigned char c){
+        out.push_back(c);
+        if(++numLiterals == MaxLiteralLength){
+            flushLiterals();
+            startLiterals();
+        }
+    };
+
+    size_t ip = 0;
+    while(ip + 2 < inSize){
+        const unsigned int v = (in[ip] << 16) | (in[ip + 1] << 8) | in[ip + 2];
+        const unsigned int h = ((v * 2654435761u) >> (32 - HashBits)) & ((1 << HashBits) - 1);
+        const size_t entry = table[h];
+        table[h] = ip + 1;
+        if(entry > 0){
+            const size_t ref = entry - 1;
+            const size_t offset = ip - ref - 1;
+            if(offset < MaxOffset && in[ref] == in[ip] && in[ref + 1] == in[ip + 1] && in[ref + 2] == in[ip + 2]){
+                const size_t maxLength = std::min(inSize - ip, MaxRefLength);
+                size_t length = 3;
+                while(length < maxLength && in[ref + length] == in[ip + length]){
+                    ++length;
+                }
+                flushLiterals();
+                const size_t l = length - 2;
+                if(l < 7){
+                    out.push_back((l << 5) | (offset >> 8));
+                } else {
+                    out.push_back((7 << 5) | (offset >> 8));
+                    out.push_back(l - 7);
+                }
+                out.push_back(offset & 0xff);
+                ip += length;
+                startLiterals();
+                continue;
+            }
+        }
+        addLiteral(in[ip++]);
+    }
+    while(ip < inSize){
+        addLiteral(in[ip++]);
+    }
+    flushLiterals();
+}
+
+
+struct Field
+{
+    string name;
+    int size;
+    char type;
+    int count;
+    // The byte offset of the field in a point
+    int offset;
+};
+
+
+inline double readBinaryValue(const char* p, char type, int size)
+{
+    switch(type){
+    case 'F':
+        if(size == 4){
+            float v; memcpy(&v, p, 4); return v;
+        } else if(size == 8){
+            double v; memcpy(&v, p, 8); return v;
         }
+        break;
+    case 'I':
+        switch(size){
+        case 1: { int8_t v; memcpy(&v, p, 1); return v; }
+        case 2: { int16_t v; memcpy(&v, p, 2); return v; }
+        case 4: { int32_t v; memcpy(&v, p, 4); return v; }
+        case 8: { int64_t v; memcpy(&v, p, 8); return static_cast<double>(v); }
+        }
+        break;
+    case 'U':
+        switch(size){
+        case 1: { uint8_t v; memcpy(&v, p, 1); return v; }
+        case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+        case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+        case 8: { uint64_t v; memcpy(&v, p, 8); return static_cast<double>(v); }
+        }
+        break;
+    }
+    return 0.0;
+}
+
+
+void writeHeader(ostream& os, bool hasColors, int numPoints, const Isometry3& viewpoint, const char* dataType)
+{
+    os << scientific << setprecision(9);
+
+    os << "# .PCD v.7 - Point Cloud Data file format\n";
+    os << "VERSION .7\n";
+    if(hasColors){
+        os << "FIELDS x y z rgb\n";
+        os << "SIZE 4 4 4 4\n";
+        os << "TYPE F F F F\n";
+        os << "COUNT 1 1 1 1\n";
+    } else {
+        os << "FIELDS x y z\n";
+        os << "SIZE 4 4 4\n";
+        os << "TYPE F F F\n";
+        os << "COUNT 1 1 1\n";
+    }
+
+    os << "WIDTH " << numPoints << "\n";
+    os << "HEIGHT 1\n";
+
+    os << "VIEWPOINT ";
+    Isometry3::ConstTranslationPart t = viewpoint.translation();
+    os << t.x() << " " << t.y() << " " << t.z() << " ";
+    const Quaternion q(viewpoint.rotation());
+    os << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
+
+    os << "POINTS " << numPoints << "\n";
+
+    os << "DATA " << dataType << "\n";
+}
+
+
+float getRGBFloatValue(const Vector3f& c)
+{
+    RGBValue rgb;
+    rgb.alpha = 0;
+    rgb.red = (unsigned char)(255.0 * c[0]);
+    rgb.green = (unsigned char)(255.0 * c[1]);
+    rgb.blue = (unsigned char)(255.0 * c[2]);
+    return rgb.float_value;
+}
+
+}
+
+namespace cnoid {
+
+class PCDLoader::Impl
+{
+public:
+    MappedFile file;
+    string filename;
+    int dataType;
+    int numPoints;
+    int pointSize;
+    vector<Field> fields;
+    int elementFields[NUM_ELEMENTS];
+    bool hasNormals;
+    bool hasColors;
+    const char* data;
+    size_t dataSize;
+    int currentIndex;
+
+    // For the binary data
+    struct Accessor {
+        const char* base;
+        int stride;
+        char type;
+        int size;
+        double read(int index) const { return readBinaryValue(base + index * static_cast<size_t>(stride), type, size); }
+    };
+    Accessor accessors[NUM_ELEMENTS];
+    bool isBinaryDataReady;
+    vector<char> decompressedData;
+
+    // For the ascii data
+    unique_ptr<EasyScanner> scanner;
+    vector<int> asciiValueElements;
+
+    Impl();
+    void clear();
+    void open(const string& filename);
+    void readHeader();
+    void prepareBinaryData();
+    int readBinaryPoints(int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals, SgColorArray* colors);
+    int readAsciiPoints(int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals, SgColorArray* colors);
+};
+
+}
+
+
+PCDLoader::PCDLoader()
+{
+    impl = new Impl;
+}
+
+
+PCDLoader::Impl::Impl()
+{
+    clear();
+}
+
+
+PCDLoader::~PCDLoader()
+{
+    delete impl;
+}
+
+
+void PCDLoader::Impl::clear()
+{
+    file.close();
+    dataType = PCD_ASCII;
+    numPoints = 0;
+    pointSize = 0;
+    fields.clear();
+    for(int i=0; i < NUM_ELEMENTS; ++i){
+        elementFields[i] = -1;
     }
+    hasNormals = false;
+    hasColors = false;
+    data = nullptr;
+    dataSize = 0;
+    currentIndex = 0;
+    isBinaryDataReady = false;
+    decompressedData.clear();
+    decompressedData.shrink_to_fit();
+    scanner.reset();
+    asciiValueElements.clear();
+}
+
+
+void PCDLoader::open(const std::string& filename)
+{
+    impl->open(filename);
+}
+
+
+void PCDLoader::Impl::open(const std::string& filename)
+{
+    clear();
+    this->filename = filename;
+    file.open(filename);
+    try {
+        readHeader();
+    }
+    catch(...){
+        clear();
+        throw;
+    }
+}
+
 
+void PCDLoader::close()
+{
+    impl->clear();
+}
+
+
+void PCDLoader::Impl::readHeader()
+{
+    const char* p = file.data;
+    const char* const end = file.data + file.size;
+    int width = 0;
+    int height = 1;
+    int declaredNumPoints = -1;
+    vector<int> sizes;
+    vector<char> types;
+    vector<int> counts;
+    bool isDataFound = false;
+
+    while(p < end && !isDataFound){
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(!lineEnd){
+            lineEnd = end;
+        }
+        istringstream line(string(p, lineEnd));
+        p = (lineEnd < end) ? lineEnd + 1 : end;
+
+        string key;
+        if(!(line >> key) || key[0] == '#'){
+            continue;
+        }
+        if(key == "FIELDS" || key == "COLUMNS"){
+            string name;
+            while(line >> name){
+                Field field;
+                field.name = name;
+                fields.push_back(field);
+            }
+        } else if(key == "SIZE"){
+            int size;
+            while(line >> size){
+                sizes.push_back(size);
+            }
+        } else if(key == "TYPE"){
+            char type;
+            while(line >> type){
+                types.push_back(type);
+            }
+        } else if(key == "COUNT"){
+            int count;
+            while(line >> count){
+                counts.push_back(count);
+            }
+        } else if(key == "WIDTH"){
+            line >> width;
+        } else if(key == "HEIGHT"){
+            line >> height;
+        } else if(key == "POINTS"){
+            if(!(line >> declaredNumPoints)){
+                throwReadError("The 'POINTS' field is not correctly specified.");
+            }
+        } else if(key == "DATA"){
+            string type;
+            line >> type;
+            if(type == "ascii"){
+                dataType = PCD_ASCII;
+            } else if(type == "binary"){
+                dataType = PCD_BINARY;
+            } else if(type == "binary_compressed"){
+                dataType = PCD_BINARY_COMPRESSED;
+            } else {
+                throwReadError(format("The '{}' data type is not supported.", type));
+            }
+            isDataFound = true;
+        }
+    }
+
+    if(!isDataFound){
+        throwReadError("The 'DATA' field is not found.");
+    }
+    if(fields.empty()){
+        throwReadError("The specification of field elements is not found.");
+    }
+    const int numFields = fields.size();
+    const bool isBinary = (dataType != PCD_ASCII);
+    if((!sizes.empty() || isBinary) && static_cast<int>(sizes.size()) != numFields){
+        throwReadError("The 'SIZE' field does not match the 'FIELDS' field.");
+    }
+    if((!types.empty() || isBinary) && static_cast<int>(types.size()) != numFields){
+        throwReadError("The 'TYPE' field does not match the 'FIELDS' field.");
+    }
+    if(!counts.empty() && static_cast<int>(counts.size()) != numFields){
+        throwReadError("The 'COUNT' field does not match the 'FIELDS' field.");
+    }
+
+    pointSize = 0;
+    for(int i=0; i < numFields; ++i){
+        auto& field = fields[i];
+        field.size = sizes.empty() ? 4 : sizes[i];
+        field.type = types.empty() ? 'F' : types[i];
+        field.count = counts.empty() ? 1 : counts[i];
+        if(field.count < 1 || (field.size != 1 && field.size != 2 && field.size != 4 && field.size != 8) ||
+           (field.type != 'F' && field.type != 'I' && field.type != 'U')){
+            throwReadError(format("The specification of field \"{}\" is not valid.", field.name));
+        }
+        field.offset = pointSize;
+        pointSize += field.size * field.count;
+
+        int element = -1;
+        const string& name = field.name;
+        if(name == "x"){
+            element = E_X;
+        } else if(name == "y"){
+            element = E_Y;
+        } else if(name == "z"){
+            element = E_Z;
+        } else if(name == "normal_x"){
+            element = E_NORMAL_X;
+        } else if(name == "normal_y"){
+            element = E_NORMAL_Y;
+        } else if(name == "normal_z"){
+            element = E_NORMAL_Z;
+        } else if(name == "rgb" || name == "rgba"){
+            if(field.size == 4){
+                element = E_RGB;
+            }
+        }
+        if(element >= 0){
+            elementFields[element] = i;
+        }
+    }
+    if(elementFields[E_X] < 0 || elementFields[E_Y] < 0 || elementFields[E_Z] < 0){
+        throwReadError("The x, y, z fields are not found.");
+    }
+    hasNormals = (elementFields[E_NORMAL_X] >= 0 && elementFields[E_NORMAL_Y] >= 0 && elementFields[E_NORMAL_Z] >= 0);
+    hasColors = (elementFields[E_RGB] >= 0);
+
+    numPoints = (declaredNumPoints >= 0) ? declaredNumPoints : width * height;
+    if(numPoints < 0){
+        throwReadError("The number of points is not valid.");
+    }
+
+    data = p;
+    dataSize = end - p;
+
+    if(dataType == PCD_ASCII){
+        for(auto& field : fields){
+            for(int i=0; i < field.count; ++i){
+                asciiValueElements.push_back(-1);
+            }
+        }
+        for(int i=0; i < NUM_ELEMENTS; ++i){
+            if(elementFields[i] >= 0){
+                int valueIndex = 0;
+                for(int j=0; j < elementFields[i]; ++j){
+                    valueIndex += fields[j].count;
+                }
+                asciiValueElements[valueIndex] = i;
+            }
+        }
+        scanner.reset(new EasyScanner);
+        scanner->setCommentChar('#');
+        scanner->setText(data, dataSize);
+
+    } else if(dataType == PCD_BINARY){
+        if(dataSize < static_cast<size_t>(numPoints) * pointSize){
+            throwReadError("The point data is truncated.");
+        }
+    } else if(dataType == PCD_BINARY_COMPRESSED){
+        if(dataSize < 8){
+            throwReadError("The compressed point data is truncated.");
+        }
+    }
+}
+
+
+int PCDLoader::dataType() const
+{
+    return impl->dataType;
+}
+
+
+int PCDLoader::numPoints() const
+{
+    return impl->numPoints;
+}
+
+
+bool PCDLoader::hasNormals() const
+{
+    return impl->hasNormals;
+}
+
+
+bool PCDLoader::hasColors() const
+{
+    return impl->hasColors;
+}
+
+
+bool PCDLoader::atEnd() const
+{
+    if(!impl->data){
+        return true;
+    }
+    if(impl->dataType == PCD_ASCII){
+        return !impl->scanner || impl->scanner->isEOF();
+    }
+    return impl->currentIndex >= impl->numPoints;
+}
+
+
+int PCDLoader::readPoints(int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals, SgColorArray* colors)
+{
+    if(!impl->data){
+        return 0;
+    }
+    if(!impl->hasNormals){
+        normals = nullptr;
+    }
+    if(!impl->hasColors){
+        colors = nullptr;
+    }
+    if(impl->dataType == PCD_ASCII){
+        return impl->readAsciiPoints(maxNumPoints, vertices, normals, colors);
+    }
+    return impl->readBinaryPoints(maxNumPoints, vertices, normals, colors);
+}
+
+
+void PCDLoader::Impl::prepareBinaryData()
+{
+    const char* binaryData = data;
+    bool isColumnMajor = false;
+
+    if(dataType == PCD_BINARY_COMPRESSED){
+        uint32_t compressedSize;
+        uint32_t uncompressedSize;
+        memcpy(&compressedSize, data, 4);
+        memcpy(&uncompressedSize, data + 4, 4);
+        if(dataSize - 8 < compressedSize){
+            throwReadError("The compressed point data is truncated.");
+        }
+        if(uncompressedSize != static_cast<size_t>(numPoints) * pointSize){
+            throwReadError("The size of the compressed point data does not match the header.");
+        }
+        decompressedData.resize(uncompressedSize);
+        if(uncompressedSize > 0){
+            if(!decompressLZF(reinterpret_cast<const unsigned char*>(data + 8), compressedSize,
+                              reinterpret_cast<unsigned char*>(&decompressedData[0]), uncompressedSize)){
+                throwReadError("The compressed point data is broken.");
+            }
+        }
+        binaryData = decompressedData.data();
+        // The compressed data is stored field by field
+        isColumnMajor = true;
+    }
+
+    for(int i=0; i < NUM_ELEMENTS; ++i){
+        const int fieldIndex = elementFields[i];
+        if(fieldIndex >= 0){
+            const Field& field = fields[fieldIndex];
+            auto& accessor = accessors[i];
+            accessor.type = field.type;
+            accessor.size = field.size;
+            if(isColumnMajor){
+                accessor.base = binaryData + static_cast<size_t>(numPoints) * field.offset;
+                accessor.stride = field.size * field.count;
+            } else {
+                accessor.base = binaryData + field.offset;
+                accessor.stride = pointSize;
+            }
+        }
+    }
+
+    isBinaryDataReady = true;
+}
+
+
+int PCDLoader::Impl::readBinaryPoints
+(int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals, SgColorArray* colors)
+{
+    if(!isBinaryDataReady){
+        try {
+            prepareBinaryData();
+        }
+        catch(...){
+            currentIndex = numPoints;
+            throw;
+        }
+    }
+
+    const int end = std::min(numPoints, currentIndex + std::max(0, maxNumPoints));
+    const int numOrgVertices = vertices.size();
+    vertices.reserve(numOrgVertices + (end - currentIndex));
+
+    const bool isFloatVertex =
+        accessors[E_X].type == 'F' && accessors[E_X].size == 4 &&
+        accessors[E_Y].type == 'F' && accessors[E_Y].size == 4 &&
+        accessors[E_Z].type == 'F' && accessors[E_Z].size == 4;
+
+    for(int i = currentIndex; i < end; ++i){
+        Vector3f vertex;
+        if(isFloatVertex){
+            const size_t index = i;
+            memcpy(&vertex.x(), accessors[E_X].base + index * accessors[E_X].stride, 4);
+            memcpy(&vertex.y(), accessors[E_Y].base + index * accessors[E_Y].stride, 4);
+            memcpy(&vertex.z(), accessors[E_Z].base + index * accessors[E_Z].stride, 4);
+        } else {
+            vertex << accessors[E_X].read(i), accessors[E_Y].read(i), accessors[E_Z].read(i);
+        }
+        // The invalid points of organized point clouds are skipped
+        if(!std::isfinite(vertex.x()) || !std::isfinite(vertex.y()) || !std::isfinite(vertex.z())){
+            continue;
+        }
+        vertices.push_back(vertex);
+        if(normals){
+            normals->emplace_back(
+                accessors[E_NORMAL_X].read(i), accessors[E_NORMAL_Y].read(i), accessors[E_NORMAL_Z].read(i));
+        }
+        if(colors){
+            RGBValue rgb;
+            memcpy(&rgb.float_value, accessors[E_RGB].base + static_cast<size_t>(i) * accessors[E_RGB].stride, 4);
+            colors->emplace_back(rgb.red / 255.0f, rgb.green / 255.0f, rgb.blue / 255.0f);
+        }
+    }
+    currentIndex = end;
+
+    if(currentIndex >= numPoints){
+        decompressedData.clear();
+        decompressedData.shrink_to_fit();
+    }
+
+    return vertices.size() - numOrgVertices;
+}
+
+
+int PCDLoader::Impl::readAsciiPoints
+(int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals, SgColorArray* colors)
+{
     Vector3f vertex = Vector3f::Zero();
     Vector3f normal = Vector3f::Zero();
     Vector3f color = Vector3f::Zero();
     RGBValue rgb;
+    const int numValues = asciiValueElements.size();
+    const bool isRGBFloat = hasColors && fields[elementFields[E_RGB]].type == 'F';
+    int numReadPoints = 0;
 
-    while(!scanner.isEOF()){
-        scanner.skipBlankLines();
-
-        bool hasIllegalValue = false;
-        for(int i=0; i < numElements; ++i){
-            //double value = scanner.readDoubleEx("Illeagel point values");
-
-            if(!scanner.readDouble()){
-                // put warning here
-                hasIllegalValue = true;
-                scanner.skipToLineEnd();
+    try {
+        while(numReadPoints < maxNumPoints){
+            scanner->skipBlankLines();
+            if(scanner->isEOF()){
                 break;
-                    
-            } else {
-                double value = scanner.doubleValue;
-                switch(elements[i]){
+            }
+            bool hasIllegalValue = false;
+            for(int i=0; i < numValues; ++i){
+                if(!scanner->readDouble()){
+                    hasIllegalValue = true;
+                    scanner->skipToLineEnd();
+                    break;
+                }
+                const double value = scanner->doubleValue;
+                switch(asciiValueElements[i]){
                 case E_X: vertex.x() = value; break;
                 case E_Y: vertex.y() = value; break;
                 case E_Z: vertex.z() = value; break;
@@ -80,28 +856,66 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
                 case E_NORMAL_Y: normal.y() = value; break;
                 case E_NORMAL_Z: normal.z() = value; break;
                 case E_RGB:
-                    rgb.float_value = value;
+                    if(isRGBFloat){
+                        rgb.float_value = value;
+                    } else {
+                        const uint32_t packed = static_cast<uint32_t>(value);
+                        memcpy(&rgb.float_value, &packed, 4);
+                    }
                     color[0] = rgb.red / 255.0;
                     color[1] = rgb.green / 255.0;
                     color[2] = rgb.blue / 255.0;
                     break;
+                default:
+                    break;
                 }
             }
-        }
-        if(!hasIllegalValue){
-            vertices->push_back(vertex);
-            if(hasNormals){
-                normals->push_back(normal);
-            }
-            if(hasColors){
-                colors->push_back(color);
+            if(!hasIllegalValue &&
+               std::isfinite(vertex.x()) && std::isfinite(vertex.y()) && std::isfinite(vertex.z())){
+                vertices.push_back(vertex);
+                if(normals){
+                    normals->push_back(normal);
+                }
+                if(colors){
+                    colors->push_back(color);
+                }
+                ++numReadPoints;
             }
+            scanner->readLFEOF();
         }
-        scanner.readLFEOF();
+    } catch(EasyScanner::Exception& ex){
+        throwReadError(ex.getFullMessage());
+    }
+
+    return numReadPoints;
+}
+
+
+void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+{
+    PCDLoader loader;
+    loader.open(filename);
+
+    const int numPoints = loader.numPoints();
+    SgVertexArrayPtr vertices = new SgVertexArray;
+    vertices->reserve(numPoints);
+    SgNormalArrayPtr normals;
+    if(loader.hasNormals()){
+        normals = new SgNormalArray;
+        normals->reserve(numPoints);
+    }
+    SgColorArrayPtr colors;
+    if(loader.hasColors()){
+        colors = new SgColorArray;
+        colors->reserve(numPoints);
+    }
+
+    while(!loader.atEnd()){
+        loader.readPoints(std::numeric_limits<int>::max(), *vertices, normals, colors);
     }
 
     if(vertices->empty()){
-        throw file_read_error() << error_info_message("No valid points");
+        throwReadError("No valid points");
     } else {
         out_pointSet->setVertices(vertices);
         out_pointSet->setNormals(normals);
@@ -111,67 +925,8 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
     }
 }
 
-}
-
 
-void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
-{
-    try {
-        EasyScanner scanner(filename);
-        scanner.setCommentChar('#');
-
-        int numPoints = 0;
-
-        std::vector<Element> elements;
-
-        while(true){
-            scanner.skipBlankLines();
-            scanner.readWordEx("Illegal header key");
-
-            if(scanner.stringValue == "FIELDS"){
-                while(scanner.readWord()){
-                    if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
-                    } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
-                    } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
-                    } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
-                    } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
-                    } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    } else if(scanner.stringValue == "rgb"){
-                        elements.push_back(E_RGB);
-                    }
-                }
-            } else if(scanner.stringValue == "POINTS"){
-                numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
-            } else if(scanner.stringValue == "DATA"){
-                scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
-                    }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
-                } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
-                }
-            } else {
-                scanner.skipToLineEnd();
-            }
-            scanner.readLFEOFex("The field value is not correctly specified.");
-        }
-    } catch(EasyScanner::Exception& ex){
-        throw file_read_error() << error_info_message(ex.getFullMessage());
-    }
-}
-
-
-void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint)
+void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint, int dataType)
 {
     if(!pointSet->hasVertices()){
         throw empty_data_error() << error_info_message("Empty pointset");
@@ -179,57 +934,68 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Iso
 
     bool hasColors = pointSet->hasColors() && pointSet->colorIndices().empty();
 
-    ofstream ofs;
-    ofs.open(fromUTF8(filename.c_str()));
-    ofs << scientific << setprecision(9);
-
-    ofs << "# .PCD v.7 - Point Cloud Data file format\n";
-    ofs << "VERSION .7\n";
-    if(hasColors){
-        ofs << "FIELDS x y z rgb\n";
-        ofs << "SIZE 4 4 4 4\n";
-        ofs << "TYPE F F F F\n";
-        ofs << "COUNT 1 1 1 1\n";
-    } else {
-        ofs << "FIELDS x y z\n";
-        ofs << "SIZE 4 4 4\n";
-        ofs << "TYPE F F F\n";
-        ofs << "COUNT 1 1 1\n";
-    }
-
     const SgVertexArray& points = *pointSet->vertices();
     const int numPoints = points.size();
-    ofs << "WIDTH " << numPoints << "\n";
-    ofs << "HEIGHT 1\n";
+    if(hasColors && static_cast<int>(pointSet->colors()->size()) < numPoints){
+        hasColors = false;
+    }
 
-    ofs << "VIEWPOINT ";
-    Isometry3::ConstTranslationPart t = viewpoint.translation();
-    ofs << t.x() << " " << t.y() << " " << t.z() << " ";
-    const Quaternion q(viewpoint.rotation());
-    ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
+    ofstream ofs;
 
-    ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
+    if(dataType == PCD_ASCII){
+        ofs.open(fromUTF8(filename.c_str()));
+        writeHeader(ofs, hasColors, numPoints, viewpoint, "ascii");
 
-    if(hasColors){
-        RGBValue rgb;
-        rgb.alpha = 0.0;
-        const SgColorArray& colors = *pointSet->colors();
-        for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            const Vector3f& c = colors[i];
-            rgb.red = (unsigned char)(255.0 * c[0]);
-            rgb.green = (unsigned char)(255.0 * c[1]);
-            rgb.blue = (unsigned char)(255.0 * c[2]);
-            ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+        if(hasColors){
+            const SgColorArray& colors = *pointSet->colors();
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                ofs << p.x() << " " << p.y() << " " << p.z() << " " << getRGBFloatValue(colors[i]) << "\n";
+            }
+        } else {
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            }
         }
     } else {
+        ofs.open(fromUTF8(filename.c_str()), ios::out | ios::binary);
+        const bool isCompressed = (dataType == PCD_BINARY_COMPRESSED);
+        writeHeader(ofs, hasColors, numPoints, viewpoint, isCompressed ? "binary_compressed" : "binary");
+
+        const int numFields = hasColors ? 4 : 3;
+        vector<float> buf(static_cast<size_t>(numPoints) * numFields);
+        const SgColorArray* colors = hasColors ? pointSet->colors() : nullptr;
         for(int i=0; i < numPoints; ++i){
             const Vector3f& p = points[i];
-            ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            float values[4] = { p.x(), p.y(), p.z(), 0.0f };
+            if(colors){
+                values[3] = getRGBFloatValue((*colors)[i]);
+            }
+            for(int j=0; j < numFields; ++j){
+                if(isCompressed){
+                    // The compressed data is stored field by field
+                    buf[static_cast<size_t>(j) * numPoints + i] = values[j];
+                } else {
+                    buf[static_cast<size_t>(i) * numFields + j] = values[j];
+                }
+            }
+        }
+        const size_t dataSize = buf.size() * sizeof(float);
+        if(!isCompressed){
+            ofs.write(reinterpret_cast<const char*>(buf.data()), dataSize);
+        } else {
+            vector<unsigned char> compressed;
+            compressLZF(reinterpret_cast<const unsigned char*>(buf.data()), dataSize, compressed);
+            const uint32_t sizes[2] = { static_cast<uint32_t>(compressed.size()), static_cast<uint32_t>(dataSize) };
+            ofs.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+            ofs.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
         }
     }
 
     ofs.close();
+
+    if(ofs.fail()){
+        throw file_read_error() << error_info_message(format("\"{}\" cannot be written.", filename));
+    }
 }
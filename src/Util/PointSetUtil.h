@@ -11,8 +11,55 @@
 
 namespace cnoid {
 
+enum PCDDataType { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
-CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity());
+CNOID_EXPORT void savePCD(
+    SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity(),
+    int dataType = PCD_ASCII);
+
+/**
+   This class reads the points of a PCD file sequentially so that a large point cloud can be
+   loaded chunk by chunk. The file is memory-mapped and the binary data is directly converted
+   into the vertex, normal and color arrays.
+   The file_read_error exception is thrown when the file cannot be read.
+*/
+class CNOID_EXPORT PCDLoader
+{
+public:
+    PCDLoader();
+    ~PCDLoader();
+
+    PCDLoader(const PCDLoader&) = delete;
+    PCDLoader& operator=(const PCDLoader&) = delete;
+
+    //! This function reads the header of the file.
+    void open(const std::string& filename);
+    void close();
+
+    int dataType() const;
+    //! The number of the points declared in the header including the invalid points
+    int numPoints() const;
+    bool hasNormals() const;
+    bool hasColors() const;
+
+    /**
+       Append at most maxNumPoints points to the given arrays. The points whose coordinates
+       are not finite values are skipped.
+       \param normals The normals are not read if this is null.
+       \param colors The colors are not read if this is null.
+       \return The number of the appended points
+    */
+    int readPoints(
+        int maxNumPoints, SgVertexArray& vertices, SgNormalArray* normals = nullptr, SgColorArray* colors = nullptr);
+
+    //! \return true if all the points have been read
+    bool atEnd() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
 
 }
 
@@ -231,12 +231,18 @@ bool PositionTagGroup::read(const Mapping* archive)
 
 
 bool PositionTagGroup::write(Mapping* archive) const
+{
+    return write(archive, true);
+}
+
+
+bool PositionTagGroup::write(Mapping* archive, bool doWriteTags) const
 {
     archive->write("type", "PositionTagGroup");
     archive->write("format_version", 1.0);
     archive->write("name", impl->name);
 
-    if(!tags_.empty()){
+    if(doWriteTags && !tags_.empty()){
         auto listing = archive->createListing("tags");
         for(auto& tag : tags_){
             MappingPtr node = new Mapping;
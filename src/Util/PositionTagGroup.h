@@ -62,6 +62,8 @@ public:
 
     bool read(const Mapping* archive);
     bool write(Mapping* archive) const;
+    //! The tags are not written when doWriteTags is false so that they can be stored in another way.
+    bool write(Mapping* archive, bool doWriteTags) const;
 
     enum CsvFormat { XYZMMRPYDEG = 0, XYZMM = 1 };
     bool loadCsvFile(const std::string& filename, CsvFormat csvFormat, std::ostream& os);
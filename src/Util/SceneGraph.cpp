@@ -11,6 +11,7 @@
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <typeindex>
 #include <mutex>
 
@@ -27,6 +28,8 @@ CloneMap::FlagId DisableMetaSceneCloning("SgObjectDisableMetaSceneCloning");
 
 const BoundingBox emptyBoundingBox;
 
+thread_local SgUpdateTransaction* currentUpdateTransaction = nullptr;
+
 }
 
 
@@ -152,6 +155,115 @@ bool SgObject::checkIfAncestorOf(SgObject* obj) const
 }
 
 
+SgUpdateTransaction::SgUpdateTransaction(int action)
+    : ownUpdate(action)
+{
+    update = &ownUpdate;
+    update->setInitialPathCapacity(16);
+    initialize();
+}
+
+
+SgUpdateTransaction::SgUpdateTransaction(SgUpdate& update)
+{
+    this->update = &update;
+    initialize();
+}
+
+
+void SgUpdateTransaction::initialize()
+{
+    outer = currentUpdateTransaction;
+    if(outer){
+        outer->update->addAction(update->action());
+    } else {
+        currentUpdateTransaction = this;
+    }
+}
+
+
+SgUpdateTransaction::~SgUpdateTransaction()
+{
+    commit();
+    if(!outer){
+        currentUpdateTransaction = nullptr;
+    }
+}
+
+
+void SgUpdateTransaction::addModifiedObject(SgObject* object)
+{
+    if(outer){
+        outer->addModifiedObject(object);
+    } else {
+        objects.push_back(object);
+    }
+}
+
+
+void SgUpdateTransaction::commit()
+{
+    if(outer){
+        return;
+    }
+
+    unordered_set<SgObject*> visitedObjects;
+    vector<SgObjectPtr> modifiedObjects;
+
+    std::function<void(SgObject* object)> invalidateBoundingBoxes =
+        [&](SgObject* object){
+            object->invalidateBoundingBox();
+            for(auto& parent : object->parents){
+                if(visitedObjects.insert(parent).second){
+                    invalidateBoundingBoxes(parent);
+                }
+            }
+        };
+
+    std::function<void(SgObject* object)> notify =
+        [&](SgObject* object){
+            update->pushNode(object);
+            object->sigUpdated_(*update);
+            for(auto& parent : object->parents){
+                if(visitedObjects.insert(parent).second){
+                    notify(parent);
+                }
+            }
+            update->popNode();
+        };
+
+    /*
+      The objects modified in the signal handlers are added to this transaction because it is
+      still the current one, so the notifications are repeated until no object is added.
+    */
+    while(!objects.empty()){
+        modifiedObjects.clear();
+        modifiedObjects.swap(objects);
+
+        /*
+          All the bounding boxes are invalidated before emitting the signals so that a bounding box
+          computed in a signal handler does not use the caches of the objects notified later.
+        */
+        if(update->hasAction(SgUpdate::GeometryModified)){
+            visitedObjects.clear();
+            for(auto& object : modifiedObjects){
+                if(visitedObjects.insert(object).second){
+                    invalidateBoundingBoxes(object);
+                }
+            }
+        }
+
+        visitedObjects.clear();
+        for(auto& object : modifiedObjects){
+            if(visitedObjects.insert(object).second){
+                update->clearPath();
+                notify(object);
+            }
+        }
+    }
+}
+
+
 const std::string& SgObject::uri() const
 {
     if(!uriInfo){
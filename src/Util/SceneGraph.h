@@ -156,11 +156,53 @@ private:
     };
     
     mutable std::unique_ptr<UriInfo> uriInfo;
+
+    friend class SgUpdateTransaction;
 };
 
 typedef ref_ptr<SgObject> SgObjectPtr;
 
 
+/**
+   This class batches the update notifications of many scene objects.
+
+   The objects modified in a transaction are registered with the addModifiedObject function
+   instead of calling their notifyUpdate functions. When the transaction is committed, the
+   sigUpdated signal of each registered object is emitted, and then the update is propagated to
+   the upper nodes so that each upper node is notified and its bounding box cache is invalidated
+   only once even if it is shared by many of the registered objects.
+
+   A transaction created while another transaction is active in the same thread is merged into
+   the outer one, and its objects are notified when the outer transaction is committed. The
+   updates of all the bodies in a frame can be aggregated in this way by creating a transaction
+   in the code that drives the frame.
+*/
+class CNOID_EXPORT SgUpdateTransaction
+{
+public:
+    SgUpdateTransaction(int action = SgUpdate::Modified);
+    //! The update object is used for the notifications if the transaction is not merged
+    SgUpdateTransaction(SgUpdate& update);
+    //! The transaction is committed if it has not been committed
+    ~SgUpdateTransaction();
+
+    SgUpdateTransaction(const SgUpdateTransaction&) = delete;
+    SgUpdateTransaction& operator=(const SgUpdateTransaction&) = delete;
+
+    bool isMerged() const { return outer != nullptr; }
+    void addModifiedObject(SgObject* object);
+    void commit();
+
+private:
+    SgUpdateTransaction* outer;
+    SgUpdate* update;
+    SgUpdate ownUpdate;
+    std::vector<SgObjectPtr> objects;
+
+    void initialize();
+};
+
+
 class CNOID_EXPORT SgNode : public SgObject
 {
 public:
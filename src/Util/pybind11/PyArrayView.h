@@ -0,0 +1,42 @@
+#ifndef CNOID_UTIL_PY_ARRAY_VIEW_H
+#define CNOID_UTIL_PY_ARRAY_VIEW_H
+
+#include <pybind11/numpy.h>
+#include <memory>
+#include <vector>
+
+namespace cnoid {
+
+/**
+   Create a NumPy array which shares the memory of a C++ container.
+   The base object is held by the array so that the memory is not released while the array
+   exists. Note that the memory may be reallocated when the size of the container is changed.
+   \param strides The strides in bytes
+*/
+template<class T>
+pybind11::array makePyArrayView(
+    const T* data, std::vector<pybind11::ssize_t> shape, std::vector<pybind11::ssize_t> strides,
+    pybind11::handle base, bool isWritable = true)
+{
+    pybind11::array_t<T> array(shape, strides, data, base);
+    if(!isWritable){
+        pybind11::detail::array_proxy(array.ptr())->flags &= ~pybind11::detail::npy_api::NPY_ARRAY_WRITEABLE_;
+    }
+    return std::move(array);
+}
+
+/**
+   Create a capsule holding a shared pointer. This can be used as the base object of an array
+   view to keep the data shared by the pointer alive.
+*/
+template<class T>
+pybind11::capsule makePySharedPtrCapsule(const std::shared_ptr<T>& ptr)
+{
+    return pybind11::capsule(
+        new std::shared_ptr<T>(ptr),
+        [](void* p){ delete reinterpret_cast<std::shared_ptr<T>*>(p); });
+}
+
+}
+
+#endif
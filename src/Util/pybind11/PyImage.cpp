@@ -0,0 +1,42 @@
+#include "PyUtil.h"
+#include "../Image.h"
+
+using namespace std;
+using namespace cnoid;
+namespace py = pybind11;
+
+namespace cnoid {
+
+void exportPyImage(py::module& m)
+{
+    typedef py::call_guard<py::gil_scoped_release> release_gil;
+
+    py::class_<Image, shared_ptr<Image>>(m, "Image", py::buffer_protocol())
+        .def(py::init<>())
+        .def(py::init<const Image&>())
+        // The buffer shares the pixels of the image as the array of (height, width, numComponents)
+        .def_buffer(
+            [](Image& self){
+                static unsigned char dummy;
+                return py::buffer_info(
+                    self.empty() ? &dummy : self.pixels(),
+                    sizeof(unsigned char), py::format_descriptor<unsigned char>::format(), 3,
+                    { self.height(), self.width(), self.numComponents() },
+                    { self.width() * self.numComponents(), self.numComponents(), 1 });
+            })
+        .def_property_readonly("empty", &Image::empty)
+        .def_property_readonly("width", &Image::width)
+        .def_property_readonly("height", &Image::height)
+        .def_property_readonly("numComponents", &Image::numComponents)
+        .def_property_readonly("hasAlphaComponent", &Image::hasAlphaComponent)
+        .def("setSize", (void(Image::*)(int, int, int)) &Image::setSize)
+        .def("setSize", (void(Image::*)(int, int)) &Image::setSize)
+        .def("reset", &Image::reset)
+        .def("clear", &Image::clear)
+        .def("applyVerticalFlip", &Image::applyVerticalFlip)
+        .def("load", [](Image& self, const std::string& filename){ return self.load(filename); }, release_gil())
+        .def("save", [](Image& self, const std::string& filename){ return self.save(filename); }, release_gil())
+        ;
+}
+
+}
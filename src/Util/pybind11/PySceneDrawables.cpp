@@ -1,6 +1,7 @@
 #include "PyUtil.h"
 #include "../SceneDrawables.h"
 #include "../CloneMap.h"
+#include <cstring>
 
 using namespace cnoid;
 namespace py = pybind11;
@@ -31,7 +32,58 @@ void exportPySceneDrawables(py::module& m)
         .def("setTransparency", &SgMaterial::setTransparency)
         ;
 
-    py::class_<SgMeshBase, SgMeshBasePtr, SgObject>(m, "SgMeshBase");
+    /*
+      The vertex array can be accessed as a NumPy array of (size, 3) sharing its memory.
+      SgNormalArray and SgColorArray are the same type as SgVertexArray.
+    */
+    py::class_<SgVertexArray, SgVertexArrayPtr, SgObject>(m, "SgVertexArray", py::buffer_protocol())
+        .def(py::init<>())
+        .def(py::init<size_t>())
+        .def(py::init(
+                 [](py::array_t<float, py::array::c_style | py::array::forcecast> points){
+                     if(points.ndim() != 2 || points.shape(1) != 3){
+                         throw std::invalid_argument("The shape of the array must be (n, 3).");
+                     }
+                     SgVertexArrayPtr vertices = new SgVertexArray(points.shape(0));
+                     if(!vertices->empty()){
+                         std::memcpy(vertices->data(), points.data(), sizeof(float) * 3 * vertices->size());
+                     }
+                     return vertices;
+                 }))
+        .def_buffer(
+            [](SgVertexArray& self){
+                static float dummy[3];
+                return py::buffer_info(
+                    self.empty() ? dummy : self.data(),
+                    sizeof(float), py::format_descriptor<float>::format(), 2,
+                    { static_cast<py::ssize_t>(self.size()), static_cast<py::ssize_t>(3) },
+                    { sizeof(Vector3f), sizeof(float) });
+            })
+        .def("__len__", &SgVertexArray::size)
+        .def_property_readonly("empty", &SgVertexArray::empty)
+        .def("resize", [](SgVertexArray& self, size_t size){ self.resize(size); })
+        .def("reserve", &SgVertexArray::reserve)
+        .def("clear", &SgVertexArray::clear)
+        ;
+
+    m.attr("SgNormalArray") = m.attr("SgVertexArray");
+    m.attr("SgColorArray") = m.attr("SgVertexArray");
+
+    py::class_<SgMeshBase, SgMeshBasePtr, SgObject>(m, "SgMeshBase")
+        .def_property("vertices",
+                      (SgVertexArray* (SgMeshBase::*)()) &SgMeshBase::vertices, &SgMeshBase::setVertices)
+        .def("setVertices", &SgMeshBase::setVertices)
+        .def("getOrCreateVertices", &SgMeshBase::getOrCreateVertices, py::arg("size") = 0)
+        .def_property("normals",
+                      (SgNormalArray* (SgMeshBase::*)()) &SgMeshBase::normals, &SgMeshBase::setNormals)
+        .def("setNormals", &SgMeshBase::setNormals)
+        .def("getOrCreateNormals", &SgMeshBase::getOrCreateNormals)
+        .def_property("colors",
+                      (SgColorArray* (SgMeshBase::*)()) &SgMeshBase::colors, &SgMeshBase::setColors)
+        .def("setColors", &SgMeshBase::setColors)
+        .def("getOrCreateColors", &SgMeshBase::getOrCreateColors, py::arg("size") = 0)
+        .def("updateBoundingBox", &SgMeshBase::updateBoundingBox)
+        ;
 
     py::class_<SgMesh, SgMeshPtr, SgMeshBase> sgMesh(m, "SgMesh");
 
@@ -65,6 +117,28 @@ void exportPySceneDrawables(py::module& m)
         .def("setMaterial", &SgShape::setMaterial)
         .def("getOrCreateMaterial", &SgShape::getOrCreateMaterial)
         ;
+
+    py::class_<SgPlot, SgPlotPtr, SgNode>(m, "SgPlot")
+        .def_property("vertices", (SgVertexArray* (SgPlot::*)()) &SgPlot::vertices, &SgPlot::setVertices)
+        .def("setVertices", &SgPlot::setVertices)
+        .def("getOrCreateVertices", &SgPlot::getOrCreateVertices, py::arg("size") = 0)
+        .def_property("normals", (SgNormalArray* (SgPlot::*)()) &SgPlot::normals, &SgPlot::setNormals)
+        .def("setNormals", &SgPlot::setNormals)
+        .def_property("colors", (SgColorArray* (SgPlot::*)()) &SgPlot::colors, &SgPlot::setColors)
+        .def("setColors", &SgPlot::setColors)
+        .def("getOrCreateColors", &SgPlot::getOrCreateColors, py::arg("size") = 0)
+        .def_property("material", (SgMaterial* (SgPlot::*)()) &SgPlot::material, &SgPlot::setMaterial)
+        .def("setMaterial", &SgPlot::setMaterial)
+        .def("getOrCreateMaterial", &SgPlot::getOrCreateMaterial)
+        .def("updateBoundingBox", &SgPlot::updateBoundingBox)
+        .def("clear", &SgPlot::clear)
+        ;
+
+    py::class_<SgPointSet, SgPointSetPtr, SgPlot>(m, "SgPointSet")
+        .def(py::init<>())
+        .def_property("pointSize", &SgPointSet::pointSize, &SgPointSet::setPointSize)
+        .def("setPointSize", &SgPointSet::setPointSize)
+        ;
 }
 
 }
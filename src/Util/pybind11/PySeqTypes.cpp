@@ -3,15 +3,52 @@
 */
 
 #include "../MultiValueSeq.h"
+#include "../MultiSE3Seq.h"
 #include "../ReferencedObjectSeq.h"
 #include "../ValueTree.h"
 #include "../YAMLWriter.h"
 #include "PyUtil.h"
+#include "PyArrayView.h"
 
 using namespace std;
 using namespace cnoid;
 namespace py = pybind11;
 
+namespace {
+
+typedef py::call_guard<py::gil_scoped_release> release_gil;
+
+/**
+   The view of the translation or rotation elements of a MultiSE3Seq.
+   The shape is (numFrames, numParts, 3) for the translations and (numFrames, numParts, 4)
+   for the rotations, whose elements are the quaternion coefficients in the order of x, y, z, w.
+*/
+py::array getSE3ElementArrayView(py::object self, bool isRotation)
+{
+    auto& seq = self.cast<MultiSE3Seq&>();
+    const py::ssize_t numFrames = seq.numFrames();
+    const py::ssize_t numParts = seq.numParts();
+    const py::ssize_t frameStride = sizeof(SE3) * numParts;
+    SE3* top = seq.linearizedData();
+    static SE3 dummy;
+    if(!top){
+        top = &dummy;
+    }
+    const double* data;
+    py::ssize_t numElements;
+    if(isRotation){
+        data = top->rotation().coeffs().data();
+        numElements = 4;
+    } else {
+        data = top->translation().data();
+        numElements = 3;
+    }
+    return makePyArrayView<double>(
+        data, { numFrames, numParts, numElements }, { frameStride, sizeof(SE3), sizeof(double) }, self);
+}
+
+}
+
 namespace cnoid {
 
 void exportPySeqTypes(py::module& m)
@@ -86,8 +123,18 @@ void exportPySeqTypes(py::module& m)
         ;
 
     py::class_<MultiValueSeq, shared_ptr<MultiValueSeq>, AbstractMultiSeq>
-        (m, "MultiValueSeq", py::multiple_inheritance())
+        (m, "MultiValueSeq", py::multiple_inheritance(), py::buffer_protocol())
         .def(py::init<>())
+        // The buffer shares the memory of the sequence as the array of (numFrames, numParts)
+        .def_buffer(
+            [](MultiValueSeq& self){
+                static double dummy;
+                double* data = self.linearizedData();
+                return py::buffer_info(
+                    data ? data : &dummy, sizeof(double), py::format_descriptor<double>::format(), 2,
+                    { self.numFrames(), self.numParts() },
+                    { sizeof(double) * self.numParts(), sizeof(double) });
+            })
         .def_property_readonly("empty", &MultiValueSeq::empty)
         .def("resize", &MultiValueSeq::resize)
         .def("clear", &MultiValueSeq::clear)
@@ -104,10 +151,12 @@ void exportPySeqTypes(py::module& m)
         .def("part", (MultiValueSeq::Part (MultiValueSeq::*)(int)) &MultiValueSeq::part)
         .def("loadPlainFormat",
              [](MultiValueSeq& self, const std::string& filename){
-                 return self.loadPlainFormat(filename); })
+                 return self.loadPlainFormat(filename); },
+             release_gil())
         .def("saveAsPlainFormat",
              [](MultiValueSeq& self, const std::string& filename){
-                 return self.saveAsPlainFormat(filename); })
+                 return self.saveAsPlainFormat(filename); },
+             release_gil())
         
         // deprecated
         .def("isEmpty", &MultiValueSeq::empty)
@@ -115,6 +164,30 @@ void exportPySeqTypes(py::module& m)
         .def("getPart", (MultiValueSeq::Part (MultiValueSeq::*)(int)) &MultiValueSeq::part)
         ;
 
+    py::class_<MultiSE3Seq, shared_ptr<MultiSE3Seq>, AbstractMultiSeq>
+        (m, "MultiSE3Seq", py::multiple_inheritance())
+        .def(py::init<>())
+        .def(py::init<int, int>())
+        .def_property_readonly("empty", &MultiSE3Seq::empty)
+        .def("setDimension",
+             &MultiSE3Seq::setDimension,
+             py::arg("numFrames"), py::arg("numParts"), py::arg("clearNewElements") = false)
+        .def("translationArray", [](py::object self){ return getSE3ElementArrayView(self, false); })
+        .def("rotationArray", [](py::object self){ return getSE3ElementArrayView(self, true); })
+        .def("loadPlainMatrixFormat",
+             [](MultiSE3Seq& self, const std::string& filename){
+                 return self.loadPlainMatrixFormat(filename); },
+             release_gil())
+        .def("loadPlainRpyFormat",
+             [](MultiSE3Seq& self, const std::string& filename){
+                 return self.loadPlainRpyFormat(filename); },
+             release_gil())
+        .def("saveTopPartAsPlainMatrixFormat",
+             [](MultiSE3Seq& self, const std::string& filename){
+                 return self.saveTopPartAsPlainMatrixFormat(filename); },
+             release_gil())
+        ;
+
     py::class_<ReferencedObjectSeq, shared_ptr<ReferencedObjectSeq>, AbstractSeq>
         (m, "ReferencedObjectSeq", py::multiple_inheritance())
         .def(py::init<>())
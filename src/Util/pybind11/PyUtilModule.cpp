@@ -17,6 +17,7 @@ void exportPyValueTree(py::module& m);
 void exportPyEigenTypes(py::module& m);
 void exportPyEigenArchive(py::module& m);
 void exportPySeqTypes(py::module& m);
+void exportPyImage(py::module& m);
 void exportPySceneGraph(py::module& m);
 void exportPySceneDrawables(py::module& m);
 void exportPySceneRenderer(py::module& m);
@@ -36,6 +37,7 @@ PYBIND11_MODULE(Util, m)
     exportPyEigenTypes(m);
     exportPyEigenArchive(m);
     exportPySeqTypes(m);
+    exportPyImage(m);
     exportPySceneGraph(m);
     exportPySceneDrawables(m);
     exportPySceneRenderer(m);